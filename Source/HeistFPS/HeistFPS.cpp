@@ -3,5 +3,16 @@
 #include "HeistFPS.h"
 #include "Modules/ModuleManager.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, HeistFPS, "HeistFPS" );
- 
\ No newline at end of file
+CSV_DEFINE_CATEGORY_MODULE(HEISTFPS_API, HeistFPS, true);
+
+class FHeistFPSModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		// Before any gameplay object is created, so every tagged allocation is attributed
+		FHeistMemoryTags::Register();
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FHeistFPSModule, HeistFPS, "HeistFPS" );
@@ -3,3 +3,25 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Perf/HeistPerfCounters.h"
+#include "Perf/HeistMemoryTags.h"
+
+/** Gameplay cost counters, visible with "stat HeistFPS" */
+DECLARE_STATS_GROUP(TEXT("HeistFPS"), STATGROUP_HeistFPS, STATCAT_Advanced);
+
+/** CSV profiler category, captured with "csvprofile start" or -csvCaptureFrames= */
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(HEISTFPS_API, HeistFPS);
+
+/**
+ * Times the enclosing scope as a stat cycle counter, a CSV profiler timing, an Insights CPU event and
+ * a perf harness counter. Stat must be declared with DECLARE_CYCLE_STAT(..., STATGROUP_HeistFPS).
+ */
+#define HEISTFPS_SCOPE_CYCLE_COUNTER(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	CSV_SCOPED_TIMING_STAT(HeistFPS, Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(Stat); \
+	static FHeistPerfCounter& PREPROCESSOR_JOIN(HeistPerfCounter_, __LINE__) = FHeistPerfCounters::FindOrAdd(TEXT(#Stat)); \
+	FHeistPerfScope PREPROCESSOR_JOIN(HeistPerfScope_, __LINE__)(PREPROCESSOR_JOIN(HeistPerfCounter_, __LINE__))
@@ -1,8 +1,40 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "HeistFPSGameMode.h"
+#include "HeistFPS.h"
 #include "Player/HeistFPSCharacter.h"
+#include "Game/HeistFPSGameState.h"
+#include "Game/HeistGameSession.h"
+#include "Game/HeistProfileFormat.h"
+#include "Heist/HeistInteractable.h"
+#include "Net/HeistSpectatorFeed.h"
+#include "Weapon/WeaponBase.h"
 #include "UObject/ConstructorHelpers.h"
+#include "AIController.h"
+#include "Engine/NetDriver.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerState.h"
+#include "Kismet/GameplayStatics.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/CoreDelegates.h"
+#include "TimerManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("WarmPawnPool"), STAT_HeistWarmPawnPool, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("RespawnPawn"), STAT_HeistRespawnPawn, STATGROUP_HeistFPS);
+
+static FAutoConsoleCommandWithWorldAndArgs HeistBenchRespawnCommand(
+	TEXT("heist.Bench.Respawn"),
+	TEXT("heist.Bench.Respawn [Players=16] [Waves=5] [nopool] - respawns all players in one frame per wave and logs the worst frame after each. Fails if any wave's worst frame exceeds MaxRespawnFrameMs. Server only."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		AHeistFPSGameMode* GameMode = World != nullptr ? World->GetAuthGameMode<AHeistFPSGameMode>() : nullptr;
+		if (GameMode == nullptr) { return; }
+
+		const int32 Players = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 16;
+		const int32 Waves = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 5;
+		GameMode->StartRespawnBenchmark(Players, Waves, !Args.Contains(TEXT("nopool")));
+	}));
 
 AHeistFPSGameMode::AHeistFPSGameMode()
 {
@@ -12,4 +44,455 @@ AHeistFPSGameMode::AHeistFPSGameMode()
 	{
 		DefaultPawnClass = PlayerPawnBPClass.Class;
 	}
+	GameSessionClass = AHeistGameSession::StaticClass();
+	GameStateClass = AHeistFPSGameState::StaticClass();
+}
+
+void AHeistFPSGameMode::PostLogin(APlayerController* NewPlayer)
+{
+	// The new player is already counted and its pawn spawns inside Super::PostLogin, so scale first
+	UpdateNetScaling(GetNumPlayers());
+	Super::PostLogin(NewPlayer);
+
+	AHeistFPSGameState* HeistGameState = GetGameState<AHeistFPSGameState>();
+	if (HeistGameState != nullptr && HeistGameState->GetRoundPhase() == EHeistRoundPhase::WaitingForPlayers && GetNumPlayers() >= MinPlayersToStart)
+	{
+		StartRound();
+	}
+}
+
+void AHeistFPSGameMode::StartPlay()
+{
+	Super::StartPlay();
+	WarmPawnPool();
+}
+
+void AHeistFPSGameMode::Logout(AController* Exiting)
+{
+	Super::Logout(Exiting);
+	PlayerLoadouts.Remove(Exiting);
+
+	// The exiting controller is still counted until it is destroyed
+	const bool bWasPlayer = Exiting != nullptr && Exiting->PlayerState != nullptr && !Exiting->PlayerState->IsOnlyASpectator();
+	UpdateNetScaling(GetNumPlayers() - (bWasPlayer ? 1 : 0));
+}
+
+void AHeistFPSGameMode::SetPlayerDefaults(APawn* PlayerPawn)
+{
+	Super::SetPlayerDefaults(PlayerPawn);
+
+	// Newly spawned characters start at the rate matching the current player count
+	if (PlayerPawn != nullptr && PlayerPawn->IsA<AHeistFPSCharacter>())
+	{
+		PlayerPawn->NetUpdateFrequency = CharacterNetUpdateFrequency;
+
+		const TArray<TSubclassOf<AWeaponBase>>* Loadout = PlayerLoadouts.Find(PlayerPawn->GetController());
+		CastChecked<AHeistFPSCharacter>(PlayerPawn)->SetLoadout(Loadout != nullptr ? *Loadout : TArray<TSubclassOf<AWeaponBase>>());
+	}
+}
+
+APawn* AHeistFPSGameMode::SpawnDefaultPawnAtTransform_Implementation(AController* NewPlayer, const FTransform& SpawnTransform)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistRespawnPawn);
+	HEISTFPS_LLM_SCOPE(Characters);
+
+	if (bUsePawnPool)
+	{
+		if (AHeistFPSCharacter* Pooled = TakePooledPawn(GetDefaultPawnClassForController(NewPlayer)))
+		{
+			Pooled->ActivateFromPool(SpawnTransform);
+			return Pooled;
+		}
+	}
+	return Super::SpawnDefaultPawnAtTransform_Implementation(NewPlayer, SpawnTransform);
+}
+
+FString AHeistFPSGameMode::InitNewPlayer(APlayerController* NewPlayerController, const FUniqueNetIdRepl& UniqueId, const FString& Options, const FString& Portal)
+{
+	// Spectators are normally flagged after InitNewPlayer, too late to keep them out of the session's public slots
+	if (AHeistGameSession::IsSpectatorLogin(Options) && NewPlayerController != nullptr && NewPlayerController->PlayerState != nullptr)
+	{
+		NewPlayerController->PlayerState->SetIsOnlyASpectator(true);
+	}
+
+	//Ids come from the client's profile, so anything outside the catalog is dropped rather than trusted
+	TArray<uint16> LoadoutIds;
+	if (NewPlayerController != nullptr && FHeistProfileFormat::DecodeLoadout(UGameplayStatics::ParseOption(Options, TEXT("Loadout")), MaxLoadoutWeapons, LoadoutIds))
+	{
+		TArray<TSubclassOf<AWeaponBase>> Loadout;
+		for (uint16 WeaponId : LoadoutIds)
+		{
+			if (LoadedWeaponClasses.IsValidIndex(WeaponId) && LoadedWeaponClasses[WeaponId] != nullptr)
+			{
+				Loadout.Add(LoadedWeaponClasses[WeaponId]);
+			}
+		}
+		if (Loadout.Num() > 0)
+		{
+			PlayerLoadouts.Add(NewPlayerController, MoveTemp(Loadout));
+		}
+	}
+	return Super::InitNewPlayer(NewPlayerController, UniqueId, Options, Portal);
+}
+
+void AHeistFPSGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	// Config has been applied by now, unlike in the constructor
+	CharacterNetUpdateFrequency = MaxCharacterNetUpdateFrequency;
+
+	LoadedWeaponClasses.Reset(LoadoutWeaponClasses.Num());
+	for (const TSoftClassPtr<AWeaponBase>& WeaponClass : LoadoutWeaponClasses)
+	{
+		LoadedWeaponClasses.Add(WeaponClass.LoadSynchronous());
+	}
+}
+
+void AHeistFPSGameMode::InitGameState()
+{
+	Super::InitGameState();
+
+	if (GetNetMode() != NM_Standalone)
+	{
+		SpectatorFeed = GetWorld()->SpawnActor<AHeistSpectatorFeed>();
+	}
+
+	if (AHeistFPSGameState* HeistGameState = Cast<AHeistFPSGameState>(GameState))
+	{
+		HeistGameState->OnObjectivesChanged.AddUObject(this, &AHeistFPSGameMode::OnObjectivesChanged);
+	}
+}
+
+void AHeistFPSGameMode::Killed(AController* Killer, AHeistFPSCharacter* Victim)
+{
+	if (!ensure(Victim != nullptr)) { return; }
+
+	// No score for suicides or kills without a killer
+	AController* VictimController = Victim->GetController();
+	APlayerState* KillerState = Killer != nullptr ? Killer->PlayerState : nullptr;
+	if (KillerState != nullptr && Killer != VictimController)
+	{
+		KillerState->SetScore(KillerState->GetScore() + 1.0f);
+	}
+	Victim->Die();
+
+	// The pool takes the body back once it has lain for DeathLifeSpan
+	if (bUsePawnPool)
+	{
+		Victim->SetLifeSpan(0.0f);
+		FTimerHandle BodyTimerHandle;
+		const FTimerDelegate ReleaseDelegate = FTimerDelegate::CreateUObject(this, &AHeistFPSGameMode::ReleaseBody, TWeakObjectPtr<AHeistFPSCharacter>(Victim));
+		GetWorldTimerManager().SetTimer(BodyTimerHandle, ReleaseDelegate, FMath::Max(Victim->DeathLifeSpan, 0.1f), false);
+	}
+
+	AHeistFPSGameState* HeistGameState = GetGameState<AHeistFPSGameState>();
+	if (Cast<APlayerController>(VictimController) != nullptr && HeistGameState != nullptr && HeistGameState->GetRoundPhase() == EHeistRoundPhase::InProgress)
+	{
+		FTimerHandle RespawnTimerHandle;
+		const FTimerDelegate RespawnDelegate = FTimerDelegate::CreateUObject(this, &AHeistFPSGameMode::RespawnPlayer, TWeakObjectPtr<AController>(VictimController));
+		GetWorldTimerManager().SetTimer(RespawnTimerHandle, RespawnDelegate, FMath::Max(RespawnDelay, 0.1f), false);
+	}
+}
+
+void AHeistFPSGameMode::RespawnPlayer(TWeakObjectPtr<AController> Controller)
+{
+	AController* Player = Controller.Get();
+	AHeistFPSGameState* HeistGameState = GetGameState<AHeistFPSGameState>();
+	if (Player == nullptr || Player->GetPawn() != nullptr || HeistGameState == nullptr || HeistGameState->GetRoundPhase() != EHeistRoundPhase::InProgress) { return; }
+
+	RestartPlayer(Player);
+}
+
+void AHeistFPSGameMode::ReleaseBody(TWeakObjectPtr<AHeistFPSCharacter> Body)
+{
+	AHeistFPSCharacter* Character = Body.Get();
+	if (Character != nullptr && Character->IsDead() && !Character->IsPooled() && Character->GetController() == nullptr)
+	{
+		ReleasePawn(Character);
+	}
+}
+
+/********************************************************************
+				ROUNDS
+*********************************************************************/
+void AHeistFPSGameMode::StartRound()
+{
+	AHeistFPSGameState* HeistGameState = GetGameState<AHeistFPSGameState>();
+	if (!ensure(HeistGameState != nullptr)) { return; }
+
+	// Players already spawned on joining the first round
+	const bool bRespawnAll = HeistGameState->GetRoundNumber() > 0;
+
+	HeistGameState->ResetObjectives();
+	for (TActorIterator<AHeistInteractable> It(GetWorld()); It; ++It)
+	{
+		It->ResetForRound();
+	}
+	HeistGameState->SetRoundPhase(EHeistRoundPhase::InProgress, RoundSeconds);
+
+	if (bRespawnAll)
+	{
+		for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+		{
+			APlayerController* PC = It->Get();
+			if (PC == nullptr || (PC->PlayerState != nullptr && PC->PlayerState->IsOnlyASpectator())) { continue; }
+
+			if (AHeistFPSCharacter* OldCharacter = Cast<AHeistFPSCharacter>(PC->GetPawn()))
+			{
+				ReleasePawn(OldCharacter);
+			}
+			if (PC->GetPawn() == nullptr)
+			{
+				RestartPlayer(PC);
+			}
+		}
+	}
+
+	if (RoundSeconds > 0.0f)
+	{
+		GetWorldTimerManager().SetTimer(RoundTimerHandle, FTimerDelegate::CreateUObject(this, &AHeistFPSGameMode::EndRound, false), RoundSeconds, false);
+	}
+	UE_LOG(LogTemp, Log, TEXT("Round %d started."), HeistGameState->GetRoundNumber());
+}
+
+void AHeistFPSGameMode::EndRound(bool bObjectivesComplete)
+{
+	AHeistFPSGameState* HeistGameState = GetGameState<AHeistFPSGameState>();
+	if (HeistGameState == nullptr || HeistGameState->GetRoundPhase() != EHeistRoundPhase::InProgress) { return; }
+
+	HeistGameState->SetRoundPhase(EHeistRoundPhase::RoundOver, PostRoundSeconds);
+	GetWorldTimerManager().SetTimer(RoundTimerHandle, this, &AHeistFPSGameMode::StartRound, FMath::Max(PostRoundSeconds, 0.1f), false);
+	UE_LOG(LogTemp, Log, TEXT("Round %d over - %s, $%d secured."), HeistGameState->GetRoundNumber(), bObjectivesComplete ? TEXT("objectives complete") : TEXT("out of time"), HeistGameState->GetLootValue());
+}
+
+void AHeistFPSGameMode::OnObjectivesChanged()
+{
+	AHeistFPSGameState* HeistGameState = GetGameState<AHeistFPSGameState>();
+	if (HeistGameState != nullptr && HeistGameState->GetRoundPhase() == EHeistRoundPhase::InProgress && HeistGameState->AreObjectivesComplete())
+	{
+		EndRound(true);
+	}
+}
+
+/********************************************************************
+				PAWN POOL
+*********************************************************************/
+void AHeistFPSGameMode::WarmPawnPool()
+{
+	UClass* PawnClass = DefaultPawnClass;
+	if (!bUsePawnPool || PawnClass == nullptr || !PawnClass->IsChildOf(AHeistFPSCharacter::StaticClass())) { return; }
+
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistWarmPawnPool);
+	HEISTFPS_LLM_SCOPE(Characters);
+
+	// Inventory is spawned on the character's next tick, long before it is taken from the pool
+	AActor* PlayerStart = FindPlayerStart(nullptr);
+	const FVector Location = PlayerStart != nullptr ? PlayerStart->GetActorLocation() : FVector::ZeroVector;
+	for (int32 i = 0; i < PoolWarmPerFrame && PawnPool.Num() < PawnPoolSize; i++)
+	{
+		FActorSpawnParameters SpawnInfo;
+		SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		SpawnInfo.ObjectFlags |= RF_Transient;
+		AHeistFPSCharacter* Character = GetWorld()->SpawnActor<AHeistFPSCharacter>(PawnClass, Location, FRotator::ZeroRotator, SpawnInfo);
+		if (Character == nullptr) { break; }
+
+		Character->DeactivateForPool();
+		PawnPool.Add(Character);
+	}
+
+	if (PawnPool.Num() < PawnPoolSize)
+	{
+		PoolWarmTimerHandle = GetWorldTimerManager().SetTimerForNextTick(this, &AHeistFPSGameMode::WarmPawnPool);
+	}
+}
+
+AHeistFPSCharacter* AHeistFPSGameMode::TakePooledPawn(UClass* Class)
+{
+	AHeistFPSCharacter* Taken = nullptr;
+	for (int32 i = PawnPool.Num() - 1; i >= 0; i--)
+	{
+		AHeistFPSCharacter* Character = PawnPool[i];
+		if (Character == nullptr || Character->IsPendingKill())
+		{
+			PawnPool.RemoveAtSwap(i);
+			continue;
+		}
+		if (Character->GetClass() == Class)
+		{
+			PawnPool.RemoveAtSwap(i);
+			Taken = Character;
+			break;
+		}
+	}
+
+	if (Taken != nullptr && !GetWorldTimerManager().TimerExists(PoolWarmTimerHandle))
+	{
+		PoolWarmTimerHandle = GetWorldTimerManager().SetTimerForNextTick(this, &AHeistFPSGameMode::WarmPawnPool);
+	}
+	return Taken;
+}
+
+void AHeistFPSGameMode::ReleasePawn(AHeistFPSCharacter* Character)
+{
+	if (Character == nullptr || Character->IsPendingKill() || Character->IsPooled()) { return; }
+
+	if (AController* Controller = Character->GetController())
+	{
+		Controller->UnPossess();
+	}
+
+	if (!bUsePawnPool || PawnPool.Num() >= PawnPoolSize)
+	{
+		Character->Destroy();
+		return;
+	}
+	Character->DeactivateForPool();
+	PawnPool.Add(Character);
+}
+
+/********************************************************************
+				RESPAWN BENCHMARK
+*********************************************************************/
+void AHeistFPSGameMode::StartRespawnBenchmark(int32 NumPlayers, int32 Waves, bool bUsePool)
+{
+	if (BenchmarkWavesLeft > 0) { return; }
+
+	bBenchmarkSavedUsePool = bUsePawnPool;
+	BenchmarkSavedPawnPoolSize = PawnPoolSize;
+	bUsePawnPool = bUsePool;
+	if (bUsePool)
+	{
+		PawnPoolSize = FMath::Max(PawnPoolSize, NumPlayers);
+		WarmPawnPool();
+	}
+
+	// Bot controllers go through RestartPlayer exactly like players do
+	for (int32 i = 0; i < NumPlayers; i++)
+	{
+		if (AAIController* Controller = GetWorld()->SpawnActor<AAIController>())
+		{
+			BenchmarkControllers.Add(Controller);
+		}
+	}
+
+	BenchmarkWavesLeft = Waves;
+	BenchmarkFramesLeft = 0;
+	BenchmarkWorstMs = 0.0;
+	BenchmarkLastFrameTime = FPlatformTime::Seconds();
+	BenchmarkEndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &AHeistFPSGameMode::OnBenchmarkEndFrame);
+
+	// Leaves time for the pool to fill at PoolWarmPerFrame before the first wave
+	GetWorldTimerManager().SetTimer(BenchmarkTimerHandle, this, &AHeistFPSGameMode::RunBenchmarkWave, 3.0f, false);
+	UE_LOG(LogTemp, Log, TEXT("heist.Bench.Respawn: %d players, %d waves, pool %s."), NumPlayers, Waves, bUsePool ? TEXT("on") : TEXT("off"));
+}
+
+void AHeistFPSGameMode::RunBenchmarkWave()
+{
+	for (AController* Controller : BenchmarkControllers)
+	{
+		if (Controller != nullptr && Controller->GetPawn() == nullptr)
+		{
+			RestartPlayer(Controller);
+		}
+	}
+
+	// The next frames include the pawns' first ticks and, without the pool, inventory spawning
+	BenchmarkFramesLeft = 30;
+	BenchmarkWaveWorstMs = 0.0;
+}
+
+void AHeistFPSGameMode::OnBenchmarkEndFrame()
+{
+	//Idle time is the sleep at the start of the frame that holds the server's tick rate
+	const double Now = FPlatformTime::Seconds();
+	const double FrameMs = FMath::Max(Now - BenchmarkLastFrameTime - FApp::GetIdleTime(), 0.0) * 1000.0;
+	BenchmarkLastFrameTime = Now;
+	if (BenchmarkFramesLeft <= 0) { return; }
+
+	BenchmarkWaveWorstMs = FMath::Max(BenchmarkWaveWorstMs, FrameMs);
+	if (--BenchmarkFramesLeft > 0) { return; }
+
+	int32 Spawned = 0;
+	for (AController* Controller : BenchmarkControllers)
+	{
+		if (Controller != nullptr && Controller->GetPawn() != nullptr)
+		{
+			Spawned++;
+			ReleasePawn(Cast<AHeistFPSCharacter>(Controller->GetPawn()));
+		}
+	}
+	BenchmarkWorstMs = FMath::Max(BenchmarkWorstMs, BenchmarkWaveWorstMs);
+	UE_LOG(LogTemp, Log, TEXT("heist.Bench.Respawn: wave respawned %d - worst frame %.2f ms."), Spawned, BenchmarkWaveWorstMs);
+
+	if (--BenchmarkWavesLeft > 0)
+	{
+		// Releasing happens now, outside the measured frames, and the pool refills before the next wave
+		GetWorldTimerManager().SetTimer(BenchmarkTimerHandle, this, &AHeistFPSGameMode::RunBenchmarkWave, 2.0f, false);
+		return;
+	}
+	FinishRespawnBenchmark();
+}
+
+void AHeistFPSGameMode::FinishRespawnBenchmark()
+{
+	FCoreDelegates::OnEndFrame.Remove(BenchmarkEndFrameHandle);
+	for (AController* Controller : BenchmarkControllers)
+	{
+		if (Controller != nullptr)
+		{
+			ReleasePawn(Cast<AHeistFPSCharacter>(Controller->GetPawn()));
+			Controller->Destroy();
+		}
+	}
+	BenchmarkControllers.Reset();
+
+	const bool bPassed = BenchmarkWorstMs <= MaxRespawnFrameMs;
+	UE_LOG(LogTemp, Log, TEXT("heist.Bench.Respawn: done - worst frame %.2f ms (budget %.1f ms) with the pool %s - %s."),
+		BenchmarkWorstMs, MaxRespawnFrameMs, bUsePawnPool ? TEXT("on") : TEXT("off"), bPassed ? TEXT("PASSED") : TEXT("FAILED"));
+	if (!bPassed)
+	{
+		UE_LOG(LogTemp, Error, TEXT("heist.Bench.Respawn: a respawn wave went over MaxRespawnFrameMs."));
+	}
+	bUsePawnPool = bBenchmarkSavedUsePool;
+
+	// Pawns the benchmark grew the pool by are not kept past it
+	PawnPoolSize = BenchmarkSavedPawnPoolSize;
+	while (PawnPool.Num() > PawnPoolSize)
+	{
+		if (AHeistFPSCharacter* Extra = PawnPool.Pop())
+		{
+			Extra->Destroy();
+		}
+	}
+}
+
+float AHeistFPSGameMode::GetPlayerLoadAlpha(int32 NumPlayers) const
+{
+	const int32 Range = FMath::Max(ScaledPlayerCount - UnscaledPlayerCount, 1);
+	return FMath::Clamp(static_cast<float>(NumPlayers - UnscaledPlayerCount) / Range, 0.0f, 1.0f);
+}
+
+void AHeistFPSGameMode::UpdateNetScaling(int32 NumPlayers)
+{
+	const float Alpha = GetPlayerLoadAlpha(NumPlayers);
+	CharacterNetUpdateFrequency = FMath::Lerp(MaxCharacterNetUpdateFrequency, MinCharacterNetUpdateFrequency, Alpha);
+	const int32 ServerTickRate = FMath::RoundToInt(FMath::Lerp(static_cast<float>(MaxServerTickRate), static_cast<float>(MinServerTickRate), Alpha));
+
+	UWorld* World = GetWorld();
+	if (!ensure(World != nullptr)) { return; }
+
+	// Fewer net ticks per second keeps server frame time flat as replication work grows with player count
+	UNetDriver* NetDriver = World->GetNetDriver();
+	if (NetDriver != nullptr)
+	{
+		NetDriver->NetServerMaxTickRate = ServerTickRate;
+	}
+
+	for (TActorIterator<AHeistFPSCharacter> It(World); It; ++It)
+	{
+		It->NetUpdateFrequency = CharacterNetUpdateFrequency;
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Net scaling for %d players: character NetUpdateFrequency %.1f, server tick rate %d."), NumPlayers, CharacterNetUpdateFrequency, ServerTickRate);
 }
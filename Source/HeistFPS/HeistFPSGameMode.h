@@ -6,13 +6,165 @@
 #include "GameFramework/GameModeBase.h"
 #include "HeistFPSGameMode.generated.h"
 
-UCLASS(minimalapi)
+UCLASS(minimalapi, config=Game)
 class AHeistFPSGameMode : public AGameModeBase
 {
 	GENERATED_BODY()
 
 public:
 	AHeistFPSGameMode();
+
+	virtual void PostLogin(APlayerController* NewPlayer) override;
+
+	virtual void Logout(AController* Exiting) override;
+
+	virtual void SetPlayerDefaults(APawn* PlayerPawn) override;
+
+	/** Starts warming the pawn pool */
+	virtual void StartPlay() override;
+
+	/** Reuses a pooled character when one is ready, otherwise spawns under the HeistCharacters LLM tag */
+	virtual APawn* SpawnDefaultPawnAtTransform_Implementation(AController* NewPlayer, const FTransform& SpawnTransform) override;
+
+	/** Loads the loadout weapon catalog and starts characters at MaxCharacterNetUpdateFrequency */
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+
+	/** Flags ?SpectatorOnly=1 logins before the game session registers them and reads the ?Loadout= option */
+	virtual FString InitNewPlayer(APlayerController* NewPlayerController, const FUniqueNetIdRepl& UniqueId, const FString& Options, const FString& Portal = TEXT("")) override;
+
+	virtual void InitGameState() override;
+
+	/** Called by UHeistDamageSubsystem when a character's health reaches 0. Killer may be null. */
+	virtual void Killed(AController* Killer, class AHeistFPSCharacter* Victim);
+
+	/** Resets objectives and interactables and, after the first round, respawns every player at once */
+	void StartRound();
+
+	void EndRound(bool bObjectivesComplete);
+
+	/** Takes a character back into the pawn pool, or destroys it when the pool is full or disabled */
+	void ReleasePawn(class AHeistFPSCharacter* Character);
+
+	/** Recomputes rates for NumPlayers and applies them to the net driver and all characters. Also used by the perf harness for its bots. */
+	void UpdateNetScaling(int32 NumPlayers);
+
+	/** heist.Bench.Respawn - kills and respawns NumPlayers bot controllers together Waves times, logging the worst frame of each wave */
+	void StartRespawnBenchmark(int32 NumPlayers, int32 Waves, bool bUsePool);
+
+	/** Weapons a player can pick for their loadout - the profile stores indices into this list, so only append */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Loadout)
+	TArray<TSoftClassPtr<class AWeaponBase>> LoadoutWeaponClasses;
+
+	UPROPERTY(Config, EditDefaultsOnly, Category = Loadout)
+	int32 MaxLoadoutWeapons = 2;
+
+	/** Round length in seconds, 0 for no time limit */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Rounds)
+	float RoundSeconds = 900.0f;
+
+	/** Seconds between the end of one round and the start of the next */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Rounds)
+	float PostRoundSeconds = 10.0f;
+
+	UPROPERTY(Config, EditDefaultsOnly, Category = Rounds)
+	float RespawnDelay = 5.0f;
+
+	UPROPERTY(Config, EditDefaultsOnly, Category = Rounds)
+	int32 MinPlayersToStart = 1;
+
+	/** Reuse hidden, pre-spawned characters for respawns instead of spawning them */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Rounds)
+	bool bUsePawnPool = true;
+
+	/** Characters kept ready in the pool - a full team's mass respawn should not have to spawn any */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Rounds)
+	int32 PawnPoolSize = 16;
+
+	/** Characters the pool spawns per frame while it is short, so warming never hitches either */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Rounds)
+	int32 PoolWarmPerFrame = 1;
+
+	/** heist.Bench.Respawn fails if the worst server frame of any wave exceeds this, in ms */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Rounds)
+	float MaxRespawnFrameMs = 16.0f;
+
+	/** Character net update frequency with few players connected */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Scaling)
+	float MaxCharacterNetUpdateFrequency = 60.0f;
+
+	/** Character net update frequency once ScaledPlayerCount players are connected */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Scaling)
+	float MinCharacterNetUpdateFrequency = 20.0f;
+
+	/** Server net tick rate with few players connected */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Scaling)
+	int32 MaxServerTickRate = 60;
+
+	/** Server net tick rate once ScaledPlayerCount players are connected */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Scaling)
+	int32 MinServerTickRate = 30;
+
+	/** Player count up to which the max rates are used */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Scaling)
+	int32 UnscaledPlayerCount = 4;
+
+	/** Player count at which the min rates are reached */
+	UPROPERTY(Config, EditDefaultsOnly, Category = Scaling)
+	int32 ScaledPlayerCount = 32;
+
+protected:
+	/** Replicates characters to spectator-only connections - only spawned for networked games */
+	UPROPERTY(Transient)
+	class AHeistSpectatorFeed* SpectatorFeed;
+
+	/** Hidden, inactive characters with inventory attached, ready to be possessed */
+	UPROPERTY(Transient)
+	TArray<class AHeistFPSCharacter*> PawnPool;
+
+	/** LoadoutWeaponClasses resolved once in InitGame so logins never load a class */
+	UPROPERTY(Transient)
+	TArray<UClass*> LoadedWeaponClasses;
+
+	/** Weapons each player asked for when logging in - players without an entry get the character's defaults */
+	TMap<TWeakObjectPtr<AController>, TArray<TSubclassOf<class AWeaponBase>>> PlayerLoadouts;
+
+	FTimerHandle RoundTimerHandle;
+	FTimerHandle PoolWarmTimerHandle;
+
+	/** Spawns up to PoolWarmPerFrame characters into the pool and reschedules itself while it is short */
+	void WarmPawnPool();
+
+	/** Returns a pooled character of Class, or null */
+	class AHeistFPSCharacter* TakePooledPawn(UClass* Class);
+
+	void RespawnPlayer(TWeakObjectPtr<AController> Controller);
+
+	void ReleaseBody(TWeakObjectPtr<class AHeistFPSCharacter> Body);
+
+	void OnObjectivesChanged();
+
+	/** Respawn benchmark state */
+	UPROPERTY(Transient)
+	TArray<AController*> BenchmarkControllers;
+	int32 BenchmarkWavesLeft = 0;
+	int32 BenchmarkFramesLeft = 0;
+	double BenchmarkLastFrameTime = 0.0;
+	double BenchmarkWaveWorstMs = 0.0;
+	double BenchmarkWorstMs = 0.0;
+	bool bBenchmarkSavedUsePool = true;
+	int32 BenchmarkSavedPawnPoolSize = 0;
+	FDelegateHandle BenchmarkEndFrameHandle;
+	FTimerHandle BenchmarkTimerHandle;
+
+	void RunBenchmarkWave();
+	void OnBenchmarkEndFrame();
+	void FinishRespawnBenchmark();
+
+	/** Net update frequency currently applied to characters */
+	float CharacterNetUpdateFrequency = 60.0f;
+
+	/** Returns 0 at UnscaledPlayerCount players and 1 at ScaledPlayerCount players */
+	float GetPlayerLoadAlpha(int32 NumPlayers) const;
 };
 
 
@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Game/HeistDamageSubsystem.h"
+#include "HeistFPS.h"
+
+#include "HeistFPSGameMode.h"
+#include "Game/HeistFPSGameState.h"
+#include "Player/HeistFPSCharacter.h"
+#include "Weapon/HeistProjectileSubsystem.h"
+#include "Weapon/WeaponBase.h"
+
+#include "Components/CapsuleComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Controller.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("DamageResolve"), STAT_HeistDamageResolve, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("DamageBroadcastDeaths"), STAT_HeistDamageBroadcastDeaths, STATGROUP_HeistFPS);
+
+static int32 GHeistDamageBatched = 1;
+static FAutoConsoleVariableRef CVarHeistDamageBatched(
+	TEXT("heist.Damage.Batched"),
+	GHeistDamageBatched,
+	TEXT("Resolve hits and broadcast deaths once per frame (1) or as each hit lands (0, for comparison)."));
+
+void UHeistDamageSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	UHeistProjectileSubsystem* Projectiles = Cast<UHeistProjectileSubsystem>(Collection.InitializeDependency(UHeistProjectileSubsystem::StaticClass()));
+	if (Projectiles != nullptr)
+	{
+		ImpactHandle = Projectiles->OnProjectileImpact.AddUObject(this, &UHeistDamageSubsystem::OnProjectileImpact);
+	}
+}
+
+void UHeistDamageSubsystem::Deinitialize()
+{
+	UHeistProjectileSubsystem* Projectiles = GetWorld()->GetSubsystem<UHeistProjectileSubsystem>();
+	if (Projectiles != nullptr)
+	{
+		Projectiles->OnProjectileImpact.Remove(ImpactHandle);
+	}
+	PendingHits.Reset();
+	PendingDeaths.Reset();
+	Super::Deinitialize();
+}
+
+TStatId UHeistDamageSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UHeistDamageSubsystem, STATGROUP_Tickables);
+}
+
+void UHeistDamageSubsystem::Tick(float DeltaTime)
+{
+	ResolveHits();
+	BroadcastDeaths();
+}
+
+float UHeistDamageSubsystem::ComputeDamage(const FHeistDamageProfile& Profile, float Distance, bool bHeadshot)
+{
+	const float FalloffRange = FMath::Max(Profile.FalloffEnd - Profile.FalloffStart, 1.0f);
+	const float FalloffAlpha = FMath::Clamp((Distance - Profile.FalloffStart) / FalloffRange, 0.0f, 1.0f);
+	const float Damage = Profile.BaseDamage * FMath::Lerp(1.0f, Profile.MinDamageScale, FalloffAlpha);
+	return bHeadshot ? Damage * Profile.HeadshotMultiplier : Damage;
+}
+
+void UHeistDamageSubsystem::OnProjectileImpact(AActor* Instigator, const FHitResult& Hit)
+{
+	AHeistFPSCharacter* Victim = Cast<AHeistFPSCharacter>(Hit.GetActor());
+	AHeistFPSCharacter* Shooter = Cast<AHeistFPSCharacter>(Instigator);
+	if (Victim == nullptr || Shooter == nullptr || Shooter->Inventory.Num() == 0 || Shooter->Inventory[0] == nullptr) { return; }
+
+	//Rounds trace against the capsule, so the bone is only known when the mesh blocks the trace
+	const float HeadHeight = Victim->GetActorLocation().Z + Victim->GetCapsuleComponent()->GetScaledCapsuleHalfHeight() * HeadshotHeightFraction;
+	const bool bHeadshot = Hit.BoneName == HeadBoneName || Hit.ImpactPoint.Z > HeadHeight;
+
+	const float Distance = FVector::Dist(Shooter->GetActorLocation(), Hit.ImpactPoint);
+	QueueHit(Victim, Shooter->GetController(), Shooter->Inventory[0]->GetDamageProfile(), Distance, bHeadshot);
+}
+
+void UHeistDamageSubsystem::QueueHit(AHeistFPSCharacter* Victim, AController* Instigator, const FHeistDamageProfile& Profile, float Distance, bool bHeadshot)
+{
+	if (Victim == nullptr || !Victim->HasAuthority() || Victim->IsDead()) { return; }
+
+	PendingHits.Add({ Victim, Instigator, ComputeDamage(Profile, Distance, bHeadshot), bHeadshot });
+
+	if (GHeistDamageBatched == 0)
+	{
+		ResolveHits();
+		BroadcastDeaths();
+	}
+}
+
+void UHeistDamageSubsystem::ResolveHits()
+{
+	if (PendingHits.Num() == 0) { return; }
+
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistDamageResolve);
+
+	//Hits on one victim end up next to each other, so each victim's state is read and written once
+	PendingHits.Sort([](const FPendingHit& A, const FPendingHit& B) { return A.Victim.Get() < B.Victim.Get(); });
+
+	AHeistFPSGameMode* GameMode = GetWorld()->GetAuthGameMode<AHeistFPSGameMode>();
+	for (int32 First = 0; First < PendingHits.Num();)
+	{
+		AHeistFPSCharacter* Victim = PendingHits[First].Victim.Get();
+		int32 Last = First;
+		while (Last + 1 < PendingHits.Num() && PendingHits[Last + 1].Victim.Get() == Victim)
+		{
+			Last++;
+		}
+
+		if (Victim != nullptr && !Victim->IsDead())
+		{
+			float Health = Victim->GetHealth();
+			float Armor = Victim->GetArmor();
+			const FPendingHit* KillingHit = nullptr;
+			for (int32 i = First; i <= Last; i++)
+			{
+				const FPendingHit& Hit = PendingHits[i];
+				float Damage = Hit.Damage;
+				if (!Hit.bHeadshot && Armor > 0.0f)
+				{
+					const float Absorbed = FMath::Min(Damage * Victim->ArmorAbsorption, Armor);
+					Armor -= Absorbed;
+					Damage -= Absorbed;
+				}
+
+				Health -= Damage;
+				if (Health <= 0.0f)
+				{
+					KillingHit = &Hit;
+					break;
+				}
+			}
+			NumHitsResolved += Last - First + 1;
+			Victim->SetHealthAndArmor(FMath::Max(Health, 0.0f), Armor);
+
+			if (KillingHit != nullptr)
+			{
+				AController* Killer = KillingHit->Instigator.Get();
+				FHeistDeathEvent& Death = PendingDeaths.AddDefaulted_GetRef();
+				Death.Victim = Victim;
+				Death.Killer = Killer != nullptr ? Killer->PlayerState : nullptr;
+				Death.bHeadshot = KillingHit->bHeadshot;
+
+				if (GameMode != nullptr)
+				{
+					GameMode->Killed(Killer, Victim);
+				}
+				else
+				{
+					Victim->Die();
+				}
+			}
+		}
+		First = Last + 1;
+	}
+	PendingHits.Reset();
+}
+
+void UHeistDamageSubsystem::BroadcastDeaths()
+{
+	if (PendingDeaths.Num() == 0) { return; }
+
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistDamageBroadcastDeaths);
+
+	AHeistFPSGameState* GameState = GetWorld()->GetGameState<AHeistFPSGameState>();
+	if (GameState != nullptr)
+	{
+		GameState->MulticastDeaths(PendingDeaths);
+		NumDeathBroadcasts++;
+	}
+	PendingDeaths.Reset();
+}
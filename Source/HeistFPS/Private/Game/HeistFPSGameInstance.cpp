@@ -2,46 +2,93 @@
 
 
 #include "Game/HeistFPSGameInstance.h"
+#include "HeistFPS.h"
 
-#include "UObject/ConstructorHelpers.h"
 #include "Blueprint/UserWidget.h"
 #include "Engine/World.h"
+#include "TimerManager.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/Async.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
 #include "OnlineSubsystem.h"
 #include "OnlineSessionSettings.h"
 
+#include "Game/HeistUISubsystem.h"
 #include "Game/MainMenu.h"
+#include "Net/HeistMockSessionInterface.h"
 
 const static FName SESSION_NAME = TEXT("My Session");
 
+DECLARE_CYCLE_STAT(TEXT("OnCreateSessionComplete"), STAT_HeistOnCreateSessionComplete, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("OnUpdateSessionComplete"), STAT_HeistOnUpdateSessionComplete, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("OnDestroySessionComplete"), STAT_HeistOnDestroySessionComplete, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("OnFindSessionsComplete"), STAT_HeistOnFindSessionsComplete, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("OnJoinSessionComplete"), STAT_HeistOnJoinSessionComplete, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("LoadProfile"), STAT_HeistLoadProfile, STATGROUP_HeistFPS);
+
+static FAutoConsoleCommandWithWorldAndArgs HeistProfileSetLoadoutCommand(
+	TEXT("heist.Profile.SetLoadout"),
+	TEXT("heist.Profile.SetLoadout <WeaponId> [WeaponId] - sets the loadout sent when joining, as indices into the game mode's LoadoutWeaponClasses. No ids restores the default weapons."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UHeistFPSGameInstance* GameInstance = World != nullptr ? World->GetGameInstance<UHeistFPSGameInstance>() : nullptr;
+		if (GameInstance == nullptr) { return; }
+
+		TArray<uint16> Loadout;
+		for (const FString& Arg : Args)
+		{
+			Loadout.Add(static_cast<uint16>(FMath::Clamp(FCString::Atoi(*Arg), 0, 0xFFFF)));
+		}
+		GameInstance->SetLoadout(Loadout);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs HeistBenchSessionsCommand(
+	TEXT("heist.Bench.Sessions"),
+	TEXT("heist.Bench.Sessions [Sessions] [Runs] - with the mock session backend and the main menu open, refreshes the server list against Sessions synthetic sessions Runs times and logs the time per refresh."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UHeistFPSGameInstance* GameInstance = World != nullptr ? World->GetGameInstance<UHeistFPSGameInstance>() : nullptr;
+		if (GameInstance == nullptr) { return; }
+
+		const int32 NumSessions = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 5000;
+		const int32 Runs = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 10;
+		GameInstance->StartSessionBenchmark(NumSessions, Runs);
+	}));
+
 UHeistFPSGameInstance::UHeistFPSGameInstance(const FObjectInitializer &ObjectInitializer)
 {
-	//Return if PauseMenu is not found
-	ConstructorHelpers::FClassFinder<UUserWidget>PauseMenuBPClass(TEXT("/Game/UI/WBP_PauseMenu"));
-	if (!ensure(PauseMenuBPClass.Class != nullptr)) { return; }
-	PauseMenuClass = PauseMenuBPClass.Class;
-
-	//Return if MainMenu is not found
-	ConstructorHelpers::FClassFinder<UUserWidget>MainMenuBPClass(TEXT("/Game/UI/WBP_MainMenu"));
-	if (!ensure(MainMenuBPClass.Class != nullptr)) { return; }
-	MainMenuClass = MainMenuBPClass.Class;
 }
 
 void UHeistFPSGameInstance::Init()
 {
+	Super::Init();
 
-	
+	ParseHostCommandLine();
+	LoadProfile();
 
 	//Get Online SubSystem
 	IOnlineSubsystem* SubSystem = IOnlineSubsystem::Get();
+	bUseMockSessions |= FParse::Param(FCommandLine::Get(), TEXT("MockSessions"));
 
 	//Log error to console if SubSystem is null
-	if (SubSystem != nullptr)
+	if (SubSystem != nullptr || bUseMockSessions)
 	{
 		//Check if interface is valid and register OnCreate and OnDestroy Session Events
-		SessionInterface = SubSystem->GetSessionInterface();
+		if (bUseMockSessions)
+		{
+			SessionInterface = MakeShared<FHeistMockSessionInterface, ESPMode::ThreadSafe>();
+		}
+		else
+		{
+			SessionInterface = SubSystem->GetSessionInterface();
+		}
 		if (SessionInterface.IsValid())
 		{
 			SessionInterface->OnCreateSessionCompleteDelegates.AddUObject(this, &UHeistFPSGameInstance::OnCreateSessionComplete);
+			SessionInterface->OnUpdateSessionCompleteDelegates.AddUObject(this, &UHeistFPSGameInstance::OnUpdateSessionComplete);
 			SessionInterface->OnDestroySessionCompleteDelegates.AddUObject(this, &UHeistFPSGameInstance::OnDestroySessionComplete);
 			SessionInterface->OnFindSessionsCompleteDelegates.AddUObject(this, &UHeistFPSGameInstance::OnFindSessionsComplete);
 			SessionInterface->OnJoinSessionCompleteDelegates.AddUObject(this, &UHeistFPSGameInstance::OnJoinSessionComplete);
@@ -52,153 +99,475 @@ void UHeistFPSGameInstance::Init()
 	}
 }
 
+void UHeistFPSGameInstance::ParseHostCommandLine()
+{
+	const TCHAR* CommandLine = FCommandLine::Get();
+	FParse::Value(CommandLine, TEXT("MaxPlayers="), DefaultHostSettings.MaxPlayers);
+	FParse::Value(CommandLine, TEXT("HostMap="), DefaultHostSettings.MapIndex);
+	if (FParse::Param(CommandLine, TEXT("LAN")))
+	{
+		DefaultHostSettings.bIsLANMatch = true;
+	}
+	else if (FParse::Param(CommandLine, TEXT("NoLAN")))
+	{
+		DefaultHostSettings.bIsLANMatch = false;
+	}
+	FParse::Value(CommandLine, TEXT("MaxSpectators="), DefaultHostSettings.MaxSpectators);
+	DefaultHostSettings.MaxPlayers = FMath::Clamp(DefaultHostSettings.MaxPlayers, 1, MaxPlayersLimit);
+	DefaultHostSettings.MaxSpectators = FMath::Clamp(DefaultHostSettings.MaxSpectators, 0, MaxSpectatorsLimit);
+}
+
+void UHeistFPSGameInstance::Shutdown()
+{
+	if (PendingProfileWrite.IsValid())
+	{
+		PendingProfileWrite.Wait();
+	}
+
+	//The subsystem's interface outlives this instance, so its delegates must not keep pointing at it
+	if (SessionInterface.IsValid())
+	{
+		SessionInterface->ClearOnCreateSessionCompleteDelegates(this);
+		SessionInterface->ClearOnUpdateSessionCompleteDelegates(this);
+		SessionInterface->ClearOnDestroySessionCompleteDelegates(this);
+		SessionInterface->ClearOnFindSessionsCompleteDelegates(this);
+		SessionInterface->ClearOnJoinSessionCompleteDelegates(this);
+	}
+	Super::Shutdown();
+}
+
+/********************************************************************
+				PROFILE
+*********************************************************************/
+FString UHeistFPSGameInstance::GetProfilePath() const
+{
+	return FPaths::ProjectSavedDir() / TEXT("SaveGames") / ProfileFileName;
+}
+
+void UHeistFPSGameInstance::LoadProfile()
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistLoadProfile);
+
+	const double Start = FPlatformTime::Seconds();
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *GetProfilePath(), FILEREAD_Silent)) { return; }
+
+	if (!FHeistProfileFormat::Read(Bytes.GetData(), Bytes.Num(), Profile))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Profile %s could not be read - using defaults."), *GetProfilePath());
+		return;
+	}
+	UE_LOG(LogTemp, Log, TEXT("Loaded profile with %d items in %.3f ms."), Profile.Items.Num(), (FPlatformTime::Seconds() - Start) * 1000.0);
+}
+
+void UHeistFPSGameInstance::SaveProfile()
+{
+	//Saves are written in order - a save still in flight finishes before the next one starts
+	if (PendingProfileWrite.IsValid())
+	{
+		PendingProfileWrite.Wait();
+	}
+
+	TArray<uint8> Bytes;
+	FHeistProfileFormat::Write(Profile, Bytes);
+	FString FilePath = GetProfilePath();
+	PendingProfileWrite = Async(EAsyncExecution::ThreadPool, [FilePath, Bytes = MoveTemp(Bytes)]()
+	{
+		//A crash mid-write leaves the temp file behind instead of a truncated profile
+		const FString TempPath = FilePath + TEXT(".tmp");
+		if (!FFileHelper::SaveArrayToFile(Bytes, *TempPath) || !IFileManager::Get().Move(*FilePath, *TempPath, true, true))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Failed to save profile to %s."), *FilePath);
+		}
+	});
+}
+
+void UHeistFPSGameInstance::SetLoadout(const TArray<uint16>& Loadout)
+{
+	Profile.Loadout = Loadout;
+	SaveProfile();
+}
+
+FString UHeistFPSGameInstance::GetLoadoutOption() const
+{
+	return Profile.Loadout.Num() > 0 ? TEXT("?Loadout=") + FHeistProfileFormat::EncodeLoadout(Profile.Loadout) : FString();
+}
+
+FHostSettings UHeistFPSGameInstance::GetDefaultHostSettings() const
+{
+	return DefaultHostSettings;
+}
+
+TArray<FText> UHeistFPSGameInstance::GetHostableMapNames() const
+{
+	TArray<FText> MapNames;
+	for (const FMapInfo& Map : HostableMaps)
+	{
+		MapNames.Add(Map.MapName);
+	}
+	return MapNames;
+}
+
 void UHeistFPSGameInstance::LoadMainMenu()
 {
-	//Return if MainMenuClass is null
-	if (!ensure(MainMenuClass != nullptr)) { UE_LOG(LogTemp, Warning, TEXT("MainMenuClass not found.")); return; }
-	
-	MainMenu = CreateWidget<UMainMenu>(this, MainMenuClass);
-	MainMenu->SetMenuInterface(this);
-	MainMenu->Setup();
+	HEISTFPS_LLM_SCOPE(UI);
+	//Menus are cached by the UI subsystem, so this only shows the one built at startup
+	UHeistUISubsystem* UI = GetSubsystem<UHeistUISubsystem>();
+	if (!ensure(UI != nullptr)) { return; }
+
+	MainMenu = UI->ShowMainMenu(this);
+	if (MainMenu == nullptr) { UE_LOG(LogTemp, Warning, TEXT("MainMenuClass not found.")); }
 }
 
 void UHeistFPSGameInstance::TogglePauseMenu()
 {
-	//Return if PauseMenuClass is null
-	if (!ensure(PauseMenuClass != nullptr)) { return; }
-	//Only Create PauseMenu widget if it hasn't been created previously
-	if(PauseMenu == nullptr)
+	HEISTFPS_LLM_SCOPE(UI);
+	UHeistUISubsystem* UI = GetSubsystem<UHeistUISubsystem>();
+	if (!ensure(UI != nullptr)) { return; }
+	UI->TogglePauseMenu();
+}
+
+void UHeistFPSGameInstance::HostMap(const FHostSettings& Settings)
+{
+	if (!SessionInterface.IsValid()) { UE_LOG(LogTemp, Warning, TEXT("SessionInterface is not valid")); return; }
+
+	//Ignore repeated host requests while a previous one is still in flight
+	if (HostState != EHostState::Idle) { UE_LOG(LogTemp, Warning, TEXT("Host already in progress.")); return; }
+
+	PendingHostSettings = Settings;
+	PendingHostSettings.MaxPlayers = FMath::Clamp(Settings.MaxPlayers, 1, MaxPlayersLimit);
+	PendingHostSettings.MaxSpectators = FMath::Clamp(Settings.MaxSpectators, 0, MaxSpectatorsLimit);
+	PendingHostSettings.MapIndex = HostableMaps.IsValidIndex(Settings.MapIndex) ? Settings.MapIndex : 0;
+
+	HostAttempts = 0;
+	HostStartTime = FPlatformTime::Seconds();
+	StartHostStep();
+}
+
+void UHeistFPSGameInstance::StartHostStep()
+{
+	FNamedOnlineSession* ExistingSession = SessionInterface->GetNamedSession(SESSION_NAME);
+	if (ExistingSession == nullptr)
 	{
-		PauseMenu = CreateWidget<UUserWidget>(this, PauseMenuClass);
+		SetHostState(EHostState::Creating);
+		CreateSession();
+		return;
 	}
-	
-	//Return if PauseMenu or PlayerController are null
-	if (!ensure(PauseMenu != nullptr && GetFirstLocalPlayerController() != nullptr)) { return; }
-	if (PauseMenu->IsInViewport())
+
+	//A destroy started elsewhere is still running - OnDestroySessionComplete will create the session
+	if (ExistingSession->SessionState == EOnlineSessionState::Destroying)
 	{
-		//Remove pause menu from viewport and return input mode back to game only
-		PauseMenu->RemoveFromViewport();
-		FInputModeGameOnly InputModeData;
-		GetFirstLocalPlayerController()->SetInputMode(InputModeData);
-		GetFirstLocalPlayerController()->bShowMouseCursor = false;
+		SetHostState(EHostState::Destroying);
+		return;
 	}
-	else
+
+	//A session left over from joining someone else's game can't be reused - destroy it and create our own
+	if (!ExistingSession->bHosting)
 	{
-		//Add pause menu to viewport with specified z-index
-		PauseMenu->AddToViewport(1);
-		//Set GameAndUI input mode, enable cursor and set focus to pause menu
-		FInputModeGameAndUI InputModeData;
-		InputModeData.SetWidgetToFocus(PauseMenu->TakeWidget());
-		GetFirstLocalPlayerController()->SetInputMode(InputModeData);
-		GetFirstLocalPlayerController()->bShowMouseCursor = true;
+		SetHostState(EHostState::Destroying);
+		if (!SessionInterface->DestroySession(SESSION_NAME))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("DestroySession could not be started."));
+		}
+		return;
+	}
+
+	//Reuse our own session by pushing the new settings to it instead of a destroy/create round trip
+	SetHostState(EHostState::Updating);
+	FOnlineSessionSettings SessionSettings = MakeSessionSettings();
+	if (!SessionInterface->UpdateSession(SESSION_NAME, SessionSettings, true))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UpdateSession could not be started."));
 	}
 }
 
-void UHeistFPSGameInstance::HostMap()
+void UHeistFPSGameInstance::SetHostState(EHostState NewState)
 {
-	//Check if session already exist and destroy if true - otherwise create session
-	FNamedOnlineSession* ExistingSession = SessionInterface->GetNamedSession(SESSION_NAME);
-	if (ExistingSession != nullptr)
+	const double Now = FPlatformTime::Seconds();
+	if (HostState != EHostState::Idle)
 	{
-		SessionInterface->DestroySession(SESSION_NAME);
+		UE_LOG(LogTemp, Log, TEXT("Host step %s finished in %.2f ms (%.2f ms total)."),
+			*UEnum::GetValueAsString(HostState), (Now - HostStepStartTime) * 1000.0, (Now - HostStartTime) * 1000.0);
 	}
-	else {
-		CreateSession();
+	HostState = NewState;
+	HostStepStartTime = Now;
+}
+
+//Only called from the completion delegates. The NULL, Steam and mock subsystems also fire the delegate when a call
+//can't be started, so counting the false return as well would spend two attempts on one failure
+void UHeistFPSGameInstance::HandleHostFailure(const TCHAR* Reason)
+{
+	HostAttempts++;
+	UE_LOG(LogTemp, Warning, TEXT("Host step %s failed: %s (attempt %d of %d)."), *UEnum::GetValueAsString(HostState), Reason, HostAttempts, MaxHostAttempts);
+
+	if (HostAttempts >= MaxHostAttempts)
+	{
+		//Give up and leave the player on the menu so they can try again
+		SetHostState(EHostState::Idle);
+		return;
 	}
+
+	//Retry from a clean slate - destroy whatever is left of the session before creating it again
+	FTimerDelegate RetryDelegate = FTimerDelegate::CreateWeakLambda(this, [this]()
+	{
+		if (SessionInterface.IsValid() && SessionInterface->GetNamedSession(SESSION_NAME) != nullptr)
+		{
+			SetHostState(EHostState::Destroying);
+			if (!SessionInterface->DestroySession(SESSION_NAME))
+			{
+				UE_LOG(LogTemp, Warning, TEXT("DestroySession could not be started."));
+			}
+		}
+		else
+		{
+			StartHostStep();
+		}
+	});
+	GetTimerManager().SetTimer(HostRetryTimerHandle, RetryDelegate, HostRetryDelay * HostAttempts, false);
 }
 
 void UHeistFPSGameInstance::RefreshServerList()
 {
+	HEISTFPS_LLM_SCOPE(UI);
 	if (!SessionInterface.IsValid()) { return; }
-	if (!ensure(MainMenu != nullptr)) { return; }
-	MainMenu->ClearServerList();
+	//Searches also run without the menu, for the session benchmark and tests
+	if (MainMenu != nullptr)
+	{
+		MainMenu->ClearServerList();
+	}
 
 	SessionSearch = MakeShareable(new FOnlineSessionSearch());
 	if (SessionSearch.IsValid())
 	{
-		SessionSearch->bIsLanQuery = true;
+		SearchStartTime = FPlatformTime::Seconds();
+		SessionSearch->bIsLanQuery = DefaultHostSettings.bIsLANMatch;
+		SessionSearch->MaxSearchResults = MaxSearchResults;
+		if (!DefaultHostSettings.bIsLANMatch)
+		{
+			SessionSearch->QuerySettings.Set(SEARCH_PRESENCE, true, EOnlineComparisonOp::Equals);
+		}
 		SessionInterface->FindSessions(0, SessionSearch.ToSharedRef());
 	}
 }
 
+FOnlineSessionSettings UHeistFPSGameInstance::MakeSessionSettings() const
+{
+	FOnlineSessionSettings SessionSettings;
+	SessionSettings.bIsLANMatch = PendingHostSettings.bIsLANMatch;
+	SessionSettings.bShouldAdvertise = true;
+	SessionSettings.bUsesPresence = !PendingHostSettings.bIsLANMatch;
+	SessionSettings.NumPublicConnections = PendingHostSettings.MaxPlayers;
+	SessionSettings.Set(SETTING_MAPNAME, GetHostedMapURL(), EOnlineDataAdvertisementType::ViaOnlineService);
+	return SessionSettings;
+}
+
+FString UHeistFPSGameInstance::GetHostedMapURL() const
+{
+	if (HostableMaps.IsValidIndex(PendingHostSettings.MapIndex))
+	{
+		return HostableMaps[PendingHostSettings.MapIndex].MapURL.ToString();
+	}
+	return TEXT("/Game/Maps/Test/Test1");
+}
+
 void UHeistFPSGameInstance::CreateSession()
 {
 	//Check if SessionInterface is valid and print error to console if not
 	if (!SessionInterface.IsValid()) { UE_LOG(LogTemp, Warning, TEXT("SessionInterface is not valid")); return; }
 
 	//Create session with specified session name
-	FOnlineSessionSettings SessionSettings;
-	SessionSettings.bIsLANMatch = true;
-	SessionSettings.bShouldAdvertise = true;
-	SessionSettings.NumPublicConnections = 4;
-	SessionInterface->CreateSession(0, FName(SESSION_NAME), SessionSettings);
+	FOnlineSessionSettings SessionSettings = MakeSessionSettings();
+	if (!SessionInterface->CreateSession(0, FName(SESSION_NAME), SessionSettings))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("CreateSession could not be started."));
+	}
 }
 
 void UHeistFPSGameInstance::OnCreateSessionComplete(FName SessionName, bool Success)
 {
-	//Return and print error to console if session creation fails
-	if (!Success) { UE_LOG(LogTemp, Warning, TEXT("Failed to create session.")); return; }
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistOnCreateSessionComplete);
+
+	if (HostState != EHostState::Creating) { return; }
+
+	//Retry if session creation fails
+	if (!Success) { HandleHostFailure(TEXT("Failed to create session.")); return; }
+
+	TravelToHostedMap();
+}
+
+void UHeistFPSGameInstance::OnUpdateSessionComplete(FName SessionName, bool Success)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistOnUpdateSessionComplete);
+
+	if (HostState != EHostState::Updating) { return; }
+
+	//Fall back to destroy and create if the existing session could not be reused
+	if (!Success) { HandleHostFailure(TEXT("Failed to update session.")); return; }
 
+	TravelToHostedMap();
+}
+
+void UHeistFPSGameInstance::OnDestroySessionComplete(FName SessionName, bool Success)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistOnDestroySessionComplete);
+
+	if (HostState != EHostState::Destroying) { return; }
+
+	//If destroy session fails - print to console and retry
+	if (!Success) { HandleHostFailure(TEXT("Failed to destroy session.")); return; }
+	
+	SetHostState(EHostState::Creating);
+	CreateSession();
+}
+
+void UHeistFPSGameInstance::TravelToHostedMap()
+{
 	//Return if world does not exist
 	UWorld* World = GetWorld();
-	if (!ensure(World != nullptr)) { return; }
+	if (!ensure(World != nullptr)) { SetHostState(EHostState::Idle); return; }
+
+	SetHostState(EHostState::Travelling);
 
 	if (MainMenu != nullptr)
 	{
 		MainMenu->Teardown();
 	}
 
-	//Load map as listening server
-	World->ServerTravel("/Game/Maps/Test/Test1?listen");
+	//Load map as listening server - MaxPlayers and MaxSpectators are picked up by the GameSession
+	//The host's own player logs in with the travel URL's options, so its loadout rides along the same way a client's does
+	World->ServerTravel(FString::Printf(TEXT("%s?listen?MaxPlayers=%d?MaxSpectators=%d%s"), *GetHostedMapURL(), PendingHostSettings.MaxPlayers, PendingHostSettings.MaxSpectators, *GetLoadoutOption()));
+	SetHostState(EHostState::Idle);
 }
 
-void UHeistFPSGameInstance::OnDestroySessionComplete(FName SessionName, bool Success)
+void UHeistFPSGameInstance::JoinMap(uint32 SessionIndex)
 {
-	//If destroy session fails - print to console and early return
-	if (!Success) { UE_LOG(LogTemp, Warning, TEXT("Failed to destroy session.")); return; }
-	
-	CreateSession();
+	JoinSessionAt(SessionIndex, false);
 }
 
-void UHeistFPSGameInstance::JoinMap(uint32 SessionIndex)
+void UHeistFPSGameInstance::SpectateMap(uint32 SessionIndex)
+{
+	JoinSessionAt(SessionIndex, true);
+}
+
+void UHeistFPSGameInstance::JoinSessionAt(uint32 SessionIndex, bool bAsSpectator)
 {
 	if (!SessionInterface.IsValid()) { return; }
-	if (!SessionSearch.IsValid()) { return; }
+	//The list can be clicked after a refresh has shrunk or cleared the results behind it
+	if (!SessionSearch.IsValid() || !SessionSearch->SearchResults.IsValidIndex(static_cast<int32>(SessionIndex))) { return; }
 	if (MainMenu != nullptr)
 	{
 		MainMenu->Teardown();
 	}
 
+	bJoinAsSpectator = bAsSpectator;
 	SessionInterface->JoinSession(0, SESSION_NAME, SessionSearch->SearchResults[SessionIndex]);
 }
 
 void UHeistFPSGameInstance::OnFindSessionsComplete(bool Success)
 {
-	if (!Success) { UE_LOG(LogTemp, Warning, TEXT("Failed to find sessions.")); return; }
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistOnFindSessionsComplete);
+	HEISTFPS_LLM_SCOPE(UI);
+
+	const double ListStartTime = FPlatformTime::Seconds();
+	if (!Success) { UE_LOG(LogTemp, Warning, TEXT("Failed to find sessions.")); UpdateSessionBenchmark(0.0); return; }
 	if (!SessionSearch.IsValid()) { UE_LOG(LogTemp, Warning, TEXT("SessionSearch is not valid.")); return; }
 
 	TArray<FString> SessionNames;
+	SessionNames.Reserve(SessionSearch->SearchResults.Num());
 
 	for (FOnlineSessionSearchResult& Session : SessionSearch->SearchResults)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Found session: %s"), *Session.GetSessionIdStr());
+		UE_LOG(LogTemp, Verbose, TEXT("Found session: %s"), *Session.GetSessionIdStr());
 		SessionNames.Add(Session.GetSessionIdStr());
 	}
-	if (!ensure(MainMenu != nullptr)) { return; }
-	MainMenu->SetServerList(SessionNames);
+	if (MainMenu != nullptr)
+	{
+		MainMenu->SetServerList(SessionNames);
+	}
+	UpdateSessionBenchmark((FPlatformTime::Seconds() - ListStartTime) * 1000.0);
+}
+
+int32 UHeistFPSGameInstance::GetNumSearchResults() const
+{
+	return SessionSearch.IsValid() ? SessionSearch->SearchResults.Num() : 0;
+}
+
+void UHeistFPSGameInstance::StartSessionBenchmark(int32 NumSessions, int32 Runs)
+{
+	if (!bUseMockSessions) { UE_LOG(LogTemp, Warning, TEXT("heist.Bench.Sessions needs the mock session backend (-MockSessions).")); return; }
+	if (MainMenu == nullptr) { UE_LOG(LogTemp, Warning, TEXT("heist.Bench.Sessions needs the main menu open.")); return; }
+	if (SessionBenchmarkRunsLeft > 0) { UE_LOG(LogTemp, Warning, TEXT("heist.Bench.Sessions is already running.")); return; }
+
+	//Both are put back in UpdateSessionBenchmark, so the menu searches as before once the benchmark is done
+	IConsoleVariable* CountVar = IConsoleManager::Get().FindConsoleVariable(TEXT("heist.MockSessions.Count"));
+	SessionBenchmarkSavedSessionCount = CountVar != nullptr ? CountVar->GetInt() : 0;
+	SessionBenchmarkSavedMaxSearchResults = MaxSearchResults;
+	if (CountVar != nullptr)
+	{
+		CountVar->Set(NumSessions);
+	}
+	MaxSearchResults = NumSessions;
+
+	SessionBenchmarkRuns = Runs;
+	SessionBenchmarkRunsLeft = Runs;
+	SessionBenchmarkTotalMs = 0.0;
+	SessionBenchmarkWorstMs = 0.0;
+	SessionBenchmarkListMs = 0.0;
+	RefreshServerList();
+}
+
+void UHeistFPSGameInstance::UpdateSessionBenchmark(double ListMs)
+{
+	if (SessionBenchmarkRunsLeft <= 0) { return; }
+
+	const double RefreshMs = (FPlatformTime::Seconds() - SearchStartTime) * 1000.0;
+	SessionBenchmarkTotalMs += RefreshMs;
+	SessionBenchmarkWorstMs = FMath::Max(SessionBenchmarkWorstMs, RefreshMs);
+	SessionBenchmarkListMs += ListMs;
+
+	if (--SessionBenchmarkRunsLeft > 0)
+	{
+		RefreshServerList();
+		return;
+	}
+
+	//Refresh time includes the configured mock latency, list time is the menu's share of the frame the results arrive in
+	UE_LOG(LogTemp, Log, TEXT("heist.Bench.Sessions: %d refreshes of %d sessions - refresh avg %.2f ms worst %.2f ms, list avg %.2f ms."),
+		SessionBenchmarkRuns, SessionSearch.IsValid() ? SessionSearch->SearchResults.Num() : 0,
+		SessionBenchmarkTotalMs / SessionBenchmarkRuns, SessionBenchmarkWorstMs, SessionBenchmarkListMs / SessionBenchmarkRuns);
+
+	MaxSearchResults = SessionBenchmarkSavedMaxSearchResults;
+	if (IConsoleVariable* CountVar = IConsoleManager::Get().FindConsoleVariable(TEXT("heist.MockSessions.Count")))
+	{
+		CountVar->Set(SessionBenchmarkSavedSessionCount);
+	}
 }
 
 void UHeistFPSGameInstance::OnJoinSessionComplete(FName SessionName, EOnJoinSessionCompleteResult::Type Result)
 {
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistOnJoinSessionComplete);
+
 	if (!SessionInterface.IsValid()) { return; }
+	if (Result != EOnJoinSessionCompleteResult::Success) { UE_LOG(LogTemp, Warning, TEXT("Failed to join session (result %d)."), static_cast<int32>(Result)); bJoinAsSpectator = false; return; }
 
 	FString IpAddress;
 	if (!SessionInterface->GetResolvedConnectString(SessionName, IpAddress)) { UE_LOG(LogTemp, Warning, TEXT("Could not resolve connection string.")); return; }
 
-	//Return if PlayerController is null
+	//Return if there is no local player to travel with, as in automation tests
 	APlayerController* PlayerController = GetFirstLocalPlayerController();
-	if (!ensure(PlayerController != nullptr)) { return; }
+	if (PlayerController == nullptr) { UE_LOG(LogTemp, Warning, TEXT("No local player to travel with.")); return; }
 	
+	//Spectators join without a character and are limited by the server's MaxSpectators instead of MaxPlayers
+	if (bJoinAsSpectator)
+	{
+		IpAddress += TEXT("?SpectatorOnly=1");
+		bJoinAsSpectator = false;
+	}
+	else
+	{
+		IpAddress += GetLoadoutOption();
+	}
+
 	//Load map at specified IP address as client
 	PlayerController->ClientTravel(IpAddress, ETravelType::TRAVEL_Absolute);
 }
@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Game/HeistFPSGameState.h"
+#include "HeistFPS.h"
+
+#include "Net/UnrealNetwork.h"
+
+void AHeistFPSGameState::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(AHeistFPSGameState, Objectives);
+	DOREPLIFETIME(AHeistFPSGameState, LootValue);
+	DOREPLIFETIME(AHeistFPSGameState, RoundPhase);
+	DOREPLIFETIME(AHeistFPSGameState, PhaseEndTime);
+	DOREPLIFETIME(AHeistFPSGameState, RoundNumber);
+}
+
+void AHeistFPSGameState::MulticastDeaths_Implementation(const TArray<FHeistDeathEvent>& Deaths)
+{
+	OnDeaths.Broadcast(Deaths);
+}
+
+void AHeistFPSGameState::AddObjectiveStep(int32 Index)
+{
+	if (!ensure(Index >= 0 && Index <= MAX_uint8)) { return; }
+
+	if (Index >= Objectives.Num())
+	{
+		Objectives.SetNum(Index + 1);
+	}
+	FHeistObjectiveProgress& Objective = Objectives[Index];
+	Objective.Required = static_cast<uint8>(FMath::Min(Objective.Required + 1, static_cast<int32>(MAX_uint8)));
+	OnRep_Objectives();
+}
+
+void AHeistFPSGameState::AdvanceObjective(int32 Index)
+{
+	if (!Objectives.IsValidIndex(Index)) { return; }
+
+	FHeistObjectiveProgress& Objective = Objectives[Index];
+	if (Objective.Completed >= Objective.Required) { return; }
+
+	Objective.Completed++;
+	OnRep_Objectives();
+}
+
+void AHeistFPSGameState::AddLoot(int32 Value)
+{
+	LootValue += Value;
+	OnRep_Objectives();
+}
+
+bool AHeistFPSGameState::AreObjectivesComplete() const
+{
+	for (const FHeistObjectiveProgress& Objective : Objectives)
+	{
+		if (Objective.Required > 0 && !Objective.IsComplete())
+		{
+			return false;
+		}
+	}
+	return Objectives.Num() > 0;
+}
+
+void AHeistFPSGameState::ResetObjectives()
+{
+	for (FHeistObjectiveProgress& Objective : Objectives)
+	{
+		Objective.Completed = 0;
+	}
+	LootValue = 0;
+	OnRep_Objectives();
+}
+
+void AHeistFPSGameState::SetRoundPhase(EHeistRoundPhase Phase, float Seconds)
+{
+	if (Phase == EHeistRoundPhase::InProgress)
+	{
+		RoundNumber++;
+	}
+	RoundPhase = Phase;
+	PhaseEndTime = Seconds > 0.0f ? GetServerWorldTimeSeconds() + Seconds : 0.0f;
+}
+
+float AHeistFPSGameState::GetPhaseSecondsRemaining() const
+{
+	return PhaseEndTime > 0.0f ? FMath::Max(PhaseEndTime - GetServerWorldTimeSeconds(), 0.0f) : 0.0f;
+}
+
+void AHeistFPSGameState::OnRep_Objectives()
+{
+	OnObjectivesChanged.Broadcast();
+}
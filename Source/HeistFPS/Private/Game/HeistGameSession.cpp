@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Game/HeistGameSession.h"
+
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "Kismet/GameplayStatics.h"
+
+bool AHeistGameSession::IsSpectatorLogin(const FString& Options)
+{
+	return UGameplayStatics::ParseOption(Options, TEXT("SpectatorOnly")) == TEXT("1");
+}
+
+void AHeistGameSession::RegisterPlayer(APlayerController* NewPlayer, const TSharedPtr<const FUniqueNetId>& UniqueId, bool bWasFromInvite)
+{
+	//AHeistFPSGameMode::InitNewPlayer flags spectators before they are registered
+	if (NewPlayer != nullptr && NewPlayer->PlayerState != nullptr && NewPlayer->PlayerState->IsOnlyASpectator())
+	{
+		return;
+	}
+	Super::RegisterPlayer(NewPlayer, UniqueId, bWasFromInvite);
+}
+
+void AHeistGameSession::UnregisterPlayer(const APlayerController* ExitingPlayer)
+{
+	if (ExitingPlayer != nullptr && ExitingPlayer->PlayerState != nullptr && ExitingPlayer->PlayerState->IsOnlyASpectator())
+	{
+		return;
+	}
+	Super::UnregisterPlayer(ExitingPlayer);
+}
@@ -0,0 +1,169 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Game/HeistProfileFormat.h"
+#include "HeistFPS.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Crc.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+static_assert(PLATFORM_LITTLE_ENDIAN, "Profile arrays are copied straight from disk");
+
+namespace
+{
+	struct FProfileHeader
+	{
+		uint32 Magic;
+		uint16 Version;
+		uint16 HeaderSize;
+		uint32 PayloadSize;
+		uint32 PayloadCrc;
+	};
+
+	struct FProfileFixedV1
+	{
+		int64 Experience;
+		int32 Level;
+		int32 Cash;
+		uint32 NumItems;
+		uint32 NumLoadout;
+	};
+}
+
+static FAutoConsoleCommand HeistBenchProfileCommand(
+	TEXT("heist.Bench.Profile"),
+	TEXT("heist.Bench.Profile [Items=500] [Iterations=1000] - times reading a profile with Items owned items from memory and from disk against the 1 ms budget."),
+	FConsoleCommandWithArgsDelegate::CreateStatic([](const TArray<FString>& Args)
+	{
+		const int32 NumItems = Args.Num() > 0 ? FMath::Clamp(FCString::Atoi(*Args[0]), 0, 0xFFFF) : 500;
+		const int32 Iterations = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 1000;
+
+		FHeistProfile Source;
+		Source.Experience = 123456789;
+		Source.Level = 42;
+		Source.Cash = 987654;
+		for (int32 i = 0; i < NumItems; i++)
+		{
+			Source.Items.Add({ static_cast<uint16>(i), static_cast<uint16>(1 + i % 5), static_cast<uint32>(i * 31) });
+		}
+		Source.Loadout = { 0, 1 };
+
+		TArray<uint8> Bytes;
+		FHeistProfileFormat::Write(Source, Bytes);
+
+		double TotalMs = 0.0;
+		double WorstMs = 0.0;
+		bool bAllRead = true;
+		for (int32 i = 0; i < Iterations; i++)
+		{
+			FHeistProfile Profile;
+			const double Start = FPlatformTime::Seconds();
+			bAllRead &= FHeistProfileFormat::Read(Bytes.GetData(), Bytes.Num(), Profile);
+			const double Ms = (FPlatformTime::Seconds() - Start) * 1000.0;
+			TotalMs += Ms;
+			WorstMs = FMath::Max(WorstMs, Ms);
+		}
+
+		//Cold path as seen at startup - open, read and parse one file
+		const FString FilePath = FPaths::ProjectSavedDir() / TEXT("SaveGames") / TEXT("BenchProfile.hprofile");
+		FFileHelper::SaveArrayToFile(Bytes, *FilePath);
+		const double FileStart = FPlatformTime::Seconds();
+		TArray<uint8> FileBytes;
+		FHeistProfile FileProfile;
+		bAllRead &= FFileHelper::LoadFileToArray(FileBytes, *FilePath) && FHeistProfileFormat::Read(FileBytes.GetData(), FileBytes.Num(), FileProfile);
+		const double FileMs = (FPlatformTime::Seconds() - FileStart) * 1000.0;
+		IFileManager::Get().Delete(*FilePath);
+
+		UE_LOG(LogTemp, Log, TEXT("heist.Bench.Profile: %d items, %d bytes - parse avg %.4f ms, worst %.4f ms, file load %.4f ms - %s"),
+			NumItems, Bytes.Num(), TotalMs / Iterations, WorstMs, FileMs, bAllRead && FileMs < 1.0 && WorstMs < 1.0 ? TEXT("within budget") : TEXT("OVER BUDGET"));
+	}));
+
+void FHeistProfileFormat::Write(const FHeistProfile& Profile, TArray<uint8>& OutBytes)
+{
+	FProfileFixedV1 Fixed;
+	Fixed.Experience = Profile.Experience;
+	Fixed.Level = Profile.Level;
+	Fixed.Cash = Profile.Cash;
+	Fixed.NumItems = Profile.Items.Num();
+	Fixed.NumLoadout = Profile.Loadout.Num();
+
+	const int64 ItemBytes = Profile.Items.Num() * sizeof(FHeistProfileItem);
+	const int64 LoadoutBytes = Profile.Loadout.Num() * sizeof(uint16);
+	const int64 PayloadSize = sizeof(FProfileFixedV1) + ItemBytes + LoadoutBytes;
+
+	OutBytes.SetNumUninitialized(sizeof(FProfileHeader) + PayloadSize);
+	uint8* Payload = OutBytes.GetData() + sizeof(FProfileHeader);
+	FMemory::Memcpy(Payload, &Fixed, sizeof(Fixed));
+	FMemory::Memcpy(Payload + sizeof(Fixed), Profile.Items.GetData(), ItemBytes);
+	FMemory::Memcpy(Payload + sizeof(Fixed) + ItemBytes, Profile.Loadout.GetData(), LoadoutBytes);
+
+	FProfileHeader Header;
+	Header.Magic = HeistProfile::Magic;
+	Header.Version = HeistProfile::Version;
+	Header.HeaderSize = sizeof(FProfileHeader);
+	Header.PayloadSize = static_cast<uint32>(PayloadSize);
+	Header.PayloadCrc = FCrc::MemCrc32(Payload, PayloadSize);
+	FMemory::Memcpy(OutBytes.GetData(), &Header, sizeof(Header));
+}
+
+bool FHeistProfileFormat::Read(const uint8* Data, int64 Size, FHeistProfile& OutProfile)
+{
+	if (Data == nullptr || Size < static_cast<int64>(sizeof(FProfileHeader))) { return false; }
+
+	FProfileHeader Header;
+	FMemory::Memcpy(&Header, Data, sizeof(Header));
+	if (Header.Magic != HeistProfile::Magic || Header.Version == 0 || Header.HeaderSize < sizeof(FProfileHeader)) { return false; }
+	if (Header.HeaderSize + static_cast<int64>(Header.PayloadSize) != Size) { return false; }
+
+	const uint8* Payload = Data + Header.HeaderSize;
+	if (Header.PayloadSize < sizeof(FProfileFixedV1) || FCrc::MemCrc32(Payload, Header.PayloadSize) != Header.PayloadCrc) { return false; }
+
+	FProfileFixedV1 Fixed;
+	FMemory::Memcpy(&Fixed, Payload, sizeof(Fixed));
+	const int64 ItemBytes = static_cast<int64>(Fixed.NumItems) * sizeof(FHeistProfileItem);
+	const int64 LoadoutBytes = static_cast<int64>(Fixed.NumLoadout) * sizeof(uint16);
+	if (sizeof(Fixed) + ItemBytes + LoadoutBytes > Header.PayloadSize) { return false; }
+
+	OutProfile.Experience = Fixed.Experience;
+	OutProfile.Level = Fixed.Level;
+	OutProfile.Cash = Fixed.Cash;
+	OutProfile.Items.SetNumUninitialized(Fixed.NumItems);
+	FMemory::Memcpy(OutProfile.Items.GetData(), Payload + sizeof(Fixed), ItemBytes);
+	OutProfile.Loadout.SetNumUninitialized(Fixed.NumLoadout);
+	FMemory::Memcpy(OutProfile.Loadout.GetData(), Payload + sizeof(Fixed) + ItemBytes, LoadoutBytes);
+	return true;
+}
+
+FString FHeistProfileFormat::EncodeLoadout(const TArray<uint16>& Loadout)
+{
+	FString Value;
+	for (int32 i = 0; i < Loadout.Num(); i++)
+	{
+		if (i > 0)
+		{
+			Value += TEXT(".");
+		}
+		Value.AppendInt(Loadout[i]);
+	}
+	return Value;
+}
+
+bool FHeistProfileFormat::DecodeLoadout(const FString& Value, int32 MaxWeapons, TArray<uint16>& OutLoadout)
+{
+	TArray<FString> Ids;
+	Value.ParseIntoArray(Ids, TEXT("."));
+	if (Ids.Num() == 0 || Ids.Num() > MaxWeapons) { return false; }
+
+	OutLoadout.Reset(Ids.Num());
+	for (const FString& Id : Ids)
+	{
+		if (!Id.IsNumeric()) { return false; }
+		const int32 WeaponId = FCString::Atoi(*Id);
+		if (WeaponId < 0 || WeaponId > 0xFFFF) { return false; }
+		OutLoadout.Add(static_cast<uint16>(WeaponId));
+	}
+	return true;
+}
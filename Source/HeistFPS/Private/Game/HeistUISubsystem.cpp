@@ -0,0 +1,340 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Game/HeistUISubsystem.h"
+#include "HeistFPS.h"
+
+#include "Game/MainMenu.h"
+#include "Game/MenuInterface.h"
+
+#include "Blueprint/UserWidget.h"
+#include "Engine/AssetManager.h"
+#include "Engine/GameInstance.h"
+#include "Engine/StreamableManager.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/CoreDelegates.h"
+#include "UObject/UObjectGlobals.h"
+
+DECLARE_CYCLE_STAT(TEXT("MenuTransition"), STAT_HeistMenuTransition, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("MenuCreate"), STAT_HeistMenuCreate, STATGROUP_HeistFPS);
+
+static FAutoConsoleCommandWithWorldAndArgs HeistMenuTimingCommand(
+	TEXT("heist.Test.MenuTiming"),
+	TEXT("heist.Test.MenuTiming [Cycles=20] - shows and hides the main and pause menus one transition per frame and fails if a frame after a transition exceeds MaxTransitionFrameMs. Screens are built before the first transition, so their first creation and the map load back to the menu are not measured. Run with r.VSync 0."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UGameInstance* GameInstance = World != nullptr ? World->GetGameInstance() : nullptr;
+		UHeistUISubsystem* UI = GameInstance != nullptr ? GameInstance->GetSubsystem<UHeistUISubsystem>() : nullptr;
+		if (UI == nullptr) { return; }
+
+		UI->StartTimingTest(Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 20, false);
+	}));
+
+bool UHeistUISubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	return !IsRunningDedicatedServer();
+}
+
+void UHeistUISubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	PostLoadMapHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &UHeistUISubsystem::OnPostLoadMap);
+	WorldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddUObject(this, &UHeistUISubsystem::OnWorldCleanup);
+	bTestRequested = FParse::Param(FCommandLine::Get(), TEXT("HeistUITest"));
+
+	PreloadScreen(EHeistMenuScreen::MainMenu);
+}
+
+void UHeistUISubsystem::Deinitialize()
+{
+	FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(PostLoadMapHandle);
+	FWorldDelegates::OnWorldCleanup.Remove(WorldCleanupHandle);
+	FCoreDelegates::OnEndFrame.Remove(TestEndFrameHandle);
+	for (TSharedPtr<FStreamableHandle>& Handle : ScreenLoadHandles)
+	{
+		if (Handle.IsValid())
+		{
+			Handle->CancelHandle();
+			Handle.Reset();
+		}
+	}
+	Super::Deinitialize();
+}
+
+UMainMenu* UHeistUISubsystem::GetMainMenu() const
+{
+	return Cast<UMainMenu>(Screens[static_cast<int32>(EHeistMenuScreen::MainMenu)]);
+}
+
+int32 UHeistUISubsystem::GetScreenZOrder(EHeistMenuScreen Screen)
+{
+	return Screen == EHeistMenuScreen::PauseMenu ? 1 : 0;
+}
+
+/********************************************************************
+				SCREEN CACHE
+*********************************************************************/
+void UHeistUISubsystem::PreloadScreen(EHeistMenuScreen Screen)
+{
+	TSharedPtr<FStreamableHandle>& Handle = ScreenLoadHandles[static_cast<int32>(Screen)];
+	if (GetScreenWidget(Screen) != nullptr || Handle.IsValid()) { return; }
+
+	const FSoftObjectPath ClassPath = Screen == EHeistMenuScreen::MainMenu ? MainMenuClass.ToSoftObjectPath() : PauseMenuClass.ToSoftObjectPath();
+	if (ClassPath.IsNull()) { return; }
+
+	Handle = UAssetManager::GetStreamableManager().RequestAsyncLoad(ClassPath, FStreamableDelegate::CreateWeakLambda(this, [this, Screen]()
+	{
+		ScreenLoadHandles[static_cast<int32>(Screen)].Reset();
+		AttachToViewport(Screen);
+	}));
+}
+
+UUserWidget* UHeistUISubsystem::GetOrCreateScreen(EHeistMenuScreen Screen)
+{
+	UUserWidget*& Widget = GetScreenWidget(Screen);
+	if (Widget != nullptr) { return Widget; }
+
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistMenuCreate);
+	HEISTFPS_LLM_SCOPE(UI);
+
+	//Only reached before a preload finishes, which blocks on the load
+	UClass* Class = Screen == EHeistMenuScreen::MainMenu ? MainMenuClass.LoadSynchronous() : PauseMenuClass.LoadSynchronous();
+	if (!ensure(Class != nullptr)) { UE_LOG(LogTemp, Warning, TEXT("Menu class for %s not found."), *UEnum::GetValueAsString(Screen)); return nullptr; }
+
+	Widget = CreateWidget<UUserWidget>(GetGameInstance(), Class);
+	if (Widget != nullptr)
+	{
+		Widget->SetVisibility(ESlateVisibility::Collapsed);
+	}
+	return Widget;
+}
+
+void UHeistUISubsystem::AttachToViewport(EHeistMenuScreen Screen)
+{
+	if (GetGameInstance()->GetGameViewportClient() == nullptr) { return; }
+
+	UUserWidget* Widget = GetOrCreateScreen(Screen);
+	if (Widget == nullptr || Widget->IsInViewport()) { return; }
+
+	//Building the Slate tree here keeps it out of the frame the screen is first shown in
+	Widget->SetVisibility(ESlateVisibility::Collapsed);
+	Widget->AddToViewport(GetScreenZOrder(Screen));
+}
+
+void UHeistUISubsystem::OnPostLoadMap(UWorld* World)
+{
+	if (World == nullptr || World != GetGameInstance()->GetWorld()) { return; }
+
+	//Travel takes every widget out of the viewport - cached screens go back in hidden before they are needed
+	for (EHeistMenuScreen Screen : { EHeistMenuScreen::MainMenu, EHeistMenuScreen::PauseMenu })
+	{
+		if (GetScreenWidget(Screen) != nullptr)
+		{
+			AttachToViewport(Screen);
+		}
+	}
+	PreloadScreen(EHeistMenuScreen::PauseMenu);
+
+	if (bTestRequested)
+	{
+		bTestRequested = false;
+		StartTimingTest(20, true);
+	}
+}
+
+void UHeistUISubsystem::OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources)
+{
+	if (World == nullptr || World != GetGameInstance()->GetWorld()) { return; }
+
+	for (const TWeakObjectPtr<UUserWidget>& Widget : ShownWidgets)
+	{
+		if (Widget.IsValid())
+		{
+			Widget->SetVisibility(ESlateVisibility::Collapsed);
+		}
+	}
+	ShownWidgets.Reset();
+	InputController.Reset();
+	InputFocus.Reset();
+	bInputModeSet = false;
+}
+
+/********************************************************************
+				SHOW AND HIDE
+*********************************************************************/
+UMainMenu* UHeistUISubsystem::ShowMainMenu(IMenuInterface* MenuInterface)
+{
+	AttachToViewport(EHeistMenuScreen::MainMenu);
+	UMainMenu* MainMenu = GetMainMenu();
+	if (MainMenu == nullptr) { return nullptr; }
+
+	//The cached menu still shows whatever screen and list it was left on before travel
+	MainMenu->SetMenuInterface(MenuInterface);
+	MainMenu->ResetMenu();
+	ShowWidget(MainMenu);
+
+	//The game is the next thing after the main menu, so its pause menu is built while the player browses
+	PreloadScreen(EHeistMenuScreen::PauseMenu);
+	return MainMenu;
+}
+
+void UHeistUISubsystem::TogglePauseMenu()
+{
+	AttachToViewport(EHeistMenuScreen::PauseMenu);
+	UUserWidget* PauseMenu = GetScreenWidget(EHeistMenuScreen::PauseMenu);
+	if (PauseMenu == nullptr) { return; }
+
+	if (PauseMenu->GetVisibility() == ESlateVisibility::Collapsed)
+	{
+		ShowWidget(PauseMenu);
+	}
+	else
+	{
+		HideWidget(PauseMenu);
+	}
+}
+
+void UHeistUISubsystem::ShowWidget(UUserWidget* Widget)
+{
+	if (!ensure(Widget != nullptr)) { return; }
+
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistMenuTransition);
+
+	//Widgets not created through this subsystem still work, they are just added on first show
+	if (!Widget->IsInViewport())
+	{
+		Widget->AddToViewport(Widget == GetScreenWidget(EHeistMenuScreen::PauseMenu) ? GetScreenZOrder(EHeistMenuScreen::PauseMenu) : 0);
+	}
+	Widget->SetVisibility(ESlateVisibility::Visible);
+
+	ShownWidgets.Remove(Widget);
+	ShownWidgets.Add(Widget);
+	ApplyInputMode();
+}
+
+void UHeistUISubsystem::HideWidget(UUserWidget* Widget)
+{
+	if (Widget == nullptr) { return; }
+
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistMenuTransition);
+
+	Widget->SetVisibility(ESlateVisibility::Collapsed);
+	ShownWidgets.Remove(Widget);
+	ApplyInputMode();
+}
+
+void UHeistUISubsystem::ApplyInputMode()
+{
+	ShownWidgets.RemoveAll([](const TWeakObjectPtr<UUserWidget>& Widget) { return !Widget.IsValid(); });
+	UUserWidget* Focus = ShownWidgets.Num() > 0 ? ShownWidgets.Last().Get() : nullptr;
+
+	APlayerController* Controller = InputController.Get();
+	if (Controller == nullptr || Controller->GetWorld() != GetGameInstance()->GetWorld())
+	{
+		Controller = GetGameInstance()->GetFirstLocalPlayerController();
+		InputController = Controller;
+		bInputModeSet = false;
+	}
+	if (Controller == nullptr) { return; }
+
+	//Showing or hiding a screen under the focused one leaves input where it is
+	if (bInputModeSet && InputFocus.Get() == Focus) { return; }
+
+	if (Focus != nullptr)
+	{
+		FInputModeGameAndUI InputModeData;
+		InputModeData.SetWidgetToFocus(Focus->TakeWidget());
+		Controller->SetInputMode(InputModeData);
+	}
+	else
+	{
+		Controller->SetInputMode(FInputModeGameOnly());
+	}
+	Controller->bShowMouseCursor = Focus != nullptr;
+	InputFocus = Focus;
+	bInputModeSet = true;
+}
+
+/********************************************************************
+				TIMING TEST
+*********************************************************************/
+void UHeistUISubsystem::StartTimingTest(int32 Cycles, bool bExitWhenDone)
+{
+	if (TestEndFrameHandle.IsValid()) { return; }
+
+	PreloadScreen(EHeistMenuScreen::MainMenu);
+	PreloadScreen(EHeistMenuScreen::PauseMenu);
+
+	//Main menu shown, hidden, pause menu shown, hidden
+	TestStepsLeft = Cycles * 4;
+	TestTransitions = 0;
+	TestFramesToMeasure = 0;
+	TestWorstMs = 0.0;
+	bTestExitWhenDone = bExitWhenDone;
+	TestLastFrameTime = FPlatformTime::Seconds();
+	TestEndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &UHeistUISubsystem::OnTestEndFrame);
+	UE_LOG(LogTemp, Log, TEXT("heist.Test.MenuTiming: %d cycles, budget %.1f ms."), Cycles, MaxTransitionFrameMs);
+}
+
+void UHeistUISubsystem::OnTestEndFrame()
+{
+	//Idle time is the sleep that holds the frame rate limit, not work
+	const double Now = FPlatformTime::Seconds();
+	const double FrameMs = FMath::Max(Now - TestLastFrameTime - FApp::GetIdleTime(), 0.0) * 1000.0;
+	TestLastFrameTime = Now;
+
+	if (TestFramesToMeasure > 0)
+	{
+		TestWorstMs = FMath::Max(TestWorstMs, FrameMs);
+		if (FrameMs > MaxTransitionFrameMs)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("heist.Test.MenuTiming: transition %d took a %.2f ms frame."), TestTransitions, FrameMs);
+		}
+		TestFramesToMeasure--;
+		return;
+	}
+
+	if (TestStepsLeft <= 0)
+	{
+		FinishTimingTest();
+		return;
+	}
+
+	//Transitions start once both preloads are done, as they would be in play
+	if (ScreenLoadHandles[0].IsValid() || ScreenLoadHandles[1].IsValid()) { return; }
+
+	RunTestStep();
+}
+
+void UHeistUISubsystem::RunTestStep()
+{
+	switch (TestTransitions % 4)
+	{
+	case 0: ShowMainMenu(Cast<IMenuInterface>(GetGameInstance())); break;
+	case 1: HideWidget(GetMainMenu()); break;
+	default: TogglePauseMenu(); break;
+	}
+	TestTransitions++;
+	TestStepsLeft--;
+
+	//The transition's layout and paint land in the next frame, and its first render in the one after
+	TestFramesToMeasure = 2;
+}
+
+void UHeistUISubsystem::FinishTimingTest()
+{
+	FCoreDelegates::OnEndFrame.Remove(TestEndFrameHandle);
+	TestEndFrameHandle.Reset();
+
+	const bool bPassed = TestWorstMs <= MaxTransitionFrameMs;
+	UE_LOG(LogTemp, Log, TEXT("heist.Test.MenuTiming: %s - %d transitions, worst frame %.2f ms (budget %.1f ms)."),
+		bPassed ? TEXT("PASSED") : TEXT("FAILED"), TestTransitions, TestWorstMs, MaxTransitionFrameMs);
+	if (bTestExitWhenDone)
+	{
+		FPlatformMisc::RequestExitWithStatus(false, bPassed ? 0 : 1);
+	}
+}
@@ -2,12 +2,17 @@
 
 
 #include "Game/MainMenu.h"
+#include "HeistFPS.h"
 
 #include "UObject/ConstructorHelpers.h"
 #include "Components/Button.h"
 #include "Components/WidgetSwitcher.h"
 #include "Components/CircularThrobber.h"
+#include "Components/SpinBox.h"
+#include "Components/CheckBox.h"
+#include "Components/ComboBoxString.h"
 
+#include "Game/HeistUISubsystem.h"
 #include "Game/SessionBtn.h"
 
 
@@ -40,6 +45,10 @@ bool UMainMenu::Initialize()
 	JoinConfirmBtn->OnClicked.AddDynamic(this, &UMainMenu::JoinAGame);
 	if (!ensure(JoinBackBtn != nullptr)) { return false; }
 	JoinBackBtn->OnClicked.AddDynamic(this, &UMainMenu::BackToMainMenu);
+	if (JoinSpectateBtn != nullptr)
+	{
+		JoinSpectateBtn->OnClicked.AddDynamic(this, &UMainMenu::SpectateAGame);
+	}
 
 	return true;
 }
@@ -51,31 +60,73 @@ void UMainMenu::SetMenuInterface(IMenuInterface* Interface)
 
 void UMainMenu::Setup()
 {
-	UWorld* World = GetWorld();
-	if (!ensure(World != nullptr)) { return; }
-
-	this->AddToViewport();
-	FInputModeGameAndUI InputModeData;
-	InputModeData.SetWidgetToFocus(this->TakeWidget());
-	World->GetFirstPlayerController()->SetInputMode(InputModeData);
-	World->GetFirstPlayerController()->bShowMouseCursor = true;
+	UGameInstance* GameInstance = GetGameInstance();
+	UHeistUISubsystem* UI = GameInstance != nullptr ? GameInstance->GetSubsystem<UHeistUISubsystem>() : nullptr;
+	if (!ensure(UI != nullptr)) { return; }
+	UI->ShowWidget(this);
 }
 
 void UMainMenu::Teardown()
 {
-	UWorld* World = GetWorld();
-	if (!ensure(World != nullptr)) { return; }
+	UGameInstance* GameInstance = GetGameInstance();
+	UHeistUISubsystem* UI = GameInstance != nullptr ? GameInstance->GetSubsystem<UHeistUISubsystem>() : nullptr;
+	if (!ensure(UI != nullptr)) { return; }
+	UI->HideWidget(this);
+}
 
-	this->RemoveFromViewport();
-	FInputModeGameOnly InputModeData;
-	World->GetFirstPlayerController()->SetInputMode(InputModeData);
-	World->GetFirstPlayerController()->bShowMouseCursor = false;
+void UMainMenu::NativeTick(const FGeometry& MyGeometry, float InDeltaTime)
+{
+	Super::NativeTick(MyGeometry, InDeltaTime);
+	BuildPendingRows();
 }
 
 void UMainMenu::OpenHostMenu()
 {
 	if (!ensure(MainMenuSwitcher != nullptr)) { return; }
 	MainMenuSwitcher->SetActiveWidgetIndex(1);
+	PopulateHostOptions();
+}
+
+void UMainMenu::PopulateHostOptions()
+{
+	if (!ensure(MenuInterface != nullptr)) { return; }
+	FHostSettings Defaults = MenuInterface->GetDefaultHostSettings();
+
+	if (HostMaxPlayersSpin != nullptr)
+	{
+		HostMaxPlayersSpin->SetValue(Defaults.MaxPlayers);
+	}
+	if (HostLANCheck != nullptr)
+	{
+		HostLANCheck->SetIsChecked(Defaults.bIsLANMatch);
+	}
+	if (HostMapCombo != nullptr)
+	{
+		HostMapCombo->ClearOptions();
+		for (const FText& MapName : MenuInterface->GetHostableMapNames())
+		{
+			HostMapCombo->AddOption(MapName.ToString());
+		}
+		HostMapCombo->SetSelectedIndex(Defaults.MapIndex);
+	}
+}
+
+FHostSettings UMainMenu::GetSelectedHostSettings() const
+{
+	FHostSettings Settings = MenuInterface->GetDefaultHostSettings();
+	if (HostMaxPlayersSpin != nullptr)
+	{
+		Settings.MaxPlayers = FMath::RoundToInt(HostMaxPlayersSpin->GetValue());
+	}
+	if (HostLANCheck != nullptr)
+	{
+		Settings.bIsLANMatch = HostLANCheck->IsChecked();
+	}
+	if (HostMapCombo != nullptr && HostMapCombo->GetSelectedIndex() != INDEX_NONE)
+	{
+		Settings.MapIndex = HostMapCombo->GetSelectedIndex();
+	}
+	return Settings;
 }
 
 void UMainMenu::OpenJoinMenu()
@@ -88,17 +139,51 @@ void UMainMenu::OpenJoinMenu()
 
 void UMainMenu::SetServerList(TArray<FString> SessionNames)
 {
+	//Rows are filled in over the next frames so a long list never stalls one
+	PendingSessionNames = MoveTemp(SessionNames);
+	PendingRowIndex = 0;
+	if (PendingSessionNames.Num() == 0)
+	{
+		LoadingThrobber->SetVisibility(ESlateVisibility::Collapsed);
+		return;
+	}
+	BuildPendingRows();
+}
+
+void UMainMenu::BuildPendingRows()
+{
+	if (PendingRowIndex >= PendingSessionNames.Num()) { return; }
+
+	HEISTFPS_LLM_SCOPE(UI);
 	if (!ensure(SessionList != nullptr)) { return; }
 
-	for (int32 i = 0; i < SessionNames.Num(); i++)
+	const double EndTime = FPlatformTime::Seconds() + RowBuildBudgetMs / 1000.0;
+	do
 	{
-		USessionBtn* SessionBtn = CreateWidget<USessionBtn>(this, SessionBtnClass);
-		if (!ensure(SessionBtn != nullptr)) { return; }
-		SessionBtn->SetSessionName(FText::FromString(SessionNames[i]));
+		const int32 i = PendingRowIndex;
+		if (!SessionRows.IsValidIndex(i))
+		{
+			USessionBtn* NewRow = CreateWidget<USessionBtn>(this, SessionBtnClass);
+			if (!ensure(NewRow != nullptr)) { return; }
+			SessionList->AddChild(NewRow);
+			SessionRows.Add(NewRow);
+		}
+
+		USessionBtn* SessionBtn = SessionRows[i];
+		SessionBtn->SetSessionName(FText::FromString(PendingSessionNames[i]));
 		SessionBtn->Setup(this, i);
-		SessionList->AddChild(SessionBtn);
+		SessionBtn->SetVisibility(ESlateVisibility::Visible);
+		PendingRowIndex++;
+		NumShownRows = PendingRowIndex;
+	}
+	while (PendingRowIndex < PendingSessionNames.Num() && FPlatformTime::Seconds() < EndTime);
+
+	if (PendingRowIndex >= PendingSessionNames.Num())
+	{
+		PendingSessionNames.Reset();
+		PendingRowIndex = 0;
+		LoadingThrobber->SetVisibility(ESlateVisibility::Collapsed);
 	}
-	LoadingThrobber->SetVisibility(ESlateVisibility::Collapsed);
 }
 
 void UMainMenu::SetSelectedSession(uint32 InIndex)
@@ -109,10 +194,24 @@ void UMainMenu::SetSelectedSession(uint32 InIndex)
 void UMainMenu::ClearServerList()
 {
 	if (!ensure(SessionList != nullptr)) { return; }
-	SessionList->ClearChildren();
+	for (int32 i = 0; i < NumShownRows; i++)
+	{
+		SessionRows[i]->SetVisibility(ESlateVisibility::Collapsed);
+	}
+	NumShownRows = 0;
+	PendingSessionNames.Reset();
+	PendingRowIndex = 0;
+	SelectedSessionIndex.Reset();
 	LoadingThrobber->SetVisibility(ESlateVisibility::Visible);
 }
 
+void UMainMenu::ResetMenu()
+{
+	if (!ensure(MainMenuSwitcher != nullptr)) { return; }
+	MainMenuSwitcher->SetActiveWidgetIndex(0);
+	ClearServerList();
+}
+
 void UMainMenu::JoinAGame()
 {
 	if (!ensure(MenuInterface != nullptr)) { return; }
@@ -127,10 +226,23 @@ void UMainMenu::JoinAGame()
 	
 }
 
+void UMainMenu::SpectateAGame()
+{
+	if (!ensure(MenuInterface != nullptr)) { return; }
+
+	if (SelectedSessionIndex.IsSet())
+	{
+		MenuInterface->SpectateMap(SelectedSessionIndex.GetValue());
+	}
+	else {
+		UE_LOG(LogTemp, Warning, TEXT("Session index not set."));
+	}
+}
+
 void UMainMenu::HostAGame()
 {
 	if (!ensure(MenuInterface != nullptr)) { return; }
-	MenuInterface->HostMap();
+	MenuInterface->HostMap(GetSelectedHostSettings());
 }
 
 void UMainMenu::BackToMainMenu()
@@ -21,7 +21,8 @@ void USessionBtn::Setup(class UMainMenu* InParent, uint32 InIndex)
 	Parent = InParent;
 	Index = InIndex;
 
-	JoinSessionBtn->OnClicked.AddDynamic(this, &USessionBtn::OnClicked);
+	//Rows are reused across refreshes, so the handler may already be bound
+	JoinSessionBtn->OnClicked.AddUniqueDynamic(this, &USessionBtn::OnClicked);
 }
 
 void USessionBtn::OnClicked()
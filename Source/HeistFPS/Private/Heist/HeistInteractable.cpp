@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Heist/HeistInteractable.h"
+#include "HeistFPS.h"
+
+#include "Game/HeistFPSGameState.h"
+#include "Heist/HeistInteractionSubsystem.h"
+#include "Player/HeistFPSCharacter.h"
+
+#include "Components/StaticMeshComponent.h"
+#include "Engine/World.h"
+#include "Net/UnrealNetwork.h"
+#include "TimerManager.h"
+
+AHeistInteractable::AHeistInteractable()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	// Placed in the map on every machine - nothing is sent until the interactable is used up
+	bReplicates = true;
+	NetDormancy = DORM_Initial;
+
+	Mesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Mesh"));
+	Mesh->SetCollisionProfileName(UCollisionProfile::BlockAllDynamic_ProfileName);
+	SetRootComponent(Mesh);
+}
+
+void AHeistInteractable::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UHeistInteractionSubsystem* Interaction = GetWorld()->GetSubsystem<UHeistInteractionSubsystem>())
+	{
+		GridHandle = Interaction->Register(this);
+	}
+
+	AHeistFPSGameState* GameState = GetWorld()->GetGameState<AHeistFPSGameState>();
+	if (HasAuthority() && GameState != nullptr && ObjectiveIndex != INDEX_NONE)
+	{
+		GameState->AddObjectiveStep(ObjectiveIndex);
+	}
+}
+
+void AHeistInteractable::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UHeistInteractionSubsystem* Interaction = GetWorld()->GetSubsystem<UHeistInteractionSubsystem>())
+	{
+		Interaction->Unregister(this);
+	}
+	GridHandle = INDEX_NONE;
+	GetWorldTimerManager().ClearTimer(InteractTimerHandle);
+	Super::EndPlay(EndPlayReason);
+}
+
+void AHeistInteractable::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(AHeistInteractable, bCompleted);
+}
+
+void AHeistInteractable::Interact(AHeistFPSCharacter* Character)
+{
+	if (!HasAuthority() || !CanInteract() || Character == nullptr) { return; }
+
+	if (InteractSeconds <= 0.0f)
+	{
+		Interactor = Character;
+		CompleteInteract();
+		return;
+	}
+
+	// One interactor at a time - a second player has to wait for the first to finish or walk away
+	if (GetWorldTimerManager().IsTimerActive(InteractTimerHandle)) { return; }
+
+	Interactor = Character;
+	GetWorldTimerManager().SetTimer(InteractTimerHandle, this, &AHeistInteractable::CompleteInteract, InteractSeconds, false);
+}
+
+void AHeistInteractable::CompleteInteract()
+{
+	AHeistFPSCharacter* Character = Interactor.Get();
+	Interactor = nullptr;
+
+	// Held interactions fail if the interactor died or walked off
+	UHeistInteractionSubsystem* Interaction = GetWorld()->GetSubsystem<UHeistInteractionSubsystem>();
+	if (Character == nullptr || Character->IsDead() || Interaction == nullptr || !Interaction->IsInRange(Character, this)) { return; }
+
+	AHeistFPSGameState* GameState = GetWorld()->GetGameState<AHeistFPSGameState>();
+	if (GameState != nullptr)
+	{
+		if (Type == EHeistInteractableType::Loot)
+		{
+			GameState->AddLoot(LootValue);
+		}
+		if (ObjectiveIndex != INDEX_NONE)
+		{
+			GameState->AdvanceObjective(ObjectiveIndex);
+		}
+	}
+
+	FlushNetDormancy();
+	bCompleted = true;
+	OnRep_Completed();
+}
+
+void AHeistInteractable::ResetForRound()
+{
+	GetWorldTimerManager().ClearTimer(InteractTimerHandle);
+	Interactor = nullptr;
+	if (!HasAuthority() || !bCompleted) { return; }
+
+	FlushNetDormancy();
+	bCompleted = false;
+	OnRep_Completed();
+}
+
+void AHeistInteractable::OnRep_Completed()
+{
+	// Taken loot disappears, vaults and keypads stay in their completed state
+	const bool bTaken = bCompleted && Type == EHeistInteractableType::Loot;
+	SetActorHiddenInGame(bTaken);
+	SetActorEnableCollision(!bTaken);
+
+	if (bCompleted)
+	{
+		OnCompleted();
+	}
+}
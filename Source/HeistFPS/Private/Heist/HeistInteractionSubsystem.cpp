@@ -0,0 +1,157 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Heist/HeistInteractionSubsystem.h"
+#include "HeistFPS.h"
+
+#include "Heist/HeistInteractable.h"
+#include "Player/HeistFPSCharacter.h"
+
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("InteractionQuery"), STAT_HeistInteractionQuery, STATGROUP_HeistFPS);
+
+static FAutoConsoleCommandWithWorldAndArgs HeistBenchInteractionCommand(
+	TEXT("heist.Bench.Interaction"),
+	TEXT("heist.Bench.Interaction [Lootables=5000] [Players=32] [Frames=300] - per-player interaction query cost of the spatial grid against a full scan."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		const int32 NumLootables = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 5000;
+		const int32 NumPlayers = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 32;
+		const int32 NumFrames = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 300;
+		const UHeistInteractionSubsystem* Settings = GetDefault<UHeistInteractionSubsystem>();
+
+		// A large multi-floor bank - 20,000 x 20,000 cm over three floors
+		FRandomStream Random(1337);
+		const float Extent = 10000.0f;
+		FHeistSpatialHash Grid(Settings->CellSize);
+		TArray<FVector> Locations;
+		for (int32 i = 0; i < NumLootables; i++)
+		{
+			const FVector Location(Random.FRandRange(-Extent, Extent), Random.FRandRange(-Extent, Extent), Random.RandRange(0, 2) * 400.0f);
+			Grid.Add(Location);
+			Locations.Add(Location);
+		}
+
+		TArray<FVector> Players;
+		for (int32 i = 0; i < NumPlayers * NumFrames; i++)
+		{
+			Players.Emplace(Random.FRandRange(-Extent, Extent), Random.FRandRange(-Extent, Extent), Random.RandRange(0, 2) * 400.0f + 160.0f);
+		}
+
+		const float Radius = Settings->InteractDistance;
+		TArray<int32> Handles;
+		int64 GridFound = 0;
+		const double GridStart = FPlatformTime::Seconds();
+		for (const FVector& Player : Players)
+		{
+			Handles.Reset();
+			Grid.Query(Player, Radius, Handles);
+			GridFound += Handles.Num();
+		}
+		const double GridSeconds = FPlatformTime::Seconds() - GridStart;
+
+		// What an actor iterator per player amounts to, without the iterator's own overhead
+		const float RadiusSq = FMath::Square(Radius);
+		int64 ScanFound = 0;
+		const double ScanStart = FPlatformTime::Seconds();
+		for (const FVector& Player : Players)
+		{
+			for (const FVector& Location : Locations)
+			{
+				ScanFound += FVector::DistSquared(Location, Player) <= RadiusSq ? 1 : 0;
+			}
+		}
+		const double ScanSeconds = FPlatformTime::Seconds() - ScanStart;
+
+		const double Queries = Players.Num();
+		UE_LOG(LogTemp, Log, TEXT("heist.Bench.Interaction: %d lootables, %d players x %d frames."), NumLootables, NumPlayers, NumFrames);
+		UE_LOG(LogTemp, Log, TEXT("heist.Bench.Interaction: grid %.3f us/player query, %.3f ms/frame for all players (%lld found)."),
+			GridSeconds * 1e6 / Queries, GridSeconds * 1e3 / NumFrames, GridFound);
+		UE_LOG(LogTemp, Log, TEXT("heist.Bench.Interaction: scan %.3f us/player query, %.3f ms/frame for all players (%lld found)."),
+			ScanSeconds * 1e6 / Queries, ScanSeconds * 1e3 / NumFrames, ScanFound);
+	}));
+
+void UHeistInteractionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	Grid = FHeistSpatialHash(CellSize);
+}
+
+void UHeistInteractionSubsystem::Deinitialize()
+{
+	Grid.Reset();
+	Interactables.Reset();
+	Super::Deinitialize();
+}
+
+int32 UHeistInteractionSubsystem::Register(AHeistInteractable* Interactable)
+{
+	if (!ensure(Interactable != nullptr)) { return INDEX_NONE; }
+
+	const int32 Handle = Grid.Add(Interactable->GetActorLocation());
+	if (Handle >= Interactables.Num())
+	{
+		Interactables.SetNum(Handle + 1);
+	}
+	Interactables[Handle] = Interactable;
+	return Handle;
+}
+
+void UHeistInteractionSubsystem::Unregister(AHeistInteractable* Interactable)
+{
+	const int32 Handle = Interactable != nullptr ? Interactable->GetGridHandle() : INDEX_NONE;
+	if (!Interactables.IsValidIndex(Handle) || Interactables[Handle] != Interactable) { return; }
+
+	Grid.Remove(Handle);
+	Interactables[Handle] = nullptr;
+}
+
+void UHeistInteractionSubsystem::QueryInteractables(const FVector& Center, float Radius, TArray<AHeistInteractable*>& OutInteractables) const
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistInteractionQuery);
+
+	QueryHandles.Reset();
+	Grid.Query(Center, Radius, QueryHandles);
+	for (int32 Handle : QueryHandles)
+	{
+		if (Interactables[Handle] != nullptr)
+		{
+			OutInteractables.Add(Interactables[Handle]);
+		}
+	}
+}
+
+AHeistInteractable* UHeistInteractionSubsystem::FindInteractable(const FVector& ViewLocation, const FVector& ViewDirection) const
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistInteractionQuery);
+
+	QueryHandles.Reset();
+	Grid.Query(ViewLocation, InteractDistance, QueryHandles);
+
+	// Prefer what the player is looking at most directly
+	AHeistInteractable* Best = nullptr;
+	float BestDot = MinFacingDot;
+	for (int32 Handle : QueryHandles)
+	{
+		AHeistInteractable* Interactable = Interactables[Handle];
+		if (Interactable == nullptr || !Interactable->CanInteract()) { continue; }
+
+		const float Dot = (Grid.GetLocation(Handle) - ViewLocation).GetSafeNormal() | ViewDirection;
+		if (Dot >= BestDot)
+		{
+			BestDot = Dot;
+			Best = Interactable;
+		}
+	}
+	return Best;
+}
+
+bool UHeistInteractionSubsystem::IsInRange(const AHeistFPSCharacter* Character, const AHeistInteractable* Interactable) const
+{
+	if (Character == nullptr || Interactable == nullptr) { return false; }
+
+	const float MaxDistance = InteractDistance + ServerRangeSlack;
+	return FVector::DistSquared(Character->GetPawnViewLocation(), Interactable->GetActorLocation()) <= FMath::Square(MaxDistance);
+}
@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Heist/HeistSpatialHash.h"
+#include "HeistFPS.h"
+
+FHeistSpatialHash::FHeistSpatialHash(float InCellSize)
+	: CellSize(FMath::Max(InCellSize, 1.0f))
+{
+}
+
+FIntPoint FHeistSpatialHash::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+int32 FHeistSpatialHash::Add(const FVector& Location)
+{
+	int32 Handle;
+	if (FreeHandles.Num() > 0)
+	{
+		Handle = FreeHandles.Pop(false);
+		Locations[Handle] = Location;
+	}
+	else
+	{
+		Handle = Locations.Add(Location);
+	}
+	Cells.FindOrAdd(GetCell(Location)).Add(Handle);
+	return Handle;
+}
+
+void FHeistSpatialHash::Remove(int32 Handle)
+{
+	if (!Locations.IsValidIndex(Handle)) { return; }
+
+	const FIntPoint Cell = GetCell(Locations[Handle]);
+	TArray<int32>* CellHandles = Cells.Find(Cell);
+	if (CellHandles != nullptr && CellHandles->RemoveSingleSwap(Handle, false) > 0)
+	{
+		if (CellHandles->Num() == 0)
+		{
+			Cells.Remove(Cell);
+		}
+		FreeHandles.Add(Handle);
+	}
+}
+
+void FHeistSpatialHash::Query(const FVector& Center, float Radius, TArray<int32>& OutHandles) const
+{
+	const FIntPoint Min = GetCell(Center - FVector(Radius, Radius, 0.0f));
+	const FIntPoint Max = GetCell(Center + FVector(Radius, Radius, 0.0f));
+	const float RadiusSq = FMath::Square(Radius);
+
+	for (int32 X = Min.X; X <= Max.X; X++)
+	{
+		for (int32 Y = Min.Y; Y <= Max.Y; Y++)
+		{
+			const TArray<int32>* CellHandles = Cells.Find(FIntPoint(X, Y));
+			if (CellHandles == nullptr) { continue; }
+
+			for (int32 Handle : *CellHandles)
+			{
+				if (FVector::DistSquared(Locations[Handle], Center) <= RadiusSq)
+				{
+					OutHandles.Add(Handle);
+				}
+			}
+		}
+	}
+}
+
+void FHeistSpatialHash::Reset()
+{
+	Cells.Reset();
+	Locations.Reset();
+	FreeHandles.Reset();
+}
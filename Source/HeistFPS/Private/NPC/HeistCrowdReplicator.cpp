@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "NPC/HeistCrowdReplicator.h"
+#include "HeistFPS.h"
+
+#include "NPC/HeistCrowdSubsystem.h"
+
+#include "Engine/World.h"
+#include "Net/UnrealNetwork.h"
+
+void FHeistCrowdNetEntry::PostReplicatedAdd(const FHeistCrowdNetArray& InArray)
+{
+	if (InArray.Owner != nullptr)
+	{
+		InArray.Owner->OnEntryChanged(*this);
+	}
+}
+
+void FHeistCrowdNetEntry::PostReplicatedChange(const FHeistCrowdNetArray& InArray)
+{
+	if (InArray.Owner != nullptr)
+	{
+		InArray.Owner->OnEntryChanged(*this);
+	}
+}
+
+void FHeistCrowdNetEntry::PreReplicatedRemove(const FHeistCrowdNetArray& InArray)
+{
+	if (InArray.Owner != nullptr)
+	{
+		InArray.Owner->OnEntryRemoved(*this);
+	}
+}
+
+AHeistCrowdReplicator::AHeistCrowdReplicator()
+{
+	PrimaryActorTick.bCanEverTick = false;
+	bReplicates = true;
+	bAlwaysRelevant = true;
+	SetReplicatingMovement(false);
+}
+
+void AHeistCrowdReplicator::PostInitializeComponents()
+{
+	Super::PostInitializeComponents();
+	Crowd.Owner = this;
+}
+
+void AHeistCrowdReplicator::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(AHeistCrowdReplicator, Crowd);
+}
+
+void AHeistCrowdReplicator::OnEntryChanged(const FHeistCrowdNetEntry& Entry)
+{
+	if (UHeistCrowdSubsystem* CrowdSubsystem = GetWorld()->GetSubsystem<UHeistCrowdSubsystem>())
+	{
+		CrowdSubsystem->ApplyNetEntry(Entry);
+	}
+}
+
+void AHeistCrowdReplicator::OnEntryRemoved(const FHeistCrowdNetEntry& Entry)
+{
+	if (UHeistCrowdSubsystem* CrowdSubsystem = GetWorld()->GetSubsystem<UHeistCrowdSubsystem>())
+	{
+		CrowdSubsystem->RemoveNetEntry(Entry.Id);
+	}
+}
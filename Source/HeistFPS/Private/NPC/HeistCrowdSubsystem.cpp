@@ -0,0 +1,855 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "NPC/HeistCrowdSubsystem.h"
+#include "HeistFPS.h"
+
+#include "NPC/HeistCrowdReplicator.h"
+#include "NPC/HeistNPCActor.h"
+#include "Player/HeistFPSCharacter.h"
+
+#include "Components/CapsuleComponent.h"
+#include "Engine/TargetPoint.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerStart.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "NavigationData.h"
+#include "NavigationSystem.h"
+
+DECLARE_CYCLE_STAT(TEXT("CrowdTick"), STAT_HeistCrowdTick, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("CrowdLOD"), STAT_HeistCrowdLOD, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("CrowdMovement"), STAT_HeistCrowdMovement, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("CrowdPathQueries"), STAT_HeistCrowdPathQueries, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("CrowdPerception"), STAT_HeistCrowdPerception, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("CrowdReplicate"), STAT_HeistCrowdReplicate, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("CrowdActors"), STAT_HeistCrowdActors, STATGROUP_HeistFPS);
+
+static FAutoConsoleCommandWithWorldAndArgs HeistCrowdSpawnCommand(
+	TEXT("heist.Crowd.Spawn"),
+	TEXT("heist.Crowd.Spawn <Guards> <Civilians> [Radius] - adds crowd NPCs around the first player start (server only)."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UHeistCrowdSubsystem* Crowd = World != nullptr ? World->GetSubsystem<UHeistCrowdSubsystem>() : nullptr;
+		if (Crowd == nullptr || Args.Num() < 2) { return; }
+
+		const float Radius = Args.Num() > 2 ? FCString::Atof(*Args[2]) : Crowd->InitialSpawnRadius;
+		AActor* PlayerStart = nullptr;
+		for (TActorIterator<APlayerStart> It(World); It; ++It)
+		{
+			PlayerStart = *It;
+			break;
+		}
+		const FVector Center = PlayerStart != nullptr ? PlayerStart->GetActorLocation() : FVector::ZeroVector;
+		Crowd->SpawnNPCs(EHeistNPCType::Guard, FCString::Atoi(*Args[0]), Center, Radius);
+		Crowd->SpawnNPCs(EHeistNPCType::Civilian, FCString::Atoi(*Args[1]), Center, Radius);
+		UE_LOG(LogTemp, Log, TEXT("heist.Crowd.Spawn: %d NPCs."), Crowd->GetNumNPCs());
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs HeistCrowdClearCommand(
+	TEXT("heist.Crowd.Clear"),
+	TEXT("Removes every crowd NPC (server only)."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UHeistCrowdSubsystem* Crowd = World != nullptr ? World->GetSubsystem<UHeistCrowdSubsystem>() : nullptr)
+		{
+			Crowd->ClearNPCs();
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs HeistBenchCrowdCommand(
+	TEXT("heist.Bench.Crowd"),
+	TEXT("heist.Bench.Crowd [SecondsPerCount=10] [exit] - runs 100, 500 and 2000 NPCs in turn and logs server frame time for each. Run headless with -server -nullrhi."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UHeistCrowdSubsystem* Crowd = World != nullptr ? World->GetSubsystem<UHeistCrowdSubsystem>() : nullptr;
+		if (Crowd == nullptr) { return; }
+
+		const float Seconds = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 10.0f;
+		const bool bExit = Args.Contains(TEXT("exit"));
+		Crowd->StartBenchmark({ 100, 500, 2000 }, Seconds > 0.0f ? Seconds : 10.0f, bExit);
+	}));
+
+void UHeistCrowdSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	PerceptionTraceDelegate.BindUObject(this, &UHeistCrowdSubsystem::OnPerceptionTrace);
+}
+
+void UHeistCrowdSubsystem::Deinitialize()
+{
+	Crowd.Reset();
+	PathCache.Reset();
+	PendingPathRequests.Reset();
+	ActorPool.Reset();
+	FreeActorSlots.Reset();
+	Super::Deinitialize();
+}
+
+void UHeistCrowdSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (!InWorld.IsGameWorld() || !IsServer()) { return; }
+
+	const FVector Center = GetSpawnCenter();
+	BuildGoals(Center);
+
+	//One actor carries the whole crowd to clients
+	if (InWorld.GetNetMode() != NM_Standalone)
+	{
+		FActorSpawnParameters SpawnInfo;
+		SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		Replicator = InWorld.SpawnActor<AHeistCrowdReplicator>(SpawnInfo);
+		if (Replicator != nullptr)
+		{
+			Replicator->NetUpdateFrequency = NetUpdateRate;
+		}
+	}
+
+	SpawnNPCs(EHeistNPCType::Guard, InitialGuards, Center, InitialSpawnRadius);
+	SpawnNPCs(EHeistNPCType::Civilian, InitialCivilians, Center, InitialSpawnRadius);
+}
+
+bool UHeistCrowdSubsystem::IsServer() const
+{
+	UWorld* World = GetWorld();
+	return World != nullptr && World->GetNetMode() != NM_Client;
+}
+
+bool UHeistCrowdSubsystem::IsTickable() const
+{
+	if (IsTemplate()) { return false; }
+
+	UWorld* World = GetWorld();
+	if (World == nullptr || !World->IsGameWorld()) { return false; }
+
+	return Crowd.Num() > 0 || BenchmarkIndex != INDEX_NONE;
+}
+
+TStatId UHeistCrowdSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UHeistCrowdSubsystem, STATGROUP_Tickables);
+}
+
+void UHeistCrowdSubsystem::Tick(float DeltaTime)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	{
+		HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistCrowdTick);
+
+		TimeSinceLOD += DeltaTime;
+		if (TimeSinceLOD >= LODInterval)
+		{
+			TimeSinceLOD = 0.0f;
+			UpdateLODs();
+		}
+
+		if (IsServer())
+		{
+			TimeSincePerception += DeltaTime;
+			if (TimeSincePerception >= PerceptionInterval)
+			{
+				RunPerception(TimeSincePerception);
+				TimeSincePerception = 0.0f;
+			}
+			ProcessPathQueries();
+			SimulateMovement(DeltaTime);
+
+			TimeSinceNetUpdate += DeltaTime;
+			if (Replicator != nullptr && TimeSinceNetUpdate >= 1.0f / FMath::Max(NetUpdateRate, 1.0f))
+			{
+				TimeSinceNetUpdate = 0.0f;
+				UpdateReplicator();
+			}
+		}
+		else
+		{
+			SmoothNetLocations(DeltaTime);
+		}
+
+		UpdateActors();
+	}
+
+	if (BenchmarkIndex != INDEX_NONE)
+	{
+		TickBenchmark(DeltaTime, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	}
+}
+
+/********************************************************************
+				POPULATION
+*********************************************************************/
+FVector UHeistCrowdSubsystem::GetSpawnCenter() const
+{
+	for (TActorIterator<APlayerStart> It(GetWorld()); It; ++It)
+	{
+		return It->GetActorLocation();
+	}
+	return FVector::ZeroVector;
+}
+
+void UHeistCrowdSubsystem::BuildGoals(const FVector& Center)
+{
+	Goals.Reset();
+	for (TActorIterator<ATargetPoint> It(GetWorld()); It; ++It)
+	{
+		Goals.Add(It->GetActorLocation());
+	}
+
+	//Maps without target points still get somewhere to walk to
+	if (Goals.Num() < 2)
+	{
+		Goals.Reset();
+		const int32 RingPoints = 8;
+		for (int32 i = 0; i < RingPoints; i++)
+		{
+			const float Angle = 2.0f * PI * i / RingPoints;
+			Goals.Add(Center + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.0f) * InitialSpawnRadius * 0.75f);
+		}
+	}
+}
+
+int32 UHeistCrowdSubsystem::SpawnNPCs(EHeistNPCType Type, int32 Count, const FVector& Center, float Radius)
+{
+	if (!IsServer() || Count <= 0) { return 0; }
+
+	HEISTFPS_LLM_SCOPE(Characters);
+
+	if (Goals.Num() == 0)
+	{
+		BuildGoals(Center);
+	}
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	int32 Added = 0;
+	for (int32 i = 0; i < Count && Crowd.Num() < MAX_uint16; i++)
+	{
+		//Ids are replicated as 16 bits, so skip any still in use after wrapping
+		while (Crowd.IdToIndex.Contains(NextId))
+		{
+			NextId = (NextId + 1) & MAX_uint16;
+		}
+		const int32 Id = NextId;
+		NextId = (NextId + 1) & MAX_uint16;
+
+		const FVector2D Offset = FMath::RandPointInCircle(Radius);
+		FVector Location = Center + FVector(Offset.X, Offset.Y, 0.0f);
+		FNavLocation NavLocation;
+		if (NavSys != nullptr && NavSys->ProjectPointToNavigation(Location, NavLocation, FVector(500.0f, 500.0f, 1000.0f)))
+		{
+			Location = NavLocation.Location;
+		}
+
+		const int32 Index = Crowd.Add(Id, Type, Location, FMath::RandHelper(Goals.Num()));
+		Crowd.Yaws[Index] = FMath::FRandRange(-180.0f, 180.0f);
+
+		//Spread far updates over frames so they do not all land on one
+		Crowd.PendingDeltaTimes[Index] = FMath::FRand() * FarUpdateInterval;
+
+		if (Replicator != nullptr)
+		{
+			FHeistCrowdNetEntry& Entry = Replicator->Crowd.Items.AddDefaulted_GetRef();
+			Entry.Id = static_cast<uint16>(Id);
+			Entry.Type = Type;
+			Entry.State = Crowd.States[Index];
+			Entry.Location = Location;
+			Replicator->Crowd.MarkItemDirty(Entry);
+		}
+		Added++;
+	}
+	return Added;
+}
+
+void UHeistCrowdSubsystem::ClearNPCs()
+{
+	for (int32 i = 0; i < Crowd.Num(); i++)
+	{
+		ReleaseActor(i);
+	}
+	Crowd.Reset();
+	PathCache.Reset();
+	PendingPathRequests.Reset();
+	PendingNoises.Reset();
+
+	if (Replicator != nullptr)
+	{
+		Replicator->Crowd.Items.Reset();
+		Replicator->Crowd.MarkArrayDirty();
+	}
+}
+
+/********************************************************************
+				LOD AND ACTORS
+*********************************************************************/
+void UHeistCrowdSubsystem::GatherViewLocations(TArray<FVector>& OutLocations) const
+{
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PC = It->Get();
+		if (PC == nullptr) { continue; }
+
+		if (PC->GetPawn() != nullptr)
+		{
+			OutLocations.Add(PC->GetPawn()->GetActorLocation());
+		}
+		else if (PC->IsLocalController())
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PC->GetPlayerViewPoint(ViewLocation, ViewRotation);
+			OutLocations.Add(ViewLocation);
+		}
+	}
+
+	//Headless benchmarks have no players, so stand one in the middle of the crowd
+	if (BenchmarkIndex != INDEX_NONE)
+	{
+		OutLocations.Add(BenchmarkCenter);
+	}
+}
+
+void UHeistCrowdSubsystem::UpdateLODs()
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistCrowdLOD);
+
+	TArray<FVector> ViewLocations;
+	GatherViewLocations(ViewLocations);
+
+	const float FullDistanceSq = FMath::Square(FullActorDistance);
+	const float MidDistanceSq = FMath::Square(MidDistance);
+	TArray<TPair<float, int32>> FullCandidates;
+	for (int32 i = 0; i < Crowd.Num(); i++)
+	{
+		float MinDistanceSq = BIG_NUMBER;
+		for (const FVector& ViewLocation : ViewLocations)
+		{
+			MinDistanceSq = FMath::Min(MinDistanceSq, FVector::DistSquared(ViewLocation, Crowd.Locations[i]));
+		}
+
+		Crowd.LODs[i] = MinDistanceSq < MidDistanceSq ? EHeistNPCLOD::Mid : EHeistNPCLOD::Far;
+		if (MinDistanceSq < FullDistanceSq)
+		{
+			FullCandidates.Emplace(MinDistanceSq, i);
+		}
+	}
+
+	//Nearest first when more NPCs are close than there are actors to give them
+	if (FullCandidates.Num() > MaxFullActors)
+	{
+		FullCandidates.Sort([](const TPair<float, int32>& A, const TPair<float, int32>& B) { return A.Key < B.Key; });
+		FullCandidates.SetNum(MaxFullActors, false);
+	}
+	for (const TPair<float, int32>& Candidate : FullCandidates)
+	{
+		Crowd.LODs[Candidate.Value] = EHeistNPCLOD::Full;
+	}
+
+	for (int32 i = 0; i < Crowd.Num(); i++)
+	{
+		const bool bWantsActor = Crowd.LODs[i] == EHeistNPCLOD::Full;
+		const bool bHasActor = Crowd.ActorSlots[i] != INDEX_NONE;
+		if (bWantsActor && !bHasActor)
+		{
+			AcquireActor(i);
+		}
+		else if (!bWantsActor && bHasActor)
+		{
+			ReleaseActor(i);
+		}
+	}
+}
+
+int32 UHeistCrowdSubsystem::AcquireActor(int32 Index)
+{
+	int32 Slot = INDEX_NONE;
+	if (FreeActorSlots.Num() > 0)
+	{
+		Slot = FreeActorSlots.Pop(false);
+	}
+	else
+	{
+		HEISTFPS_LLM_SCOPE(Characters);
+
+		UClass* Class = NPCActorClass.LoadSynchronous();
+		if (Class == nullptr)
+		{
+			Class = AHeistNPCActor::StaticClass();
+		}
+
+		FActorSpawnParameters SpawnInfo;
+		SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		AHeistNPCActor* Actor = GetWorld()->SpawnActor<AHeistNPCActor>(Class, Crowd.Locations[Index], FRotator::ZeroRotator, SpawnInfo);
+		if (Actor == nullptr) { return INDEX_NONE; }
+		Slot = ActorPool.Add(Actor);
+	}
+
+	ActorPool[Slot]->Bind(Crowd.Ids[Index], Crowd.Types[Index]);
+	Crowd.ActorSlots[Index] = Slot;
+	return Slot;
+}
+
+void UHeistCrowdSubsystem::ReleaseActor(int32 Index)
+{
+	const int32 Slot = Crowd.ActorSlots[Index];
+	if (Slot == INDEX_NONE) { return; }
+
+	if (ActorPool.IsValidIndex(Slot) && ActorPool[Slot] != nullptr)
+	{
+		ActorPool[Slot]->Bind(INDEX_NONE, Crowd.Types[Index]);
+		FreeActorSlots.Add(Slot);
+	}
+	Crowd.ActorSlots[Index] = INDEX_NONE;
+}
+
+void UHeistCrowdSubsystem::UpdateActors()
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistCrowdActors);
+
+	for (int32 i = 0; i < Crowd.Num(); i++)
+	{
+		const int32 Slot = Crowd.ActorSlots[i];
+		if (Slot == INDEX_NONE) { continue; }
+
+		AHeistNPCActor* Actor = ActorPool[Slot];
+		if (Actor == nullptr) { continue; }
+
+		//Crowd locations are on the ground, actors are placed by their capsule centre
+		const FVector Location = Crowd.Locations[i] + FVector(0.0f, 0.0f, Actor->Capsule->GetScaledCapsuleHalfHeight());
+		Actor->SetActorLocationAndRotation(Location, FRotator(0.0f, Crowd.Yaws[i], 0.0f));
+		Actor->Speed = Crowd.Speeds[i];
+		Actor->State = Crowd.States[i];
+	}
+}
+
+/********************************************************************
+				MOVEMENT AND NAVIGATION
+*********************************************************************/
+void UHeistCrowdSubsystem::SimulateMovement(float DeltaTime)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistCrowdMovement);
+
+	for (int32 i = 0; i < Crowd.Num(); i++)
+	{
+		const EHeistNPCLOD LOD = Crowd.LODs[i];
+		const float Interval = LOD == EHeistNPCLOD::Full ? 0.0f : (LOD == EHeistNPCLOD::Mid ? MidUpdateInterval : FarUpdateInterval);
+
+		float& Pending = Crowd.PendingDeltaTimes[i];
+		Pending += DeltaTime;
+		if (Pending < Interval) { continue; }
+
+		const float Step = Pending;
+		Pending = 0.0f;
+		MoveNPC(i, Step);
+	}
+}
+
+void UHeistCrowdSubsystem::MoveNPC(int32 Index, float DeltaTime)
+{
+	EHeistNPCState& State = Crowd.States[Index];
+	FVector& Location = Crowd.Locations[Index];
+
+	float& TimeRemaining = Crowd.StateTimeRemaining[Index];
+	if (State == EHeistNPCState::Alert || State == EHeistNPCState::Flee)
+	{
+		TimeRemaining -= DeltaTime;
+		if (TimeRemaining <= 0.0f)
+		{
+			State = EHeistNPCState::Patrol;
+			Crowd.Paths[Index] = nullptr;
+		}
+	}
+
+	FVector Target = Location;
+	float Speed = 0.0f;
+	bool bFollowingPath = false;
+	switch (State)
+	{
+	case EHeistNPCState::Flee:
+		//Straight away from the noise - running civilians do not need a path
+		Target = Location + (Location - Crowd.StimulusLocations[Index]).GetSafeNormal2D() * RunSpeed;
+		Speed = RunSpeed;
+		break;
+	case EHeistNPCState::Alert:
+		Target = Crowd.StimulusLocations[Index];
+		Speed = FVector::DistSquared2D(Target, Location) > FMath::Square(100.0f) ? RunSpeed : 0.0f;
+		break;
+	default:
+	{
+		const TSharedPtr<const FHeistCrowdPath>& Path = Crowd.Paths[Index];
+		if (!Path.IsValid())
+		{
+			RequestPath(Index);
+			Crowd.Speeds[Index] = 0.0f;
+			return;
+		}
+		if (!Path->Points.IsValidIndex(Crowd.PathPoints[Index]))
+		{
+			Crowd.Goals[Index] = PickNextGoal(Index);
+			Crowd.Paths[Index] = nullptr;
+			Crowd.Speeds[Index] = 0.0f;
+			return;
+		}
+		Target = Path->Points[Crowd.PathPoints[Index]];
+		Speed = WalkSpeed;
+		bFollowingPath = true;
+		break;
+	}
+	}
+
+	const FVector Delta = Target - Location;
+	const float Distance = Delta.Size2D();
+	const float StepLength = Speed * DeltaTime;
+	if (Distance <= StepLength)
+	{
+		Location = Target;
+		if (bFollowingPath)
+		{
+			Crowd.PathPoints[Index]++;
+		}
+	}
+	else if (Distance > KINDA_SMALL_NUMBER)
+	{
+		Location += Delta * (StepLength / Distance);
+	}
+
+	if (Distance > KINDA_SMALL_NUMBER && Speed > 0.0f)
+	{
+		Crowd.Yaws[Index] = FMath::RadiansToDegrees(FMath::Atan2(Delta.Y, Delta.X));
+	}
+	Crowd.Speeds[Index] = Speed;
+}
+
+int32 UHeistCrowdSubsystem::PickNextGoal(int32 Index) const
+{
+	//Guards walk their route in order, civilians wander
+	if (Crowd.Types[Index] == EHeistNPCType::Guard)
+	{
+		return (Crowd.Goals[Index] + 1) % Goals.Num();
+	}
+	return FMath::RandHelper(Goals.Num());
+}
+
+void UHeistCrowdSubsystem::RequestPath(int32 Index)
+{
+	const FVector& Location = Crowd.Locations[Index];
+	const FIntPoint Cell(FMath::FloorToInt(Location.X / PathShareCellSize), FMath::FloorToInt(Location.Y / PathShareCellSize));
+	const TPair<FIntPoint, int32> Key(Cell, Crowd.Goals[Index]);
+
+	if (const TSharedPtr<const FHeistCrowdPath>* Cached = PathCache.Find(Key))
+	{
+		Crowd.Paths[Index] = *Cached;
+		//The first point is where the original requester stood, somewhere in this cell
+		Crowd.PathPoints[Index] = (*Cached)->Points.Num() > 1 ? 1 : 0;
+		return;
+	}
+	PendingPathRequests.FindOrAdd(Key).AddUnique(Crowd.Ids[Index]);
+}
+
+void UHeistCrowdSubsystem::ProcessPathQueries()
+{
+	if (PendingPathRequests.Num() == 0) { return; }
+
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistCrowdPathQueries);
+
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	const ANavigationData* NavData = NavSys != nullptr ? NavSys->GetDefaultNavDataInstance(FNavigationSystem::DontCreate) : nullptr;
+
+	int32 Queries = 0;
+	for (auto It = PendingPathRequests.CreateIterator(); It && Queries < MaxPathQueriesPerFrame; ++It)
+	{
+		const TPair<FIntPoint, int32> Key = It.Key();
+		const TArray<int32>& Requesters = It.Value();
+
+		int32 StartIndex = INDEX_NONE;
+		for (int32 Id : Requesters)
+		{
+			if (const int32* Index = Crowd.IdToIndex.Find(Id))
+			{
+				StartIndex = *Index;
+				break;
+			}
+		}
+		if (StartIndex == INDEX_NONE || !Goals.IsValidIndex(Key.Value))
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+
+		const FVector Start = Crowd.Locations[StartIndex];
+		const FVector End = Goals[Key.Value];
+		TSharedRef<FHeistCrowdPath> Path = MakeShared<FHeistCrowdPath>();
+		if (NavData != nullptr)
+		{
+			FPathFindingQuery Query(nullptr, *NavData, Start, End);
+			const FPathFindingResult Result = NavSys->FindPathSync(Query);
+			if (Result.IsSuccessful() && Result.Path.IsValid())
+			{
+				for (const FNavPathPoint& Point : Result.Path->GetPathPoints())
+				{
+					Path->Points.Add(Point.Location);
+				}
+			}
+		}
+		//Without a navmesh (e.g. benchmark maps) NPCs walk straight
+		if (Path->Points.Num() == 0)
+		{
+			Path->Points.Add(Start);
+			Path->Points.Add(End);
+		}
+		Queries++;
+
+		if (PathCache.Num() >= MaxCachedPaths)
+		{
+			PathCache.Reset();
+		}
+		PathCache.Add(Key, Path);
+
+		for (int32 Id : Requesters)
+		{
+			if (const int32* Index = Crowd.IdToIndex.Find(Id))
+			{
+				Crowd.Paths[*Index] = Path;
+				Crowd.PathPoints[*Index] = *Index == StartIndex || Path->Points.Num() < 2 ? 0 : 1;
+			}
+		}
+		It.RemoveCurrent();
+	}
+}
+
+/********************************************************************
+				PERCEPTION
+*********************************************************************/
+void UHeistCrowdSubsystem::ReportNoise(const UObject* WorldContext, const FVector& Location, float Radius)
+{
+	UWorld* World = WorldContext != nullptr ? WorldContext->GetWorld() : nullptr;
+	UHeistCrowdSubsystem* CrowdSubsystem = World != nullptr ? World->GetSubsystem<UHeistCrowdSubsystem>() : nullptr;
+	if (CrowdSubsystem == nullptr || CrowdSubsystem->Crowd.Num() == 0 || !CrowdSubsystem->IsServer()) { return; }
+
+	//Handled with the next perception batch
+	CrowdSubsystem->PendingNoises.Add({ Location, Radius });
+}
+
+void UHeistCrowdSubsystem::ApplyStimulus(int32 Index, const FVector& Location)
+{
+	Crowd.States[Index] = Crowd.Types[Index] == EHeistNPCType::Guard ? EHeistNPCState::Alert : EHeistNPCState::Flee;
+	Crowd.StimulusLocations[Index] = Location;
+	Crowd.StateTimeRemaining[Index] = StimulusSeconds;
+	Crowd.Paths[Index] = nullptr;
+	if (Crowd.Types[Index] == EHeistNPCType::Guard)
+	{
+		Crowd.Awareness[Index] = 1.0f;
+	}
+}
+
+void UHeistCrowdSubsystem::RunPerception(float Interval)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistCrowdPerception);
+
+	for (const FNoiseEvent& Noise : PendingNoises)
+	{
+		const float RadiusSq = FMath::Square(Noise.Radius);
+		for (int32 i = 0; i < Crowd.Num(); i++)
+		{
+			if (FVector::DistSquared(Crowd.Locations[i], Noise.Location) < RadiusSq)
+			{
+				ApplyStimulus(i, Noise.Location);
+			}
+		}
+	}
+	PendingNoises.Reset();
+
+	PerceptionTargets.Reset();
+	for (TActorIterator<AHeistFPSCharacter> It(GetWorld()); It; ++It)
+	{
+		if (It->IsPlayerControlled() && PerceptionTargets.Num() < 256)
+		{
+			PerceptionTargets.Add(It->GetPawnViewLocation());
+		}
+	}
+	LastPerceptionInterval = Interval;
+
+	UWorld* World = GetWorld();
+	const float RangeSq = FMath::Square(SightRange);
+	const float CosHalfAngle = FMath::Cos(FMath::DegreesToRadians(SightHalfAngle));
+	for (int32 i = 0; i < Crowd.Num(); i++)
+	{
+		if (Crowd.Types[i] != EHeistNPCType::Guard) { continue; }
+
+		Crowd.Awareness[i] = FMath::Max(Crowd.Awareness[i] - AwarenessDecayRate * Interval, 0.0f);
+
+		const FVector Eye = Crowd.Locations[i] + FVector(0.0f, 0.0f, 160.0f);
+		const FVector Forward = FRotator(0.0f, Crowd.Yaws[i], 0.0f).Vector();
+		for (int32 Target = 0; Target < PerceptionTargets.Num(); Target++)
+		{
+			const FVector ToTarget = PerceptionTargets[Target] - Eye;
+			if (ToTarget.SizeSquared() > RangeSq || (ToTarget.GetSafeNormal() | Forward) < CosHalfAngle) { continue; }
+
+			//Only guards with a player in their cone pay for a trace, and all of them resolve together next frame
+			FCollisionQueryParams Params(SCENE_QUERY_STAT(HeistCrowdPerception), false);
+			if (Crowd.ActorSlots[i] != INDEX_NONE)
+			{
+				Params.AddIgnoredActor(ActorPool[Crowd.ActorSlots[i]]);
+			}
+			const uint32 UserData = (static_cast<uint32>(Crowd.Ids[i]) << 8) | static_cast<uint32>(Target);
+			World->AsyncLineTraceByChannel(EAsyncTraceType::Single, Eye, PerceptionTargets[Target], ECC_Visibility, Params, FCollisionResponseParams::DefaultResponseParam, &PerceptionTraceDelegate, UserData);
+		}
+	}
+}
+
+void UHeistCrowdSubsystem::OnPerceptionTrace(const FTraceHandle& Handle, FTraceDatum& Datum)
+{
+	const int32 Id = static_cast<int32>(Datum.UserData >> 8);
+	const int32 Target = static_cast<int32>(Datum.UserData & 0xFF);
+	const int32* Index = Crowd.IdToIndex.Find(Id);
+	if (Index == nullptr || !PerceptionTargets.IsValidIndex(Target)) { return; }
+
+	//Blocked by anything other than a pawn - usually the player being looked at
+	for (const FHitResult& Hit : Datum.OutHits)
+	{
+		if (Hit.bBlockingHit && Cast<APawn>(Hit.GetActor()) == nullptr) { return; }
+	}
+
+	float& Awareness = Crowd.Awareness[*Index];
+	Awareness = FMath::Min(Awareness + AwarenessGainRate * LastPerceptionInterval, 1.0f);
+	if (Awareness >= 1.0f)
+	{
+		ApplyStimulus(*Index, PerceptionTargets[Target]);
+	}
+}
+
+/********************************************************************
+				REPLICATION
+*********************************************************************/
+void UHeistCrowdSubsystem::UpdateReplicator()
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistCrowdReplicate);
+
+	TArray<FHeistCrowdNetEntry>& Items = Replicator->Crowd.Items;
+	if (!ensure(Items.Num() == Crowd.Num())) { return; }
+
+	const float ToleranceSq = FMath::Square(NetLocationTolerance);
+	for (int32 i = 0; i < Crowd.Num(); i++)
+	{
+		FHeistCrowdNetEntry& Entry = Items[i];
+		if (Entry.State == Crowd.States[i] && FVector::DistSquared(Crowd.NetLocations[i], Crowd.Locations[i]) <= ToleranceSq) { continue; }
+
+		Entry.State = Crowd.States[i];
+		Entry.Location = Crowd.Locations[i];
+		Entry.Yaw = FRotator::CompressAxisToByte(Crowd.Yaws[i]);
+		Crowd.NetLocations[i] = Crowd.Locations[i];
+		Replicator->Crowd.MarkItemDirty(Entry);
+	}
+}
+
+void UHeistCrowdSubsystem::ApplyNetEntry(const FHeistCrowdNetEntry& Entry)
+{
+	int32 Index;
+	if (const int32* Existing = Crowd.IdToIndex.Find(Entry.Id))
+	{
+		Index = *Existing;
+		//Speed for anim comes from how far the NPC moved since the last update
+		Crowd.Speeds[Index] = FMath::Min(FVector::Dist2D(Crowd.NetLocations[Index], Entry.Location) * NetUpdateRate, RunSpeed);
+	}
+	else
+	{
+		HEISTFPS_LLM_SCOPE(Characters);
+		Index = Crowd.Add(Entry.Id, Entry.Type, Entry.Location, 0);
+	}
+
+	Crowd.States[Index] = Entry.State;
+	Crowd.NetLocations[Index] = Entry.Location;
+	Crowd.Yaws[Index] = FRotator::DecompressAxisFromByte(Entry.Yaw);
+}
+
+void UHeistCrowdSubsystem::RemoveNetEntry(int32 Id)
+{
+	const int32* Index = Crowd.IdToIndex.Find(Id);
+	if (Index == nullptr) { return; }
+
+	const int32 RemoveIndex = *Index;
+	ReleaseActor(RemoveIndex);
+	Crowd.RemoveAtSwap(RemoveIndex);
+}
+
+void UHeistCrowdSubsystem::SmoothNetLocations(float DeltaTime)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistCrowdMovement);
+
+	const float Alpha = 1.0f - FMath::Exp(-8.0f * DeltaTime);
+	for (int32 i = 0; i < Crowd.Num(); i++)
+	{
+		Crowd.Locations[i] = FMath::Lerp(Crowd.Locations[i], Crowd.NetLocations[i], Alpha);
+	}
+}
+
+/********************************************************************
+				BENCHMARK
+*********************************************************************/
+void UHeistCrowdSubsystem::StartBenchmark(const TArray<int32>& Counts, float SecondsPerCount, bool bExitWhenDone)
+{
+	if (!IsServer() || Counts.Num() == 0) { UE_LOG(LogTemp, Warning, TEXT("heist.Bench.Crowd: run on a server or standalone world.")); return; }
+
+	BenchmarkCounts = Counts;
+	BenchmarkSecondsPerCount = SecondsPerCount;
+	bBenchmarkExitWhenDone = bExitWhenDone;
+	BenchmarkCenter = GetSpawnCenter();
+	BenchmarkIndex = 0;
+	BeginBenchmarkCount();
+}
+
+void UHeistCrowdSubsystem::BeginBenchmarkCount()
+{
+	ClearNPCs();
+
+	//Constant density, so larger crowds cover more ground instead of stacking up
+	const int32 Count = BenchmarkCounts[BenchmarkIndex];
+	const float Radius = InitialSpawnRadius * FMath::Sqrt(Count / 500.0f);
+	BuildGoals(BenchmarkCenter);
+	SpawnNPCs(EHeistNPCType::Guard, Count / 4, BenchmarkCenter, Radius);
+	SpawnNPCs(EHeistNPCType::Civilian, Count - Count / 4, BenchmarkCenter, Radius);
+
+	BenchmarkElapsed = 0.0f;
+	BenchmarkFrames = 0;
+	BenchmarkBusyMs = 0.0;
+	BenchmarkWorstMs = 0.0;
+	BenchmarkCrowdMs = 0.0;
+}
+
+void UHeistCrowdSubsystem::TickBenchmark(float DeltaTime, double CrowdMs)
+{
+	//The first second is spent resolving the initial path queries and is not measured
+	const float WarmupSeconds = 1.0f;
+	BenchmarkElapsed += DeltaTime;
+	if (BenchmarkElapsed < WarmupSeconds) { return; }
+
+	//Busy time excludes the sleep servers do to hold their tick rate
+	const double BusyMs = (FApp::GetDeltaTime() - FApp::GetIdleTime()) * 1000.0;
+	BenchmarkFrames++;
+	BenchmarkBusyMs += BusyMs;
+	BenchmarkWorstMs = FMath::Max(BenchmarkWorstMs, BusyMs);
+	BenchmarkCrowdMs += CrowdMs;
+
+	if (BenchmarkElapsed < WarmupSeconds + BenchmarkSecondsPerCount) { return; }
+
+	const int32 Frames = FMath::Max(BenchmarkFrames, 1);
+	UE_LOG(LogTemp, Log, TEXT("heist.Bench.Crowd: %4d NPCs - server frame %.2f ms avg, %.2f ms worst, crowd %.3f ms/frame, %d actors, %d cached paths."),
+		BenchmarkCounts[BenchmarkIndex], BenchmarkBusyMs / Frames, BenchmarkWorstMs, BenchmarkCrowdMs / Frames, ActorPool.Num() - FreeActorSlots.Num(), PathCache.Num());
+
+	BenchmarkIndex++;
+	if (BenchmarkCounts.IsValidIndex(BenchmarkIndex))
+	{
+		BeginBenchmarkCount();
+		return;
+	}
+
+	BenchmarkIndex = INDEX_NONE;
+	ClearNPCs();
+	UE_LOG(LogTemp, Log, TEXT("heist.Bench.Crowd: done."));
+	if (bBenchmarkExitWhenDone)
+	{
+		FPlatformMisc::RequestExitWithStatus(false, 0);
+	}
+}
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "NPC/HeistCrowdTypes.h"
+#include "HeistFPS.h"
+
+int32 FHeistCrowdData::Add(int32 Id, EHeistNPCType Type, const FVector& Location, int32 Goal)
+{
+	const int32 Index = Ids.Add(Id);
+	Types.Add(Type);
+	States.Add(EHeistNPCState::Patrol);
+	LODs.Add(EHeistNPCLOD::Far);
+	Locations.Add(Location);
+	Yaws.Add(0.0f);
+	Speeds.Add(0.0f);
+	PendingDeltaTimes.Add(0.0f);
+	Paths.Add(nullptr);
+	PathPoints.Add(0);
+	Goals.Add(Goal);
+	Awareness.Add(0.0f);
+	StimulusLocations.Add(Location);
+	StateTimeRemaining.Add(0.0f);
+	NetLocations.Add(Location);
+	ActorSlots.Add(INDEX_NONE);
+	IdToIndex.Add(Id, Index);
+	return Index;
+}
+
+void FHeistCrowdData::RemoveAtSwap(int32 Index)
+{
+	IdToIndex.Remove(Ids[Index]);
+	const int32 Last = Ids.Num() - 1;
+	if (Index != Last)
+	{
+		IdToIndex.Add(Ids[Last], Index);
+	}
+
+	Ids.RemoveAtSwap(Index, 1, false);
+	Types.RemoveAtSwap(Index, 1, false);
+	States.RemoveAtSwap(Index, 1, false);
+	LODs.RemoveAtSwap(Index, 1, false);
+	Locations.RemoveAtSwap(Index, 1, false);
+	Yaws.RemoveAtSwap(Index, 1, false);
+	Speeds.RemoveAtSwap(Index, 1, false);
+	PendingDeltaTimes.RemoveAtSwap(Index, 1, false);
+	Paths.RemoveAtSwap(Index, 1, false);
+	PathPoints.RemoveAtSwap(Index, 1, false);
+	Goals.RemoveAtSwap(Index, 1, false);
+	Awareness.RemoveAtSwap(Index, 1, false);
+	StimulusLocations.RemoveAtSwap(Index, 1, false);
+	StateTimeRemaining.RemoveAtSwap(Index, 1, false);
+	NetLocations.RemoveAtSwap(Index, 1, false);
+	ActorSlots.RemoveAtSwap(Index, 1, false);
+}
+
+void FHeistCrowdData::Reset()
+{
+	Ids.Reset();
+	Types.Reset();
+	States.Reset();
+	LODs.Reset();
+	Locations.Reset();
+	Yaws.Reset();
+	Speeds.Reset();
+	PendingDeltaTimes.Reset();
+	Paths.Reset();
+	PathPoints.Reset();
+	Goals.Reset();
+	Awareness.Reset();
+	StimulusLocations.Reset();
+	StateTimeRemaining.Reset();
+	NetLocations.Reset();
+	ActorSlots.Reset();
+	IdToIndex.Reset();
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "NPC/HeistNPCActor.h"
+#include "HeistFPS.h"
+
+#include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+
+AHeistNPCActor::AHeistNPCActor()
+{
+	HEISTFPS_LLM_SCOPE(Characters);
+
+	// Driven entirely by the crowd subsystem
+	PrimaryActorTick.bCanEverTick = false;
+	bReplicates = false;
+
+	Capsule = CreateDefaultSubobject<UCapsuleComponent>(TEXT("Capsule"));
+	Capsule->InitCapsuleSize(34.0f, 88.0f);
+	Capsule->SetCollisionProfileName(UCollisionProfile::Pawn_ProfileName);
+	SetRootComponent(Capsule);
+
+	Mesh = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("Mesh"));
+	Mesh->SetupAttachment(Capsule);
+	Mesh->SetRelativeLocationAndRotation(FVector(0.0f, 0.0f, -88.0f), FRotator(0.0f, -90.0f, 0.0f));
+	Mesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Mesh->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
+}
+
+void AHeistNPCActor::Bind(int32 InNPCId, EHeistNPCType InType)
+{
+	NPCId = InNPCId;
+	Type = InType;
+	Speed = 0.0f;
+	State = EHeistNPCState::Idle;
+
+	const bool bBound = NPCId != INDEX_NONE;
+	SetActorHiddenInGame(!bBound);
+	SetActorEnableCollision(bBound);
+	Mesh->SetComponentTickEnabled(bBound);
+}
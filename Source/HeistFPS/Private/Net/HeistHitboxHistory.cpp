@@ -0,0 +1,334 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/HeistHitboxHistory.h"
+#include "HeistFPS.h"
+
+DECLARE_CYCLE_STAT(TEXT("HitboxHistoryBroadphase"), STAT_HeistHitboxHistoryBroadphase, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("HitboxHistoryTrace"), STAT_HeistHitboxHistoryTrace, STATGROUP_HeistFPS);
+
+void FHeistHitboxHistory::Init(int32 InNumFrames, int32 InMaxSlots, const TArray<float>& InHitboxRadii, float InCellSize)
+{
+	NumFrames = FMath::Max(InNumFrames, 2);
+	MaxSlots = FMath::Max(InMaxSlots, 1);
+	CellSize = FMath::Max(InCellSize, 100.0f);
+	HitboxRadii = InHitboxRadii;
+	NewestFrame = INDEX_NONE;
+	NumRecorded = 0;
+
+	const int32 NumPoses = NumFrames * MaxSlots;
+	FrameTimes.SetNumZeroed(NumFrames);
+	Present.SetNumZeroed(NumPoses);
+	CapsuleCenters.SetNumZeroed(NumPoses);
+	CapsuleHalfHeights.SetNumZeroed(NumPoses);
+	CapsuleRadii.SetNumZeroed(NumPoses);
+	HitboxCenters.SetNumZeroed(NumPoses * HitboxRadii.Num());
+
+	BucketStarts.SetNumZeroed(NumBuckets + 1);
+	BucketEntries.Reset();
+	LargeSlots.Reset();
+	SlotStamps.SetNumZeroed(MaxSlots);
+	Candidates.Reset(MaxSlots);
+}
+
+void FHeistHitboxHistory::BeginFrame(double Time)
+{
+	NewestFrame = (NewestFrame + 1) % NumFrames;
+	NumRecorded = FMath::Min(NumRecorded + 1, NumFrames);
+	FrameTimes[NewestFrame] = Time;
+	FMemory::Memzero(&Present[GetIndex(NewestFrame, 0)], MaxSlots);
+}
+
+void FHeistHitboxHistory::WriteSlot(int32 Slot, const FVector& CapsuleCenter, float CapsuleHalfHeight, float CapsuleRadius, const FVector* InHitboxCenters)
+{
+	if (!ensure(Slot >= 0 && Slot < MaxSlots && NewestFrame != INDEX_NONE)) { return; }
+
+	const int32 Index = GetIndex(NewestFrame, Slot);
+	Present[Index] = 1;
+	CapsuleCenters[Index] = CapsuleCenter;
+	CapsuleHalfHeights[Index] = CapsuleHalfHeight;
+	CapsuleRadii[Index] = CapsuleRadius;
+	FMemory::Memcpy(&HitboxCenters[Index * HitboxRadii.Num()], InHitboxCenters, HitboxRadii.Num() * sizeof(FVector));
+}
+
+void FHeistHitboxHistory::ClearSlot(int32 Slot)
+{
+	for (int32 Frame = 0; Frame < NumFrames; Frame++)
+	{
+		Present[GetIndex(Frame, Slot)] = 0;
+	}
+}
+
+int32 FHeistHitboxHistory::GetBucket(int32 CellX, int32 CellY)
+{
+	return static_cast<int32>((static_cast<uint32>(CellX) * 73856093u ^ static_cast<uint32>(CellY) * 19349663u) & (NumBuckets - 1));
+}
+
+void FHeistHitboxHistory::EndFrame()
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistHitboxHistoryBroadphase);
+
+	//Cell range each slot covers over the whole history - traces at any past time find it there
+	TArray<FIntRect, TInlineAllocator<64>> SlotCells;
+	SlotCells.SetNumUninitialized(MaxSlots);
+	LargeSlots.Reset();
+	FMemory::Memzero(BucketStarts.GetData(), BucketStarts.Num() * sizeof(int32));
+
+	for (int32 Slot = 0; Slot < MaxSlots; Slot++)
+	{
+		FBox2D Bounds(ForceInit);
+		float MaxRadius = 0.0f;
+		for (int32 Age = 0; Age < NumRecorded; Age++)
+		{
+			const int32 Index = GetIndex(GetFrame(Age), Slot);
+			if (Present[Index] != 0)
+			{
+				Bounds += FVector2D(CapsuleCenters[Index]);
+				MaxRadius = FMath::Max(MaxRadius, CapsuleRadii[Index]);
+			}
+		}
+
+		FIntRect& Cells = SlotCells[Slot];
+		if (!Bounds.bIsValid)
+		{
+			Cells = FIntRect(0, 0, -1, -1);
+			continue;
+		}
+		Cells.Min = FIntPoint(FMath::FloorToInt((Bounds.Min.X - MaxRadius) / CellSize), FMath::FloorToInt((Bounds.Min.Y - MaxRadius) / CellSize));
+		Cells.Max = FIntPoint(FMath::FloorToInt((Bounds.Max.X + MaxRadius) / CellSize), FMath::FloorToInt((Bounds.Max.Y + MaxRadius) / CellSize));
+
+		//A respawn inside the history window stretches the bounds across the map
+		if ((Cells.Max.X - Cells.Min.X + 1) * (Cells.Max.Y - Cells.Min.Y + 1) > MaxCellsPerSlot)
+		{
+			LargeSlots.Add(Slot);
+			Cells = FIntRect(0, 0, -1, -1);
+			continue;
+		}
+		for (int32 Y = Cells.Min.Y; Y <= Cells.Max.Y; Y++)
+		{
+			for (int32 X = Cells.Min.X; X <= Cells.Max.X; X++)
+			{
+				BucketStarts[GetBucket(X, Y) + 1]++;
+			}
+		}
+	}
+
+	for (int32 Bucket = 0; Bucket < NumBuckets; Bucket++)
+	{
+		BucketStarts[Bucket + 1] += BucketStarts[Bucket];
+	}
+	BucketEntries.SetNumUninitialized(BucketStarts[NumBuckets]);
+
+	TArray<int32, TInlineAllocator<NumBuckets>> Fill;
+	Fill.Append(BucketStarts.GetData(), NumBuckets);
+	for (int32 Slot = 0; Slot < MaxSlots; Slot++)
+	{
+		const FIntRect& Cells = SlotCells[Slot];
+		for (int32 Y = Cells.Min.Y; Y <= Cells.Max.Y; Y++)
+		{
+			for (int32 X = Cells.Min.X; X <= Cells.Max.X; X++)
+			{
+				BucketEntries[Fill[GetBucket(X, Y)]++] = Slot;
+			}
+		}
+	}
+}
+
+double FHeistHitboxHistory::GetOldestTime() const
+{
+	return NumRecorded > 0 ? FrameTimes[GetFrame(NumRecorded - 1)] : 0.0;
+}
+
+double FHeistHitboxHistory::GetNewestTime() const
+{
+	return NumRecorded > 0 ? FrameTimes[NewestFrame] : 0.0;
+}
+
+void FHeistHitboxHistory::AddCandidate(int32 Slot) const
+{
+	if (SlotStamps[Slot] != CurrentStamp)
+	{
+		SlotStamps[Slot] = CurrentStamp;
+		Candidates.Add(Slot);
+	}
+}
+
+void FHeistHitboxHistory::GatherCandidates(const FVector& Start, const FVector& End) const
+{
+	Candidates.Reset();
+	if (++CurrentStamp == 0)
+	{
+		FMemory::Memzero(SlotStamps.GetData(), SlotStamps.Num() * sizeof(uint32));
+		CurrentStamp = 1;
+	}
+
+	for (int32 Slot : LargeSlots)
+	{
+		AddCandidate(Slot);
+	}
+
+	//Walk the cells the shot crosses in X and Y, in order
+	const FVector2D From = FVector2D(Start) / CellSize;
+	const FVector2D To = FVector2D(End) / CellSize;
+	const FVector2D Delta = To - From;
+	FIntPoint Cell(FMath::FloorToInt(From.X), FMath::FloorToInt(From.Y));
+	const FIntPoint EndCell(FMath::FloorToInt(To.X), FMath::FloorToInt(To.Y));
+	const FIntPoint Step(Delta.X >= 0.0f ? 1 : -1, Delta.Y >= 0.0f ? 1 : -1);
+	const FVector2D TimeDelta(Delta.X != 0.0f ? 1.0f / FMath::Abs(Delta.X) : BIG_NUMBER, Delta.Y != 0.0f ? 1.0f / FMath::Abs(Delta.Y) : BIG_NUMBER);
+	FVector2D TimeMax(
+		Delta.X != 0.0f ? (Step.X > 0 ? Cell.X + 1 - From.X : From.X - Cell.X) * TimeDelta.X : BIG_NUMBER,
+		Delta.Y != 0.0f ? (Step.Y > 0 ? Cell.Y + 1 - From.Y : From.Y - Cell.Y) * TimeDelta.Y : BIG_NUMBER);
+
+	const int32 NumCells = FMath::Abs(EndCell.X - Cell.X) + FMath::Abs(EndCell.Y - Cell.Y) + 1;
+	for (int32 i = 0; i < NumCells; i++)
+	{
+		const int32 Bucket = GetBucket(Cell.X, Cell.Y);
+		for (int32 Entry = BucketStarts[Bucket]; Entry < BucketStarts[Bucket + 1]; Entry++)
+		{
+			AddCandidate(BucketEntries[Entry]);
+		}
+
+		if (TimeMax.X < TimeMax.Y)
+		{
+			TimeMax.X += TimeDelta.X;
+			Cell.X += Step.X;
+		}
+		else
+		{
+			TimeMax.Y += TimeDelta.Y;
+			Cell.Y += Step.Y;
+		}
+	}
+}
+
+void FHeistHitboxHistory::FindFrames(double Time, int32& OutFrameA, int32& OutFrameB, float& OutAlpha) const
+{
+	//Ages run newest (0) to oldest - binary search for the newest frame at or before Time
+	int32 Low = 0;
+	int32 High = NumRecorded - 1;
+	if (Time >= FrameTimes[GetFrame(0)])
+	{
+		OutFrameA = OutFrameB = GetFrame(0);
+		OutAlpha = 0.0f;
+		return;
+	}
+	if (Time <= FrameTimes[GetFrame(High)])
+	{
+		OutFrameA = OutFrameB = GetFrame(High);
+		OutAlpha = 0.0f;
+		return;
+	}
+	while (High - Low > 1)
+	{
+		const int32 Mid = (Low + High) / 2;
+		if (FrameTimes[GetFrame(Mid)] > Time)
+		{
+			Low = Mid;
+		}
+		else
+		{
+			High = Mid;
+		}
+	}
+
+	OutFrameA = GetFrame(High);
+	OutFrameB = GetFrame(Low);
+	const double Span = FrameTimes[OutFrameB] - FrameTimes[OutFrameA];
+	OutAlpha = Span > 0.0 ? static_cast<float>((Time - FrameTimes[OutFrameA]) / Span) : 0.0f;
+}
+
+bool FHeistHitboxHistory::TraceSlot(int32 Slot, int32 FrameA, int32 FrameB, float Alpha, const FVector& Start, const FVector& Direction, float Length, FHeistRewindHit& InOutHit) const
+{
+	int32 IndexA = GetIndex(FrameA, Slot);
+	int32 IndexB = GetIndex(FrameB, Slot);
+	if (Present[IndexA] == 0 && Present[IndexB] == 0) { return false; }
+
+	//Spawned or removed between the two frames - use the pose that exists
+	if (Present[IndexA] == 0)
+	{
+		IndexA = IndexB;
+	}
+	else if (Present[IndexB] == 0)
+	{
+		IndexB = IndexA;
+	}
+
+	const FVector Center = FMath::Lerp(CapsuleCenters[IndexA], CapsuleCenters[IndexB], Alpha);
+	const float Radius = FMath::Lerp(CapsuleRadii[IndexA], CapsuleRadii[IndexB], Alpha);
+	const float HalfSegment = FMath::Max(FMath::Lerp(CapsuleHalfHeights[IndexA], CapsuleHalfHeights[IndexB], Alpha) - Radius, 0.0f);
+
+	FVector OnShot;
+	FVector OnCapsule;
+	FMath::SegmentDistToSegmentSafe(Start, Start + Direction * Length, Center - FVector(0.0f, 0.0f, HalfSegment), Center + FVector(0.0f, 0.0f, HalfSegment), OnShot, OnCapsule);
+	if (FVector::DistSquared(OnShot, OnCapsule) > FMath::Square(Radius)) { return false; }
+
+	bool bHit = false;
+	const int32 NumHitboxes = HitboxRadii.Num();
+	const FVector* CentersA = &HitboxCenters[IndexA * NumHitboxes];
+	const FVector* CentersB = &HitboxCenters[IndexB * NumHitboxes];
+	for (int32 Hitbox = 0; Hitbox < NumHitboxes; Hitbox++)
+	{
+		const FVector ToCenter = FMath::Lerp(CentersA[Hitbox], CentersB[Hitbox], Alpha) - Start;
+		const float Along = FVector::DotProduct(ToCenter, Direction);
+		const float MissSq = ToCenter.SizeSquared() - FMath::Square(Along);
+		const float RadiusSq = FMath::Square(HitboxRadii[Hitbox]);
+		if (MissSq > RadiusSq) { continue; }
+
+		const float Entry = FMath::Max(Along - FMath::Sqrt(RadiusSq - MissSq), 0.0f);
+		if (Entry > Length || Entry >= InOutHit.Distance || Along + HitboxRadii[Hitbox] < 0.0f) { continue; }
+
+		InOutHit.Slot = Slot;
+		InOutHit.Hitbox = Hitbox;
+		InOutHit.Distance = Entry;
+		InOutHit.Location = Start + Direction * Entry;
+		bHit = true;
+	}
+	return bHit;
+}
+
+bool FHeistHitboxHistory::Trace(const FVector& Start, const FVector& End, double Time, int32 IgnoreSlot, FHeistRewindHit& OutHit, bool bBroadphase) const
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistHitboxHistoryTrace);
+
+	if (NumRecorded == 0) { return false; }
+
+	FVector Direction;
+	float Length;
+	(End - Start).ToDirectionAndLength(Direction, Length);
+	if (Length <= KINDA_SMALL_NUMBER) { return false; }
+
+	if (bBroadphase)
+	{
+		GatherCandidates(Start, End);
+	}
+	else
+	{
+		Candidates.Reset();
+		for (int32 Slot = 0; Slot < MaxSlots; Slot++)
+		{
+			Candidates.Add(Slot);
+		}
+	}
+
+	int32 FrameA;
+	int32 FrameB;
+	float Alpha;
+	FindFrames(Time, FrameA, FrameB, Alpha);
+
+	FHeistRewindHit Hit;
+	Hit.Distance = BIG_NUMBER;
+	bool bHit = false;
+	for (int32 Slot : Candidates)
+	{
+		if (Slot != IgnoreSlot)
+		{
+			bHit |= TraceSlot(Slot, FrameA, FrameB, Alpha, Start, Direction, Length, Hit);
+		}
+	}
+
+	if (bHit)
+	{
+		OutHit = Hit;
+	}
+	return bHit;
+}
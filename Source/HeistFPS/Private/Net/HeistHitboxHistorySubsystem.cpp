@@ -0,0 +1,227 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/HeistHitboxHistorySubsystem.h"
+#include "HeistFPS.h"
+
+#include "Player/HeistFPSCharacter.h"
+
+#include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("HitboxHistoryRecord"), STAT_HeistHitboxHistoryRecord, STATGROUP_HeistFPS);
+
+static FAutoConsoleCommand HeistBenchRewindCommand(
+	TEXT("heist.Bench.Rewind"),
+	TEXT("heist.Bench.Rewind [Players=32] [Shots=20000] - records HistoryFrames of moving players and times rewinding and testing shots with and without the grid broadphase."),
+	FConsoleCommandWithArgsDelegate::CreateStatic([](const TArray<FString>& Args)
+	{
+		const int32 NumPlayers = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 2) : 32;
+		const int32 NumShots = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 20000;
+		const UHeistHitboxHistorySubsystem* Settings = GetDefault<UHeistHitboxHistorySubsystem>();
+		const int32 NumFrames = Settings->HistoryFrames;
+		const float FrameTime = 1.0f / 60.0f;
+
+		TArray<float> Radii;
+		for (const FHeistHitboxDef& Def : Settings->Hitboxes)
+		{
+			Radii.Add(Def.Radius);
+		}
+		if (Radii.Num() == 0)
+		{
+			Radii = { 12.0f, 22.0f, 20.0f, 18.0f };
+		}
+
+		//Hitboxes stacked up the capsule, head last
+		TArray<FVector> Offsets;
+		for (int32 i = 0; i < Radii.Num(); i++)
+		{
+			Offsets.Emplace(0.0f, 0.0f, FMath::Lerp(-50.0f, 70.0f, Radii.Num() > 1 ? i / float(Radii.Num() - 1) : 0.5f));
+		}
+
+		FHeistHitboxHistory History;
+		History.Init(NumFrames, NumPlayers, Radii, Settings->CellSize);
+
+		//Players running around an 8000 x 8000 cm floor
+		FRandomStream Random(4242);
+		TArray<FVector> Locations;
+		TArray<FVector> Velocities;
+		for (int32 i = 0; i < NumPlayers; i++)
+		{
+			Locations.Emplace(Random.FRandRange(-4000.0f, 4000.0f), Random.FRandRange(-4000.0f, 4000.0f), 90.0f);
+			Velocities.Add(FVector(Random.GetUnitVector().GetSafeNormal2D() * 600.0f));
+		}
+
+		TArray<FVector> Recorded;
+		TArray<FVector> HitboxCenters;
+		HitboxCenters.SetNum(Radii.Num());
+		double RecordSeconds = 0.0;
+		for (int32 Frame = 0; Frame < NumFrames; Frame++)
+		{
+			for (int32 i = 0; i < NumPlayers; i++)
+			{
+				if (Random.FRand() < 0.05f)
+				{
+					Velocities[i] = FVector(Random.GetUnitVector().GetSafeNormal2D() * 600.0f);
+				}
+				Locations[i] += Velocities[i] * FrameTime;
+			}
+			Recorded.Append(Locations);
+
+			const double Start = FPlatformTime::Seconds();
+			History.BeginFrame(Frame * FrameTime);
+			for (int32 i = 0; i < NumPlayers; i++)
+			{
+				for (int32 Hitbox = 0; Hitbox < Radii.Num(); Hitbox++)
+				{
+					HitboxCenters[Hitbox] = Locations[i] + Offsets[Hitbox];
+				}
+				History.WriteSlot(i, Locations[i], 90.0f, 35.0f, HitboxCenters.GetData());
+			}
+			History.EndFrame();
+			RecordSeconds += FPlatformTime::Seconds() - Start;
+		}
+
+		//Each shot is aimed at a hitbox of a random target at a random point in the history, with some spread
+		struct FShot { FVector Start; FVector End; double Time; int32 Shooter; };
+		TArray<FShot> Shots;
+		for (int32 i = 0; i < NumShots; i++)
+		{
+			const int32 Shooter = Random.RandRange(0, NumPlayers - 1);
+			const int32 Target = (Shooter + Random.RandRange(1, NumPlayers - 1)) % NumPlayers;
+			const int32 Frame = Random.RandRange(0, NumFrames - 1);
+			const FVector Eye = Recorded[(NumFrames - 1) * NumPlayers + Shooter] + FVector(0.0f, 0.0f, 70.0f);
+			const FVector Aim = Recorded[Frame * NumPlayers + Target] + Offsets[Random.RandRange(0, Offsets.Num() - 1)] + Random.GetUnitVector() * 30.0f;
+			Shots.Add({ Eye, Eye + (Aim - Eye).GetSafeNormal() * 10000.0f, Frame * FrameTime, Shooter });
+		}
+
+		int32 BroadphaseHits = 0;
+		int64 Candidates = 0;
+		const double BroadphaseStart = FPlatformTime::Seconds();
+		for (const FShot& Shot : Shots)
+		{
+			FHeistRewindHit Hit;
+			BroadphaseHits += History.Trace(Shot.Start, Shot.End, Shot.Time, Shot.Shooter, Hit) ? 1 : 0;
+			Candidates += History.GetLastNumCandidates();
+		}
+		const double BroadphaseSeconds = FPlatformTime::Seconds() - BroadphaseStart;
+
+		int32 BruteHits = 0;
+		const double BruteStart = FPlatformTime::Seconds();
+		for (const FShot& Shot : Shots)
+		{
+			FHeistRewindHit Hit;
+			BruteHits += History.Trace(Shot.Start, Shot.End, Shot.Time, Shot.Shooter, Hit, false) ? 1 : 0;
+		}
+		const double BruteSeconds = FPlatformTime::Seconds() - BruteStart;
+
+		UE_LOG(LogTemp, Log, TEXT("heist.Bench.Rewind: %d players, %d frames (%.2f s), %d hitboxes - record %.2f us/frame"),
+			NumPlayers, NumFrames, NumFrames * FrameTime, Radii.Num(), RecordSeconds * 1000000.0 / NumFrames);
+		UE_LOG(LogTemp, Log, TEXT("heist.Bench.Rewind: grid %.3f us/shot, %.1f candidates, %d hits | all players %.3f us/shot, %d hits"),
+			BroadphaseSeconds * 1000000.0 / NumShots, double(Candidates) / NumShots, BroadphaseHits, BruteSeconds * 1000000.0 / NumShots, BruteHits);
+	}));
+
+void UHeistHitboxHistorySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	TArray<float> Radii;
+	for (const FHeistHitboxDef& Def : Hitboxes)
+	{
+		Radii.Add(Def.Radius);
+	}
+	History.Init(HistoryFrames, MaxCharacters, Radii, CellSize);
+	HitboxScratch.SetNum(Radii.Num());
+
+	SlotCharacters.SetNum(History.GetMaxSlots());
+	SlotBoneIndices.Init(INDEX_NONE, History.GetMaxSlots() * Hitboxes.Num());
+	for (int32 Slot = History.GetMaxSlots() - 1; Slot >= 0; Slot--)
+	{
+		FreeSlots.Add(Slot);
+	}
+}
+
+void UHeistHitboxHistorySubsystem::Deinitialize()
+{
+	SlotCharacters.Reset();
+	FreeSlots.Reset();
+	Super::Deinitialize();
+}
+
+TStatId UHeistHitboxHistorySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UHeistHitboxHistorySubsystem, STATGROUP_Tickables);
+}
+
+bool UHeistHitboxHistorySubsystem::IsTickable() const
+{
+	return !IsTemplate() && FreeSlots.Num() < SlotCharacters.Num();
+}
+
+int32 UHeistHitboxHistorySubsystem::FindSlot(const AHeistFPSCharacter* Character) const
+{
+	return SlotCharacters.IndexOfByPredicate([Character](const TWeakObjectPtr<AHeistFPSCharacter>& Slot) { return Slot.Get() == Character; });
+}
+
+void UHeistHitboxHistorySubsystem::Register(AHeistFPSCharacter* Character)
+{
+	if (Character == nullptr || FindSlot(Character) != INDEX_NONE) { return; }
+	if (FreeSlots.Num() == 0) { UE_LOG(LogTemp, Warning, TEXT("Hitbox history is full - %s is not recorded."), *Character->GetName()); return; }
+
+	const int32 Slot = FreeSlots.Pop();
+	SlotCharacters[Slot] = Character;
+	History.ClearSlot(Slot);
+
+	USkeletalMeshComponent* Mesh = Character->GetMesh();
+	for (int32 Hitbox = 0; Hitbox < Hitboxes.Num(); Hitbox++)
+	{
+		SlotBoneIndices[Slot * Hitboxes.Num() + Hitbox] = Mesh != nullptr ? Mesh->GetBoneIndex(Hitboxes[Hitbox].BoneName) : INDEX_NONE;
+	}
+}
+
+void UHeistHitboxHistorySubsystem::Unregister(AHeistFPSCharacter* Character)
+{
+	const int32 Slot = FindSlot(Character);
+	if (Slot == INDEX_NONE) { return; }
+
+	SlotCharacters[Slot] = nullptr;
+	History.ClearSlot(Slot);
+	FreeSlots.Add(Slot);
+}
+
+void UHeistHitboxHistorySubsystem::Tick(float DeltaTime)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistHitboxHistoryRecord);
+
+	History.BeginFrame(GetWorld()->GetTimeSeconds());
+	for (int32 Slot = 0; Slot < SlotCharacters.Num(); Slot++)
+	{
+		// Pooled and dead characters cannot be hit, so they are left out of the frame
+		AHeistFPSCharacter* Character = SlotCharacters[Slot].Get();
+		if (Character == nullptr || Character->IsPooled() || Character->IsDead()) { continue; }
+
+		const UCapsuleComponent* Capsule = Character->GetCapsuleComponent();
+		const USkeletalMeshComponent* Mesh = Character->GetMesh();
+		const FVector Center = Character->GetActorLocation();
+		for (int32 Hitbox = 0; Hitbox < Hitboxes.Num(); Hitbox++)
+		{
+			const int32 BoneIndex = SlotBoneIndices[Slot * Hitboxes.Num() + Hitbox];
+			HitboxScratch[Hitbox] = BoneIndex != INDEX_NONE ? Mesh->GetBoneTransform(BoneIndex).GetLocation() : Center;
+		}
+		History.WriteSlot(Slot, Center, Capsule->GetScaledCapsuleHalfHeight(), Capsule->GetScaledCapsuleRadius(), HitboxScratch.GetData());
+	}
+	History.EndFrame();
+}
+
+AHeistFPSCharacter* UHeistHitboxHistorySubsystem::TraceRewound(const FVector& Start, const FVector& End, double ServerTime, const AHeistFPSCharacter* IgnoreCharacter, int32& OutHitbox, FVector& OutLocation) const
+{
+	FHeistRewindHit Hit;
+	const int32 IgnoreSlot = IgnoreCharacter != nullptr ? FindSlot(IgnoreCharacter) : INDEX_NONE;
+	if (!History.Trace(Start, End, ServerTime, IgnoreSlot, Hit)) { return nullptr; }
+
+	OutHitbox = Hit.Hitbox;
+	OutLocation = Hit.Location;
+	return SlotCharacters[Hit.Slot].Get();
+}
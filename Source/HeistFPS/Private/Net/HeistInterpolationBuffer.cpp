@@ -0,0 +1,197 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/HeistInterpolationBuffer.h"
+#include "HeistFPS.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+void FHeistAnimInterpolationBuffer::AddSample(const FHeistAnimSample& Sample)
+{
+	if (Num > 0)
+	{
+		const FHeistAnimSample& Newest = Get(Num - 1);
+		if (Sample.ServerTime <= Newest.ServerTime) { return; }
+
+		//Servers only send changes, so a long gap means the old value held until just before this sample
+		if (Sample.ServerTime - Newest.ServerTime > MaxInterpolationGap)
+		{
+			FHeistAnimSample Held = Newest;
+			Held.ServerTime = Sample.ServerTime - MaxExtrapolation;
+			Push(Held);
+		}
+	}
+	Push(Sample);
+}
+
+void FHeistAnimInterpolationBuffer::Push(const FHeistAnimSample& Sample)
+{
+	if (Num == Capacity)
+	{
+		Head = (Head + 1) % Capacity;
+		Num--;
+	}
+	Samples[(Head + Num) % Capacity] = Sample;
+	Num++;
+}
+
+bool FHeistAnimInterpolationBuffer::Sample(float RenderTime, FHeistAnimSample& OutSample) const
+{
+	if (Num == 0) { return false; }
+
+	const FHeistAnimSample& Oldest = Get(0);
+	if (Num == 1 || RenderTime <= Oldest.ServerTime)
+	{
+		OutSample = Oldest;
+		return true;
+	}
+
+	//Search back from the newest sample - the render time is normally near the end of the buffer
+	for (int32 Index = Num - 2; Index >= 0; Index--)
+	{
+		const FHeistAnimSample& From = Get(Index);
+		if (From.ServerTime <= RenderTime)
+		{
+			const FHeistAnimSample& To = Get(Index + 1);
+			const float Span = To.ServerTime - From.ServerTime;
+			float Alpha = (RenderTime - From.ServerTime) / Span;
+
+			//Only the newest pair may run past 1, for MaxExtrapolation seconds, then it eases back onto the newest sample
+			const float PastNewest = RenderTime - To.ServerTime;
+			if (Index == Num - 2 && PastNewest > 0.0f)
+			{
+				float Extrapolated = FMath::Min(PastNewest, MaxExtrapolation);
+				if (PastNewest > MaxExtrapolation)
+				{
+					Extrapolated *= 1.0f - FMath::SmoothStep(0.0f, ExtrapolationRecovery, PastNewest - MaxExtrapolation);
+				}
+				Alpha = 1.0f + Extrapolated / Span;
+			}
+			OutSample = Lerp(From, To, Alpha);
+			OutSample.ServerTime = RenderTime;
+			return true;
+		}
+	}
+	OutSample = Oldest;
+	return true;
+}
+
+FHeistAnimSample FHeistAnimInterpolationBuffer::Lerp(const FHeistAnimSample& From, const FHeistAnimSample& To, float Alpha)
+{
+	FHeistAnimSample Result;
+	Result.Speed = FMath::Max(FMath::Lerp(From.Speed, To.Speed, Alpha), 0.0f);
+	//Angles take the shortest way round
+	Result.Direction = FRotator::NormalizeAxis(From.Direction + FMath::FindDeltaAngleDegrees(From.Direction, To.Direction) * Alpha);
+	Result.Pitch = FRotator::NormalizeAxis(From.Pitch + FMath::FindDeltaAngleDegrees(From.Pitch, To.Pitch) * Alpha);
+	Result.Yaw = FRotator::NormalizeAxis(From.Yaw + FMath::FindDeltaAngleDegrees(From.Yaw, To.Yaw) * Alpha);
+	return Result;
+}
+
+/********************************************************************
+				BENCHMARK
+*********************************************************************/
+namespace HeistInterpolationBench
+{
+	//Smooth aim movement with a fast component, in degrees
+	static float TrueYaw(float Time)
+	{
+		return 60.0f * FMath::Sin(Time * 1.3f) + 20.0f * FMath::Sin(Time * 4.1f);
+	}
+
+	struct FResult
+	{
+		double MeanAbsError = 0.0;
+		double RmsAcceleration = 0.0;
+	};
+
+	/**
+	 * Sends TrueYaw at UpdateRate with send jitter, latency jitter and loss, renders it at 120 fps either as
+	 * received or through the buffer, and measures error against the truth at the displayed time and the
+	 * RMS second difference per frame - the visible jitter.
+	 */
+	static FResult Run(float UpdateRate, bool bBuffered, float Delay, float Seconds)
+	{
+		FRandomStream Random(42);
+		FHeistAnimInterpolationBuffer Buffer;
+
+		struct FPacket { float ArrivalTime; FHeistAnimSample Sample; };
+		TArray<FPacket> Packets;
+		for (float SendTime = 0.0f; SendTime < Seconds; SendTime += (1.0f / UpdateRate) * Random.FRandRange(0.8f, 1.2f))
+		{
+			if (Random.FRand() < 0.05f) { continue; }
+			FPacket Packet;
+			Packet.Sample.ServerTime = SendTime;
+			Packet.Sample.Yaw = TrueYaw(SendTime);
+			Packet.ArrivalTime = SendTime + 0.05f + Random.FRandRange(0.0f, 0.03f);
+			Packets.Add(Packet);
+		}
+		Packets.Sort([](const FPacket& A, const FPacket& B) { return A.ArrivalTime < B.ArrivalTime; });
+
+		const float FrameTime = 1.0f / 120.0f;
+		int32 NextPacket = 0;
+		float LastArrivedYaw = 0.0f;
+		TArray<float> Rendered;
+		double ErrorSum = 0.0;
+		for (float Time = 1.0f; Time < Seconds; Time += FrameTime)
+		{
+			while (NextPacket < Packets.Num() && Packets[NextPacket].ArrivalTime <= Time)
+			{
+				Buffer.AddSample(Packets[NextPacket].Sample);
+				LastArrivedYaw = Packets[NextPacket].Sample.Yaw;
+				NextPacket++;
+			}
+
+			//Server time is estimated as local time minus the mean one-way latency
+			const float ServerTime = Time - 0.065f;
+			float Yaw = LastArrivedYaw;
+			float DisplayedTime = ServerTime;
+			FHeistAnimSample Sample;
+			if (bBuffered && Buffer.Sample(ServerTime - Delay, Sample))
+			{
+				Yaw = Sample.Yaw;
+				DisplayedTime = ServerTime - Delay;
+			}
+			ErrorSum += FMath::Abs(FMath::FindDeltaAngleDegrees(TrueYaw(DisplayedTime), Yaw));
+			Rendered.Add(Yaw);
+		}
+
+		FResult Result;
+		double AccelerationSum = 0.0;
+		for (int32 i = 2; i < Rendered.Num(); i++)
+		{
+			const double SecondDifference = Rendered[i] - 2.0 * Rendered[i - 1] + Rendered[i - 2];
+			AccelerationSum += SecondDifference * SecondDifference;
+		}
+		Result.MeanAbsError = ErrorSum / FMath::Max(Rendered.Num(), 1);
+		Result.RmsAcceleration = FMath::Sqrt(AccelerationSum / FMath::Max(Rendered.Num() - 2, 1));
+		return Result;
+	}
+}
+
+static FAutoConsoleCommand HeistBenchProxyInterpolationCommand(
+	TEXT("heist.Bench.ProxyInterpolation"),
+	TEXT("heist.Bench.ProxyInterpolation [Delay=0.1] [Seconds=30] [MaxErrorDeg=0.5] - compares applying simulated proxy anim updates on arrival against the interpolation buffer at 10, 20 and 30 Hz. Fails if the buffer's mean error exceeds MaxErrorDeg or it is not smoother and more accurate than applying on arrival."),
+	FConsoleCommandWithArgsDelegate::CreateStatic([](const TArray<FString>& Args)
+	{
+		const float Delay = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 0.1f;
+		const float Seconds = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 30.0f;
+		const float MaxErrorDegrees = Args.Num() > 2 ? FCString::Atof(*Args[2]) : 0.5f;
+
+		bool bPassed = true;
+		const float Rates[] = { 10.0f, 20.0f, 30.0f };
+		for (float Rate : Rates)
+		{
+			const HeistInterpolationBench::FResult Raw = HeistInterpolationBench::Run(Rate, false, Delay, Seconds);
+			const HeistInterpolationBench::FResult Buffered = HeistInterpolationBench::Run(Rate, true, Delay, Seconds);
+			UE_LOG(LogTemp, Log, TEXT("heist.Bench.ProxyInterpolation: %2.0f Hz - on arrival: error %.3f deg, jitter %.4f deg/frame^2 | buffered %.2fs: error %.3f deg, jitter %.4f deg/frame^2"),
+				Rate, Raw.MeanAbsError, Raw.RmsAcceleration, Delay, Buffered.MeanAbsError, Buffered.RmsAcceleration);
+
+			if (Buffered.MeanAbsError > MaxErrorDegrees || Buffered.MeanAbsError >= Raw.MeanAbsError || Buffered.RmsAcceleration >= Raw.RmsAcceleration)
+			{
+				UE_LOG(LogTemp, Error, TEXT("heist.Bench.ProxyInterpolation: %2.0f Hz is outside the bound - buffered error %.3f deg (max %.3f)."), Rate, Buffered.MeanAbsError, MaxErrorDegrees);
+				bPassed = false;
+			}
+		}
+		UE_LOG(LogTemp, Log, TEXT("heist.Bench.ProxyInterpolation: %s."), bPassed ? TEXT("PASSED") : TEXT("FAILED"));
+	}));
@@ -0,0 +1,423 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/HeistMockSessionInterface.h"
+#include "HeistFPS.h"
+
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+
+static float GHeistMockSessionLatencyMs = 50.0f;
+static FAutoConsoleVariableRef CVarHeistMockSessionLatencyMs(
+	TEXT("heist.MockSessions.LatencyMs"),
+	GHeistMockSessionLatencyMs,
+	TEXT("Milliseconds before a mock session request completes."));
+
+static float GHeistMockSessionFailurePct = 0.0f;
+static FAutoConsoleVariableRef CVarHeistMockSessionFailurePct(
+	TEXT("heist.MockSessions.FailurePct"),
+	GHeistMockSessionFailurePct,
+	TEXT("Chance in percent that a mock session request fails."));
+
+static int32 GHeistMockSessionCount = 100;
+static FAutoConsoleVariableRef CVarHeistMockSessionCount(
+	TEXT("heist.MockSessions.Count"),
+	GHeistMockSessionCount,
+	TEXT("Number of synthetic sessions a mock search finds, before MaxSearchResults is applied."));
+
+static int32 GHeistMockSessionSeed = 1;
+static FAutoConsoleVariableRef CVarHeistMockSessionSeed(
+	TEXT("heist.MockSessions.Seed"),
+	GHeistMockSessionSeed,
+	TEXT("Seed for the synthetic sessions and injected failures. Changing it restarts both sequences."));
+
+static FString GHeistMockSessionConnectAddress = TEXT("127.0.0.1:7777");
+static FAutoConsoleVariableRef CVarHeistMockSessionConnectAddress(
+	TEXT("heist.MockSessions.ConnectAddress"),
+	GHeistMockSessionConnectAddress,
+	TEXT("Address every mock session resolves to when joined."));
+
+FHeistMockSessionInterface::FHeistMockSessionInterface()
+{
+	UE_LOG(LogTemp, Log, TEXT("Using mock session backend."));
+}
+
+FHeistMockSessionInterface::~FHeistMockSessionInterface()
+{
+}
+
+bool FHeistMockSessionInterface::Tick(float DeltaTime)
+{
+	if (PendingCompletions.Num() == 0) { return true; }
+
+	//Completions can start new requests, so the due ones are taken out before any of them run
+	const double Now = FPlatformTime::Seconds();
+	TArray<FPendingCompletion> Due;
+	for (int32 i = 0; i < PendingCompletions.Num();)
+	{
+		if (PendingCompletions[i].DueTime <= Now)
+		{
+			Due.Add(MoveTemp(PendingCompletions[i]));
+			PendingCompletions.RemoveAt(i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+
+	for (FPendingCompletion& Completion : Due)
+	{
+		Completion.Complete();
+	}
+	return true;
+}
+
+void FHeistMockSessionInterface::Defer(TFunction<void()>&& Complete)
+{
+	//Completed on a later tick even without latency, like a real backend
+	PendingCompletions.Add({ FPlatformTime::Seconds() + FMath::Max(GHeistMockSessionLatencyMs, 0.0f) / 1000.0, MoveTemp(Complete) });
+}
+
+bool FHeistMockSessionInterface::ShouldFail()
+{
+	if (FailureStreamSeed != GHeistMockSessionSeed)
+	{
+		FailureStreamSeed = GHeistMockSessionSeed;
+		FailureStream.Initialize(FailureStreamSeed);
+	}
+	return FailureStream.FRand() * 100.0f < GHeistMockSessionFailurePct;
+}
+
+void FHeistMockSessionInterface::BuildHostedSessions()
+{
+	const int32 Count = FMath::Max(GHeistMockSessionCount, 0);
+	if (HostedSessions.Num() == Count && HostedSessionsSeed == GHeistMockSessionSeed) { return; }
+
+	HostedSessionsSeed = GHeistMockSessionSeed;
+	FRandomStream Stream(HostedSessionsSeed);
+	HostedSessions.Reset(Count);
+	for (int32 i = 0; i < Count; i++)
+	{
+		FOnlineSessionSearchResult& Result = HostedSessions.AddDefaulted_GetRef();
+		Result.PingInMs = Stream.RandRange(10, 200);
+
+		FOnlineSessionSettings& Settings = Result.Session.SessionSettings;
+		Settings.bShouldAdvertise = true;
+		Settings.bUsesPresence = true;
+		Settings.NumPublicConnections = Stream.RandRange(2, 16);
+		Settings.Set(SETTING_MAPNAME, FString::Printf(TEXT("MockMap%d"), Stream.RandRange(1, 4)), EOnlineDataAdvertisementType::ViaOnlineService);
+
+		Result.Session.NumOpenPublicConnections = Stream.RandRange(0, Settings.NumPublicConnections);
+		Result.Session.OwningUserName = FString::Printf(TEXT("MockHost%d"), i);
+		Result.Session.OwningUserId = MakeShared<FUniqueNetIdString>(Result.Session.OwningUserName);
+		Result.Session.SessionInfo = MakeShared<FHeistMockSessionInfo>(FString::Printf(TEXT("MockSession%05d"), i), GHeistMockSessionConnectAddress);
+	}
+}
+
+/********************************************************************
+				NAMED SESSIONS
+*********************************************************************/
+TSharedPtr<const FUniqueNetId> FHeistMockSessionInterface::CreateSessionIdFromString(const FString& SessionIdStr)
+{
+	return MakeShared<FUniqueNetIdString>(SessionIdStr);
+}
+
+FNamedOnlineSession* FHeistMockSessionInterface::GetNamedSession(FName SessionName)
+{
+	return Sessions.FindByPredicate([SessionName](const FNamedOnlineSession& Session) { return Session.SessionName == SessionName; });
+}
+
+void FHeistMockSessionInterface::RemoveNamedSession(FName SessionName)
+{
+	Sessions.RemoveAll([SessionName](const FNamedOnlineSession& Session) { return Session.SessionName == SessionName; });
+}
+
+EOnlineSessionState::Type FHeistMockSessionInterface::GetSessionState(FName SessionName) const
+{
+	const FNamedOnlineSession* Session = Sessions.FindByPredicate([SessionName](const FNamedOnlineSession& Session) { return Session.SessionName == SessionName; });
+	return Session != nullptr ? Session->SessionState : EOnlineSessionState::NoSession;
+}
+
+bool FHeistMockSessionInterface::HasPresenceSession()
+{
+	return Sessions.ContainsByPredicate([](const FNamedOnlineSession& Session) { return Session.SessionSettings.bUsesPresence; });
+}
+
+FNamedOnlineSession* FHeistMockSessionInterface::AddNamedSession(FName SessionName, const FOnlineSessionSettings& SessionSettings)
+{
+	return &Sessions.Emplace_GetRef(SessionName, SessionSettings);
+}
+
+FNamedOnlineSession* FHeistMockSessionInterface::AddNamedSession(FName SessionName, const FOnlineSession& Session)
+{
+	return &Sessions.Emplace_GetRef(SessionName, Session);
+}
+
+FOnlineSessionSettings* FHeistMockSessionInterface::GetSessionSettings(FName SessionName)
+{
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	return Session != nullptr ? &Session->SessionSettings : nullptr;
+}
+
+int32 FHeistMockSessionInterface::GetNumSessions()
+{
+	return Sessions.Num();
+}
+
+void FHeistMockSessionInterface::DumpSessionState()
+{
+	for (const FNamedOnlineSession& Session : Sessions)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Mock session %s: %s"), *Session.SessionName.ToString(), EOnlineSessionState::ToString(Session.SessionState));
+	}
+}
+
+/********************************************************************
+				HOSTING
+*********************************************************************/
+bool FHeistMockSessionInterface::CreateSession(int32 HostingPlayerNum, FName SessionName, const FOnlineSessionSettings& NewSessionSettings)
+{
+	if (GetNamedSession(SessionName) != nullptr)
+	{
+		//Like the NULL and Steam subsystems, a call that can't start still reports through the delegate
+		UE_LOG(LogTemp, Warning, TEXT("Mock session %s already exists."), *SessionName.ToString());
+		Defer([this, SessionName]() { TriggerOnCreateSessionCompleteDelegates(SessionName, false); });
+		return false;
+	}
+
+	FNamedOnlineSession* Session = AddNamedSession(SessionName, NewSessionSettings);
+	Session->SessionState = EOnlineSessionState::Creating;
+	Session->bHosting = true;
+	Session->NumOpenPublicConnections = NewSessionSettings.NumPublicConnections;
+	Session->OwningUserName = TEXT("MockLocalHost");
+	Session->OwningUserId = MakeShared<FUniqueNetIdString>(Session->OwningUserName);
+	Session->SessionInfo = MakeShared<FHeistMockSessionInfo>(TEXT("MockLocalSession"), GHeistMockSessionConnectAddress);
+
+	Defer([this, SessionName]()
+	{
+		const bool bSuccess = !ShouldFail();
+		if (bSuccess)
+		{
+			if (FNamedOnlineSession* Created = GetNamedSession(SessionName))
+			{
+				Created->SessionState = EOnlineSessionState::Pending;
+			}
+		}
+		else
+		{
+			RemoveNamedSession(SessionName);
+		}
+		TriggerOnCreateSessionCompleteDelegates(SessionName, bSuccess);
+	});
+	return true;
+}
+
+bool FHeistMockSessionInterface::CreateSession(const FUniqueNetId& HostingPlayerId, FName SessionName, const FOnlineSessionSettings& NewSessionSettings)
+{
+	return CreateSession(0, SessionName, NewSessionSettings);
+}
+
+bool FHeistMockSessionInterface::StartSession(FName SessionName)
+{
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	if (Session == nullptr) { return false; }
+
+	Session->SessionState = EOnlineSessionState::InProgress;
+	Defer([this, SessionName]() { TriggerOnStartSessionCompleteDelegates(SessionName, true); });
+	return true;
+}
+
+bool FHeistMockSessionInterface::UpdateSession(FName SessionName, FOnlineSessionSettings& UpdatedSessionSettings, bool bShouldRefreshOnlineData)
+{
+	if (GetNamedSession(SessionName) == nullptr)
+	{
+		Defer([this, SessionName]() { TriggerOnUpdateSessionCompleteDelegates(SessionName, false); });
+		return false;
+	}
+
+	Defer([this, SessionName, UpdatedSessionSettings]()
+	{
+		FNamedOnlineSession* Session = GetNamedSession(SessionName);
+		const bool bSuccess = Session != nullptr && !ShouldFail();
+		if (bSuccess)
+		{
+			Session->SessionSettings = UpdatedSessionSettings;
+		}
+		TriggerOnUpdateSessionCompleteDelegates(SessionName, bSuccess);
+	});
+	return true;
+}
+
+bool FHeistMockSessionInterface::EndSession(FName SessionName)
+{
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	if (Session == nullptr) { return false; }
+
+	Session->SessionState = EOnlineSessionState::Ended;
+	Defer([this, SessionName]() { TriggerOnEndSessionCompleteDelegates(SessionName, true); });
+	return true;
+}
+
+bool FHeistMockSessionInterface::DestroySession(FName SessionName, const FOnDestroySessionCompleteDelegate& CompletionDelegate)
+{
+	FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	if (Session == nullptr || Session->SessionState == EOnlineSessionState::Destroying)
+	{
+		Defer([this, SessionName, CompletionDelegate]()
+		{
+			CompletionDelegate.ExecuteIfBound(SessionName, false);
+			TriggerOnDestroySessionCompleteDelegates(SessionName, false);
+		});
+		return false;
+	}
+
+	Session->SessionState = EOnlineSessionState::Destroying;
+	Defer([this, SessionName, CompletionDelegate]()
+	{
+		//A failed destroy leaves the session as it was, so the caller can retry
+		const bool bSuccess = !ShouldFail();
+		if (bSuccess)
+		{
+			RemoveNamedSession(SessionName);
+		}
+		else if (FNamedOnlineSession* Remaining = GetNamedSession(SessionName))
+		{
+			Remaining->SessionState = EOnlineSessionState::Pending;
+		}
+		CompletionDelegate.ExecuteIfBound(SessionName, bSuccess);
+		TriggerOnDestroySessionCompleteDelegates(SessionName, bSuccess);
+	});
+	return true;
+}
+
+/********************************************************************
+				SEARCH AND JOIN
+*********************************************************************/
+bool FHeistMockSessionInterface::FindSessions(int32 SearchingPlayerNum, const TSharedRef<FOnlineSessionSearch>& SearchSettings)
+{
+	if (CurrentSearch.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Mock session search already in progress."));
+		return false;
+	}
+
+	CurrentSearch = SearchSettings;
+	SearchSettings->SearchResults.Reset();
+	SearchSettings->SearchState = EOnlineAsyncTaskState::InProgress;
+
+	const int32 Serial = ++SearchSerial;
+	Defer([this, Serial]()
+	{
+		if (!CurrentSearch.IsValid() || Serial != SearchSerial) { return; }
+
+		//Results are filled on a later tick, outside RefreshServerList's scope, so they are tagged here as well
+		HEISTFPS_LLM_SCOPE(UI);
+		TSharedPtr<FOnlineSessionSearch> Search = MoveTemp(CurrentSearch);
+		CurrentSearch.Reset();
+
+		const bool bSuccess = !ShouldFail();
+		if (bSuccess)
+		{
+			BuildHostedSessions();
+			const int32 NumResults = Search->MaxSearchResults > 0 ? FMath::Min(HostedSessions.Num(), Search->MaxSearchResults) : HostedSessions.Num();
+			Search->SearchResults.Append(HostedSessions.GetData(), NumResults);
+		}
+		Search->SearchState = bSuccess ? EOnlineAsyncTaskState::Done : EOnlineAsyncTaskState::Failed;
+		TriggerOnFindSessionsCompleteDelegates(bSuccess);
+	});
+	return true;
+}
+
+bool FHeistMockSessionInterface::FindSessions(const FUniqueNetId& SearchingPlayerId, const TSharedRef<FOnlineSessionSearch>& SearchSettings)
+{
+	return FindSessions(0, SearchSettings);
+}
+
+bool FHeistMockSessionInterface::CancelFindSessions()
+{
+	if (!CurrentSearch.IsValid()) { return false; }
+
+	CurrentSearch->SearchState = EOnlineAsyncTaskState::Failed;
+	CurrentSearch.Reset();
+	Defer([this]() { TriggerOnCancelFindSessionsCompleteDelegates(true); });
+	return true;
+}
+
+bool FHeistMockSessionInterface::JoinSession(int32 PlayerNum, FName SessionName, const FOnlineSessionSearchResult& DesiredSession)
+{
+	if (GetNamedSession(SessionName) != nullptr)
+	{
+		Defer([this, SessionName]() { TriggerOnJoinSessionCompleteDelegates(SessionName, EOnJoinSessionCompleteResult::AlreadyInSession); });
+		return false;
+	}
+
+	FNamedOnlineSession* Session = AddNamedSession(SessionName, DesiredSession.Session);
+	Session->SessionState = EOnlineSessionState::Pending;
+
+	Defer([this, SessionName]()
+	{
+		const bool bSuccess = !ShouldFail();
+		if (!bSuccess)
+		{
+			RemoveNamedSession(SessionName);
+		}
+		TriggerOnJoinSessionCompleteDelegates(SessionName, bSuccess ? EOnJoinSessionCompleteResult::Success : EOnJoinSessionCompleteResult::UnknownError);
+	});
+	return true;
+}
+
+bool FHeistMockSessionInterface::JoinSession(const FUniqueNetId& PlayerId, FName SessionName, const FOnlineSessionSearchResult& DesiredSession)
+{
+	return JoinSession(0, SessionName, DesiredSession);
+}
+
+bool FHeistMockSessionInterface::GetResolvedConnectString(FName SessionName, FString& ConnectInfo, FName PortType)
+{
+	const FNamedOnlineSession* Session = GetNamedSession(SessionName);
+	if (Session == nullptr || !Session->SessionInfo.IsValid()) { return false; }
+
+	ConnectInfo = StaticCastSharedPtr<FHeistMockSessionInfo>(Session->SessionInfo)->GetConnectAddress();
+	return true;
+}
+
+bool FHeistMockSessionInterface::GetResolvedConnectString(const FOnlineSessionSearchResult& SearchResult, FName PortType, FString& ConnectInfo)
+{
+	if (!SearchResult.Session.SessionInfo.IsValid()) { return false; }
+
+	ConnectInfo = StaticCastSharedPtr<FHeistMockSessionInfo>(SearchResult.Session.SessionInfo)->GetConnectAddress();
+	return true;
+}
+
+/********************************************************************
+				UNSUPPORTED
+*********************************************************************/
+// Matchmaking, friends, invites and player registration are not used by the game and are not mocked
+
+bool FHeistMockSessionInterface::IsPlayerInSession(FName SessionName, const FUniqueNetId& UniqueId) { return false; }
+bool FHeistMockSessionInterface::StartMatchmaking(const TArray<TSharedRef<const FUniqueNetId>>& LocalPlayers, FName SessionName, const FOnlineSessionSettings& NewSessionSettings, TSharedRef<FOnlineSessionSearch>& SearchSettings) { return false; }
+bool FHeistMockSessionInterface::CancelMatchmaking(int32 SearchingPlayerNum, FName SessionName) { return false; }
+bool FHeistMockSessionInterface::CancelMatchmaking(const FUniqueNetId& SearchingPlayerId, FName SessionName) { return false; }
+bool FHeistMockSessionInterface::FindSessionById(const FUniqueNetId& SearchingUserId, const FUniqueNetId& SessionId, const FUniqueNetId& FriendId, const FOnSingleSessionResultCompleteDelegate& CompletionDelegate) { return false; }
+bool FHeistMockSessionInterface::PingSearchResults(const FOnlineSessionSearchResult& SearchResult) { return false; }
+bool FHeistMockSessionInterface::FindFriendSession(int32 LocalUserNum, const FUniqueNetId& Friend) { return false; }
+bool FHeistMockSessionInterface::FindFriendSession(const FUniqueNetId& LocalUserId, const FUniqueNetId& Friend) { return false; }
+bool FHeistMockSessionInterface::FindFriendSession(const FUniqueNetId& LocalUserId, const TArray<TSharedRef<const FUniqueNetId>>& FriendList) { return false; }
+bool FHeistMockSessionInterface::SendSessionInviteToFriend(int32 LocalUserNum, FName SessionName, const FUniqueNetId& Friend) { return false; }
+bool FHeistMockSessionInterface::SendSessionInviteToFriend(const FUniqueNetId& LocalUserId, FName SessionName, const FUniqueNetId& Friend) { return false; }
+bool FHeistMockSessionInterface::SendSessionInviteToFriends(int32 LocalUserNum, FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& Friends) { return false; }
+bool FHeistMockSessionInterface::SendSessionInviteToFriends(const FUniqueNetId& LocalUserId, FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& Friends) { return false; }
+bool FHeistMockSessionInterface::RegisterPlayer(FName SessionName, const FUniqueNetId& PlayerId, bool bWasInvited) { return false; }
+bool FHeistMockSessionInterface::RegisterPlayers(FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& Players, bool bWasInvited) { return false; }
+bool FHeistMockSessionInterface::UnregisterPlayer(FName SessionName, const FUniqueNetId& PlayerId) { return false; }
+bool FHeistMockSessionInterface::UnregisterPlayers(FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& Players) { return false; }
+
+void FHeistMockSessionInterface::RegisterLocalPlayer(const FUniqueNetId& PlayerId, FName SessionName, const FOnRegisterLocalPlayerCompleteDelegate& Delegate)
+{
+	Delegate.ExecuteIfBound(PlayerId, EOnJoinSessionCompleteResult::Success);
+}
+
+void FHeistMockSessionInterface::UnregisterLocalPlayer(const FUniqueNetId& PlayerId, FName SessionName, const FOnUnregisterLocalPlayerCompleteDelegate& Delegate)
+{
+	Delegate.ExecuteIfBound(PlayerId, true);
+}
@@ -0,0 +1,163 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/HeistNetPrioritySubsystem.h"
+#include "HeistFPS.h"
+
+#include "Player/HeistFPSCharacter.h"
+
+#include "Engine/World.h"
+#include "Engine/NetDriver.h"
+#include "Engine/NetConnection.h"
+
+DECLARE_CYCLE_STAT(TEXT("NetPriorityThrottle"), STAT_HeistNetPriorityThrottle, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("NetPriorityBudgets"), STAT_HeistNetPriorityBudgets, STATGROUP_HeistFPS);
+
+UHeistNetPrioritySubsystem* UHeistNetPrioritySubsystem::Get(const UObject* WorldContext)
+{
+	UWorld* World = WorldContext != nullptr ? WorldContext->GetWorld() : nullptr;
+	UHeistNetPrioritySubsystem* Priority = World != nullptr ? World->GetSubsystem<UHeistNetPrioritySubsystem>() : nullptr;
+	return (Priority != nullptr && Priority->bEnabled) ? Priority : nullptr;
+}
+
+bool UHeistNetPrioritySubsystem::IsTickable() const
+{
+	if (!bEnabled || IsTemplate()) { return false; }
+
+	UWorld* World = GetWorld();
+	if (World == nullptr || !World->IsGameWorld()) { return false; }
+
+	const ENetMode NetMode = World->GetNetMode();
+	return NetMode == NM_DedicatedServer || NetMode == NM_ListenServer;
+}
+
+TStatId UHeistNetPrioritySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UHeistNetPrioritySubsystem, STATGROUP_Tickables);
+}
+
+void UHeistNetPrioritySubsystem::Tick(float DeltaTime)
+{
+	TimeSinceBudgetUpdate += DeltaTime;
+	if (TimeSinceBudgetUpdate >= 1.0f)
+	{
+		UpdateConnectionBudgets(TimeSinceBudgetUpdate);
+		TimeSinceBudgetUpdate = 0.0f;
+	}
+}
+
+float UHeistNetPrioritySubsystem::GetRelevance(const AHeistFPSCharacter& Character, const FVector& ViewPos, const FVector& ViewDir) const
+{
+	const FVector ToCharacter = Character.GetActorLocation() - ViewPos;
+	float Relevance = FMath::GetMappedRangeValueClamped(FVector2D(NearDistance, FarDistance), FVector2D(1.0f, FarRelevance), ToCharacter.Size());
+
+	if ((ToCharacter | ViewDir) < 0.0f)
+	{
+		Relevance *= BehindRelevanceScale;
+	}
+	if (!Character.bCombatInitiated && !Character.HasMovedWithin(RecentMovementSeconds))
+	{
+		Relevance *= IdleRelevanceScale;
+	}
+
+	//Someone aiming or armed matters wherever they are
+	if (Character.bAimDownSight)
+	{
+		Relevance = FMath::Max(Relevance, AimDownSightRelevance);
+	}
+	else if (Character.bCombatInitiated)
+	{
+		Relevance = FMath::Max(Relevance, CombatRelevance);
+	}
+	return FMath::Clamp(Relevance, 0.0f, 1.0f);
+}
+
+float UHeistNetPrioritySubsystem::GetNetPriority(const AHeistFPSCharacter& Character, const FVector& ViewPos, const FVector& ViewDir, const AActor* ViewTarget, float Time) const
+{
+	//Same boost the engine gives the viewer's own pawn
+	if (ViewTarget == &Character || ViewTarget == Character.GetInstigator())
+	{
+		return Character.NetPriority * Time * 4.0f;
+	}
+
+	//Spans the engine's 0.2 to 2 distance band multipliers
+	return Character.NetPriority * Time * FMath::Lerp(0.2f, 2.0f, GetRelevance(Character, ViewPos, ViewDir));
+}
+
+bool UHeistNetPrioritySubsystem::ShouldThrottle(const AHeistFPSCharacter& Character, const FNetViewer& Viewer) const
+{
+	//Owners always get every update - their own pawn drives movement correction
+	if (Viewer.Connection == nullptr || Viewer.Connection == Character.GetNetConnection() || Viewer.ViewTarget == &Character) { return false; }
+
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistNetPriorityThrottle);
+
+	//Never sent to this connection yet
+	const FConnectionState* State = Connections.Find(FObjectKey(Viewer.Connection));
+	const float* LastSendTime = State != nullptr ? State->LastSendTimes.Find(FObjectKey(&Character)) : nullptr;
+	if (LastSendTime == nullptr) { return false; }
+
+	const float Relevance = GetRelevance(Character, Viewer.ViewLocation, Viewer.ViewDir);
+	const float MaxFrequency = FMath::Max(Character.NetUpdateFrequency, MinNetUpdateFrequency);
+	const float Frequency = FMath::Max(FMath::Lerp(MinNetUpdateFrequency, MaxFrequency, Relevance) * State->FrequencyScale, MinNetUpdateFrequency);
+
+	//Half an actor update of slack so full-rate characters are not skipped by timing jitter
+	return GetWorld()->GetTimeSeconds() - *LastSendTime < 1.0f / Frequency - 0.5f / MaxFrequency;
+}
+
+void UHeistNetPrioritySubsystem::RecordSend(const AHeistFPSCharacter& Character, const UNetConnection* Connection)
+{
+	//Only connections ShouldThrottle can hold back need the time
+	if (Connection == nullptr || Connection == Character.GetNetConnection()) { return; }
+
+	Connections.FindOrAdd(FObjectKey(Connection)).LastSendTimes.Add(FObjectKey(&Character), GetWorld()->GetTimeSeconds());
+}
+
+void UHeistNetPrioritySubsystem::UpdateConnectionBudgets(float Interval)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistNetPriorityBudgets);
+
+	UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+	if (NetDriver == nullptr) { return; }
+
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		if (Connection == nullptr) { continue; }
+
+		//Clients request their own rate, which the server otherwise accepts up to MaxClientRate
+		Connection->CurrentNetSpeed = FMath::Min(Connection->CurrentNetSpeed, BandwidthBudget);
+
+		FConnectionState& State = Connections.FindOrAdd(FObjectKey(Connection));
+		const int64 OutTotalBytes = Connection->OutTotalBytes;
+		if (State.LastOutTotalBytes >= 0)
+		{
+			//Back off quickly when close to the budget and recover slowly, so saturation rarely decides what gets dropped
+			const float TargetBytesPerSecond = BandwidthBudget * TargetUtilization;
+			const float BytesPerSecond = (OutTotalBytes - State.LastOutTotalBytes) / Interval;
+			if (BytesPerSecond > TargetBytesPerSecond)
+			{
+				State.FrequencyScale = FMath::Max(State.FrequencyScale * 0.8f, 0.1f);
+			}
+			else if (BytesPerSecond < TargetBytesPerSecond * 0.75f)
+			{
+				State.FrequencyScale = FMath::Min(State.FrequencyScale + 0.05f, 1.0f);
+			}
+		}
+		State.LastOutTotalBytes = OutTotalBytes;
+	}
+
+	for (auto It = Connections.CreateIterator(); It; ++It)
+	{
+		if (It.Key().ResolveObjectPtr() == nullptr)
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+		for (auto SendIt = It.Value().LastSendTimes.CreateIterator(); SendIt; ++SendIt)
+		{
+			if (SendIt.Key().ResolveObjectPtr() == nullptr)
+			{
+				SendIt.RemoveCurrent();
+			}
+		}
+	}
+}
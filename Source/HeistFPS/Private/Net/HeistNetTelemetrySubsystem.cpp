@@ -0,0 +1,270 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/HeistNetTelemetrySubsystem.h"
+#include "HeistFPS.h"
+
+#include "Engine/World.h"
+#include "Engine/NetDriver.h"
+#include "Engine/NetConnection.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Async/Async.h"
+
+DECLARE_CYCLE_STAT(TEXT("NetTelemetryFlush"), STAT_HeistNetTelemetryFlush, STATGROUP_HeistFPS);
+
+static int32 GHeistNetTelemetry = 0;
+static FAutoConsoleVariableRef CVarHeistNetTelemetry(
+	TEXT("heist.NetTelemetry"),
+	GHeistNetTelemetry,
+	TEXT("Collect per-second network telemetry on servers and write it to Saved/Telemetry (0 = off, 1 = on)."));
+
+UHeistNetTelemetrySubsystem* UHeistNetTelemetrySubsystem::Get(const UObject* WorldContext)
+{
+	UWorld* World = WorldContext != nullptr ? WorldContext->GetWorld() : nullptr;
+	UHeistNetTelemetrySubsystem* Telemetry = World != nullptr ? World->GetSubsystem<UHeistNetTelemetrySubsystem>() : nullptr;
+	return (Telemetry != nullptr && Telemetry->IsCollecting()) ? Telemetry : nullptr;
+}
+
+void UHeistNetTelemetrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	if (FParse::Param(FCommandLine::Get(), TEXT("HeistNetTelemetry")))
+	{
+		GHeistNetTelemetry = 1;
+	}
+	CollectStartTime = FPlatformTime::Seconds();
+}
+
+void UHeistNetTelemetrySubsystem::Deinitialize()
+{
+	if (IsCollecting())
+	{
+		Flush();
+	}
+	if (PendingWrite.IsValid())
+	{
+		PendingWrite.Wait();
+	}
+	Super::Deinitialize();
+}
+
+bool UHeistNetTelemetrySubsystem::IsCollecting() const
+{
+	if (GHeistNetTelemetry == 0 || IsTemplate()) { return false; }
+
+	UWorld* World = GetWorld();
+	if (World == nullptr || !World->IsGameWorld()) { return false; }
+
+	const ENetMode NetMode = World->GetNetMode();
+	return NetMode == NM_DedicatedServer || NetMode == NM_ListenServer;
+}
+
+bool UHeistNetTelemetrySubsystem::IsTickable() const
+{
+	return IsCollecting();
+}
+
+TStatId UHeistNetTelemetrySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UHeistNetTelemetrySubsystem, STATGROUP_Tickables);
+}
+
+void UHeistNetTelemetrySubsystem::Tick(float DeltaTime)
+{
+	TimeSinceFlush += DeltaTime;
+	if (TimeSinceFlush >= FlushInterval)
+	{
+		Flush();
+	}
+}
+
+FName UHeistNetTelemetrySubsystem::GetCounterName(const UObject* Owner, FName MemberName)
+{
+	//"Class.Member" is built once per pair - building it per call showed up with every character recording each tick
+	const TPair<const UClass*, FName> Key(Owner->GetClass(), MemberName);
+	if (const FName* Existing = CounterNames.Find(Key))
+	{
+		return *Existing;
+	}
+	const FName CounterName(*FString::Printf(TEXT("%s.%s"), *Owner->GetClass()->GetName(), *MemberName.ToString()));
+	CounterNames.Add(Key, CounterName);
+	return CounterName;
+}
+
+void UHeistNetTelemetrySubsystem::RecordPropertyIfChanged(const AActor* Actor, FName PropertyName, uint32 ValueHash, int32 EstimatedBytes)
+{
+	uint32& LastHash = LastPropertyHashes.FindOrAdd(TPair<FObjectKey, FName>(FObjectKey(Actor), PropertyName), ValueHash ^ 1);
+	if (LastHash == ValueHash) { return; }
+	LastHash = ValueHash;
+
+	FNetTelemetryCounter& Counter = PropertyCounters.FindOrAdd(GetCounterName(Actor, PropertyName));
+	Counter.Count++;
+	Counter.Bytes += EstimatedBytes;
+}
+
+void UHeistNetTelemetrySubsystem::RecordRPC(const UObject* Owner, FName FunctionName)
+{
+	FNetTelemetryCounter& Counter = RPCCounters.FindOrAdd(GetCounterName(Owner, FunctionName));
+	Counter.Count++;
+}
+
+void UHeistNetTelemetrySubsystem::RecordDroppedRPC(const UObject* Owner, FName FunctionName)
+{
+	FNetTelemetryCounter& Counter = DroppedRPCCounters.FindOrAdd(GetCounterName(Owner, FunctionName));
+	Counter.Count++;
+}
+
+void UHeistNetTelemetrySubsystem::RecordKick(const UObject* Owner)
+{
+	Kicks++;
+}
+
+void UHeistNetTelemetrySubsystem::CountRPC(const UObject* Owner, FName FunctionName)
+{
+	UHeistNetTelemetrySubsystem* Telemetry = Get(Owner);
+	if (Telemetry != nullptr)
+	{
+		Telemetry->RecordRPC(Owner, FunctionName);
+	}
+}
+
+void UHeistNetTelemetrySubsystem::Flush()
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistNetTelemetryFlush);
+
+	const double Timestamp = FPlatformTime::Seconds() - CollectStartTime;
+	const float Interval = FMath::Max(TimeSinceFlush, KINDA_SMALL_NUMBER);
+	TimeSinceFlush = 0.0f;
+
+	//Rows are: time, kind, name, count per second, bytes per second, estimated bytes per second, ping ms, loss in %, loss out %
+	//Property bytes are the in-memory size of each changed value, not what the net driver serialized, so they go in the estimate column
+	TArray<FString> Rows;
+	for (const TPair<FName, FNetTelemetryCounter>& Pair : PropertyCounters)
+	{
+		Rows.Add(FString::Printf(TEXT("%.1f,property,%s,%.1f,,%.1f,,,"), Timestamp, *Pair.Key.ToString(), Pair.Value.Count / Interval, Pair.Value.Bytes / Interval));
+	}
+	for (const TPair<FName, FNetTelemetryCounter>& Pair : RPCCounters)
+	{
+		Rows.Add(FString::Printf(TEXT("%.1f,rpc,%s,%.1f,,,,,"), Timestamp, *Pair.Key.ToString(), Pair.Value.Count / Interval));
+	}
+	for (const TPair<FName, FNetTelemetryCounter>& Pair : DroppedRPCCounters)
+	{
+		Rows.Add(FString::Printf(TEXT("%.1f,rpc_dropped,%s,%.1f,,,,,"), Timestamp, *Pair.Key.ToString(), Pair.Value.Count / Interval));
+	}
+	if (Kicks > 0)
+	{
+		Rows.Add(FString::Printf(TEXT("%.1f,kick,RPCLimiter,%d,,,,,"), Timestamp, Kicks));
+	}
+	AppendConnectionRows(Rows, Timestamp);
+
+	PropertyCounters.Reset();
+	RPCCounters.Reset();
+	DroppedRPCCounters.Reset();
+	Kicks = 0;
+	PruneStaleEntries();
+
+	WriteRows(MoveTemp(Rows));
+}
+
+void UHeistNetTelemetrySubsystem::AppendConnectionRows(TArray<FString>& OutRows, double Timestamp)
+{
+	UWorld* World = GetWorld();
+	UNetDriver* NetDriver = World != nullptr ? World->GetNetDriver() : nullptr;
+	if (NetDriver == nullptr) { return; }
+
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		if (Connection == nullptr) { continue; }
+
+		FConnectionTotals& Last = LastConnectionTotals.FindOrAdd(FObjectKey(Connection));
+		const int32 InPackets = Connection->InTotalPackets - Last.InPackets;
+		const int32 OutPackets = Connection->OutTotalPackets - Last.OutPackets;
+		const int32 InLost = Connection->InTotalPacketsLost - Last.InPacketsLost;
+		const int32 OutLost = Connection->OutTotalPacketsLost - Last.OutPacketsLost;
+		Last.InPackets = Connection->InTotalPackets;
+		Last.OutPackets = Connection->OutTotalPackets;
+		Last.InPacketsLost = Connection->InTotalPacketsLost;
+		Last.OutPacketsLost = Connection->OutTotalPacketsLost;
+
+		const float InLoss = InPackets + InLost > 0 ? 100.0f * InLost / (InPackets + InLost) : 0.0f;
+		const float OutLoss = OutPackets > 0 ? 100.0f * OutLost / OutPackets : 0.0f;
+
+		float PingMs = Connection->AvgLag * 1000.0f;
+		APlayerController* PC = Connection->PlayerController;
+		if (PC != nullptr && PC->PlayerState != nullptr)
+		{
+			PingMs = PC->PlayerState->ExactPing;
+		}
+
+		OutRows.Add(FString::Printf(TEXT("%.1f,connection,%s,%d,%d,,%.1f,%.2f,%.2f"), Timestamp,
+			*Connection->LowLevelGetRemoteAddress(true), Connection->OutPacketsPerSecond, Connection->OutBytesPerSecond, PingMs, InLoss, OutLoss));
+	}
+}
+
+void UHeistNetTelemetrySubsystem::PruneStaleEntries()
+{
+	for (auto It = LastPropertyHashes.CreateIterator(); It; ++It)
+	{
+		if (It.Key().Key.ResolveObjectPtr() == nullptr)
+		{
+			It.RemoveCurrent();
+		}
+	}
+	for (auto It = LastConnectionTotals.CreateIterator(); It; ++It)
+	{
+		if (It.Key().ResolveObjectPtr() == nullptr)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void UHeistNetTelemetrySubsystem::WriteRows(TArray<FString>&& Rows)
+{
+	if (Rows.Num() == 0) { return; }
+
+	if (CurrentFilePath.IsEmpty() || CurrentFileRows + Rows.Num() > MaxRowsPerFile)
+	{
+		RollFile();
+	}
+	CurrentFileRows += Rows.Num();
+
+	//File IO happens off the game thread - the previous write is waited on so rows stay in order
+	if (PendingWrite.IsValid())
+	{
+		PendingWrite.Wait();
+	}
+	FString Contents = FString::Join(Rows, TEXT("\n")) + TEXT("\n");
+	FString FilePath = CurrentFilePath;
+	PendingWrite = Async(EAsyncExecution::ThreadPool, [FilePath, Contents]()
+	{
+		FFileHelper::SaveStringToFile(Contents, *FilePath, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+	});
+}
+
+void UHeistNetTelemetrySubsystem::RollFile()
+{
+	const FString Directory = FPaths::ProjectSavedDir() / TEXT("Telemetry");
+	IFileManager::Get().MakeDirectory(*Directory, true);
+
+	//Delete the oldest files so at most MaxFiles remain after this one is created
+	TArray<FString> Existing;
+	IFileManager::Get().FindFiles(Existing, *(Directory / TEXT("HeistNet_*.csv")), true, false);
+	Existing.Sort();
+	for (int32 i = 0; i <= Existing.Num() - MaxFiles; i++)
+	{
+		IFileManager::Get().Delete(*(Directory / Existing[i]));
+	}
+
+	CurrentFilePath = Directory / FString::Printf(TEXT("HeistNet_%s.csv"), *FDateTime::Now().ToString());
+	CurrentFileRows = 0;
+	FFileHelper::SaveStringToFile(TEXT("time,kind,name,count_per_sec,bytes_per_sec,est_bytes_per_sec,ping_ms,loss_in_pct,loss_out_pct\n"), *CurrentFilePath);
+}
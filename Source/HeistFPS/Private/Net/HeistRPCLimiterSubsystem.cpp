@@ -0,0 +1,232 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/HeistRPCLimiterSubsystem.h"
+#include "Net/HeistNetTelemetrySubsystem.h"
+
+#include "Engine/World.h"
+#include "Engine/NetConnection.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/GameSession.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/App.h"
+#include "Misc/CoreDelegates.h"
+
+bool FHeistTokenBucket::TryConsume(const FHeistRPCRateLimit& Limit, double Now)
+{
+	if (!bStarted)
+	{
+		bStarted = true;
+		Tokens = Limit.Burst;
+		LastRefillTime = Now;
+	}
+
+	Tokens = FMath::Min(Limit.Burst, Tokens + static_cast<float>(Now - LastRefillTime) * Limit.TokensPerSecond);
+	LastRefillTime = Now;
+	if (Tokens >= 1.0f)
+	{
+		Tokens -= 1.0f;
+		return true;
+	}
+	return false;
+}
+
+void UHeistRPCLimiterSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	for (const FHeistRPCRateLimit& Limit : Limits)
+	{
+		LimitsByFunction.Add(Limit.FunctionName, Limit);
+	}
+}
+
+void UHeistRPCLimiterSubsystem::Deinitialize()
+{
+	FCoreDelegates::OnEndFrame.Remove(FloodTestEndFrameHandle);
+	Super::Deinitialize();
+}
+
+const FHeistRPCRateLimit& UHeistRPCLimiterSubsystem::GetLimit(FName FunctionName) const
+{
+	const FHeistRPCRateLimit* Limit = LimitsByFunction.Find(FunctionName);
+	return Limit != nullptr ? *Limit : DefaultLimit;
+}
+
+bool UHeistRPCLimiterSubsystem::ConsumeRPC(const AActor* Actor, FName FunctionName)
+{
+	UWorld* World = Actor != nullptr ? Actor->GetWorld() : nullptr;
+	UHeistRPCLimiterSubsystem* Limiter = World != nullptr ? World->GetSubsystem<UHeistRPCLimiterSubsystem>() : nullptr;
+	if (Limiter == nullptr || !Limiter->bEnabled) { return true; }
+
+	//Listen server hosts and bots have no connection
+	UNetConnection* Connection = Actor->GetNetConnection();
+	if (Connection == nullptr) { return true; }
+
+	return Limiter->Consume(Connection, FunctionName, Actor, true);
+}
+
+bool UHeistRPCLimiterSubsystem::RetryRPC(const AActor* Actor, FName FunctionName)
+{
+	UWorld* World = Actor != nullptr ? Actor->GetWorld() : nullptr;
+	UHeistRPCLimiterSubsystem* Limiter = World != nullptr ? World->GetSubsystem<UHeistRPCLimiterSubsystem>() : nullptr;
+	if (Limiter == nullptr || !Limiter->bEnabled) { return true; }
+
+	UNetConnection* Connection = Actor->GetNetConnection();
+	if (Connection == nullptr) { return true; }
+
+	return Limiter->Consume(Connection, FunctionName, Actor, false);
+}
+
+bool UHeistRPCLimiterSubsystem::CanSendRPC(const AActor* Actor, FName FunctionName)
+{
+	UWorld* World = Actor != nullptr ? Actor->GetWorld() : nullptr;
+	UHeistRPCLimiterSubsystem* Limiter = World != nullptr ? World->GetSubsystem<UHeistRPCLimiterSubsystem>() : nullptr;
+	if (Limiter == nullptr || !Limiter->bEnabled) { return true; }
+
+	//Only clients send over a connection - servers call their own RPCs locally
+	if (World->GetNetMode() != NM_Client) { return true; }
+
+	return Limiter->SendBuckets.FindOrAdd(FunctionName).TryConsume(Limiter->GetLimit(FunctionName), FPlatformTime::Seconds());
+}
+
+float UHeistRPCLimiterSubsystem::GetSustainedRate(const AActor* Actor, FName FunctionName)
+{
+	UWorld* World = Actor != nullptr ? Actor->GetWorld() : nullptr;
+	UHeistRPCLimiterSubsystem* Limiter = World != nullptr ? World->GetSubsystem<UHeistRPCLimiterSubsystem>() : nullptr;
+	if (Limiter == nullptr || !Limiter->bEnabled) { return 0.0f; }
+
+	return Limiter->GetLimit(FunctionName).TokensPerSecond;
+}
+
+bool UHeistRPCLimiterSubsystem::Consume(UNetConnection* Connection, FName FunctionName, const AActor* Actor, bool bCountViolation)
+{
+	const double Now = FPlatformTime::Seconds();
+	const FHeistRPCRateLimit& Limit = GetLimit(FunctionName);
+
+	FConnectionBudget* Budget = Connections.Find(FObjectKey(Connection));
+	if (Budget == nullptr)
+	{
+		//Forget connections that have since closed before tracking a new one
+		for (auto It = Connections.CreateIterator(); It; ++It)
+		{
+			if (It.Key().ResolveObjectPtr() == nullptr)
+			{
+				It.RemoveCurrent();
+			}
+		}
+		Budget = &Connections.Add(FObjectKey(Connection));
+	}
+	if (Budget->bKicked) { return false; }
+
+	if (Budget->Buckets.FindOrAdd(FunctionName).TryConsume(Limit, Now))
+	{
+		return true;
+	}
+	if (!bCountViolation) { return false; }
+
+	DroppedCalls++;
+
+	if (UHeistNetTelemetrySubsystem* Telemetry = UHeistNetTelemetrySubsystem::Get(Actor))
+	{
+		Telemetry->RecordDroppedRPC(Actor, FunctionName);
+	}
+
+	if (Now - Budget->ViolationWindowStart > ViolationWindow)
+	{
+		Budget->ViolationWindowStart = Now;
+		Budget->Violations = 0;
+	}
+	Budget->Violations++;
+	if (Budget->Violations >= KickThreshold)
+	{
+		Budget->bKicked = true;
+		Kick(Connection);
+		if (UHeistNetTelemetrySubsystem* Telemetry = UHeistNetTelemetrySubsystem::Get(Actor))
+		{
+			Telemetry->RecordKick(Actor);
+		}
+	}
+	return false;
+}
+
+void UHeistRPCLimiterSubsystem::Kick(UNetConnection* Connection)
+{
+	APlayerController* PC = Connection->PlayerController;
+	UE_LOG(LogTemp, Warning, TEXT("Kicking %s for exceeding the server RPC budget."), *Connection->LowLevelGetRemoteAddress(true));
+
+	AGameModeBase* GameMode = GetWorld()->GetAuthGameMode();
+	if (PC != nullptr && GameMode != nullptr && GameMode->GameSession != nullptr)
+	{
+		GameMode->GameSession->KickPlayer(PC, NSLOCTEXT("HeistFPS", "RPCFloodKick", "Too many requests."));
+	}
+	else
+	{
+		Connection->Close();
+	}
+}
+
+void UHeistRPCLimiterSubsystem::StartFloodTest(TFunction<void()> FloodFrame, int32 Frames)
+{
+	if (FloodTestFrameCount > 0) { return; }
+
+	//Flooding connections must be measured, not kicked
+	FloodTestSavedKickThreshold = KickThreshold;
+	KickThreshold = MAX_int32;
+
+	FloodTestFrame = MoveTemp(FloodFrame);
+	FloodTestFrameCount = FMath::Max(Frames, 1);
+	FloodTestFrames = 0;
+	FloodTestStartDropped = DroppedCalls;
+	FloodTestTotalMs = 0.0;
+	FloodTestWorstMs = 0.0;
+	FloodTestLastFrameTime = FPlatformTime::Seconds();
+	FloodTestEndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &UHeistRPCLimiterSubsystem::OnFloodTestEndFrame);
+}
+
+void UHeistRPCLimiterSubsystem::OnFloodTestEndFrame()
+{
+	//Idle time is the sleep at the start of the frame that holds the server's tick rate
+	const double Now = FPlatformTime::Seconds();
+	const double FrameMs = FMath::Max(Now - FloodTestLastFrameTime - FApp::GetIdleTime(), 0.0) * 1000.0;
+	FloodTestLastFrameTime = Now;
+
+	//The first frame measured is the one before any flooding
+	if (FloodTestFrames > 0)
+	{
+		FloodTestTotalMs += FrameMs;
+		FloodTestWorstMs = FMath::Max(FloodTestWorstMs, FrameMs);
+	}
+	if (FloodTestFrames++ >= FloodTestFrameCount)
+	{
+		FinishFloodTest();
+		return;
+	}
+
+	//Calls made here land in the next measured frame
+	FloodTestFrame();
+}
+
+void UHeistRPCLimiterSubsystem::FinishFloodTest()
+{
+	FCoreDelegates::OnEndFrame.Remove(FloodTestEndFrameHandle);
+	FloodTestFrame = nullptr;
+
+	//Violations from the flood must not get anyone kicked after the test
+	KickThreshold = FloodTestSavedKickThreshold;
+	for (TPair<FObjectKey, FConnectionBudget>& Pair : Connections)
+	{
+		Pair.Value.Violations = 0;
+	}
+
+	const int32 Measured = FMath::Max(FloodTestFrames - 1, 1);
+	const double AvgMs = FloodTestTotalMs / Measured;
+	const bool bPassed = FloodTestWorstMs <= MaxFloodFrameMs;
+	UE_LOG(LogTemp, Log, TEXT("heist.Net.FloodTest: %d frames, server frame avg %.2f ms, worst %.2f ms (budget %.1f ms), %d calls dropped - %s."),
+		Measured, AvgMs, FloodTestWorstMs, MaxFloodFrameMs, DroppedCalls - FloodTestStartDropped, bPassed ? TEXT("PASSED") : TEXT("FAILED"));
+	if (!bPassed)
+	{
+		UE_LOG(LogTemp, Error, TEXT("heist.Net.FloodTest: the server did not hold its tick rate under the flood."));
+	}
+	FloodTestFrameCount = 0;
+}
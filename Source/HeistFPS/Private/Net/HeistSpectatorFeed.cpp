@@ -0,0 +1,256 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/HeistSpectatorFeed.h"
+#include "HeistFPS.h"
+
+#include "Player/HeistFPSCharacter.h"
+
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "Net/UnrealNetwork.h"
+
+DECLARE_CYCLE_STAT(TEXT("SpectatorFeedCapture"), STAT_HeistSpectatorFeedCapture, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("SpectatorFeedInterpolate"), STAT_HeistSpectatorFeedInterpolate, STATGROUP_HeistFPS);
+
+FHeistSpectatorCharacterState FHeistSpectatorCharacterState::FromReplayState(uint16 InId, const FHeistReplayCharacterState& State)
+{
+	FHeistSpectatorCharacterState Result;
+	Result.Id = InId;
+	Result.LocationX = State.LocationX;
+	Result.LocationY = State.LocationY;
+	Result.LocationZ = State.LocationZ;
+	Result.Yaw = State.Yaw;
+	Result.AimPitch = State.AimPitch;
+	Result.AimYaw = State.AimYaw;
+	Result.Direction = State.Direction;
+	Result.Speed = State.Speed;
+	Result.Flags = State.Flags;
+	return Result;
+}
+
+FHeistReplayCharacterState FHeistSpectatorCharacterState::ToReplayState() const
+{
+	FHeistReplayCharacterState Result;
+	Result.LocationX = LocationX;
+	Result.LocationY = LocationY;
+	Result.LocationZ = LocationZ;
+	Result.Yaw = Yaw;
+	Result.AimPitch = AimPitch;
+	Result.AimYaw = AimYaw;
+	Result.Direction = Direction;
+	Result.Speed = Speed;
+	Result.Flags = Flags;
+	return Result;
+}
+
+//Compressed angles wrap at 16 bits, so the signed difference is the shortest way round
+static uint16 LerpCompressedAngle(uint16 From, uint16 To, float Alpha)
+{
+	return static_cast<uint16>(From + FMath::RoundToInt(static_cast<int16>(To - From) * Alpha));
+}
+
+static FHeistReplayCharacterState InterpolateState(const FHeistReplayCharacterState& From, const FHeistReplayCharacterState& To, float Alpha)
+{
+	FHeistReplayCharacterState Result = From;
+	Result.LocationX = FMath::RoundToInt(FMath::Lerp<float>(From.LocationX, To.LocationX, Alpha));
+	Result.LocationY = FMath::RoundToInt(FMath::Lerp<float>(From.LocationY, To.LocationY, Alpha));
+	Result.LocationZ = FMath::RoundToInt(FMath::Lerp<float>(From.LocationZ, To.LocationZ, Alpha));
+	Result.Yaw = LerpCompressedAngle(From.Yaw, To.Yaw, Alpha);
+	Result.AimPitch = LerpCompressedAngle(From.AimPitch, To.AimPitch, Alpha);
+	Result.AimYaw = LerpCompressedAngle(From.AimYaw, To.AimYaw, Alpha);
+	Result.Direction = LerpCompressedAngle(From.Direction, To.Direction, Alpha);
+	Result.Speed = static_cast<uint16>(FMath::RoundToInt(FMath::Lerp<float>(From.Speed, To.Speed, Alpha)));
+	return Result;
+}
+
+AHeistSpectatorFeed::AHeistSpectatorFeed()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	bReplicates = true;
+	bAlwaysRelevant = false;
+	SetReplicatingMovement(false);
+}
+
+void AHeistSpectatorFeed::BeginPlay()
+{
+	Super::BeginPlay();
+
+	NetUpdateFrequency = SpectatorUpdateRate;
+	MinNetUpdateFrequency = SpectatorUpdateRate;
+
+	//The server only needs to capture as often as snapshots are sent
+	if (HasAuthority())
+	{
+		SetActorTickInterval(1.0f / FMath::Max(SpectatorUpdateRate, 1.0f));
+	}
+}
+
+void AHeistSpectatorFeed::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	for (const TPair<uint16, TWeakObjectPtr<AHeistFPSCharacter>>& Pair : Puppets)
+	{
+		if (AHeistFPSCharacter* Puppet = Pair.Value.Get())
+		{
+			Puppet->Destroy();
+		}
+	}
+	Puppets.Reset();
+	Super::EndPlay(EndPlayReason);
+}
+
+void AHeistSpectatorFeed::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(AHeistSpectatorFeed, Snapshot);
+}
+
+bool AHeistSpectatorFeed::IsSpectatorViewer(const AActor* Viewer)
+{
+	const APlayerController* PC = Cast<APlayerController>(Viewer);
+	return PC != nullptr && PC->PlayerState != nullptr && PC->PlayerState->IsOnlyASpectator();
+}
+
+bool AHeistSpectatorFeed::IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const
+{
+	return IsSpectatorViewer(RealViewer);
+}
+
+void AHeistSpectatorFeed::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (HasAuthority())
+	{
+		CaptureSnapshot();
+	}
+	else
+	{
+		UpdatePuppets();
+	}
+}
+
+void AHeistSpectatorFeed::CaptureSnapshot()
+{
+	//Nothing to send until an observer joins
+	AGameModeBase* GameMode = GetWorld()->GetAuthGameMode();
+	if (GameMode == nullptr || GameMode->GetNumSpectators() == 0) { return; }
+
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistSpectatorFeedCapture);
+
+	for (auto It = CharacterIds.CreateIterator(); It; ++It)
+	{
+		if (It.Key().ResolveObjectPtr() == nullptr)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	Snapshot.ServerTime = GetWorld()->GetTimeSeconds();
+	Snapshot.Characters.Reset();
+	for (TActorIterator<AHeistFPSCharacter> It(GetWorld()); It; ++It)
+	{
+		if (It->IsPendingKill() || It->IsPooled()) { continue; }
+
+		uint16* CharacterId = CharacterIds.Find(FObjectKey(*It));
+		if (CharacterId == nullptr)
+		{
+			CharacterId = &CharacterIds.Add(FObjectKey(*It), NextCharacterId++);
+		}
+		Snapshot.Characters.Add(FHeistSpectatorCharacterState::FromReplayState(*CharacterId, FHeistReplayCharacterState::FromCharacter(**It)));
+	}
+}
+
+void AHeistSpectatorFeed::OnRep_Snapshot()
+{
+	//Property updates only ever deliver newer values, but a map change restarts server time
+	if (SnapshotBuffer.Num() > 0 && Snapshot.ServerTime <= SnapshotBuffer.Last().ServerTime)
+	{
+		SnapshotBuffer.Reset();
+	}
+	SnapshotBuffer.Add(Snapshot);
+}
+
+void AHeistSpectatorFeed::UpdatePuppets()
+{
+	AGameStateBase* GameState = GetWorld()->GetGameState();
+	if (GameState == nullptr || SnapshotBuffer.Num() == 0) { return; }
+
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistSpectatorFeedInterpolate);
+
+	const float RenderTime = GameState->GetServerWorldTimeSeconds() - InterpolationDelay;
+
+	//Newest snapshot at or before the render time, interpolated towards the one after it
+	int32 FromIndex = 0;
+	for (int32 i = 0; i < SnapshotBuffer.Num(); i++)
+	{
+		if (SnapshotBuffer[i].ServerTime <= RenderTime)
+		{
+			FromIndex = i;
+		}
+	}
+	//Holds the newest snapshot when the next one is late
+	const int32 ToIndex = FMath::Min(FromIndex + 1, SnapshotBuffer.Num() - 1);
+	const FHeistSpectatorSnapshot& From = SnapshotBuffer[FromIndex];
+	const FHeistSpectatorSnapshot& To = SnapshotBuffer[ToIndex];
+	const float Span = To.ServerTime - From.ServerTime;
+	const float Alpha = Span > KINDA_SMALL_NUMBER ? FMath::Clamp((RenderTime - From.ServerTime) / Span, 0.0f, 1.0f) : 0.0f;
+
+	TSet<uint16> Seen;
+	for (const FHeistSpectatorCharacterState& FromState : From.Characters)
+	{
+		const FHeistSpectatorCharacterState* ToState = To.Characters.FindByPredicate([&FromState](const FHeistSpectatorCharacterState& State) { return State.Id == FromState.Id; });
+		const FHeistReplayCharacterState State = ToState != nullptr
+			? InterpolateState(FromState.ToReplayState(), ToState->ToReplayState(), Alpha)
+			: FromState.ToReplayState();
+
+		TWeakObjectPtr<AHeistFPSCharacter>& WeakPuppet = Puppets.FindOrAdd(FromState.Id);
+		if (!WeakPuppet.IsValid())
+		{
+			WeakPuppet = SpawnPuppet();
+		}
+		if (AHeistFPSCharacter* Puppet = WeakPuppet.Get())
+		{
+			State.ApplyToCharacter(*Puppet);
+		}
+		Seen.Add(FromState.Id);
+	}
+
+	for (auto It = Puppets.CreateIterator(); It; ++It)
+	{
+		if (!Seen.Contains(It.Key()))
+		{
+			if (AHeistFPSCharacter* Puppet = It.Value().Get())
+			{
+				Puppet->Destroy();
+			}
+			It.RemoveCurrent();
+		}
+	}
+
+	//Snapshots older than the interpolation source are no longer needed
+	SnapshotBuffer.RemoveAt(0, FromIndex, false);
+}
+
+AHeistFPSCharacter* AHeistSpectatorFeed::SpawnPuppet()
+{
+	HEISTFPS_LLM_SCOPE(Characters);
+
+	AGameStateBase* GameState = GetWorld()->GetGameState();
+	const AGameModeBase* GameModeDefaults = GameState != nullptr ? GameState->GetDefaultGameMode() : nullptr;
+	UClass* Class = GameModeDefaults != nullptr ? GameModeDefaults->DefaultPawnClass.Get() : nullptr;
+	if (Class == nullptr || !Class->IsChildOf(AHeistFPSCharacter::StaticClass())) { return nullptr; }
+
+	FActorSpawnParameters SpawnInfo;
+	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	AHeistFPSCharacter* Puppet = GetWorld()->SpawnActor<AHeistFPSCharacter>(Class, FTransform::Identity, SpawnInfo);
+	if (Puppet != nullptr)
+	{
+		Puppet->MakePuppet();
+	}
+	return Puppet;
+}
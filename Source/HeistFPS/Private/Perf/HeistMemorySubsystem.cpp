@@ -0,0 +1,198 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Perf/HeistMemorySubsystem.h"
+#include "HeistFPS.h"
+
+#include "Perf/HeistMemoryTags.h"
+#include "Player/HeistFPSCharacter.h"
+#include "Weapon/WeaponBase.h"
+
+#include "Blueprint/UserWidget.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Async/Async.h"
+#include "UObject/UObjectIterator.h"
+
+DECLARE_CYCLE_STAT(TEXT("MemoryCsvRow"), STAT_HeistMemoryCsvRow, STATGROUP_HeistFPS);
+
+static int32 GHeistMemoryCsv = 0;
+static FAutoConsoleVariableRef CVarHeistMemoryCsv(
+	TEXT("heist.MemoryCsv"),
+	GHeistMemoryCsv,
+	TEXT("Write a periodic memory CSV to Saved/Telemetry (0 = only on dedicated servers, 1 = always)."));
+
+static FAutoConsoleCommandWithWorldAndArgs HeistMemoryDumpCommand(
+	TEXT("heist.Memory.Dump"),
+	TEXT("Logs process memory, HeistFPS LLM tag totals (run with -llm) and live gameplay object counts."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UHeistMemorySubsystem::DumpSnapshot(World);
+	}));
+
+static double ToMB(int64 Bytes)
+{
+	return Bytes / (1024.0 * 1024.0);
+}
+
+void UHeistMemorySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	if (FParse::Param(FCommandLine::Get(), TEXT("HeistMemoryCsv")))
+	{
+		GHeistMemoryCsv = 1;
+	}
+	StartTime = FPlatformTime::Seconds();
+}
+
+void UHeistMemorySubsystem::Deinitialize()
+{
+	if (PendingWrite.IsValid())
+	{
+		PendingWrite.Wait();
+	}
+	Super::Deinitialize();
+}
+
+bool UHeistMemorySubsystem::IsWritingCsv() const
+{
+	if (IsTemplate()) { return false; }
+
+	UWorld* World = GetWorld();
+	if (World == nullptr || !World->IsGameWorld()) { return false; }
+
+	return GHeistMemoryCsv != 0 || (bCsvOnDedicatedServer && World->GetNetMode() == NM_DedicatedServer);
+}
+
+bool UHeistMemorySubsystem::IsTickable() const
+{
+	return IsWritingCsv();
+}
+
+TStatId UHeistMemorySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UHeistMemorySubsystem, STATGROUP_Tickables);
+}
+
+void UHeistMemorySubsystem::Tick(float DeltaTime)
+{
+	TimeSinceRow += DeltaTime;
+	if (TimeSinceRow >= CsvInterval)
+	{
+		TimeSinceRow = 0.0f;
+		WriteRow();
+	}
+}
+
+int32 UHeistMemorySubsystem::CountCharacters(UWorld* World)
+{
+	int32 Characters = 0;
+	if (World != nullptr)
+	{
+		for (TActorIterator<AHeistFPSCharacter> It(World); It; ++It)
+		{
+			Characters++;
+		}
+	}
+	return Characters;
+}
+
+void UHeistMemorySubsystem::DumpSnapshot(UWorld* World)
+{
+	const FPlatformMemoryStats Stats = FPlatformMemory::GetStats();
+	UE_LOG(LogTemp, Log, TEXT("heist.Memory.Dump: physical %.1f MB (peak %.1f MB), virtual %.1f MB."),
+		ToMB(Stats.UsedPhysical), ToMB(Stats.PeakUsedPhysical), ToMB(Stats.UsedVirtual));
+
+	if (FHeistMemoryTags::IsTracking())
+	{
+		FHeistMemoryTags::ForEachTag([](EHeistLLMTag Tag)
+		{
+			UE_LOG(LogTemp, Log, TEXT("heist.Memory.Dump:   %-16s %8.2f MB"), FHeistMemoryTags::GetName(Tag), ToMB(FHeistMemoryTags::GetBytes(Tag)));
+		});
+	}
+	else
+	{
+		UE_LOG(LogTemp, Log, TEXT("heist.Memory.Dump:   LLM tag totals unavailable - run with -llm."));
+	}
+
+	//Object counts give a rough picture even without LLM
+	int32 Weapons = 0;
+	if (World != nullptr)
+	{
+		for (TActorIterator<AWeaponBase> It(World); It; ++It)
+		{
+			Weapons++;
+		}
+	}
+	int32 Widgets = 0;
+	for (TObjectIterator<UUserWidget> It; It; ++It)
+	{
+		Widgets++;
+	}
+	UE_LOG(LogTemp, Log, TEXT("heist.Memory.Dump:   %d characters, %d weapons, %d widgets."), CountCharacters(World), Weapons, Widgets);
+}
+
+void UHeistMemorySubsystem::WriteRow()
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistMemoryCsvRow);
+
+	if (CurrentFilePath.IsEmpty() || CurrentFileRows >= MaxRowsPerFile)
+	{
+		RollFile();
+	}
+	CurrentFileRows++;
+
+	//Rows are: time, characters, physical MB, peak physical MB, virtual MB, then one MB column per tag
+	const FPlatformMemoryStats Stats = FPlatformMemory::GetStats();
+	FString Row = FString::Printf(TEXT("%.1f,%d,%.2f,%.2f,%.2f"), FPlatformTime::Seconds() - StartTime, CountCharacters(GetWorld()),
+		ToMB(Stats.UsedPhysical), ToMB(Stats.PeakUsedPhysical), ToMB(Stats.UsedVirtual));
+	FHeistMemoryTags::ForEachTag([&Row](EHeistLLMTag Tag)
+	{
+		Row += FString::Printf(TEXT(",%.2f"), ToMB(FHeistMemoryTags::GetBytes(Tag)));
+	});
+	Row += TEXT("\n");
+
+	//File IO happens off the game thread - the previous write is waited on so rows stay in order
+	if (PendingWrite.IsValid())
+	{
+		PendingWrite.Wait();
+	}
+	FString FilePath = CurrentFilePath;
+	PendingWrite = Async(EAsyncExecution::ThreadPool, [FilePath, Row]()
+	{
+		FFileHelper::SaveStringToFile(Row, *FilePath, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+	});
+}
+
+void UHeistMemorySubsystem::RollFile()
+{
+	const FString Directory = FPaths::ProjectSavedDir() / TEXT("Telemetry");
+	IFileManager::Get().MakeDirectory(*Directory, true);
+
+	//Delete the oldest files so at most MaxFiles remain after this one is created
+	TArray<FString> Existing;
+	IFileManager::Get().FindFiles(Existing, *(Directory / TEXT("HeistMemory_*.csv")), true, false);
+	Existing.Sort();
+	for (int32 i = 0; i <= Existing.Num() - MaxFiles; i++)
+	{
+		IFileManager::Get().Delete(*(Directory / Existing[i]));
+	}
+
+	FString Header = TEXT("time,characters,physical_mb,peak_physical_mb,virtual_mb");
+	FHeistMemoryTags::ForEachTag([&Header](EHeistLLMTag Tag)
+	{
+		Header += FString::Printf(TEXT(",%s_mb"), FHeistMemoryTags::GetName(Tag));
+	});
+
+	CurrentFilePath = Directory / FString::Printf(TEXT("HeistMemory_%s.csv"), *FDateTime::Now().ToString());
+	CurrentFileRows = 0;
+	FFileHelper::SaveStringToFile(Header + TEXT("\n"), *CurrentFilePath);
+}
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Perf/HeistMemoryTags.h"
+#include "HeistFPS.h"
+
+#include "HAL/LowLevelMemStats.h"
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+static_assert(static_cast<int32>(EHeistLLMTag::Characters) >= static_cast<int32>(ELLMTag::ProjectTagStart), "HeistFPS LLM tags must be in the project tag range");
+static_assert(static_cast<int32>(EHeistLLMTag::End) <= static_cast<int32>(ELLMTag::ProjectTagEnd), "HeistFPS LLM tags must be in the project tag range");
+
+DECLARE_LLM_MEMORY_STAT(TEXT("HeistCharacters"), STAT_HeistCharactersLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("HeistWeapons"), STAT_HeistWeaponsLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("HeistUI"), STAT_HeistUILLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("HeistFX"), STAT_HeistFXLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("HeistFPS"), STAT_HeistFPSSummaryLLM, STATGROUP_LLM);
+#endif
+
+void FHeistMemoryTags::Register()
+{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	FLowLevelMemTracker& Tracker = FLowLevelMemTracker::Get();
+	Tracker.RegisterProjectTag(static_cast<int32>(EHeistLLMTag::Characters), GetName(EHeistLLMTag::Characters), GET_STATFNAME(STAT_HeistCharactersLLM), GET_STATFNAME(STAT_HeistFPSSummaryLLM));
+	Tracker.RegisterProjectTag(static_cast<int32>(EHeistLLMTag::Weapons), GetName(EHeistLLMTag::Weapons), GET_STATFNAME(STAT_HeistWeaponsLLM), GET_STATFNAME(STAT_HeistFPSSummaryLLM));
+	Tracker.RegisterProjectTag(static_cast<int32>(EHeistLLMTag::UI), GetName(EHeistLLMTag::UI), GET_STATFNAME(STAT_HeistUILLM), GET_STATFNAME(STAT_HeistFPSSummaryLLM));
+	Tracker.RegisterProjectTag(static_cast<int32>(EHeistLLMTag::FX), GetName(EHeistLLMTag::FX), GET_STATFNAME(STAT_HeistFXLLM), GET_STATFNAME(STAT_HeistFPSSummaryLLM));
+#endif
+}
+
+bool FHeistMemoryTags::IsTracking()
+{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	return FLowLevelMemTracker::IsEnabled();
+#else
+	return false;
+#endif
+}
+
+int64 FHeistMemoryTags::GetBytes(EHeistLLMTag Tag)
+{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	if (IsTracking())
+	{
+		return FLowLevelMemTracker::Get().GetTagAmountForTracker(ELLMTracker::Default, static_cast<ELLMTag>(Tag));
+	}
+#endif
+	return 0;
+}
+
+const TCHAR* FHeistMemoryTags::GetName(EHeistLLMTag Tag)
+{
+	switch (Tag)
+	{
+	case EHeistLLMTag::Characters:	return TEXT("HeistCharacters");
+	case EHeistLLMTag::Weapons:		return TEXT("HeistWeapons");
+	case EHeistLLMTag::UI:			return TEXT("HeistUI");
+	case EHeistLLMTag::FX:			return TEXT("HeistFX");
+	default:						return TEXT("Unknown");
+	}
+}
+
+void FHeistMemoryTags::ForEachTag(TFunctionRef<void(EHeistLLMTag)> Visitor)
+{
+	for (int32 Tag = static_cast<int32>(EHeistLLMTag::Characters); Tag < static_cast<int32>(EHeistLLMTag::End); Tag++)
+	{
+		Visitor(static_cast<EHeistLLMTag>(Tag));
+	}
+}
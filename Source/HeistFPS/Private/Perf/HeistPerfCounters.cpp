@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Perf/HeistPerfCounters.h"
+
+#include "Misc/ScopeLock.h"
+
+TAtomic<bool> FHeistPerfCounters::bCapturing(false);
+
+namespace HeistPerfCounters
+{
+	//Counters are heap allocated and never freed so references handed out stay valid
+	static TArray<FHeistPerfCounter*>& GetCounters()
+	{
+		static TArray<FHeistPerfCounter*> Counters;
+		return Counters;
+	}
+
+	static FCriticalSection& GetLock()
+	{
+		static FCriticalSection Lock;
+		return Lock;
+	}
+}
+
+FHeistPerfCounter& FHeistPerfCounters::FindOrAdd(const TCHAR* Name)
+{
+	FScopeLock Lock(&HeistPerfCounters::GetLock());
+	for (FHeistPerfCounter* Counter : HeistPerfCounters::GetCounters())
+	{
+		if (Counter->Name == Name)
+		{
+			return *Counter;
+		}
+	}
+	FHeistPerfCounter* Counter = new FHeistPerfCounter(Name);
+	HeistPerfCounters::GetCounters().Add(Counter);
+	return *Counter;
+}
+
+void FHeistPerfCounters::BeginCapture()
+{
+	FScopeLock Lock(&HeistPerfCounters::GetLock());
+	for (FHeistPerfCounter* Counter : HeistPerfCounters::GetCounters())
+	{
+		Counter->Cycles = 0;
+		Counter->Calls = 0;
+	}
+	bCapturing = true;
+}
+
+void FHeistPerfCounters::EndCapture()
+{
+	bCapturing = false;
+}
+
+void FHeistPerfCounters::ForEachCounter(TFunctionRef<void(const FHeistPerfCounter&)> Visitor)
+{
+	FScopeLock Lock(&HeistPerfCounters::GetLock());
+	for (const FHeistPerfCounter* Counter : HeistPerfCounters::GetCounters())
+	{
+		if (Counter->Calls.Load() > 0)
+		{
+			Visitor(*Counter);
+		}
+	}
+}
@@ -0,0 +1,833 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Perf/HeistPerfHarnessSubsystem.h"
+#include "HeistFPS.h"
+#include "HeistFPSGameMode.h"
+
+#include "Game/HeistDamageSubsystem.h"
+#include "Net/HeistNetPrioritySubsystem.h"
+#include "Perf/HeistMemorySubsystem.h"
+#include "Player/HeistCharacterMovementComponent.h"
+#include "Player/HeistFPSCharacter.h"
+#include "Replay/HeistReplaySubsystem.h"
+
+#include "Engine/GameInstance.h"
+#include "Engine/NetDriver.h"
+#include "Engine/NetConnection.h"
+#include "GameFramework/GameModeBase.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/ConfigCacheIni.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "TimerManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("PerfSpawnCharacter"), STAT_HeistPerfSpawnCharacter, STATGROUP_HeistFPS);
+
+static const TCHAR* BaselineSection = TEXT("Baseline");
+static const TCHAR* BaselineToleranceKey = TEXT("Tolerance");
+
+/** Operations timed by the probes, in the order they run - equip must come before fire */
+static const TCHAR* ProbeOpNames[] = { TEXT("Spawn"), TEXT("Equip"), TEXT("Fire"), TEXT("Sprint"), TEXT("Crouch") };
+
+/** Which way a metric regresses */
+enum class EHeistMetricDirection : uint8
+{
+	LowerIsBetter,
+	HigherIsBetter,
+	/** Describes the scripted load rather than its cost - logged, but neither saved nor compared */
+	Informational
+};
+
+static EHeistMetricDirection GetMetricDirection(const FString& Name)
+{
+	//Skipping idle movement is the saving, so a drop in the share skipped is the regression
+	if (Name == TEXT("Movement.SkippedPct"))
+	{
+		return EHeistMetricDirection::HigherIsBetter;
+	}
+	//These count the work the bots generated, which follows the scenario script and not the code's cost
+	if (Name == TEXT("Movement.ClientMovesPerSec") || Name == TEXT("Damage.HitsPerSec") || Name == TEXT("Damage.DeathBroadcastsPerSec"))
+	{
+		return EHeistMetricDirection::Informational;
+	}
+	return EHeistMetricDirection::LowerIsBetter;
+}
+
+static UHeistPerfHarnessSubsystem* GetPerfHarness(UWorld* World)
+{
+	UGameInstance* GameInstance = World != nullptr ? World->GetGameInstance() : nullptr;
+	return GameInstance != nullptr ? GameInstance->GetSubsystem<UHeistPerfHarnessSubsystem>() : nullptr;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs HeistPerfBeginCommand(
+	TEXT("heist.Perf.Begin"),
+	TEXT("Starts a HeistFPS perf capture."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UHeistPerfHarnessSubsystem* Harness = GetPerfHarness(World))
+		{
+			Harness->BeginCapture();
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs HeistPerfEndCommand(
+	TEXT("heist.Perf.End"),
+	TEXT("Ends the HeistFPS perf capture and compares it against the baseline. Pass 'save' to overwrite the baseline."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UHeistPerfHarnessSubsystem* Harness = GetPerfHarness(World))
+		{
+			Harness->EndCapture(Args.Num() > 0 && Args[0] == TEXT("save"));
+		}
+	}));
+
+void UHeistPerfHarnessSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	bScenarioRequested = FParse::Param(FCommandLine::Get(), TEXT("HeistPerfCheck"));
+	bSaveBaselineAfterScenario = FParse::Param(FCommandLine::Get(), TEXT("HeistPerfSaveBaseline"));
+	if (bScenarioRequested)
+	{
+		WorldInitializedHandle = FWorldDelegates::OnWorldInitializedActors.AddUObject(this, &UHeistPerfHarnessSubsystem::OnWorldInitializedActors);
+	}
+}
+
+void UHeistPerfHarnessSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldInitializedActors.Remove(WorldInitializedHandle);
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+	FWorldDelegates::OnWorldPreActorTick.Remove(PreActorTickHandle);
+	FCoreDelegates::OnEndFrame.Remove(ProbeEndFrameHandle);
+	StopClients();
+	Super::Deinitialize();
+}
+
+void UHeistPerfHarnessSubsystem::BeginCapture()
+{
+	if (bCapturing) { return; }
+	bCapturing = true;
+
+	CaptureStartTime = FPlatformTime::Seconds();
+	CaptureStartMemory = FPlatformMemory::GetStats().UsedPhysical;
+	CaptureStartCharacters = UHeistMemorySubsystem::CountCharacters(GetGameInstance()->GetWorld());
+	CaptureStartTagBytes.Reset();
+	FHeistMemoryTags::ForEachTag([this](EHeistLLMTag Tag)
+	{
+		CaptureStartTagBytes.Add(static_cast<int32>(Tag), FHeistMemoryTags::GetBytes(Tag));
+	});
+	UWorld* World = GetGameInstance()->GetWorld();
+	const UHeistDamageSubsystem* Damage = World != nullptr ? World->GetSubsystem<UHeistDamageSubsystem>() : nullptr;
+	CaptureStartHits = Damage != nullptr ? Damage->GetNumHitsResolved() : 0;
+	CaptureStartDeathBroadcasts = Damage != nullptr ? Damage->GetNumDeathBroadcasts() : 0;
+	CaptureStartMovementSteps = UHeistCharacterMovementComponent::GetNumSteps();
+	CaptureStartSkippedMovementSteps = UHeistCharacterMovementComponent::GetNumSkippedSteps();
+	CaptureStartClientMoves = UHeistCharacterMovementComponent::GetNumClientMoves();
+	CaptureStartAllocations = GetAllocationCount();
+	CapturedFrames = 0;
+	CapturedFrameMs = 0.0;
+	WorstFrameMs = 0.0;
+	LastFrameTime = FPlatformTime::Seconds();
+	PhaseResults.Reset();
+	MaxClientBytesPerSec = 0.0;
+	MinPhaseClients = INDEX_NONE;
+
+	EndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &UHeistPerfHarnessSubsystem::OnEndFrame);
+	FHeistPerfCounters::BeginCapture();
+	UE_LOG(LogTemp, Log, TEXT("HeistPerf: capture started."));
+}
+
+bool UHeistPerfHarnessSubsystem::EndCapture(bool bSaveBaseline)
+{
+	if (!bCapturing) { return true; }
+	bCapturing = false;
+
+	FHeistPerfCounters::EndCapture();
+	FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+
+	TMap<FString, double> Results = CollectResults();
+	Results.KeySort(TLess<FString>());
+	for (const TPair<FString, double>& Result : Results)
+	{
+		UE_LOG(LogTemp, Log, TEXT("HeistPerf: %s = %.4f"), *Result.Key, Result.Value);
+	}
+
+	//Absolute budgets apply whether or not the baseline is being refreshed
+	const bool bWithinBudgets = CheckBudgets(Results);
+	if (bSaveBaseline)
+	{
+		SaveBaseline(Results);
+		return bWithinBudgets;
+	}
+	return CompareAgainstBaseline(Results) && bWithinBudgets;
+}
+
+void UHeistPerfHarnessSubsystem::OnEndFrame()
+{
+	//Idle time is the sleep that holds the server's tick rate, so leaving it out gives the work done per frame
+	const double Now = FPlatformTime::Seconds();
+	const double FrameMs = FMath::Max(Now - LastFrameTime - FApp::GetIdleTime(), 0.0) * 1000.0;
+	LastFrameTime = Now;
+
+	CapturedFrames++;
+	CapturedFrameMs += FrameMs;
+	WorstFrameMs = FMath::Max(WorstFrameMs, FrameMs);
+	PhaseFrames++;
+	PhaseFrameMs += FrameMs;
+	PhaseWorstFrameMs = FMath::Max(PhaseWorstFrameMs, FrameMs);
+}
+
+TMap<FString, double> UHeistPerfHarnessSubsystem::CollectResults() const
+{
+	TMap<FString, double> Results;
+	const double Seconds = FMath::Max(FPlatformTime::Seconds() - CaptureStartTime, 0.001);
+
+	double ReplayRecordMs = 0.0;
+	double DamageMs = 0.0;
+	double AnimGameThreadMs = 0.0;
+	double MovementMs = 0.0;
+	FHeistPerfCounters::ForEachCounter([&Results, &ReplayRecordMs, &DamageMs, &AnimGameThreadMs, &MovementMs](const FHeistPerfCounter& Counter)
+	{
+		Results.Add(Counter.Name + TEXT(".AvgMs"), Counter.GetAverageMs());
+		if (Counter.Name == TEXT("STAT_HeistReplayRecord"))
+		{
+			ReplayRecordMs = FPlatformTime::ToMilliseconds64(Counter.Cycles.Load());
+		}
+		else if (Counter.Name == TEXT("STAT_HeistDamageResolve") || Counter.Name == TEXT("STAT_HeistDamageBroadcastDeaths"))
+		{
+			DamageMs += FPlatformTime::ToMilliseconds64(Counter.Cycles.Load());
+		}
+		else if (Counter.Name == TEXT("STAT_HeistAnimPreUpdate") || Counter.Name == TEXT("STAT_HeistUpdateCharacterAnimMovement"))
+		{
+			AnimGameThreadMs += FPlatformTime::ToMilliseconds64(Counter.Cycles.Load());
+		}
+		else if (Counter.Name == TEXT("STAT_HeistCharacterMovementTick") || Counter.Name == TEXT("STAT_HeistServerMoveAutonomous"))
+		{
+			MovementMs += FPlatformTime::ToMilliseconds64(Counter.Cycles.Load());
+		}
+	});
+	Results.Add(TEXT("Replay.RecordFramePct"), CapturedFrameMs > 0.0 ? 100.0 * ReplayRecordMs / CapturedFrameMs : 0.0);
+
+	//Per-call averages differ between batched and per-hit resolution, so damage is compared by its share of frame time
+	Results.Add(TEXT("Damage.FramePct"), CapturedFrameMs > 0.0 ? 100.0 * DamageMs / CapturedFrameMs : 0.0);
+	Results.Add(TEXT("Anim.GameThreadFramePct"), CapturedFrameMs > 0.0 ? 100.0 * AnimGameThreadMs / CapturedFrameMs : 0.0);
+	Results.Add(TEXT("Movement.FramePct"), CapturedFrameMs > 0.0 ? 100.0 * MovementMs / CapturedFrameMs : 0.0);
+	const int64 MovementSteps = UHeistCharacterMovementComponent::GetNumSteps() - CaptureStartMovementSteps;
+	const int64 SkippedMovementSteps = UHeistCharacterMovementComponent::GetNumSkippedSteps() - CaptureStartSkippedMovementSteps;
+	Results.Add(TEXT("Movement.SkippedPct"), MovementSteps > 0 ? 100.0 * SkippedMovementSteps / MovementSteps : 0.0);
+	Results.Add(TEXT("Movement.ClientMovesPerSec"), (UHeistCharacterMovementComponent::GetNumClientMoves() - CaptureStartClientMoves) / Seconds);
+	UWorld* World = GetGameInstance()->GetWorld();
+	const UHeistDamageSubsystem* Damage = World != nullptr ? World->GetSubsystem<UHeistDamageSubsystem>() : nullptr;
+	if (Damage != nullptr)
+	{
+		Results.Add(TEXT("Damage.HitsPerSec"), (Damage->GetNumHitsResolved() - CaptureStartHits) / Seconds);
+		Results.Add(TEXT("Damage.DeathBroadcastsPerSec"), (Damage->GetNumDeathBroadcasts() - CaptureStartDeathBroadcasts) / Seconds);
+	}
+
+	Results.Add(TEXT("Frame.AvgMs"), CapturedFrames > 0 ? CapturedFrameMs / CapturedFrames : 0.0);
+	Results.Add(TEXT("Frame.WorstMs"), WorstFrameMs);
+
+	//Left out rather than reported as 0 when the allocator does not count its calls
+	const uint64 Allocations = GetAllocationCount() - CaptureStartAllocations;
+	if (Allocations > 0 && CapturedFrames > 0)
+	{
+		Results.Add(TEXT("Memory.AllocsPerFrame"), static_cast<double>(Allocations) / CapturedFrames);
+	}
+
+	const int64 MemoryDelta = static_cast<int64>(FPlatformMemory::GetStats().UsedPhysical) - static_cast<int64>(CaptureStartMemory);
+	Results.Add(TEXT("Memory.GrowthMB"), MemoryDelta / (1024.0 * 1024.0));
+
+	//Only meaningful when the capture added players, as the scripted scenario does
+	const int32 AddedCharacters = UHeistMemorySubsystem::CountCharacters(World) - CaptureStartCharacters;
+	if (AddedCharacters > 0)
+	{
+		Results.Add(TEXT("Memory.GrowthPerPlayerMB"), MemoryDelta / (1024.0 * 1024.0) / AddedCharacters);
+	}
+	if (FHeistMemoryTags::IsTracking())
+	{
+		FHeistMemoryTags::ForEachTag([this, &Results](EHeistLLMTag Tag)
+		{
+			const int64 TagDelta = FHeistMemoryTags::GetBytes(Tag) - CaptureStartTagBytes.FindRef(static_cast<int32>(Tag));
+			Results.Add(FString::Printf(TEXT("Memory.%sGrowthMB"), FHeistMemoryTags::GetName(Tag)), TagDelta / (1024.0 * 1024.0));
+		});
+	}
+	Results.Append(OperationResults);
+	if (PhaseResults.Num() > 0)
+	{
+		Results.Append(PhaseResults);
+		Results.Add(TEXT("Net.MaxClientBytesPerSec"), MaxClientBytesPerSec);
+	}
+	return Results;
+}
+
+bool UHeistPerfHarnessSubsystem::CompareAgainstBaseline(const TMap<FString, double>& Results) const
+{
+	const FString Path = FPaths::ProjectDir() / BaselineFile;
+	FConfigFile Baseline;
+	Baseline.Read(Path);
+
+	//A missing or empty baseline would pass every run, so it is a failure in itself
+	const FConfigSection* Section = Baseline.Find(BaselineSection);
+	if (Section == nullptr || Section->Num() <= (Section->Contains(BaselineToleranceKey) ? 1 : 0))
+	{
+		UE_LOG(LogTemp, Error, TEXT("HeistPerf: %s has no [%s] entries - commit a baseline with -HeistPerfSaveBaseline."), *Path, BaselineSection);
+		return false;
+	}
+
+	//Ceilings are committed with a Tolerance of 0, so the ceiling is the only margin
+	FString ToleranceString;
+	const double AllowedChange = Baseline.GetString(BaselineSection, BaselineToleranceKey, ToleranceString) ? FCString::Atod(*ToleranceString) : Tolerance;
+
+	bool bPassed = true;
+	for (const TPair<FString, double>& Result : Results)
+	{
+		FString BaselineString;
+		if (!Baseline.GetString(BaselineSection, *Result.Key, BaselineString))
+		{
+			UE_LOG(LogTemp, Log, TEXT("HeistPerf: %s has no baseline."), *Result.Key);
+			continue;
+		}
+
+		const double BaselineValue = FCString::Atod(*BaselineString);
+		const EHeistMetricDirection Direction = GetMetricDirection(Result.Key);
+		if (Direction == EHeistMetricDirection::Informational) { continue; }
+
+		const bool bHigherIsBetter = Direction == EHeistMetricDirection::HigherIsBetter;
+		const double Allowed = BaselineValue * (bHigherIsBetter ? 1.0 - AllowedChange : 1.0 + AllowedChange);
+		const bool bRegressed = bHigherIsBetter
+			? Result.Value < Allowed && BaselineValue - Result.Value > NoiseFloor
+			: Result.Value > Allowed && Result.Value - BaselineValue > NoiseFloor;
+		if (bRegressed)
+		{
+			UE_LOG(LogTemp, Error, TEXT("HeistPerf: REGRESSION %s = %.4f, baseline %.4f (allowed %s %.4f)."),
+				*Result.Key, Result.Value, BaselineValue, bHigherIsBetter ? TEXT("at least") : TEXT("at most"), Allowed);
+			bPassed = false;
+		}
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("HeistPerf: comparison against %s %s."), *Path, bPassed ? TEXT("passed") : TEXT("FAILED"));
+	return bPassed;
+}
+
+bool UHeistPerfHarnessSubsystem::CheckBudgets(const TMap<FString, double>& Results) const
+{
+	//Every budget is checked so one run reports all of them
+	bool bWithinBudgets = true;
+
+	const double* ReplayFramePct = Results.Find(TEXT("Replay.RecordFramePct"));
+	if (ReplayFramePct != nullptr && *ReplayFramePct > MaxReplayRecordFramePct)
+	{
+		UE_LOG(LogTemp, Error, TEXT("HeistPerf: OVER BUDGET Replay.RecordFramePct = %.4f, budget %.4f."), *ReplayFramePct, MaxReplayRecordFramePct);
+		bWithinBudgets = false;
+	}
+
+	const double* GrowthPerPlayer = Results.Find(TEXT("Memory.GrowthPerPlayerMB"));
+	if (GrowthPerPlayer != nullptr && *GrowthPerPlayer > MaxMemoryGrowthPerPlayerMB)
+	{
+		UE_LOG(LogTemp, Error, TEXT("HeistPerf: OVER BUDGET Memory.GrowthPerPlayerMB = %.4f, budget %.4f."), *GrowthPerPlayer, MaxMemoryGrowthPerPlayerMB);
+		bWithinBudgets = false;
+	}
+
+	//The load test's pass condition - server frame time at every player count the scenario steps through
+	for (const TPair<FString, double>& Result : Results)
+	{
+		if (Result.Key.StartsWith(TEXT("Frame.AvgMs.")) && Result.Value > MaxServerFrameMs)
+		{
+			UE_LOG(LogTemp, Error, TEXT("HeistPerf: OVER BUDGET %s = %.4f, budget %.4f."), *Result.Key, Result.Value, MaxServerFrameMs);
+			bWithinBudgets = false;
+		}
+	}
+
+	const UHeistNetPrioritySubsystem* NetPriority = GetDefault<UHeistNetPrioritySubsystem>();
+	const double* ClientBytesPerSec = Results.Find(TEXT("Net.MaxClientBytesPerSec"));
+	if (NetPriority->bEnabled && ClientBytesPerSec != nullptr && *ClientBytesPerSec > NetPriority->BandwidthBudget)
+	{
+		UE_LOG(LogTemp, Error, TEXT("HeistPerf: OVER BUDGET Net.MaxClientBytesPerSec = %.1f, budget %d."), *ClientBytesPerSec, NetPriority->BandwidthBudget);
+		bWithinBudgets = false;
+	}
+
+	//With no connections the per-client bandwidth is 0 and would pass any budget, so it must not count as a pass
+	if (MinPhaseClients == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("HeistPerf: FAILED - a scenario phase measured no client connections, so Net.BytesPerClientPerSec was not captured."));
+		bWithinBudgets = false;
+	}
+	return bWithinBudgets;
+}
+
+void UHeistPerfHarnessSubsystem::SaveBaseline(const TMap<FString, double>& Results) const
+{
+	FString Contents = FString::Printf(TEXT("; Generated by heist.Perf.End save / -HeistPerfSaveBaseline\n[%s]\n%s=%.4f\n"), BaselineSection, BaselineToleranceKey, Tolerance);
+	for (const TPair<FString, double>& Result : Results)
+	{
+		if (GetMetricDirection(Result.Key) != EHeistMetricDirection::Informational)
+		{
+			Contents += FString::Printf(TEXT("%s=%.4f\n"), *Result.Key, Result.Value);
+		}
+	}
+
+	const FString Path = FPaths::ProjectDir() / BaselineFile;
+	FFileHelper::SaveStringToFile(Contents, *Path);
+	UE_LOG(LogTemp, Log, TEXT("HeistPerf: baseline written to %s."), *Path);
+}
+
+/********************************************************************
+				SCRIPTED SCENARIO
+*********************************************************************/
+void UHeistPerfHarnessSubsystem::OnWorldInitializedActors(const UWorld::FActorsInitializedParams& Params)
+{
+	UWorld* World = Params.World;
+	if (World == nullptr || !World->IsGameWorld() || World->GetAuthGameMode() == nullptr) { return; }
+
+	//Only the first server world runs the scenario
+	FWorldDelegates::OnWorldInitializedActors.Remove(WorldInitializedHandle);
+	ScenarioWorld = World;
+	ClientJoinDeadline = FPlatformTime::Seconds() + WarmupSeconds + ClientJoinTimeoutSeconds;
+
+	//Launched next tick so the server is already listening when the clients come up
+	World->GetTimerManager().SetTimerForNextTick(this, &UHeistPerfHarnessSubsystem::LaunchClients);
+	World->GetTimerManager().SetTimer(ScenarioTimerHandle, this, &UHeistPerfHarnessSubsystem::StartScenario, WarmupSeconds, false);
+}
+
+void UHeistPerfHarnessSubsystem::LaunchClients()
+{
+	UWorld* World = ScenarioWorld.Get();
+	if (World == nullptr) { return; }
+
+	FString BaseParams = FString::Printf(TEXT("127.0.0.1:%d -game -nullrhi -nosound -nosplash -unattended"), World->URL.Port);
+#if WITH_EDITOR
+	//The editor binary only runs as a game client when given the project
+	BaseParams = FString::Printf(TEXT("\"%s\" %s"), *FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()), *BaseParams);
+#endif
+
+	for (int32 i = 0; i < ScenarioClients; i++)
+	{
+		const FString Params = FString::Printf(TEXT("%s -log=HeistPerfClient%d.log"), *BaseParams, i);
+		FProcHandle Process = FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *Params, true, true, true, nullptr, 0, nullptr, nullptr);
+		if (Process.IsValid())
+		{
+			ClientProcesses.Add(Process);
+		}
+		else
+		{
+			UE_LOG(LogTemp, Error, TEXT("HeistPerf: failed to launch client %d."), i);
+		}
+	}
+	UE_LOG(LogTemp, Log, TEXT("HeistPerf: launched %d of %d clients."), ClientProcesses.Num(), ScenarioClients);
+}
+
+void UHeistPerfHarnessSubsystem::StopClients()
+{
+	for (FProcHandle& Process : ClientProcesses)
+	{
+		if (FPlatformProcess::IsProcRunning(Process))
+		{
+			FPlatformProcess::TerminateProc(Process, true);
+		}
+		FPlatformProcess::CloseProc(Process);
+	}
+	ClientProcesses.Reset();
+}
+
+int32 UHeistPerfHarnessSubsystem::GetNumClientConnections() const
+{
+	UWorld* World = ScenarioWorld.Get();
+	UNetDriver* NetDriver = World != nullptr ? World->GetNetDriver() : nullptr;
+	if (NetDriver == nullptr) { return 0; }
+
+	int32 NumClients = 0;
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		NumClients += (Connection != nullptr && Connection->PlayerController != nullptr) ? 1 : 0;
+	}
+	return NumClients;
+}
+
+void UHeistPerfHarnessSubsystem::StartScenario()
+{
+	UWorld* World = ScenarioWorld.Get();
+	if (!ensure(World != nullptr)) { return; }
+
+	//Clients take a while to boot and log in, so poll until they are all in or the join timeout runs out
+	const int32 NumClients = GetNumClientConnections();
+	if (NumClients < ScenarioClients && FPlatformTime::Seconds() < ClientJoinDeadline)
+	{
+		World->GetTimerManager().SetTimer(ScenarioTimerHandle, this, &UHeistPerfHarnessSubsystem::StartScenario, 1.0f, false);
+		return;
+	}
+
+	//Operations are probed one at a time first, so their cost is not mixed into the load of the phases
+	if (ProbeOp == INDEX_NONE && OperationProbeCount > 0)
+	{
+		StartOperationProbes();
+		return;
+	}
+	UE_LOG(LogTemp, Log, TEXT("HeistPerf: starting the scenario with %d of %d clients connected."), NumClients, ScenarioClients);
+
+	if (ScenarioPlayerCounts.Num() == 0)
+	{
+		ScenarioPlayerCounts.Add(8);
+	}
+
+	BeginCapture();
+
+	ScenarioPhase = 0;
+	BeginPhase(ScenarioPlayerCounts[0]);
+
+	UHeistReplaySubsystem* Replay = World->GetSubsystem<UHeistReplaySubsystem>();
+	if (bRecordReplayDuringScenario && Replay != nullptr)
+	{
+		Replay->StartRecording();
+	}
+
+	ScenarioStep = 0;
+	PreActorTickHandle = FWorldDelegates::OnWorldPreActorTick.AddUObject(this, &UHeistPerfHarnessSubsystem::DriveBots);
+	World->GetTimerManager().SetTimer(ScenarioStepTimerHandle, this, &UHeistPerfHarnessSubsystem::StepScenario, 0.25f, true);
+	World->GetTimerManager().SetTimer(ScenarioTimerHandle, this, &UHeistPerfHarnessSubsystem::AdvancePhase, ScenarioSeconds / ScenarioPlayerCounts.Num(), false);
+}
+
+void UHeistPerfHarnessSubsystem::StartOperationProbes()
+{
+	UE_LOG(LogTemp, Log, TEXT("HeistPerf: probing %d operations on %d bots with %d clients connected."), UE_ARRAY_COUNT(ProbeOpNames), OperationProbeCount, GetNumClientConnections());
+	OperationResults.Reset();
+	ProbeOp = 0;
+	bProbeIdleWindow = true;
+	ProbeFramesLeft = FMath::Max(OperationProbeFrames, 1);
+	ProbeStartBytes = GetClientBytesSent();
+	ProbeEndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &UHeistPerfHarnessSubsystem::OnProbeEndFrame);
+}
+
+void UHeistPerfHarnessSubsystem::OnProbeEndFrame()
+{
+	if (--ProbeFramesLeft > 0) { return; }
+	ProbeFramesLeft = FMath::Max(OperationProbeFrames, 1);
+
+	//The idle window measures what the standing bots send anyway, so it can be taken off the operation's window
+	if (bProbeIdleWindow)
+	{
+		ProbeIdleBytes = GetClientBytesSent() - ProbeStartBytes;
+		ProbeStartBytes = GetClientBytesSent();
+		ProbeOps = RunProbeOp();
+		bProbeIdleWindow = false;
+		return;
+	}
+
+	const int32 NumClients = GetNumClientConnections();
+	const int64 OperationBytes = GetClientBytesSent() - ProbeStartBytes - ProbeIdleBytes;
+	if (NumClients > 0 && ProbeOps > 0)
+	{
+		OperationResults.Add(FString::Printf(TEXT("Op.%s.BytesPerClient"), ProbeOpNames[ProbeOp]), FMath::Max<int64>(OperationBytes, 0) / static_cast<double>(NumClients * ProbeOps));
+	}
+
+	if (++ProbeOp < UE_ARRAY_COUNT(ProbeOpNames))
+	{
+		bProbeIdleWindow = true;
+		ProbeStartBytes = GetClientBytesSent();
+		return;
+	}
+
+	//Probe bots are removed so the phases run at exactly their player counts
+	FCoreDelegates::OnEndFrame.Remove(ProbeEndFrameHandle);
+	ProbeEndFrameHandle.Reset();
+	for (const TWeakObjectPtr<AHeistFPSCharacter>& WeakBot : Bots)
+	{
+		if (AHeistFPSCharacter* Bot = WeakBot.Get())
+		{
+			Bot->Destroy();
+		}
+	}
+	Bots.Reset();
+	StartScenario();
+}
+
+int32 UHeistPerfHarnessSubsystem::RunProbeOp()
+{
+	auto Record = [this](const TCHAR* Name, double StartTime, uint64 StartAllocations, int32 Ops)
+	{
+		if (Ops == 0) { return; }
+		OperationResults.Add(FString::Printf(TEXT("Op.%s.Ms"), Name), (FPlatformTime::Seconds() - StartTime) * 1000.0 / Ops);
+		const uint64 Allocations = GetAllocationCount() - StartAllocations;
+		if (Allocations > 0)
+		{
+			OperationResults.Add(FString::Printf(TEXT("Op.%s.Allocs"), Name), static_cast<double>(Allocations) / Ops);
+		}
+	};
+
+	int32 Ops = 0;
+	double StartTime = FPlatformTime::Seconds();
+	uint64 StartAllocations = GetAllocationCount();
+	if (ProbeOp == 0)
+	{
+		for (int32 i = 0; i < OperationProbeCount; i++)
+		{
+			Bots.Add(SpawnBot(Bots.Num()));
+			Ops++;
+		}
+		Record(ProbeOpNames[ProbeOp], StartTime, StartAllocations, Ops);
+
+		//Inventory would spawn on the next tick anyway - spawning it here times it on its own, and its bytes count towards Spawn
+		int32 InventoryOps = 0;
+		StartTime = FPlatformTime::Seconds();
+		StartAllocations = GetAllocationCount();
+		for (const TWeakObjectPtr<AHeistFPSCharacter>& WeakBot : Bots)
+		{
+			if (AHeistFPSCharacter* Bot = WeakBot.Get())
+			{
+				Bot->SpawnDefaultInventory();
+				InventoryOps++;
+			}
+		}
+		Record(TEXT("Inventory"), StartTime, StartAllocations, InventoryOps);
+		return Ops;
+	}
+
+	for (const TWeakObjectPtr<AHeistFPSCharacter>& WeakBot : Bots)
+	{
+		AHeistFPSCharacter* Bot = WeakBot.Get();
+		if (Bot == nullptr || Bot->IsDead() || Bot->Inventory.Num() == 0) { continue; }
+
+		switch (ProbeOp)
+		{
+		case 1:
+			if (Bot->bPrimaryEquipped) { continue; }
+			Bot->TogglePrimaryWeapon();
+			break;
+		case 2:
+			Bot->FireWeapon();
+			break;
+		case 3:
+			Bot->StartSprint();
+			break;
+		default:
+			Bot->ToggleCrouch();
+			break;
+		}
+		Ops++;
+	}
+	Record(ProbeOpNames[ProbeOp], StartTime, StartAllocations, Ops);
+	return Ops;
+}
+
+int64 UHeistPerfHarnessSubsystem::GetClientBytesSent() const
+{
+	UWorld* World = ScenarioWorld.Get();
+	UNetDriver* NetDriver = World != nullptr ? World->GetNetDriver() : nullptr;
+	if (NetDriver == nullptr) { return 0; }
+
+	int64 Bytes = 0;
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		Bytes += Connection != nullptr ? Connection->OutTotalBytes : 0;
+	}
+	return Bytes;
+}
+
+uint64 UHeistPerfHarnessSubsystem::GetAllocationCount()
+{
+	return static_cast<uint64>(FMalloc::TotalMallocCalls);
+}
+
+void UHeistPerfHarnessSubsystem::BeginPhase(int32 Count)
+{
+	UWorld* World = ScenarioWorld.Get();
+	if (!ensure(World != nullptr)) { return; }
+
+	//Connected clients are players too, bots fill the rest. Failed spawns still take their slot so the grid and counts stay stable
+	const int32 NumBots = Count - GetNumClientConnections();
+	for (int32 i = Bots.Num(); i < NumBots; i++)
+	{
+		Bots.Add(SpawnBot(i));
+	}
+
+	//Bots have no player controller, so the game mode is told the full count it should scale rates for
+	if (AHeistFPSGameMode* GameMode = World->GetAuthGameMode<AHeistFPSGameMode>())
+	{
+		GameMode->UpdateNetScaling(Count);
+	}
+
+	PhaseFrames = 0;
+	PhaseFrameMs = 0.0;
+	PhaseWorstFrameMs = 0.0;
+	PhaseStartTime = FPlatformTime::Seconds();
+	PhaseStartConnectionBytes.Reset();
+	UNetDriver* NetDriver = World->GetNetDriver();
+	if (NetDriver != nullptr)
+	{
+		for (UNetConnection* Connection : NetDriver->ClientConnections)
+		{
+			if (Connection != nullptr)
+			{
+				PhaseStartConnectionBytes.Add(FObjectKey(Connection), Connection->OutTotalBytes);
+			}
+		}
+	}
+}
+
+AHeistFPSCharacter* UHeistPerfHarnessSubsystem::SpawnBot(int32 Slot)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistPerfSpawnCharacter);
+
+	UWorld* World = ScenarioWorld.Get();
+	if (!ensure(World != nullptr)) { return nullptr; }
+
+	AGameModeBase* GameMode = World->GetAuthGameMode();
+	UClass* PawnClass = GameMode->GetDefaultPawnClassForController(nullptr);
+	AActor* PlayerStart = GameMode->FindPlayerStart(nullptr);
+	const FVector Origin = PlayerStart != nullptr ? PlayerStart->GetActorLocation() : FVector::ZeroVector;
+
+	FActorSpawnParameters SpawnInfo;
+	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+	const FVector Location = Origin + FVector((Slot % 8) * 150.0f, (Slot / 8) * 150.0f, 0.0f);
+	AHeistFPSCharacter* Bot = World->SpawnActor<AHeistFPSCharacter>(PawnClass, Location, FRotator::ZeroRotator, SpawnInfo);
+	if (Bot != nullptr)
+	{
+		Bot->SpawnDefaultController();
+	}
+	return Bot;
+}
+
+void UHeistPerfHarnessSubsystem::EndPhase(int32 Count)
+{
+	UWorld* World = ScenarioWorld.Get();
+	UNetDriver* NetDriver = World != nullptr ? World->GetNetDriver() : nullptr;
+	const double Seconds = FMath::Max(FPlatformTime::Seconds() - PhaseStartTime, 0.001);
+
+	//Only connections present for the whole phase are counted
+	double TotalBytesPerSec = 0.0;
+	int32 Clients = 0;
+	if (NetDriver != nullptr)
+	{
+		for (UNetConnection* Connection : NetDriver->ClientConnections)
+		{
+			const int64* StartBytes = Connection != nullptr ? PhaseStartConnectionBytes.Find(FObjectKey(Connection)) : nullptr;
+			if (StartBytes == nullptr) { continue; }
+
+			const double BytesPerSec = (Connection->OutTotalBytes - *StartBytes) / Seconds;
+			TotalBytesPerSec += BytesPerSec;
+			MaxClientBytesPerSec = FMath::Max(MaxClientBytesPerSec, BytesPerSec);
+			Clients++;
+		}
+	}
+
+	MinPhaseClients = MinPhaseClients == INDEX_NONE ? Clients : FMath::Min(MinPhaseClients, Clients);
+	const double AvgBytesPerSec = Clients > 0 ? TotalBytesPerSec / Clients : 0.0;
+	const double AvgFrameMs = PhaseFrames > 0 ? PhaseFrameMs / PhaseFrames : 0.0;
+	PhaseResults.Add(FString::Printf(TEXT("Net.BytesPerClientPerSec.%dPlayers"), Count), AvgBytesPerSec);
+	PhaseResults.Add(FString::Printf(TEXT("Frame.AvgMs.%dPlayers"), Count), AvgFrameMs);
+	PhaseResults.Add(FString::Printf(TEXT("Frame.WorstMs.%dPlayers"), Count), PhaseWorstFrameMs);
+	UE_LOG(LogTemp, Log, TEXT("HeistPerf: %d players, %d clients - server frame %.2f ms avg, %.2f ms worst, %.1f bytes/s per client."),
+		Count, Clients, AvgFrameMs, PhaseWorstFrameMs, AvgBytesPerSec);
+}
+
+void UHeistPerfHarnessSubsystem::AdvancePhase()
+{
+	EndPhase(ScenarioPlayerCounts[ScenarioPhase]);
+
+	ScenarioPhase++;
+	if (ScenarioPhase >= ScenarioPlayerCounts.Num())
+	{
+		FinishScenario();
+		return;
+	}
+
+	BeginPhase(ScenarioPlayerCounts[ScenarioPhase]);
+	UWorld* World = ScenarioWorld.Get();
+	if (World != nullptr)
+	{
+		World->GetTimerManager().SetTimer(ScenarioTimerHandle, this, &UHeistPerfHarnessSubsystem::AdvancePhase, ScenarioSeconds / ScenarioPlayerCounts.Num(), false);
+	}
+}
+
+void UHeistPerfHarnessSubsystem::StepScenario()
+{
+	//Cycle every bot through equip, fire, sprint and crouch toggles
+	for (int32 Slot = 0; Slot < Bots.Num(); Slot++)
+	{
+		//Bots facing along the grid shoot the row in front, so replace the ones that die
+		AHeistFPSCharacter* Bot = Bots[Slot].Get();
+		if (Bot != nullptr && Bot->IsDead())
+		{
+			Bot = SpawnBot(Slot);
+			Bots[Slot] = Bot;
+		}
+		if (Bot == nullptr || Bot->Inventory.Num() == 0) { continue; }
+
+		switch (ScenarioStep % 6)
+		{
+		case 0:
+			if (!Bot->bPrimaryEquipped) { Bot->TogglePrimaryWeapon(); }
+			break;
+		case 1:
+		case 4:
+			Bot->FireWeapon();
+			break;
+		case 2:
+			Bot->StartSprint();
+			break;
+		case 3:
+			Bot->StopSprint();
+			Bot->ToggleCrouch();
+			break;
+		case 5:
+			Bot->ToggleCrouch();
+			break;
+		}
+	}
+	ScenarioStep++;
+}
+
+void UHeistPerfHarnessSubsystem::DriveBots(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World != ScenarioWorld.Get()) { return; }
+
+	//Walkers turn 90 degrees every second (4 scenario steps), so they walk a square and stay near their slot
+	const float MovingShare = FMath::Clamp(ScenarioMovingBotPct, 0.0f, 100.0f) / 100.0f;
+	const FVector Direction = FRotator(0.0f, 90.0f * ((ScenarioStep / 4) % 4), 0.0f).Vector();
+	for (int32 Slot = 0; Slot < Bots.Num(); Slot++)
+	{
+		//Spreads the walkers evenly through the grid instead of taking the first slots
+		const bool bWalker = FMath::FloorToInt((Slot + 1) * MovingShare) > FMath::FloorToInt(Slot * MovingShare);
+		AHeistFPSCharacter* Bot = Bots[Slot].Get();
+		if (bWalker && Bot != nullptr && !Bot->IsDead())
+		{
+			Bot->AddMovementInput(Direction, 1.0f);
+		}
+	}
+}
+
+void UHeistPerfHarnessSubsystem::FinishScenario()
+{
+	UWorld* World = ScenarioWorld.Get();
+	if (World != nullptr)
+	{
+		World->GetTimerManager().ClearTimer(ScenarioStepTimerHandle);
+	}
+	FWorldDelegates::OnWorldPreActorTick.Remove(PreActorTickHandle);
+
+	const bool bPassed = EndCapture(bSaveBaselineAfterScenario);
+
+	//Stopped after the capture so writing the final chunk and index is not counted against the budget
+	UHeistReplaySubsystem* Replay = World != nullptr ? World->GetSubsystem<UHeistReplaySubsystem>() : nullptr;
+	if (Replay != nullptr)
+	{
+		Replay->StopRecording();
+	}
+
+	for (const TWeakObjectPtr<AHeistFPSCharacter>& WeakBot : Bots)
+	{
+		if (AHeistFPSCharacter* Bot = WeakBot.Get())
+		{
+			Bot->Destroy();
+		}
+	}
+	Bots.Reset();
+	StopClients();
+
+	FPlatformMisc::RequestExitWithStatus(false, bPassed ? 0 : 1);
+}
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Player/HeistCharacterAnimInstance.h"
+#include "HeistFPS.h"
+
+#include "Player/HeistFPSCharacter.h"
+
+#include "GameFramework/CharacterMovementComponent.h"
+
+DECLARE_CYCLE_STAT(TEXT("AnimPreUpdate"), STAT_HeistAnimPreUpdate, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("AnimWorkerUpdate"), STAT_HeistAnimWorkerUpdate, STATGROUP_HeistFPS);
+
+void FHeistCharacterAnimInstanceProxy::InitializeObjects(UAnimInstance* InAnimInstance)
+{
+	FAnimInstanceProxy::InitializeObjects(InAnimInstance);
+
+	Character = Cast<AHeistFPSCharacter>(InAnimInstance->TryGetPawnOwner());
+	if (const UHeistCharacterAnimInstance* Instance = Cast<UHeistCharacterAnimInstance>(InAnimInstance))
+	{
+		DirectionInterpSpeed = Instance->DirectionInterpSpeed;
+		AimDownSightInterpSpeed = Instance->AimDownSightInterpSpeed;
+		MaxLeanYawRate = FMath::Max(Instance->MaxLeanYawRate, 1.0f);
+	}
+}
+
+void FHeistCharacterAnimInstanceProxy::PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistAnimPreUpdate);
+	FAnimInstanceProxy::PreUpdate(InAnimInstance, DeltaSeconds);
+
+	const AHeistFPSCharacter* Owner = Character.Get();
+	if (Owner == nullptr) { return; }
+
+	// Plain copies only - everything derived from them happens in Update
+	Snapshot.Speed = Owner->CurrentSpeed;
+	Snapshot.Direction = Owner->CurrentDirection;
+	Snapshot.AimPitch = Owner->CurrentPitch;
+	Snapshot.AimYaw = Owner->CurrentYaw;
+	Snapshot.ActorYaw = Owner->GetActorRotation().Yaw;
+	Snapshot.bIsInAir = Owner->GetCharacterMovement()->IsFalling();
+	Snapshot.bIsCrouched = Owner->bIsCrouched;
+	Snapshot.bCombatInitiated = Owner->bCombatInitiated;
+	Snapshot.bPrimaryEquipped = Owner->bPrimaryEquipped;
+	Snapshot.bAimDownSight = Owner->bAimDownSight;
+	Snapshot.bIsDead = Owner->IsDead();
+}
+
+void FHeistCharacterAnimInstanceProxy::Update(float DeltaSeconds)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistAnimWorkerUpdate);
+	FAnimInstanceProxy::Update(DeltaSeconds);
+
+	Speed = Snapshot.Speed;
+	bIsMoving = Speed > 3.0f;
+	bIsInAir = Snapshot.bIsInAir;
+	bIsCrouched = Snapshot.bIsCrouched;
+	bCombatInitiated = Snapshot.bCombatInitiated;
+	bPrimaryEquipped = Snapshot.bPrimaryEquipped;
+	bIsDead = Snapshot.bIsDead;
+	AimPitch = Snapshot.AimPitch;
+	AimYaw = Snapshot.AimYaw;
+
+	// Ease along the shortest way round so crossing +-180 does not spin the blendspace
+	const float DirectionDelta = FRotator::NormalizeAxis(Snapshot.Direction - Direction);
+	Direction = bIsMoving ? FRotator::NormalizeAxis(Direction + DirectionDelta * FMath::Min(DeltaSeconds * DirectionInterpSpeed, 1.0f)) : Snapshot.Direction;
+
+	AimDownSightAlpha = FMath::FInterpTo(AimDownSightAlpha, Snapshot.bAimDownSight ? 1.0f : 0.0f, DeltaSeconds, AimDownSightInterpSpeed);
+
+	const float YawRate = bHasLastYaw && DeltaSeconds > 0.0f ? FRotator::NormalizeAxis(Snapshot.ActorYaw - LastActorYaw) / DeltaSeconds : 0.0f;
+	Lean = FMath::FInterpTo(Lean, FMath::Clamp(YawRate / MaxLeanYawRate, -1.0f, 1.0f), DeltaSeconds, 6.0f);
+	LastActorYaw = Snapshot.ActorYaw;
+	bHasLastYaw = true;
+}
@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Player/HeistCharacterMovementComponent.h"
+#include "HeistFPS.h"
+
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("CharacterMovementTick"), STAT_HeistCharacterMovementTick, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("ServerMoveAutonomous"), STAT_HeistServerMoveAutonomous, STATGROUP_HeistFPS);
+
+static int32 GHeistSimplifiedMovement = 1;
+static FAutoConsoleVariableRef CVarHeistSimplifiedMovement(
+	TEXT("heist.Movement.Simplified"),
+	GHeistSimplifiedMovement,
+	TEXT("Skip server movement steps for idle characters and run far characters at a reduced rate (1), or simulate everyone fully (0, for comparison)."));
+
+int64 UHeistCharacterMovementComponent::NumSteps = 0;
+int64 UHeistCharacterMovementComponent::NumSkippedSteps = 0;
+int64 UHeistCharacterMovementComponent::NumClientMoves = 0;
+
+void UHeistCharacterMovementComponent::WakeUp()
+{
+	WakeTimeLeft = WakeSeconds;
+	TimeSinceFloorCheck = FloorRecheckInterval;
+	SetFar(false);
+}
+
+bool UHeistCharacterMovementComponent::CanSkipStep(const FVector& InputAcceleration) const
+{
+	if (GHeistSimplifiedMovement == 0 || CharacterOwner == nullptr || WakeTimeLeft > 0.0f || TimeSinceFloorCheck >= FloorRecheckInterval) { return false; }
+	if (MovementMode != MOVE_Walking || !CurrentFloor.IsWalkableFloor()) { return false; }
+	if (!InputAcceleration.IsNearlyZero() || !Acceleration.IsNearlyZero() || !Velocity.IsNearlyZero() || !PendingLaunchVelocity.IsZero()) { return false; }
+
+	// Path following drives AI through RequestDirectMove rather than input, and the step is what applies it
+	if (bHasRequestedVelocity) { return false; }
+	if (CharacterOwner->bPressedJump || IsCrouching() != bWantsToCrouch) { return false; }
+	if (HasAnimRootMotion() || CurrentRootMotion.HasActiveRootMotionSources()) { return false; }
+
+	// Standing on something that moves carries the character with it
+	return !MovementBaseUtility::IsDynamicBase(GetMovementBase());
+}
+
+void UHeistCharacterMovementComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistCharacterMovementTick);
+
+	// Remote players are stepped by MoveAutonomous - only characters simulated here are simplified in Tick
+	const bool bSimulatedHere = CharacterOwner != nullptr && CharacterOwner->HasAuthority() && CharacterOwner->IsLocallyControlled();
+	if (!bSimulatedHere)
+	{
+		Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+		return;
+	}
+
+	WakeTimeLeft -= DeltaTime;
+	TimeSinceFloorCheck += DeltaTime;
+	UpdateFarState(DeltaTime);
+
+	NumSteps++;
+	if (GetPendingInputVector().IsNearlyZero() && CanSkipStep(FVector::ZeroVector))
+	{
+		ConsumeInputVector();
+		NumSkippedSteps++;
+		return;
+	}
+
+	TimeSinceFloorCheck = 0.0f;
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+}
+
+void UHeistCharacterMovementComponent::MoveAutonomous(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags, const FVector& NewAccel)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistServerMoveAutonomous);
+	NumClientMoves++;
+
+	WakeTimeLeft -= DeltaTime;
+	TimeSinceFloorCheck += DeltaTime;
+
+	// A jump or crouch change in the flags is a move even with no acceleration
+	const bool bJumpPressed = (CompressedFlags & FSavedMove_Character::FLAG_JumpPressed) != 0;
+	const bool bWantsCrouch = (CompressedFlags & FSavedMove_Character::FLAG_WantsToCrouch) != 0;
+
+	NumSteps++;
+	if (!bJumpPressed && bWantsCrouch == bWantsToCrouch && CanSkipStep(NewAccel))
+	{
+		NumSkippedSteps++;
+		return;
+	}
+
+	TimeSinceFloorCheck = 0.0f;
+	Super::MoveAutonomous(ClientTimeStamp, DeltaTime, CompressedFlags, NewAccel);
+}
+
+void UHeistCharacterMovementComponent::UpdateFarState(float DeltaTime)
+{
+	// The listen server host is never made far from itself
+	if (GHeistSimplifiedMovement == 0 || WakeTimeLeft > 0.0f || CharacterOwner->IsPlayerControlled())
+	{
+		SetFar(false);
+		return;
+	}
+
+	TimeSinceDistanceCheck += DeltaTime;
+	if (TimeSinceDistanceCheck < DistanceCheckInterval) { return; }
+	TimeSinceDistanceCheck = 0.0f;
+
+	const FVector Location = UpdatedComponent->GetComponentLocation();
+	const float FarDistanceSq = FMath::Square(FarDistance);
+	bool bNearPlayer = false;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It && !bNearPlayer; ++It)
+	{
+		const APawn* PlayerPawn = It->Get() != nullptr ? It->Get()->GetPawn() : nullptr;
+		bNearPlayer = PlayerPawn != nullptr && FVector::DistSquared(PlayerPawn->GetActorLocation(), Location) < FarDistanceSq;
+	}
+	SetFar(!bNearPlayer);
+}
+
+void UHeistCharacterMovementComponent::SetFar(bool bNewFar)
+{
+	if (bNewFar == bFar) { return; }
+
+	bFar = bNewFar;
+	SetComponentTickInterval(bFar ? FarTickInterval : 0.0f);
+
+	// Far characters re-check the floor only once they have moved far enough to need it
+	bAlwaysCheckFloor = !bFar;
+}
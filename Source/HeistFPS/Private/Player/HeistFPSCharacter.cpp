@@ -2,25 +2,56 @@
 
 #include "Player/HeistFPSCharacter.h"
 
+#include "HeistFPS.h"
 #include "Weapon/WeaponBase.h"
 #include "Game/HeistFPSGameInstance.h"
+#include "Heist/HeistInteractable.h"
+#include "Heist/HeistInteractionSubsystem.h"
+#include "Player/HeistCharacterMovementComponent.h"
+#include "Net/HeistHitboxHistorySubsystem.h"
+#include "Net/HeistNetPrioritySubsystem.h"
+#include "Net/HeistNetTelemetrySubsystem.h"
+#include "Net/HeistRPCLimiterSubsystem.h"
+#include "Net/HeistSpectatorFeed.h"
+#include "Weapon/HeistProjectileSubsystem.h"
 
 #include "Net/UnrealNetwork.h"
+#include "Engine/ActorChannel.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/InputComponent.h"
+#include "Components/SkeletalMeshComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/Controller.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/PlayerController.h"
 #include "GameFramework/SpringArmComponent.h"
 #include "GameFramework/Actor.h"
 #include "Animation/AnimInstance.h"
+#include "IAnimationBudgetAllocator.h"
+#include "SkeletalMeshComponentBudgeted.h"
+#include "Camera/PlayerCameraManager.h"
 #include "Kismet/GameplayStatics.h"
+#include "HAL/IConsoleManager.h"
+#include "EngineUtils.h"
+
+DECLARE_CYCLE_STAT(TEXT("UpdateCharacterAnimMovement"), STAT_HeistUpdateCharacterAnimMovement, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("SpawnDefaultInventory"), STAT_HeistSpawnDefaultInventory, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("ServerUpdateLastMoveRight"), STAT_HeistServerUpdateLastMoveRight, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("ServerSetCombatState"), STAT_HeistServerSetCombatState, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("ServerToggleSprint"), STAT_HeistServerToggleSprint, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("ServerFireWeapon"), STAT_HeistServerFireWeapon, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("ServerInteract"), STAT_HeistServerInteract, STATGROUP_HeistFPS);
 
 //////////////////////////////////////////////////////////////////////////
 // AHeistFPSCharacter
 
-AHeistFPSCharacter::AHeistFPSCharacter()
+AHeistFPSCharacter::AHeistFPSCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer
+		.SetDefaultSubobjectClass<USkeletalMeshComponentBudgeted>(ACharacter::MeshComponentName)
+		.SetDefaultSubobjectClass<UHeistCharacterMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
+	HEISTFPS_LLM_SCOPE(Characters);
 	PrimaryActorTick.bCanEverTick = true;
 	bReplicates = true;
 	SetReplicateMovement(true);
@@ -47,6 +78,8 @@ AHeistFPSCharacter::AHeistFPSCharacter()
 	// Create a camera
 	FPSCamera = CreateDefaultSubobject<UCameraComponent>(TEXT("FPSCamera"));
 
+	AnimFramesSkippedPerLOD = { 0, 1, 2, 4 };
+
 }
 
 /********************************************************************
@@ -54,21 +87,124 @@ AHeistFPSCharacter::AHeistFPSCharacter()
 *********************************************************************/
 void AHeistFPSCharacter::GetLifetimeReplicatedProps(TArray< FLifetimeProperty > & OutLifetimeProps) const {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
-	DOREPLIFETIME_CONDITION(AHeistFPSCharacter, CurrentSpeed, COND_SkipOwner);
-	DOREPLIFETIME_CONDITION(AHeistFPSCharacter, CurrentDirection, COND_SkipOwner);
-	DOREPLIFETIME_CONDITION(AHeistFPSCharacter, CurrentPitch, COND_SkipOwner);
-	DOREPLIFETIME_CONDITION(AHeistFPSCharacter, CurrentYaw, COND_SkipOwner);
+	DOREPLIFETIME_CONDITION(AHeistFPSCharacter, AnimState, COND_SkipOwner);
 	DOREPLIFETIME_CONDITION(AHeistFPSCharacter, LastMoveRightValue, COND_SkipOwner);
 	DOREPLIFETIME_CONDITION(AHeistFPSCharacter, bCombatInitiated, COND_SkipOwner);
 	DOREPLIFETIME_CONDITION(AHeistFPSCharacter, bPrimaryEquipped, COND_SkipOwner);
 	DOREPLIFETIME_CONDITION(AHeistFPSCharacter, bAimDownSight, COND_SkipOwner);
 	DOREPLIFETIME_CONDITION(AHeistFPSCharacter, Inventory, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(AHeistFPSCharacter, CombatStateAck, COND_OwnerOnly);
+	DOREPLIFETIME(AHeistFPSCharacter, HealthState);
+}
+
+void AHeistFPSCharacter::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	UHeistNetTelemetrySubsystem* Telemetry = UHeistNetTelemetrySubsystem::Get(this);
+	if (Telemetry == nullptr) { return; }
+
+	//Names are resolved once - GET_MEMBER_NAME_CHECKED builds a new FName on every call
+	static const FName AnimStateName = GET_MEMBER_NAME_CHECKED(AHeistFPSCharacter, AnimState);
+	static const FName LastMoveRightValueName = GET_MEMBER_NAME_CHECKED(AHeistFPSCharacter, LastMoveRightValue);
+	static const FName CombatInitiatedName = GET_MEMBER_NAME_CHECKED(AHeistFPSCharacter, bCombatInitiated);
+	static const FName PrimaryEquippedName = GET_MEMBER_NAME_CHECKED(AHeistFPSCharacter, bPrimaryEquipped);
+	static const FName AimDownSightName = GET_MEMBER_NAME_CHECKED(AHeistFPSCharacter, bAimDownSight);
+	static const FName HealthStateName = GET_MEMBER_NAME_CHECKED(AHeistFPSCharacter, HealthState);
+	static const FName InventoryName = GET_MEMBER_NAME_CHECKED(AHeistFPSCharacter, Inventory);
+	static const FName ReplicatedMovementName(TEXT("ReplicatedMovement"));
+
+	Telemetry->RecordPropertyIfChanged(this, AnimStateName, AnimState);
+	Telemetry->RecordPropertyIfChanged(this, LastMoveRightValueName, LastMoveRightValue);
+	Telemetry->RecordPropertyIfChanged(this, CombatInitiatedName, bCombatInitiated);
+	Telemetry->RecordPropertyIfChanged(this, PrimaryEquippedName, bPrimaryEquipped);
+	Telemetry->RecordPropertyIfChanged(this, AimDownSightName, bAimDownSight);
+	Telemetry->RecordPropertyIfChanged(this, HealthStateName, HealthState);
+
+	//Object references are sent as NetGUIDs - estimate roughly 4 bytes per entry
+	uint32 InventoryHash = 0;
+	for (AWeaponBase* Weapon : Inventory)
+	{
+		InventoryHash = HashCombine(InventoryHash, GetTypeHash(Weapon));
+	}
+	Telemetry->RecordPropertyIfChanged(this, InventoryName, InventoryHash, Inventory.Num() * 4);
+
+	//Movement is quantized on the wire - the estimate here is the unquantized upper bound
+	const FRepMovement& Movement = GetReplicatedMovement();
+	Telemetry->RecordPropertyIfChanged(this, ReplicatedMovementName, HashCombine(GetTypeHash(Movement.Location), GetTypeHash(Movement.LinearVelocity)), sizeof(FVector) * 2 + sizeof(FRotator));
+}
+
+bool AHeistFPSCharacter::IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const
+{
+	if (AHeistSpectatorFeed::IsSpectatorViewer(RealViewer)) { return false; }
+
+	//Hidden without collision would make a parked character irrelevant, and clients would destroy it and spawn it
+	//again on respawn. It stays relevant instead and costs nothing while dormant.
+	if (bPooled) { return true; }
+	return Super::IsNetRelevantFor(RealViewer, ViewTarget, SrcLocation);
+}
+
+float AHeistFPSCharacter::GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth)
+{
+	if (UHeistNetPrioritySubsystem* Priority = UHeistNetPrioritySubsystem::Get(this))
+	{
+		return Priority->GetNetPriority(*this, ViewPos, ViewDir, ViewTarget, Time);
+	}
+	return Super::GetNetPriority(ViewPos, ViewDir, Viewer, ViewTarget, InChannel, Time, bLowBandwidth);
+}
+
+bool AHeistFPSCharacter::IsReplicationPausedForConnection(const FNetViewer& ConnectionOwnerNetViewer)
+{
+	UHeistNetPrioritySubsystem* Priority = UHeistNetPrioritySubsystem::Get(this);
+	return Priority != nullptr && Priority->ShouldThrottle(*this, ConnectionOwnerNetViewer);
+}
+
+bool AHeistFPSCharacter::ReplicateSubobjects(UActorChannel* Channel, FOutBunch* Bunch, FReplicationFlags* RepFlags)
+{
+	//Saturated or paused channels never get here, so only sends that happened start the next throttle interval
+	if (UHeistNetPrioritySubsystem* Priority = UHeistNetPrioritySubsystem::Get(this)) {
+		Priority->RecordSend(*this, Channel->Connection);
+	}
+	return Super::ReplicateSubobjects(Channel, Bunch, RepFlags);
+}
+
+bool AHeistFPSCharacter::HasMovedWithin(float Seconds) const
+{
+	return !GetVelocity().IsNearlyZero() || GetWorld()->TimeSince(AnimState.ServerTime) < Seconds;
+}
+
+void AHeistFPSCharacter::MakePuppet()
+{
+	GetCharacterMovement()->DisableMovement();
+	GetCapsuleComponent()->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 }
 
 void AHeistFPSCharacter::PostInitializeComponents()
 {
+	HEISTFPS_LLM_SCOPE(Characters);
 	Super::PostInitializeComponents();
 
+	if (GetMesh() != nullptr)
+	{
+		MeshRelativeTransform = GetMesh()->GetRelativeTransform();
+		MeshCollisionProfile = GetMesh()->GetCollisionProfileName();
+
+		// Authority, listen server host included, keeps full rate poses for hitbox history - only client copies skip or throttle animation
+		USkeletalMeshComponentBudgeted* BudgetedMesh = Cast<USkeletalMeshComponentBudgeted>(GetMesh());
+		const bool bThrottleAnimation = !HasAuthority();
+		if (BudgetedMesh != nullptr)
+		{
+			BudgetedMesh->SetAutoRegisterWithBudgetAllocator(bThrottleAnimation);
+		}
+		if (bThrottleAnimation)
+		{
+			TimeSinceAnimSignificanceUpdate = FMath::FRand() * AnimSignificanceInterval;
+			GetMesh()->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickMontagesWhenNotRendered;
+			GetMesh()->bEnableUpdateRateOptimizations = true;
+			GetMesh()->OnAnimUpdateRateParamsCreated.BindUObject(this, &AHeistFPSCharacter::OnAnimUpdateRateParamsCreated);
+		}
+	}
+
 	if (HasAuthority())
 	{
 		// Needs to happen after character is added to repgraph
@@ -76,6 +212,7 @@ void AHeistFPSCharacter::PostInitializeComponents()
 	}
 }
 void AHeistFPSCharacter::BeginPlay() {
+	HEISTFPS_LLM_SCOPE(Characters);
 	Super::BeginPlay();
 	if (GetMesh()) {
 		FPSCamera->AttachToComponent(GetMesh(), FAttachmentTransformRules::SnapToTargetIncludingScale, TEXT("head"));
@@ -84,15 +221,48 @@ void AHeistFPSCharacter::BeginPlay() {
 	}
 	GetCharacterMovement()->GetNavAgentPropertiesRef().bCanCrouch = true;
 	bUseControllerRotationYaw = false;
+
+	if (HasAuthority()) {
+		SetHealthAndArmor(MaxHealth, StartingArmor);
+		if (UHeistHitboxHistorySubsystem* HitboxHistory = GetWorld()->GetSubsystem<UHeistHitboxHistorySubsystem>()) {
+			HitboxHistory->Register(this);
+		}
+	}
+}
+
+void AHeistFPSCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UHeistHitboxHistorySubsystem* HitboxHistory = GetWorld()->GetSubsystem<UHeistHitboxHistorySubsystem>())
+	{
+		HitboxHistory->Unregister(this);
+	}
+	Super::EndPlay(EndPlayReason);
 }
 void AHeistFPSCharacter::Tick(float DeltaTime)
 {
+	HEISTFPS_LLM_SCOPE(Characters);
 	Super::Tick(DeltaTime);
-	//GEngine->AddOnScreenDebugMessage(1, 15.0f, FColor::Yellow, FString::Printf(TEXT("Normalized Direction - %f"), CurrentDirection));
-	//UE_LOG(LogTemp, Warning, TEXT("Some warning message"));
-	//FString NetMode = GEngine->GetNetMode(GetWorld()) == NM_Client ? TEXT("Client") : TEXT("Server");
-	//UE_LOG(LogTemp, Warning, TEXT("%s is running StartSprint()"), *NetMode);
 	UpdateCharacterAnimMovement(DeltaTime);
+	UpdateReplicatedAnimState();
+	UpdateProxyAnimation();
+	ResendPendingCombatState();
+	FlushPendingServerState();
+	if (IsLocallyControlled()) {
+		UpdateInteractionFocus();
+	}
+	if (!HasAuthority()) {
+		TimeSinceAnimSignificanceUpdate += DeltaTime;
+		if (TimeSinceAnimSignificanceUpdate >= AnimSignificanceInterval) {
+			TimeSinceAnimSignificanceUpdate = 0.0f;
+			UpdateAnimBudgetSignificance();
+		}
+	}
+#if !UE_BUILD_SHIPPING
+	if (DebugFloodFramesLeft > 0) {
+		DebugFloodFramesLeft--;
+		DebugFloodServerRPCs(DebugFloodCallsPerFrame);
+	}
+#endif
 }
 
 /********************************************************************
@@ -100,6 +270,8 @@ void AHeistFPSCharacter::Tick(float DeltaTime)
 *********************************************************************/
 void AHeistFPSCharacter::UpdateCharacterAnimMovement(float DeltaTime)
 {
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistUpdateCharacterAnimMovement);
+
 	if (Controller != nullptr) {
 		/********************************************************************
 					GET DELTA ROTATION FOR AUTO-ROTATION
@@ -163,21 +335,116 @@ void AHeistFPSCharacter::UpdateCharacterAnimMovement(float DeltaTime)
 	}
 }
 
+void AHeistFPSCharacter::OnAnimUpdateRateParamsCreated(FAnimUpdateRateParameters* Params)
+{
+	Params->bShouldUseLodMap = true;
+	Params->LODToFrameSkipMap.Reset();
+	for (int32 LOD = 0; LOD < AnimFramesSkippedPerLOD.Num(); LOD++)
+	{
+		Params->LODToFrameSkipMap.Add(LOD, AnimFramesSkippedPerLOD[LOD]);
+	}
+}
+
+void AHeistFPSCharacter::UpdateAnimBudgetSignificance()
+{
+	USkeletalMeshComponentBudgeted* BudgetedMesh = Cast<USkeletalMeshComponentBudgeted>(GetMesh());
+	IAnimationBudgetAllocator* Allocator = IAnimationBudgetAllocator::Get(GetWorld());
+	if (BudgetedMesh == nullptr || Allocator == nullptr || !BudgetedMesh->IsRegistered()) { return; }
+
+	// The local player's own body is never skipped
+	if (IsLocallyControlled())
+	{
+		Allocator->SetComponentSignificance(BudgetedMesh, 1.0f, true);
+		return;
+	}
+
+	APlayerController* PC = AnimSignificanceViewer.Get();
+	if (PC == nullptr)
+	{
+		PC = GetWorld()->GetFirstPlayerController();
+		AnimSignificanceViewer = PC;
+	}
+	if (PC == nullptr || PC->PlayerCameraManager == nullptr) { return; }
+
+	const float Distance = FVector::Dist(PC->PlayerCameraManager->GetCameraLocation(), GetActorLocation());
+	Allocator->SetComponentSignificance(BudgetedMesh, AnimSignificanceDistance / (AnimSignificanceDistance + Distance));
+}
+
+/********************************************************************
+				SIMULATED PROXY ANIMATION
+*********************************************************************/
+void AHeistFPSCharacter::UpdateReplicatedAnimState()
+{
+	if (!HasAuthority() || Controller == nullptr) { return; }
+
+	FHeistReplicatedAnimState NewState;
+	NewState.Speed = static_cast<uint16>(FMath::Clamp(FMath::RoundToInt(CurrentSpeed), 0, 0xFFFF));
+	NewState.Direction = FRotator::CompressAxisToShort(CurrentDirection);
+	NewState.Pitch = FRotator::CompressAxisToShort(CurrentPitch);
+	NewState.Yaw = FRotator::CompressAxisToShort(CurrentYaw);
+
+	//Only stamp and send on change, so idle characters cost nothing
+	if (!NewState.HasSameValues(AnimState)) {
+		NewState.ServerTime = GetWorld()->GetTimeSeconds();
+		AnimState = NewState;
+	}
+}
+
+void AHeistFPSCharacter::OnRep_AnimState()
+{
+	FHeistAnimSample Sample;
+	Sample.ServerTime = AnimState.ServerTime;
+	Sample.Speed = AnimState.Speed;
+	Sample.Direction = FRotator::NormalizeAxis(FRotator::DecompressAxisFromShort(AnimState.Direction));
+	Sample.Pitch = FRotator::NormalizeAxis(FRotator::DecompressAxisFromShort(AnimState.Pitch));
+	Sample.Yaw = FRotator::NormalizeAxis(FRotator::DecompressAxisFromShort(AnimState.Yaw));
+	AnimBuffer.AddSample(Sample);
+}
+
+void AHeistFPSCharacter::UpdateProxyAnimation()
+{
+	if (GetLocalRole() != ROLE_SimulatedProxy) { return; }
+
+	AGameStateBase* GameState = GetWorld()->GetGameState();
+	if (GameState == nullptr) { return; }
+
+	FHeistAnimSample Sample;
+	if (AnimBuffer.Sample(GameState->GetServerWorldTimeSeconds() - ProxyInterpolationDelay, Sample)) {
+		CurrentSpeed = Sample.Speed;
+		CurrentDirection = Sample.Direction;
+		CurrentPitch = Sample.Pitch;
+		CurrentYaw = Sample.Yaw;
+	}
+}
+
 void AHeistFPSCharacter::SpawnDefaultInventory()
 {
-	if (!HasAuthority())
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistSpawnDefaultInventory);
+	HEISTFPS_LLM_SCOPE(Weapons);
+
+	if (!HasAuthority() || bInventorySpawned)
 	{
 		return;
 	}
+	bInventorySpawned = true;
 
-	for (int32 i = 0; i < DefaultWeaponClasses.Num(); i++)
+	const TArray<TSubclassOf<AWeaponBase>>& WeaponClasses = LoadoutWeaponClasses.Num() > 0 ? LoadoutWeaponClasses : DefaultWeaponClasses;
+	for (int32 i = 0; i < WeaponClasses.Num(); i++)
 	{
-		if (DefaultWeaponClasses[i])
+		if (WeaponClasses[i])
 		{
 			FActorSpawnParameters SpawnInfo;
 			SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-			AWeaponBase* NewWeapon = GetWorld()->SpawnActor<AWeaponBase>(DefaultWeaponClasses[i], SpawnInfo);
+			SpawnInfo.Owner = this;
+			SpawnInfo.Instigator = this;
+			AWeaponBase* NewWeapon = GetWorld()->SpawnActor<AWeaponBase>(WeaponClasses[i], SpawnInfo);
 			AddWeapon(NewWeapon);
+
+			// The pool parks characters before their inventory arrives
+			if (NewWeapon != nullptr && bPooled)
+			{
+				NewWeapon->SetNetDormancy(DORM_DormantAll);
+			}
 		}
 	}
 	if (Inventory.Num() > 0)
@@ -187,6 +454,34 @@ void AHeistFPSCharacter::SpawnDefaultInventory()
 	}
 }
 
+void AHeistFPSCharacter::SetLoadout(const TArray<TSubclassOf<AWeaponBase>>& WeaponClasses)
+{
+	if (!HasAuthority() || WeaponClasses == LoadoutWeaponClasses) { return; }
+
+	LoadoutWeaponClasses = WeaponClasses;
+	if (!bInventorySpawned) { return; }
+
+	// Pooled characters already carry the default inventory - only swap it when the player picked something else
+	TArray<TSubclassOf<AWeaponBase>> CurrentClasses;
+	for (AWeaponBase* Weapon : Inventory)
+	{
+		CurrentClasses.Add(Weapon != nullptr ? Weapon->GetClass() : nullptr);
+	}
+	if (CurrentClasses == (LoadoutWeaponClasses.Num() > 0 ? LoadoutWeaponClasses : DefaultWeaponClasses)) { return; }
+
+	ApplyCombatState(false, false);
+	for (AWeaponBase* Weapon : Inventory)
+	{
+		if (Weapon != nullptr)
+		{
+			Weapon->Destroy();
+		}
+	}
+	Inventory.Reset();
+	bInventorySpawned = false;
+	SpawnDefaultInventory();
+}
+
 void AHeistFPSCharacter::AddWeapon(AWeaponBase* Weapon) {
 	if (Weapon && HasAuthority())
 	{
@@ -213,8 +508,10 @@ void AHeistFPSCharacter::SetupPlayerInputComponent(class UInputComponent* Player
 	PlayerInputComponent->BindAction("TogglePrimaryWeapon", IE_Pressed, this, &AHeistFPSCharacter::TogglePrimaryWeapon);
 	PlayerInputComponent->BindAction("FireWeapon", IE_Pressed, this, &AHeistFPSCharacter::FireWeapon);
 
-	PlayerInputComponent->BindAction("AimDownSight", IE_Pressed, this, &AHeistFPSCharacter::AimDownSight);
-	PlayerInputComponent->BindAction("AimDownSight", IE_Released, this, &AHeistFPSCharacter::AimDownSight);
+	PlayerInputComponent->BindAction("AimDownSight", IE_Pressed, this, &AHeistFPSCharacter::StartAimDownSight);
+	PlayerInputComponent->BindAction("AimDownSight", IE_Released, this, &AHeistFPSCharacter::StopAimDownSight);
+
+	PlayerInputComponent->BindAction("Interact", IE_Pressed, this, &AHeistFPSCharacter::Interact);
 
 	PlayerInputComponent->BindAction("TogglePauseMenu", IE_Pressed, this, &AHeistFPSCharacter::TogglePauseMenu);
 
@@ -264,7 +561,8 @@ void AHeistFPSCharacter::StartSprint()
 {
 	if (!HasAuthority()) {
 		GetCharacterMovement()->MaxWalkSpeed = MaxSprintSpeed;
-		ServerToggleSprint(true);
+		PendingSprint = true;
+		FlushPendingServerState();
 	}
 	else {
 		ServerToggleSprint(true);
@@ -274,7 +572,8 @@ void AHeistFPSCharacter::StopSprint()
 {
 	if (!HasAuthority()) {
 		GetCharacterMovement()->MaxWalkSpeed = MaxWalkSpeed;
-		ServerToggleSprint(false);
+		PendingSprint = false;
+		FlushPendingServerState();
 	}
 	else {
 		ServerToggleSprint(false);
@@ -284,13 +583,17 @@ bool AHeistFPSCharacter::ServerToggleSprint_Validate(bool bIsSprinting) {
 	return true;
 }
 void AHeistFPSCharacter::ServerToggleSprint_Implementation(bool bIsSprinting) {
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistServerToggleSprint);
+	UHeistNetTelemetrySubsystem::CountRPC(this, GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerToggleSprint));
+	if (!UHeistRPCLimiterSubsystem::ConsumeRPC(this, GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerToggleSprint))) {
+		//Keep the latest state and apply it once the budget refills, rather than lose it
+		PendingSprint = bIsSprinting;
+		return;
+	}
+
 	if (HasAuthority()) {
-		if (bIsSprinting) {
-			GetCharacterMovement()->MaxWalkSpeed = MaxSprintSpeed;
-		}
-		else {
-			GetCharacterMovement()->MaxWalkSpeed = MaxWalkSpeed;
-		}
+		PendingSprint.Reset();
+		GetCharacterMovement()->MaxWalkSpeed = bIsSprinting ? MaxSprintSpeed : MaxWalkSpeed;
 	}
 }
 
@@ -308,6 +611,7 @@ void AHeistFPSCharacter::LookUpAtRate(float Rate)
 
 void AHeistFPSCharacter::MoveForward(float Value)
 {
+	Value = MoveForwardSampler.Sample(Value, FPlatformTime::Seconds());
 	if ((Controller != nullptr) && (Value != 0.0f))
 	{
 		// find out which way is forward
@@ -322,12 +626,17 @@ void AHeistFPSCharacter::MoveForward(float Value)
 
 void AHeistFPSCharacter::MoveRight(float Value)
 {
+	//Changes are sent to the server, so they are never taken faster than its budget for them
+	static const FName UpdateLastMoveRightName = GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerUpdateLastMoveRight);
+	Value = MoveRightSampler.Sample(Value, FPlatformTime::Seconds(), UHeistRPCLimiterSubsystem::GetSustainedRate(this, UpdateLastMoveRightName));
 	if ((Controller != nullptr) && (Value != 0.0f))
 	{
-		LastMoveRightValue = Value;
-		if (!HasAuthority()){
-			ServerUpdateLastMoveRight(Value);
+		//Only tell the server when the value changes rather than every frame
+		if (!HasAuthority() && Value != LastMoveRightValue){
+			PendingMoveRight = Value;
+			FlushPendingServerState();
 		}
+		LastMoveRightValue = Value;
 		// find out which way is right
 		const FRotator Rotation = Controller->GetControlRotation();
 		const FRotator YawRotation(0, Rotation.Yaw, 0);
@@ -339,85 +648,614 @@ void AHeistFPSCharacter::MoveRight(float Value)
 	}
 }
 bool AHeistFPSCharacter::ServerUpdateLastMoveRight_Validate(float Value) {
-	return true;
+	//Axis input is normalized - anything else comes from a modified client
+	return FMath::IsFinite(Value) && FMath::Abs(Value) <= 1.0f + KINDA_SMALL_NUMBER;
 }
 void AHeistFPSCharacter::ServerUpdateLastMoveRight_Implementation(float Value) {
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistServerUpdateLastMoveRight);
+	UHeistNetTelemetrySubsystem::CountRPC(this, GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerUpdateLastMoveRight));
+	if (!UHeistRPCLimiterSubsystem::ConsumeRPC(this, GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerUpdateLastMoveRight))) {
+		//Keep the latest value and apply it once the budget refills, rather than lose it
+		PendingMoveRight = Value;
+		return;
+	}
+
 	if (HasAuthority()) {
+		PendingMoveRight.Reset();
 		LastMoveRightValue = Value;
 	}
 }
 
+void AHeistFPSCharacter::FlushPendingServerState()
+{
+	static const FName ToggleSprintName = GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerToggleSprint);
+	static const FName UpdateLastMoveRightName = GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerUpdateLastMoveRight);
+
+	if (HasAuthority()) {
+		//Values the limiter dropped are applied as soon as their budget allows
+		if (PendingSprint.IsSet() && UHeistRPCLimiterSubsystem::RetryRPC(this, ToggleSprintName)) {
+			GetCharacterMovement()->MaxWalkSpeed = PendingSprint.GetValue() ? MaxSprintSpeed : MaxWalkSpeed;
+			PendingSprint.Reset();
+		}
+		if (PendingMoveRight.IsSet() && UHeistRPCLimiterSubsystem::RetryRPC(this, UpdateLastMoveRightName)) {
+			LastMoveRightValue = PendingMoveRight.GetValue();
+			PendingMoveRight.Reset();
+		}
+	}
+	else if (IsLocallyControlled()) {
+		//Only the latest value is sent, and only when the server's budget has room for it
+		if (PendingSprint.IsSet() && UHeistRPCLimiterSubsystem::CanSendRPC(this, ToggleSprintName)) {
+			ServerToggleSprint(PendingSprint.GetValue());
+			PendingSprint.Reset();
+		}
+		if (PendingMoveRight.IsSet() && UHeistRPCLimiterSubsystem::CanSendRPC(this, UpdateLastMoveRightName)) {
+			ServerUpdateLastMoveRight(PendingMoveRight.GetValue());
+			PendingMoveRight.Reset();
+		}
+	}
+}
+
+/********************************************************************
+				FIRE WEAPON CLIENT & SERVER
+*********************************************************************/
 void AHeistFPSCharacter::FireWeapon() {
-	if (bCombatInitiated) {
-		Inventory[0]->SimulateWeaponFire();
+	static const FName FireWeaponName = GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerFireWeapon);
+
+	if (!bCombatInitiated || Inventory.Num() == 0 || IsDead()) {
+		return;
+	}
+	//The server drops fire calls over its budget, so a shot it would drop is never predicted or sent
+	if (!UHeistRPCLimiterSubsystem::CanSendRPC(this, FireWeaponName)) {
+		return;
+	}
+	AWeaponBase* Weapon = Inventory[0];
+	Weapon->SimulateWeaponFire();
+
+	const uint16 PackedShot = AWeaponBase::PackShot(Weapon->ConsumeShotIndex(), Weapon->GetShotEpoch(), bAimDownSight);
+	const FRotator Aim = GetBaseAimRotation();
+	const FHeistShotPattern Pattern = Weapon->GetShotPattern(AWeaponBase::UnpackShotIndex(PackedShot), bAimDownSight);
+
+	if (HasAuthority()) {
+		HandleFireWeapon(PackedShot, Aim);
+	}
+	else {
+		//Predict the round locally - the server derives the same spread from the shot index
+		UHeistProjectileSubsystem* Projectiles = GetWorld()->GetSubsystem<UHeistProjectileSubsystem>();
+		if (Projectiles != nullptr) {
+			Projectiles->SpawnProjectile(GetPawnViewLocation(), AWeaponBase::GetShotDirection(Aim, Pattern), Weapon->GetBallistics(), this, false);
+		}
+		ServerFireWeapon(PackedShot, FRotator::CompressAxisToShort(Aim.Pitch), FRotator::CompressAxisToShort(Aim.Yaw));
+	}
+
+	//Recoil is applied to the control rotation directly so it isn't scaled by input settings
+	if (IsLocallyControlled() && Controller != nullptr) {
+		Controller->SetControlRotation(Controller->GetControlRotation() + FRotator(Pattern.RecoilPitch, Pattern.RecoilYaw, 0.0f));
+	}
+}
+bool AHeistFPSCharacter::ServerFireWeapon_Validate(uint16 PackedShot, uint16 AimPitch, uint16 AimYaw) {
+	//Aim is used as sent, so a pitch the camera could never reach is a tampered client. The slack covers compression.
+	const APlayerController* PC = Cast<APlayerController>(Controller);
+	const APlayerCameraManager* CameraManager = PC != nullptr ? PC->PlayerCameraManager : nullptr;
+	const float PitchMin = CameraManager != nullptr ? CameraManager->ViewPitchMin : -90.0f;
+	const float PitchMax = CameraManager != nullptr ? CameraManager->ViewPitchMax : 90.0f;
+	const float Pitch = FRotator::NormalizeAxis(FRotator::DecompressAxisFromShort(AimPitch));
+	return Pitch >= PitchMin - 0.01f && Pitch <= PitchMax + 0.01f;
+}
+void AHeistFPSCharacter::ServerFireWeapon_Implementation(uint16 PackedShot, uint16 AimPitch, uint16 AimYaw) {
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistServerFireWeapon);
+	UHeistNetTelemetrySubsystem::CountRPC(this, GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerFireWeapon));
+	if (!UHeistRPCLimiterSubsystem::ConsumeRPC(this, GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerFireWeapon))) {
+		return;
+	}
+	if (Inventory.Num() == 0 || IsDead()) {
+		return;
+	}
+	//Drop replayed or duplicated shots, and shots from before a re-equip
+	bool bEquipped = bPrimaryEquipped;
+	const FHeistCombatStateAck PreviousAck = CombatStateAck;
+	if (!ResolveShot(PackedShot, Inventory[0], CombatStateAck, bEquipped)) {
+		return;
 	}
+	if (bEquipped != bPrimaryEquipped) {
+		ApplyCombatState(bEquipped, false);
+	}
+	//A changed ack tells the owner straight away that the server is missing its latest request, so it resends it
+	if (CombatStateAck.PackedState != PreviousAck.PackedState || CombatStateAck.ShotEpoch != PreviousAck.ShotEpoch) {
+		ForceNetUpdate();
+	}
+	Inventory[0]->SimulateWeaponFire();
+	HandleFireWeapon(PackedShot, FRotator(FRotator::DecompressAxisFromShort(AimPitch), FRotator::DecompressAxisFromShort(AimYaw), 0.0f));
+}
+void AHeistFPSCharacter::HandleFireWeapon(uint16 PackedShot, const FRotator& Aim)
+{
+	AWeaponBase* Weapon = Inventory[0];
+
+	//The client's ADS bit is only a hint - spread comes from the server's own aim state, and remote clients are sent that
+	const uint16 ShotIndex = AWeaponBase::UnpackShotIndex(PackedShot);
+	if (AWeaponBase::UnpackAimDownSight(PackedShot) != bAimDownSight) {
+		UE_LOG(LogTemp, Verbose, TEXT("%s fired shot %d with a stale ADS flag"), *GetName(), ShotIndex);
+		PackedShot = AWeaponBase::PackShot(ShotIndex, AWeaponBase::UnpackShotEpoch(PackedShot), bAimDownSight);
+	}
+	const FHeistShotPattern Pattern = Weapon->GetShotPattern(ShotIndex, bAimDownSight);
+
+	UHeistProjectileSubsystem* Projectiles = GetWorld()->GetSubsystem<UHeistProjectileSubsystem>();
+	if (Projectiles != nullptr) {
+		Projectiles->SpawnProjectile(GetPawnViewLocation(), AWeaponBase::GetShotDirection(Aim, Pattern), Weapon->GetBallistics(), this, true);
+	}
+	Weapon->MulticastFire(PackedShot, FRotator::CompressAxisToShort(Aim.Pitch), FRotator::CompressAxisToShort(Aim.Yaw));
 }
 
 /********************************************************************
-				TOGGLE PRIMARY WEAPON CLIENT & SERVER
+				INTERACTION
 *********************************************************************/
-void AHeistFPSCharacter::TogglePrimaryWeapon()
+void AHeistFPSCharacter::UpdateInteractionFocus()
 {
-	if (!HasAuthority()) {
-		ServerTogglePrimaryWeapon(!bPrimaryEquipped);
+	UHeistInteractionSubsystem* Interaction = GetWorld()->GetSubsystem<UHeistInteractionSubsystem>();
+	if (Interaction == nullptr || IsDead()) {
+		FocusedInteractable = nullptr;
+		return;
+	}
+	FocusedInteractable = Interaction->FindInteractable(GetPawnViewLocation(), GetBaseAimRotation().Vector());
+}
+
+void AHeistFPSCharacter::Interact()
+{
+	if (FocusedInteractable != nullptr) {
+		ServerInteract(FocusedInteractable);
 	}
-	if (!bPrimaryEquipped)
+}
+
+bool AHeistFPSCharacter::ServerInteract_Validate(AHeistInteractable* Target) {
+	return Target != nullptr;
+}
+void AHeistFPSCharacter::ServerInteract_Implementation(AHeistInteractable* Target) {
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistServerInteract);
+	UHeistNetTelemetrySubsystem::CountRPC(this, GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerInteract));
+	if (!UHeistRPCLimiterSubsystem::ConsumeRPC(this, GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerInteract))) {
+		return;
+	}
+
+	UHeistInteractionSubsystem* Interaction = GetWorld()->GetSubsystem<UHeistInteractionSubsystem>();
+	//A target destroyed earlier this frame still resolves from the RPC, so reject pending kill actors too
+	if (!IsValid(Target) || IsDead() || Interaction == nullptr || !Interaction->IsInRange(this, Target)) {
+		return;
+	}
+	Target->Interact(this);
+}
+
+/********************************************************************
+				HEALTH AND DEATH
+*********************************************************************/
+float AHeistFPSCharacter::GetHealth() const
+{
+	return HasAuthority() ? Health : HealthState.Health * MaxHealth / MAX_uint8;
+}
+
+float AHeistFPSCharacter::GetArmor() const
+{
+	return HasAuthority() ? Armor : HealthState.Armor * MaxArmor / MAX_uint8;
+}
+
+void AHeistFPSCharacter::SetHealthAndArmor(float NewHealth, float NewArmor)
+{
+	//Damage brings a simplified character back to full movement so it can react
+	if (NewHealth < Health)
 	{
-		Inventory[0]->SetActorHiddenInGame(false);
+		if (UHeistCharacterMovementComponent* Movement = Cast<UHeistCharacterMovementComponent>(GetCharacterMovement()))
+		{
+			Movement->WakeUp();
+		}
 	}
-	else {
-		Inventory[0]->SetActorHiddenInGame(true);
+
+	Health = FMath::Clamp(NewHealth, 0.0f, MaxHealth);
+	Armor = FMath::Clamp(NewArmor, 0.0f, MaxArmor);
+
+	//Rounded up so a character with any health left never reads as dead
+	FHeistHealthState NewState;
+	NewState.Health = Health > 0.0f ? static_cast<uint8>(FMath::Clamp(FMath::CeilToInt(Health / MaxHealth * MAX_uint8), 1, 255)) : 0;
+	NewState.Armor = static_cast<uint8>(FMath::Clamp(FMath::CeilToInt(Armor / FMath::Max(MaxArmor, 1.0f) * MAX_uint8), 0, 255));
+	if (NewState.Health != HealthState.Health || NewState.Armor != HealthState.Armor)
+	{
+		HealthState = NewState;
+		ForceNetUpdate();
 	}
-	bCombatInitiated = !bCombatInitiated;
-	bPrimaryEquipped = !bPrimaryEquipped;
 }
-bool AHeistFPSCharacter::ServerTogglePrimaryWeapon_Validate(bool IsEquipping) {
-	return true;
+
+void AHeistFPSCharacter::Die()
+{
+	if (!HasAuthority()) { return; }
+
+	SetHealthAndArmor(0.0f, Armor);
+	PlayDeath();
+	DetachFromControllerPendingDestroy();
+	SetLifeSpan(DeathLifeSpan);
 }
-void AHeistFPSCharacter::ServerTogglePrimaryWeapon_Implementation(bool IsEquipping) {
-	if (HasAuthority()) {
-		bCombatInitiated = IsEquipping;
-		bPrimaryEquipped = IsEquipping;
-		if (IsEquipping)
+
+void AHeistFPSCharacter::OnRep_HealthState()
+{
+	if (IsDead())
+	{
+		PlayDeath();
+	}
+	else
+	{
+		RestoreFromDeath();
+	}
+}
+
+void AHeistFPSCharacter::PlayDeath()
+{
+	bPlayedDeath = true;
+	GetCharacterMovement()->StopMovementImmediately();
+	GetCharacterMovement()->DisableMovement();
+	GetCapsuleComponent()->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+
+	USkeletalMeshComponent* CharacterMesh = GetMesh();
+	if (CharacterMesh != nullptr && CharacterMesh->GetPhysicsAsset() != nullptr)
+	{
+		CharacterMesh->SetCollisionProfileName(TEXT("Ragdoll"));
+		CharacterMesh->SetSimulatePhysics(true);
+	}
+}
+
+void AHeistFPSCharacter::RestoreFromDeath()
+{
+	if (!bPlayedDeath) { return; }
+	bPlayedDeath = false;
+
+	USkeletalMeshComponent* CharacterMesh = GetMesh();
+	if (CharacterMesh != nullptr && CharacterMesh->IsSimulatingPhysics())
+	{
+		CharacterMesh->SetSimulatePhysics(false);
+		CharacterMesh->SetCollisionProfileName(MeshCollisionProfile);
+		CharacterMesh->AttachToComponent(GetCapsuleComponent(), FAttachmentTransformRules::SnapToTargetNotIncludingScale);
+		CharacterMesh->SetRelativeTransform(MeshRelativeTransform);
+	}
+	GetCapsuleComponent()->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+	GetCharacterMovement()->SetMovementMode(MOVE_Walking);
+}
+
+void AHeistFPSCharacter::DeactivateForPool()
+{
+	if (!HasAuthority()) { return; }
+
+	bPooled = true;
+	SetLifeSpan(0.0f);
+	RestoreFromDeath();
+	ApplyCombatState(false, false);
+
+	SetActorHiddenInGame(true);
+	GetCapsuleComponent()->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	GetCharacterMovement()->StopMovementImmediately();
+	GetCharacterMovement()->DisableMovement();
+	SetActorTickEnabled(false);
+	GetMesh()->SetComponentTickEnabled(false);
+
+	// Dormant straight away - the channel still sends the hidden state and waits for it to be acked before it closes,
+	// so clients keep the parked actor hidden at no further bandwidth cost
+	SetNetDormancy(DORM_DormantAll);
+	for (AWeaponBase* Weapon : Inventory)
+	{
+		if (Weapon != nullptr)
 		{
-			Inventory[0]->SetActorHiddenInGame(false);
+			Weapon->SetNetDormancy(DORM_DormantAll);
 		}
-		else {
-			Inventory[0]->SetActorHiddenInGame(true);
+	}
+}
+
+void AHeistFPSCharacter::ActivateFromPool(const FTransform& Transform)
+{
+	if (!HasAuthority()) { return; }
+
+	bPooled = false;
+	SetNetDormancy(DORM_Awake);
+	for (AWeaponBase* Weapon : Inventory)
+	{
+		if (Weapon != nullptr)
+		{
+			Weapon->SetNetDormancy(DORM_Awake);
 		}
 	}
+	SetActorLocationAndRotation(Transform.GetLocation(), Transform.Rotator(), false, nullptr, ETeleportType::ResetPhysics);
+	SetActorHiddenInGame(false);
+	GetCapsuleComponent()->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+	GetCharacterMovement()->SetMovementMode(MOVE_Walking);
+	SetActorTickEnabled(true);
+	GetMesh()->SetComponentTickEnabled(true);
+	SetHealthAndArmor(MaxHealth, StartingArmor);
+}
+
+void AHeistFPSCharacter::PossessedBy(AController* NewController)
+{
+	Super::PossessedBy(NewController);
+	ResetForPossession();
+}
+
+void AHeistFPSCharacter::PawnClientRestart()
+{
+	Super::PawnClientRestart();
+	if (!HasAuthority()) {
+		ResetForPossession();
+	}
+}
+
+void AHeistFPSCharacter::ResetForPossession()
+{
+	//Pooled characters carry whatever their last owner left, which the new owner's sequences would be compared against
+	CombatStateAck = FHeistCombatStateAck();
+	LocalCombatSequence = 0;
+	LastCombatStateSendTime = 0.0f;
+	for (AWeaponBase* Weapon : Inventory) {
+		if (Weapon != nullptr) {
+			Weapon->ResetShotSequence();
+		}
+	}
+
+	//Stamped now so simulated proxies take the reset as a newer sample than the last one they had
+	AnimState = FHeistReplicatedAnimState();
+	if (HasAuthority()) {
+		AnimState.ServerTime = GetWorld()->GetTimeSeconds();
+	}
+	AnimBuffer.Reset();
+
+	LastMoveRightValue = 1.0f;
+	MoveForwardSampler.Reset();
+	MoveRightSampler.Reset();
+	PendingSprint.Reset();
+	PendingMoveRight.Reset();
 }
 
 /********************************************************************
-				AIMDOWNSIGHT CLIENT & SERVER
+				PREDICTED COMBAT STATE CLIENT & SERVER
 *********************************************************************/
-void AHeistFPSCharacter::AimDownSight()
+void AHeistFPSCharacter::TogglePrimaryWeapon()
 {
-	if (!bCombatInitiated) { return; }
+	SetCombatState(!bPrimaryEquipped, false);
+}
 
+void AHeistFPSCharacter::StartAimDownSight()
+{
+	if (!bPrimaryEquipped) { return; }
+	SetCombatState(true, true);
+}
+
+void AHeistFPSCharacter::StopAimDownSight()
+{
+	if (!bAimDownSight) { return; }
+	SetCombatState(bPrimaryEquipped, false);
+}
+
+void AHeistFPSCharacter::SetCombatState(bool bEquipped, bool bADS)
+{
+	if (Inventory.Num() == 0) { return; }
+
+	//Predict locally - the server gets the full desired state so a lost or reordered message is harmless
+	ApplyCombatState(bEquipped, bADS);
 	if (!HasAuthority()) {
-		ServerAimDownSight();
+		LocalCombatSequence++;
+		SendCombatState();
 	}
-	bAimDownSight = !bAimDownSight;
+}
+
+void AHeistFPSCharacter::SendCombatState()
+{
+	LastCombatStateSendTime = GetWorld()->GetTimeSeconds();
+	const uint8 ShotEpoch = Inventory.Num() > 0 ? Inventory[0]->GetShotEpoch() : 0;
+	ServerSetCombatState(PackCombatState(bPrimaryEquipped, bAimDownSight) | (ShotEpoch << 2), LocalCombatSequence);
+}
+
+void AHeistFPSCharacter::ApplyCombatState(bool bEquipped, bool bADS)
+{
+	//ADS needs the weapon out
+	bADS = bADS && bEquipped;
+
+	if (bEquipped != bPrimaryEquipped && Inventory.Num() > 0) {
+		Inventory[0]->SetActorHiddenInGame(!bEquipped);
+		if (bEquipped && IsLocallyControlled()) {
+			//Each equip by whoever fires starts a new shot epoch. Requests and shots carry it, so the server
+			//moves to it without relying on seeing this edge - a lost unequip and re-equip collapse into no edge at all.
+			Inventory[0]->StartShotEpoch();
+		}
+	}
+	bCombatInitiated = bEquipped;
+	bPrimaryEquipped = bEquipped;
+
+	if (bADS != bAimDownSight) {
+		bAimDownSight = bADS;
+		UpdateAimDownSightCamera();
+	}
+}
+
+void AHeistFPSCharacter::UpdateAimDownSightCamera()
+{
+	APlayerController* PC = Cast<APlayerController>(Controller);
+	if (PC == nullptr || !PC->IsLocalController() || Inventory.Num() == 0) { return; }
 
 	if (bAimDownSight) {
 		FPSCamera->Activate(false);
 		Inventory[0]->GetADSCamera()->Activate(true);
-		APlayerController* PC = UGameplayStatics::GetPlayerController(this, 0);
 		PC->SetViewTargetWithBlend(Inventory[0], 0.25f);
 	}
 	else {
 		FPSCamera->Activate(true);
 		Inventory[0]->GetADSCamera()->Activate(false);
-		APlayerController* PC = UGameplayStatics::GetPlayerController(this, 0);
 		PC->SetViewTargetWithBlend(this, 0.25f);
 	}
 }
-bool AHeistFPSCharacter::ServerAimDownSight_Validate() {
+
+void AHeistFPSCharacter::ResendPendingCombatState()
+{
+	//Unreliable requests are repeated until the server acknowledges the latest sequence
+	if (!IsLocallyControlled() || HasAuthority() || CombatStateAck.Sequence == LocalCombatSequence) { return; }
+	if (GetWorld()->GetTimeSeconds() - LastCombatStateSendTime >= CombatStateResendInterval) {
+		SendCombatState();
+	}
+}
+
+void AHeistFPSCharacter::OnRep_CombatStateAck()
+{
+	//An ack for an older request means the latest one was lost or is still on its way - resend it now rather than
+	//waiting out the resend interval. Duplicates are dropped by their sequence.
+	if (CombatStateAck.Sequence != LocalCombatSequence) {
+		if (IsLocallyControlled() && !HasAuthority()) {
+			SendCombatState();
+		}
+		return;
+	}
+
+	//The server has seen our latest request - adopt its result if it disagreed
+	const uint8 LocalState = PackCombatState(bPrimaryEquipped, bAimDownSight);
+	if ((CombatStateAck.PackedState & 3) != LocalState) {
+		ApplyCombatState((CombatStateAck.PackedState & 1) != 0, (CombatStateAck.PackedState & 2) != 0);
+	}
+
+	//Take the server's shot epoch if it is ahead of ours. If ours is ahead, our next shot moves the server on.
+	if (bPrimaryEquipped && Inventory.Num() > 0 && Inventory[0]->IsNewerShotEpoch(CombatStateAck.ShotEpoch)) {
+		Inventory[0]->ResetShotSequence(CombatStateAck.ShotEpoch);
+	}
+}
+
+bool AHeistFPSCharacter::ServerSetCombatState_Validate(uint8 PackedState, uint8 Sequence) {
+	//Two state bits and the 4 bit shot epoch
+	return (PackedState & ~0x3F) == 0;
+}
+void AHeistFPSCharacter::ServerSetCombatState_Implementation(uint8 PackedState, uint8 Sequence) {
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistServerSetCombatState);
+	UHeistNetTelemetrySubsystem::CountRPC(this, GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerSetCombatState));
+	if (!UHeistRPCLimiterSubsystem::ConsumeRPC(this, GET_FUNCTION_NAME_CHECKED(AHeistFPSCharacter, ServerSetCombatState))) {
+		return;
+	}
+
+	bool bEquipped = false;
+	bool bADS = false;
+	if (!ResolveCombatStateRequest(PackedState, Sequence, Inventory.Num() > 0 ? Inventory[0] : nullptr, CombatStateAck, bEquipped, bADS)) {
+		return;
+	}
+	ApplyCombatState(bEquipped, bADS);
+	ForceNetUpdate();
+}
+
+bool AHeistFPSCharacter::ResolveCombatStateRequest(uint8 PackedState, uint8 Sequence, AWeaponBase* Weapon, FHeistCombatStateAck& Ack, bool& bOutEquipped, bool& bOutADS)
+{
+	//Ignore duplicates and requests older than one already applied
+	if (static_cast<int8>(Sequence - Ack.Sequence) <= 0) {
+		return false;
+	}
+
+	//ADS needs the weapon out
+	bOutEquipped = (PackedState & 1) != 0;
+	bOutADS = (PackedState & 2) != 0 && bOutEquipped;
+
+	//The epoch only widens what counts as a newer shot - moving the sequence here would drop the shots of the
+	//previous equip that are still on their way
+	if (Weapon != nullptr) {
+		Weapon->ExtendShotEpochHorizon(PackedState >> 2);
+	}
+	Ack.PackedState = PackCombatState(bOutEquipped, bOutADS);
+	Ack.Sequence = Sequence;
+	Ack.ShotEpoch = Weapon != nullptr ? Weapon->GetShotEpoch() : 0;
 	return true;
 }
-void AHeistFPSCharacter::ServerAimDownSight_Implementation(){
-	if (HasAuthority()) {
-		bAimDownSight = !bAimDownSight;
+
+bool AHeistFPSCharacter::ResolveShot(uint16 PackedShot, AWeaponBase* Weapon, FHeistCombatStateAck& Ack, bool& bInOutEquipped)
+{
+	if (Weapon == nullptr) {
+		return false;
 	}
-}
\ No newline at end of file
+
+	//Unequipped, a shot past every epoch we have heard of was fired after an equip that has not arrived, and implies it.
+	//One from an epoch we know was fired before the unequip that overtook it.
+	const bool bImpliesEquip = !bInOutEquipped && Weapon->IsBeyondShotEpochHorizon(AWeaponBase::UnpackShotEpoch(PackedShot));
+	if (!Weapon->AcceptShot(PackedShot)) {
+		return false;
+	}
+	if (bImpliesEquip) {
+		bInOutEquipped = true;
+		Ack.PackedState = PackCombatState(true, false);
+	}
+	Ack.ShotEpoch = Weapon->GetShotEpoch();
+	return true;
+}
+
+/********************************************************************
+				SYNTHETIC RPC FLOOD
+*********************************************************************/
+void AHeistFPSCharacter::ClientDebugFloodServerRPCs_Implementation(int32 CallsPerFrame, int32 Frames)
+{
+#if !UE_BUILD_SHIPPING
+	//Flooded from Tick, so the calls cross the real connection the way a misbehaving client's would
+	DebugFloodCallsPerFrame = CallsPerFrame;
+	DebugFloodFramesLeft = Frames;
+#endif
+}
+
+#if !UE_BUILD_SHIPPING
+//Fire and interact are reliable, and more unacked reliable calls than the channel buffers would close the connection
+static const int32 MaxFloodReliableCallsPerFrame = 32;
+
+void AHeistFPSCharacter::DebugFloodServerRPCs(int32 Count)
+{
+	AHeistInteractable* InteractTarget = FocusedInteractable;
+	if (InteractTarget == nullptr)
+	{
+		TActorIterator<AHeistInteractable> It(GetWorld());
+		InteractTarget = It ? *It : nullptr;
+	}
+	AWeaponBase* Weapon = Inventory.Num() > 0 ? Inventory[0] : nullptr;
+	const FRotator Aim = GetBaseAimRotation();
+
+	for (int32 i = 0; i < Count; i++)
+	{
+		ServerToggleSprint((i & 1) == 0);
+		ServerUpdateLastMoveRight((i & 1) == 0 ? 1.0f : -1.0f);
+		if (i < MaxFloodReliableCallsPerFrame)
+		{
+			if (Weapon != nullptr)
+			{
+				ServerFireWeapon(AWeaponBase::PackShot(Weapon->ConsumeShotIndex(), Weapon->GetShotEpoch(), false), FRotator::CompressAxisToShort(Aim.Pitch), FRotator::CompressAxisToShort(Aim.Yaw));
+			}
+			if (InteractTarget != nullptr)
+			{
+				ServerInteract(InteractTarget);
+			}
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs HeistFloodRPCsCommand(
+	TEXT("heist.Net.FloodRPCs"),
+	TEXT("heist.Net.FloodRPCs [Count=1000] - sends Count sprint and move RPCs, and up to 32 fire and interact RPCs, from the local character this frame to test the server rate limiter."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		APlayerController* PC = World != nullptr ? World->GetFirstPlayerController() : nullptr;
+		AHeistFPSCharacter* Character = PC != nullptr ? Cast<AHeistFPSCharacter>(PC->GetPawn()) : nullptr;
+		if (Character != nullptr)
+		{
+			Character->DebugFloodServerRPCs(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs HeistFloodTestCommand(
+	TEXT("heist.Net.FloodTest"),
+	TEXT("heist.Net.FloodTest [CallsPerFrame=1000] [Frames=300] - server only. Has every remote player flood sprint, move, fire and interact RPCs over its connection each frame and logs whether the server held its frame budget."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UHeistRPCLimiterSubsystem* Limiter = World != nullptr && World->GetNetMode() != NM_Client ? World->GetSubsystem<UHeistRPCLimiterSubsystem>() : nullptr;
+		if (Limiter == nullptr) { return; }
+
+		const int32 CallsPerFrame = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+		const int32 Frames = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 300;
+
+		//The remote clients send the calls themselves, so the server measures receiving, validating and limiting them
+		for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+		{
+			APlayerController* PC = It->Get();
+			AHeistFPSCharacter* Character = PC != nullptr && !PC->IsLocalController() ? Cast<AHeistFPSCharacter>(PC->GetPawn()) : nullptr;
+			if (Character != nullptr)
+			{
+				Character->ClientDebugFloodServerRPCs(CallsPerFrame, Frames);
+			}
+		}
+		Limiter->StartFloodTest([]() {}, Frames);
+	}));
+#endif
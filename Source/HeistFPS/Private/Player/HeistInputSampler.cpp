@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Player/HeistInputSampler.h"
+#include "HeistFPS.h"
+
+#include "HAL/IConsoleManager.h"
+
+static float GHeistInputSampleRate = 60.0f;
+static FAutoConsoleVariableRef CVarHeistInputSampleRate(
+	TEXT("heist.Input.SampleRate"),
+	GHeistInputSampleRate,
+	TEXT("Rate in Hz that movement input is sampled at, independent of frame rate. 0 applies every frame's input as read (for comparison), except on axes capped to an RPC budget."));
+
+float FHeistAxisSampler::GetSamplePeriod(float MaxRate)
+{
+	const float Period = GHeistInputSampleRate > 0.0f ? 1.0f / GHeistInputSampleRate : 0.0f;
+	return MaxRate > 0.0f ? FMath::Max(Period, 1.0f / MaxRate) : Period;
+}
+
+float FHeistAxisSampler::Sample(float RawValue, double Time, float MaxRate)
+{
+	const float SamplePeriod = GetSamplePeriod(MaxRate);
+	if (SamplePeriod <= 0.0f)
+	{
+		HeldValue = RawValue;
+		SampleTime = Time;
+		return HeldValue;
+	}
+
+	const float Snapped = FMath::Clamp(FMath::GridSnap(RawValue, Quantum), -1.0f, 1.0f);
+
+	//A key press or release shows up as a sign change or a digital value and is never delayed
+	const bool bDirectionChanged = FMath::Sign(Snapped) != FMath::Sign(HeldValue);
+	const bool bDigital = Snapped == 0.0f || FMath::Abs(Snapped) == 1.0f;
+	if (bDirectionChanged || (bDigital && Snapped != HeldValue) || Time - SampleTime >= SamplePeriod)
+	{
+		HeldValue = Snapped;
+		SampleTime = Time;
+	}
+	return HeldValue;
+}
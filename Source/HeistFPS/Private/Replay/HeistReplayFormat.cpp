@@ -0,0 +1,586 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Replay/HeistReplayFormat.h"
+
+#include "Player/HeistFPSCharacter.h"
+#include "Weapon/WeaponBase.h"
+
+#include "Algo/BinarySearch.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFilemanager.h"
+
+/********************************************************************
+				CHARACTER STATE
+*********************************************************************/
+FHeistReplayCharacterState FHeistReplayCharacterState::FromCharacter(const AHeistFPSCharacter& Character)
+{
+	const FVector Location = Character.GetActorLocation();
+
+	FHeistReplayCharacterState State;
+	State.LocationX = FMath::RoundToInt(Location.X);
+	State.LocationY = FMath::RoundToInt(Location.Y);
+	State.LocationZ = FMath::RoundToInt(Location.Z);
+	State.Yaw = FRotator::CompressAxisToShort(Character.GetActorRotation().Yaw);
+	State.AimPitch = FRotator::CompressAxisToShort(Character.CurrentPitch);
+	State.AimYaw = FRotator::CompressAxisToShort(Character.CurrentYaw);
+	State.Direction = FRotator::CompressAxisToShort(Character.CurrentDirection);
+	State.Speed = static_cast<uint16>(FMath::Clamp(FMath::RoundToInt(Character.CurrentSpeed), 0, 0xFFFF));
+	State.Flags = (Character.bIsCrouched ? Crouched : 0)
+		| (Character.bCombatInitiated ? CombatInitiated : 0)
+		| (Character.bPrimaryEquipped ? PrimaryEquipped : 0)
+		| (Character.bAimDownSight ? AimDownSight : 0)
+		| (Character.LastMoveRightValue < 0.0f ? MoveRightNegative : 0);
+	return State;
+}
+
+void FHeistReplayCharacterState::ApplyToCharacter(AHeistFPSCharacter& Character) const
+{
+	const FVector Location(LocationX, LocationY, LocationZ);
+	const FRotator Rotation(0.0f, FRotator::DecompressAxisFromShort(Yaw), 0.0f);
+	Character.SetActorLocationAndRotation(Location, Rotation);
+
+	Character.CurrentPitch = FRotator::NormalizeAxis(FRotator::DecompressAxisFromShort(AimPitch));
+	Character.CurrentYaw = FRotator::NormalizeAxis(FRotator::DecompressAxisFromShort(AimYaw));
+	Character.CurrentDirection = FRotator::NormalizeAxis(FRotator::DecompressAxisFromShort(Direction));
+	Character.CurrentSpeed = Speed;
+	Character.LastMoveRightValue = (Flags & MoveRightNegative) != 0 ? -1.0f : 1.0f;
+	Character.bIsCrouched = (Flags & Crouched) != 0;
+	Character.bCombatInitiated = (Flags & CombatInitiated) != 0;
+	Character.bAimDownSight = (Flags & AimDownSight) != 0;
+
+	const bool bEquipped = (Flags & PrimaryEquipped) != 0;
+	if (bEquipped != Character.bPrimaryEquipped && Character.Inventory.Num() > 0)
+	{
+		Character.Inventory[0]->SetActorHiddenInGame(!bEquipped);
+	}
+	Character.bPrimaryEquipped = bEquipped;
+}
+
+uint8 FHeistReplayCharacterState::DiffMask(const FHeistReplayCharacterState& Other) const
+{
+	uint8 Mask = 0;
+	if (LocationX != Other.LocationX || LocationY != Other.LocationY || LocationZ != Other.LocationZ) { Mask |= FieldLocation; }
+	if (Yaw != Other.Yaw) { Mask |= FieldYaw; }
+	if (AimPitch != Other.AimPitch || AimYaw != Other.AimYaw) { Mask |= FieldAim; }
+	if (Speed != Other.Speed) { Mask |= FieldSpeed; }
+	if (Direction != Other.Direction) { Mask |= FieldDirection; }
+	if (Flags != Other.Flags) { Mask |= FieldFlags; }
+	return Mask;
+}
+
+/********************************************************************
+				ENCODER
+*********************************************************************/
+void FHeistReplayEncoder::WriteHeader(const FHeistReplayHeader& Header)
+{
+	WriteRaw<uint32>(HeistReplay::HeaderMagic);
+	WriteRaw<uint32>(HeistReplay::Version);
+	WriteRaw<float>(Header.SampleRate);
+	WriteRaw<float>(Header.KeyframeInterval);
+	WriteRaw<int64>(Header.StartTimeTicks);
+	WriteString(Header.MapName);
+	WriteString(Header.URL);
+}
+
+void FHeistReplayEncoder::WriteFrame(uint32 TimeMs, const TArray<TPair<uint16, FHeistReplayCharacterState>>& States, bool bKeyframe)
+{
+	if (bKeyframe)
+	{
+		Keyframes.Add({ TimeMs, GetOffset() });
+		WriteRecordStart(EHeistReplayRecord::Keyframe, TimeMs);
+		WriteVarUInt(States.Num());
+		for (const TPair<uint16, FHeistReplayCharacterState>& Pair : States)
+		{
+			//Keyframes are deltas against a zeroed state so the reader needs no history
+			WriteCharacter(Pair.Key, Pair.Value, FHeistReplayCharacterState(), FHeistReplayCharacterState::FieldAll);
+			Baselines.Add(Pair.Key, Pair.Value);
+		}
+
+		//Names too, since a reader starting here never sees the CharacterAdded records before it
+		WriteVarUInt(Names.Num());
+		for (const TPair<uint16, FString>& Pair : Names)
+		{
+			WriteVarUInt(Pair.Key);
+			WriteString(Pair.Value);
+		}
+		return;
+	}
+
+	//Count changed characters first so the record can be skipped entirely when nothing moved
+	int32 NumChanged = 0;
+	for (const TPair<uint16, FHeistReplayCharacterState>& Pair : States)
+	{
+		const FHeistReplayCharacterState* Baseline = Baselines.Find(Pair.Key);
+		if (Baseline == nullptr || Pair.Value.DiffMask(*Baseline) != 0)
+		{
+			NumChanged++;
+		}
+	}
+	if (NumChanged == 0) { return; }
+
+	WriteRecordStart(EHeistReplayRecord::Frame, TimeMs);
+	WriteVarUInt(NumChanged);
+	for (const TPair<uint16, FHeistReplayCharacterState>& Pair : States)
+	{
+		FHeistReplayCharacterState& Baseline = Baselines.FindOrAdd(Pair.Key);
+		const uint8 Mask = Pair.Value.DiffMask(Baseline);
+		if (Mask != 0)
+		{
+			WriteCharacter(Pair.Key, Pair.Value, Baseline, Mask);
+			Baseline = Pair.Value;
+		}
+	}
+}
+
+void FHeistReplayEncoder::WriteShot(uint32 TimeMs, const FHeistReplayShot& Shot)
+{
+	WriteRecordStart(EHeistReplayRecord::Shot, TimeMs);
+	WriteVarUInt(Shot.CharacterId);
+	WriteRaw<uint16>(Shot.PackedShot);
+	WriteRaw<uint16>(Shot.AimPitch);
+	WriteRaw<uint16>(Shot.AimYaw);
+}
+
+void FHeistReplayEncoder::WriteCharacterAdded(uint32 TimeMs, uint16 CharacterId, const FString& Name)
+{
+	WriteRecordStart(EHeistReplayRecord::CharacterAdded, TimeMs);
+	WriteVarUInt(CharacterId);
+	WriteString(Name);
+	Names.Add(CharacterId, Name);
+}
+
+void FHeistReplayEncoder::WriteCharacterRemoved(uint32 TimeMs, uint16 CharacterId)
+{
+	WriteRecordStart(EHeistReplayRecord::CharacterRemoved, TimeMs);
+	WriteVarUInt(CharacterId);
+	Baselines.Remove(CharacterId);
+	Names.Remove(CharacterId);
+}
+
+void FHeistReplayEncoder::WriteFooter(uint32 DurationMs)
+{
+	const uint64 IndexOffset = GetOffset();
+	WriteRaw<uint32>(Keyframes.Num());
+	for (const FHeistReplayKeyframe& Keyframe : Keyframes)
+	{
+		WriteRaw<uint32>(Keyframe.TimeMs);
+		WriteRaw<uint64>(Keyframe.Offset);
+	}
+	WriteRaw<uint64>(IndexOffset);
+	WriteRaw<uint32>(DurationMs);
+	WriteRaw<uint32>(HeistReplay::FooterMagic);
+}
+
+TArray<uint8> FHeistReplayEncoder::TakeChunk()
+{
+	BaseOffset += Buffer.Num();
+	TArray<uint8> Chunk = MoveTemp(Buffer);
+	Buffer.Reset(Chunk.Num());
+	return Chunk;
+}
+
+void FHeistReplayEncoder::WriteRecordStart(EHeistReplayRecord Type, uint32 TimeMs)
+{
+	WriteRaw<uint8>(static_cast<uint8>(Type));
+	WriteVarUInt(Type == EHeistReplayRecord::Keyframe ? TimeMs : TimeMs - LastTimeMs);
+	LastTimeMs = TimeMs;
+}
+
+void FHeistReplayEncoder::WriteCharacter(uint16 CharacterId, const FHeistReplayCharacterState& State, const FHeistReplayCharacterState& Baseline, uint8 Mask)
+{
+	WriteVarUInt(CharacterId);
+	WriteRaw<uint8>(Mask);
+
+	//Angles wrap, so their deltas are taken in 16 bits
+	if (Mask & FHeistReplayCharacterState::FieldLocation)
+	{
+		WriteVarInt(State.LocationX - Baseline.LocationX);
+		WriteVarInt(State.LocationY - Baseline.LocationY);
+		WriteVarInt(State.LocationZ - Baseline.LocationZ);
+	}
+	if (Mask & FHeistReplayCharacterState::FieldYaw)
+	{
+		WriteVarInt(static_cast<int16>(State.Yaw - Baseline.Yaw));
+	}
+	if (Mask & FHeistReplayCharacterState::FieldAim)
+	{
+		WriteVarInt(static_cast<int16>(State.AimPitch - Baseline.AimPitch));
+		WriteVarInt(static_cast<int16>(State.AimYaw - Baseline.AimYaw));
+	}
+	if (Mask & FHeistReplayCharacterState::FieldSpeed)
+	{
+		WriteVarInt(State.Speed - Baseline.Speed);
+	}
+	if (Mask & FHeistReplayCharacterState::FieldDirection)
+	{
+		WriteVarInt(static_cast<int16>(State.Direction - Baseline.Direction));
+	}
+	if (Mask & FHeistReplayCharacterState::FieldFlags)
+	{
+		WriteRaw<uint8>(State.Flags);
+	}
+}
+
+void FHeistReplayEncoder::WriteVarUInt(uint32 Value)
+{
+	while (Value >= 0x80)
+	{
+		Buffer.Add(static_cast<uint8>(Value | 0x80));
+		Value >>= 7;
+	}
+	Buffer.Add(static_cast<uint8>(Value));
+}
+
+void FHeistReplayEncoder::WriteVarInt(int32 Value)
+{
+	//Zigzag so small negative deltas stay small
+	WriteVarUInt((static_cast<uint32>(Value) << 1) ^ static_cast<uint32>(Value >> 31));
+}
+
+void FHeistReplayEncoder::WriteString(const FString& Value)
+{
+	FTCHARToUTF8 Utf8(*Value);
+	WriteVarUInt(Utf8.Length());
+	Buffer.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+}
+
+/********************************************************************
+				READER
+*********************************************************************/
+FHeistReplayReader::FHeistReplayReader()
+{
+}
+
+FHeistReplayReader::~FHeistReplayReader()
+{
+	Close();
+}
+
+bool FHeistReplayReader::Open(const FString& Path)
+{
+	Close();
+
+	MappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Path));
+	if (!MappedFile.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("HeistReplay: could not map %s."), *Path);
+		return false;
+	}
+
+	const int64 FileSize = MappedFile->GetFileSize();
+	MappedRegion.Reset(MappedFile->MapRegion(0, FileSize));
+	if (!MappedRegion.IsValid())
+	{
+		Close();
+		return false;
+	}
+	Data = MappedRegion->GetMappedPtr();
+	RecordsEnd = FileSize;
+
+	if (!ReadHeader())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("HeistReplay: %s is not a complete replay."), *Path);
+		Close();
+		return false;
+	}
+	if (!ReadIndex(FileSize))
+	{
+		if (!ScanForKeyframes(FileSize))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("HeistReplay: %s is not a complete replay."), *Path);
+			Close();
+			return false;
+		}
+		UE_LOG(LogTemp, Warning, TEXT("HeistReplay: %s has no index - recovered %d keyframes and %u ms by scanning its records."), *Path, Keyframes.Num(), DurationMs);
+	}
+	return SeekTo(0);
+}
+
+void FHeistReplayReader::Close()
+{
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	Data = nullptr;
+	Keyframes.Reset();
+	States.Reset();
+	Names.Reset();
+	CurrentTimeMs = 0;
+	LastRecordTimeMs = 0;
+}
+
+bool FHeistReplayReader::ReadHeader()
+{
+	Cursor = 0;
+	bReadPastEnd = false;
+	if (ReadRaw<uint32>() != HeistReplay::HeaderMagic || ReadRaw<uint32>() != HeistReplay::Version)
+	{
+		return false;
+	}
+	Header.SampleRate = ReadRaw<float>();
+	Header.KeyframeInterval = ReadRaw<float>();
+	Header.StartTimeTicks = ReadRaw<int64>();
+	Header.MapName = ReadString();
+	Header.URL = ReadString();
+	RecordsBegin = Cursor;
+	return !bReadPastEnd;
+}
+
+bool FHeistReplayReader::ReadIndex(int64 FileSize)
+{
+	const int64 FooterSize = sizeof(uint64) + sizeof(uint32) + sizeof(uint32);
+	if (FileSize < RecordsBegin + FooterSize) { return false; }
+
+	Cursor = FileSize - FooterSize;
+	const uint64 IndexOffset = ReadRaw<uint64>();
+	DurationMs = ReadRaw<uint32>();
+	if (ReadRaw<uint32>() != HeistReplay::FooterMagic || IndexOffset < static_cast<uint64>(RecordsBegin) || IndexOffset > static_cast<uint64>(FileSize - FooterSize))
+	{
+		return false;
+	}
+
+	//The index has to fill the space up to the footer exactly, or the footer is not ours
+	Cursor = IndexOffset;
+	const uint32 NumKeyframes = ReadRaw<uint32>();
+	const int64 KeyframeSize = sizeof(uint32) + sizeof(uint64);
+	if (static_cast<int64>(IndexOffset) + static_cast<int64>(sizeof(uint32)) + NumKeyframes * KeyframeSize != FileSize - FooterSize)
+	{
+		return false;
+	}
+	Keyframes.SetNum(NumKeyframes);
+	for (FHeistReplayKeyframe& Keyframe : Keyframes)
+	{
+		Keyframe.TimeMs = ReadRaw<uint32>();
+		Keyframe.Offset = ReadRaw<uint64>();
+	}
+	RecordsEnd = IndexOffset;
+	return Keyframes.Num() > 0;
+}
+
+bool FHeistReplayReader::ScanForKeyframes(int64 FileSize)
+{
+	//Without a footer the records run to the end of the file, the last of them possibly cut short. Every record is
+	//decoded in turn, so the index and duration end at the last one that is whole.
+	Keyframes.Reset();
+	RecordsEnd = FileSize;
+	Cursor = RecordsBegin;
+	LastRecordTimeMs = 0;
+	int64 WholeRecordsEnd = RecordsBegin;
+	uint32 WholeRecordsTimeMs = 0;
+	while (Cursor < RecordsEnd)
+	{
+		const int64 RecordStart = Cursor;
+		bReadPastEnd = false;
+		const EHeistReplayRecord Type = static_cast<EHeistReplayRecord>(ReadRaw<uint8>());
+		uint32 Time = 0;
+		ReadVarUInt(Time);
+		LastRecordTimeMs = Type == EHeistReplayRecord::Keyframe ? Time : LastRecordTimeMs + Time;
+		if (!ReadRecord(Type, [](const FHeistReplayShot&) {}) || bReadPastEnd)
+		{
+			break;
+		}
+		if (Type == EHeistReplayRecord::Keyframe)
+		{
+			Keyframes.Add({ LastRecordTimeMs, static_cast<uint64>(RecordStart) });
+		}
+		WholeRecordsEnd = Cursor;
+		WholeRecordsTimeMs = LastRecordTimeMs;
+	}
+
+	RecordsEnd = WholeRecordsEnd;
+	DurationMs = WholeRecordsTimeMs;
+	bReadPastEnd = false;
+	States.Reset();
+	Names.Reset();
+	return Keyframes.Num() > 0;
+}
+
+bool FHeistReplayReader::SeekTo(uint32 TimeMs)
+{
+	if (!IsOpen()) { return false; }
+
+	//Last keyframe at or before TimeMs - keyframes are written in time order
+	int32 KeyframeIndex = Algo::UpperBoundBy(Keyframes, TimeMs, &FHeistReplayKeyframe::TimeMs) - 1;
+	KeyframeIndex = FMath::Max(KeyframeIndex, 0);
+
+	States.Reset();
+	Names.Reset();
+	Cursor = Keyframes[KeyframeIndex].Offset;
+	CurrentTimeMs = Keyframes[KeyframeIndex].TimeMs;
+	LastRecordTimeMs = CurrentTimeMs;
+	AdvanceTo(TimeMs, [](const FHeistReplayShot&) {});
+	return true;
+}
+
+void FHeistReplayReader::AdvanceTo(uint32 TimeMs, TFunctionRef<void(const FHeistReplayShot&)> OnShot)
+{
+	while (Cursor < RecordsEnd)
+	{
+		//Peek the record time and stop before anything newer than TimeMs
+		const int64 RecordStart = Cursor;
+		const EHeistReplayRecord Type = static_cast<EHeistReplayRecord>(ReadRaw<uint8>());
+		uint32 Time = 0;
+		ReadVarUInt(Time);
+		const uint32 RecordTimeMs = Type == EHeistReplayRecord::Keyframe ? Time : LastRecordTimeMs + Time;
+		if (RecordTimeMs > TimeMs)
+		{
+			Cursor = RecordStart;
+			break;
+		}
+		LastRecordTimeMs = RecordTimeMs;
+
+		if (!ReadRecord(Type, OnShot))
+		{
+			//Unknown record - the rest of the file cannot be trusted
+			UE_LOG(LogTemp, Warning, TEXT("HeistReplay: unknown record %d at offset %lld."), static_cast<int32>(Type), RecordStart);
+			Cursor = RecordsEnd;
+		}
+	}
+	//The clock moves on to TimeMs even between records - decoding keeps using LastRecordTimeMs
+	CurrentTimeMs = FMath::Max(CurrentTimeMs, FMath::Min(TimeMs, DurationMs));
+}
+
+bool FHeistReplayReader::ReadRecord(EHeistReplayRecord Type, TFunctionRef<void(const FHeistReplayShot&)> OnShot)
+{
+	switch (Type)
+	{
+	case EHeistReplayRecord::Keyframe:
+	case EHeistReplayRecord::Frame:
+	{
+		const bool bKeyframe = Type == EHeistReplayRecord::Keyframe;
+		if (bKeyframe)
+		{
+			States.Reset();
+		}
+		uint32 NumCharacters = 0;
+		ReadVarUInt(NumCharacters);
+		uint32 NumRead = 0;
+		for (; NumRead < NumCharacters && Cursor < RecordsEnd; NumRead++)
+		{
+			ReadCharacter(bKeyframe);
+		}
+		bReadPastEnd |= NumRead < NumCharacters;
+		if (bKeyframe)
+		{
+			uint32 NumNames = 0;
+			ReadVarUInt(NumNames);
+			for (NumRead = 0; NumRead < NumNames && Cursor < RecordsEnd; NumRead++)
+			{
+				uint32 CharacterId = 0;
+				ReadVarUInt(CharacterId);
+				Names.Add(static_cast<uint16>(CharacterId), ReadString());
+			}
+			bReadPastEnd |= NumRead < NumNames;
+		}
+		break;
+	}
+	case EHeistReplayRecord::Shot:
+	{
+		uint32 CharacterId = 0;
+		ReadVarUInt(CharacterId);
+		FHeistReplayShot Shot;
+		Shot.CharacterId = static_cast<uint16>(CharacterId);
+		Shot.PackedShot = ReadRaw<uint16>();
+		Shot.AimPitch = ReadRaw<uint16>();
+		Shot.AimYaw = ReadRaw<uint16>();
+		OnShot(Shot);
+		break;
+	}
+	case EHeistReplayRecord::CharacterAdded:
+	{
+		uint32 CharacterId = 0;
+		ReadVarUInt(CharacterId);
+		Names.Add(static_cast<uint16>(CharacterId), ReadString());
+		break;
+	}
+	case EHeistReplayRecord::CharacterRemoved:
+	{
+		uint32 CharacterId = 0;
+		ReadVarUInt(CharacterId);
+		States.Remove(static_cast<uint16>(CharacterId));
+		break;
+	}
+	default:
+		return false;
+	}
+	return true;
+}
+
+void FHeistReplayReader::ReadCharacter(bool bKeyframe)
+{
+	uint32 CharacterId = 0;
+	ReadVarUInt(CharacterId);
+	const uint8 Mask = ReadRaw<uint8>();
+
+	FHeistReplayCharacterState& State = States.FindOrAdd(static_cast<uint16>(CharacterId));
+	if (bKeyframe)
+	{
+		State = FHeistReplayCharacterState();
+	}
+
+	if (Mask & FHeistReplayCharacterState::FieldLocation)
+	{
+		State.LocationX += ReadVarInt();
+		State.LocationY += ReadVarInt();
+		State.LocationZ += ReadVarInt();
+	}
+	if (Mask & FHeistReplayCharacterState::FieldYaw)
+	{
+		State.Yaw += static_cast<uint16>(ReadVarInt());
+	}
+	if (Mask & FHeistReplayCharacterState::FieldAim)
+	{
+		State.AimPitch += static_cast<uint16>(ReadVarInt());
+		State.AimYaw += static_cast<uint16>(ReadVarInt());
+	}
+	if (Mask & FHeistReplayCharacterState::FieldSpeed)
+	{
+		State.Speed += static_cast<uint16>(ReadVarInt());
+	}
+	if (Mask & FHeistReplayCharacterState::FieldDirection)
+	{
+		State.Direction += static_cast<uint16>(ReadVarInt());
+	}
+	if (Mask & FHeistReplayCharacterState::FieldFlags)
+	{
+		State.Flags = ReadRaw<uint8>();
+	}
+}
+
+bool FHeistReplayReader::ReadVarUInt(uint32& OutValue)
+{
+	OutValue = 0;
+	for (int32 Shift = 0; Shift < 35 && Cursor < RecordsEnd; Shift += 7)
+	{
+		const uint8 Byte = Data[Cursor++];
+		OutValue |= static_cast<uint32>(Byte & 0x7F) << Shift;
+		if ((Byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	bReadPastEnd |= Cursor >= RecordsEnd;
+	return false;
+}
+
+int32 FHeistReplayReader::ReadVarInt()
+{
+	uint32 Value = 0;
+	ReadVarUInt(Value);
+	return static_cast<int32>(Value >> 1) ^ -static_cast<int32>(Value & 1);
+}
+
+FString FHeistReplayReader::ReadString()
+{
+	uint32 Length = 0;
+	ReadVarUInt(Length);
+	if (Cursor + Length > RecordsEnd)
+	{
+		bReadPastEnd = true;
+		Cursor = RecordsEnd;
+		return FString();
+	}
+	FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Data + Cursor), Length);
+	Cursor += Length;
+	return FString(Converted.Length(), Converted.Get());
+}
@@ -0,0 +1,428 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Replay/HeistReplaySubsystem.h"
+#include "HeistFPS.h"
+
+#include "Player/HeistFPSCharacter.h"
+#include "Weapon/WeaponBase.h"
+
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+#include "Async/Async.h"
+
+DECLARE_CYCLE_STAT(TEXT("ReplayRecord"), STAT_HeistReplayRecord, STATGROUP_HeistFPS);
+DECLARE_CYCLE_STAT(TEXT("ReplayPlayback"), STAT_HeistReplayPlayback, STATGROUP_HeistFPS);
+
+static FString GetReplayDirectory()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Replays");
+}
+
+static UHeistReplaySubsystem* GetReplaySubsystem(UWorld* World)
+{
+	return World != nullptr ? World->GetSubsystem<UHeistReplaySubsystem>() : nullptr;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs HeistReplayRecordCommand(
+	TEXT("heist.Replay.Record"),
+	TEXT("Starts recording a replay of this world to Saved/Replays."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UHeistReplaySubsystem* Replay = GetReplaySubsystem(World))
+		{
+			Replay->StartRecording();
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs HeistReplayStopCommand(
+	TEXT("heist.Replay.Stop"),
+	TEXT("Stops the current replay recording or playback."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UHeistReplaySubsystem* Replay = GetReplaySubsystem(World))
+		{
+			Replay->StopRecording();
+			Replay->StopPlayback();
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs HeistReplayPlayCommand(
+	TEXT("heist.Replay.Play"),
+	TEXT("heist.Replay.Play <File> - plays a replay from Saved/Replays in a standalone world."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UHeistReplaySubsystem* Replay = GetReplaySubsystem(World);
+		if (Replay != nullptr && Args.Num() > 0)
+		{
+			Replay->StartPlayback(Args[0]);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs HeistReplaySeekCommand(
+	TEXT("heist.Replay.Seek"),
+	TEXT("heist.Replay.Seek <Seconds> - jumps playback to a time in the replay."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UHeistReplaySubsystem* Replay = GetReplaySubsystem(World);
+		if (Replay != nullptr && Args.Num() > 0)
+		{
+			Replay->SeekPlayback(FCString::Atof(*Args[0]));
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs HeistReplayPauseCommand(
+	TEXT("heist.Replay.Pause"),
+	TEXT("Pauses or resumes replay playback."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UHeistReplaySubsystem* Replay = GetReplaySubsystem(World))
+		{
+			Replay->TogglePlaybackPaused();
+		}
+	}));
+
+void UHeistReplaySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+}
+
+void UHeistReplaySubsystem::Deinitialize()
+{
+	StopRecording();
+	StopPlayback();
+	Super::Deinitialize();
+}
+
+void UHeistReplaySubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	if (InWorld.IsGameWorld() && FParse::Param(FCommandLine::Get(), TEXT("HeistRecordReplay")))
+	{
+		StartRecording();
+	}
+}
+
+bool UHeistReplaySubsystem::IsTickable() const
+{
+	return !IsTemplate() && (IsRecording() || IsPlaying());
+}
+
+TStatId UHeistReplaySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UHeistReplaySubsystem, STATGROUP_Tickables);
+}
+
+void UHeistReplaySubsystem::Tick(float DeltaTime)
+{
+	if (IsRecording())
+	{
+		HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistReplayRecord);
+
+		TimeSinceSample += DeltaTime;
+		if (TimeSinceSample >= 1.0f / SampleRate)
+		{
+			TimeSinceSample = 0.0f;
+			RecordSample();
+		}
+	}
+
+	if (IsPlaying())
+	{
+		HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistReplayPlayback);
+
+		if (!bPlaybackPaused)
+		{
+			PlaybackTimeMs = FMath::Min(PlaybackTimeMs + DeltaTime * 1000.0, static_cast<double>(Reader.GetDurationMs()));
+		}
+		Reader.AdvanceTo(static_cast<uint32>(PlaybackTimeMs), [this](const FHeistReplayShot& Shot) { PlayShot(Shot); });
+		UpdatePuppets();
+	}
+}
+
+/********************************************************************
+				RECORDING
+*********************************************************************/
+void UHeistReplaySubsystem::StartRecording()
+{
+	UWorld* World = GetWorld();
+	if (IsRecording() || IsPlaying() || World == nullptr || !World->IsGameWorld()) { return; }
+
+	const FString Directory = GetReplayDirectory();
+	IFileManager::Get().MakeDirectory(*Directory, true);
+
+	//Delete the oldest replays so at most MaxReplays remain after this one is created
+	TArray<FString> Existing;
+	IFileManager::Get().FindFiles(Existing, *(Directory / TEXT("Heist_*.hreplay")), true, false);
+	Existing.Sort();
+	for (int32 i = 0; i <= Existing.Num() - MaxReplays; i++)
+	{
+		IFileManager::Get().Delete(*(Directory / Existing[i]));
+	}
+
+	RecordingPath = Directory / FString::Printf(TEXT("Heist_%s.hreplay"), *FDateTime::Now().ToString());
+	FileHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*RecordingPath));
+	if (!FileHandle.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("HeistReplay: could not open %s for writing."), *RecordingPath);
+		return;
+	}
+
+	FHeistReplayHeader Header;
+	Header.MapName = World->GetMapName();
+	Header.URL = World->URL.ToString();
+	Header.StartTimeTicks = FDateTime::UtcNow().GetTicks();
+	Header.SampleRate = SampleRate;
+	Header.KeyframeInterval = KeyframeInterval;
+
+	Encoder = FHeistReplayEncoder();
+	Encoder.WriteHeader(Header);
+	CharacterIds.Reset();
+	NextCharacterId = 0;
+	RecordStartTime = World->GetTimeSeconds();
+	TimeSinceSample = 0.0f;
+
+	//Force a keyframe on the first sample
+	TimeSinceKeyframe = KeyframeInterval;
+	RecordSample();
+	UE_LOG(LogTemp, Log, TEXT("HeistReplay: recording to %s."), *RecordingPath);
+}
+
+void UHeistReplaySubsystem::StopRecording()
+{
+	if (!IsRecording()) { return; }
+
+	Encoder.WriteFooter(GetRecordTimeMs());
+	FlushChunk();
+	if (PendingWrite.IsValid())
+	{
+		PendingWrite.Wait();
+	}
+	const int64 FileSize = FileHandle->Size();
+	FileHandle.Reset();
+	UE_LOG(LogTemp, Log, TEXT("HeistReplay: wrote %lld bytes to %s."), FileSize, *RecordingPath);
+}
+
+uint32 UHeistReplaySubsystem::GetRecordTimeMs() const
+{
+	return static_cast<uint32>(FMath::Max(GetWorld()->GetTimeSeconds() - RecordStartTime, 0.0) * 1000.0);
+}
+
+void UHeistReplaySubsystem::RecordShot(const AWeaponBase* Weapon, uint16 PackedShot, uint16 AimPitch, uint16 AimYaw)
+{
+	UHeistReplaySubsystem* Replay = GetReplaySubsystem(Weapon->GetWorld());
+	if (Replay == nullptr || !Replay->IsRecording()) { return; }
+
+	const uint16* CharacterId = Replay->CharacterIds.Find(FObjectKey(Weapon->GetInstigator()));
+	if (CharacterId == nullptr) { return; }
+
+	FHeistReplayShot Shot;
+	Shot.CharacterId = *CharacterId;
+	Shot.PackedShot = PackedShot;
+	Shot.AimPitch = AimPitch;
+	Shot.AimYaw = AimYaw;
+	Replay->Encoder.WriteShot(Replay->GetRecordTimeMs(), Shot);
+}
+
+void UHeistReplaySubsystem::RecordSample()
+{
+	const uint32 TimeMs = GetRecordTimeMs();
+
+	TimeSinceKeyframe += 1.0f / SampleRate;
+	const bool bKeyframe = TimeSinceKeyframe >= KeyframeInterval;
+	if (bKeyframe)
+	{
+		TimeSinceKeyframe = 0.0f;
+	}
+
+	SampleStates.Reset();
+	TSet<FObjectKey> Seen;
+	for (TActorIterator<AHeistFPSCharacter> It(GetWorld()); It; ++It)
+	{
+		AHeistFPSCharacter* Character = *It;
+		if (Character->IsPendingKill() || Character->IsPooled()) { continue; }
+
+		const FObjectKey Key(Character);
+		uint16* CharacterId = CharacterIds.Find(Key);
+		if (CharacterId == nullptr)
+		{
+			CharacterId = &CharacterIds.Add(Key, NextCharacterId++);
+			const FString Name = Character->GetPlayerState() != nullptr ? Character->GetPlayerState()->GetPlayerName() : Character->GetName();
+			Encoder.WriteCharacterAdded(TimeMs, *CharacterId, Name);
+		}
+		Seen.Add(Key);
+		SampleStates.Emplace(*CharacterId, FHeistReplayCharacterState::FromCharacter(*Character));
+	}
+
+	for (auto It = CharacterIds.CreateIterator(); It; ++It)
+	{
+		if (!Seen.Contains(It.Key()))
+		{
+			Encoder.WriteCharacterRemoved(TimeMs, It.Value());
+			It.RemoveCurrent();
+		}
+	}
+
+	Encoder.WriteFrame(TimeMs, SampleStates, bKeyframe);
+
+	if (Encoder.Buffer.Num() >= ChunkBytes)
+	{
+		FlushChunk();
+	}
+}
+
+void UHeistReplaySubsystem::FlushChunk()
+{
+	if (Encoder.Buffer.Num() == 0) { return; }
+
+	//File IO happens off the game thread - the previous chunk is waited on so chunks stay in order
+	if (PendingWrite.IsValid())
+	{
+		PendingWrite.Wait();
+	}
+	IFileHandle* Handle = FileHandle.Get();
+	PendingWrite = Async(EAsyncExecution::ThreadPool, [Handle, Chunk = Encoder.TakeChunk()]()
+	{
+		Handle->Write(Chunk.GetData(), Chunk.Num());
+	});
+}
+
+/********************************************************************
+				PLAYBACK
+*********************************************************************/
+bool UHeistReplaySubsystem::StartPlayback(const FString& File)
+{
+	UWorld* World = GetWorld();
+	if (IsRecording() || World == nullptr || !World->IsGameWorld()) { return false; }
+
+	//Puppets are local actors, so playback would fight replication in a networked world
+	if (World->GetNetMode() != NM_Standalone)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("HeistReplay: playback is only supported in standalone worlds."));
+		return false;
+	}
+
+	StopPlayback();
+
+	FString Path = File;
+	if (FPaths::IsRelative(Path))
+	{
+		Path = GetReplayDirectory() / Path;
+	}
+	if (FPaths::GetExtension(Path).IsEmpty())
+	{
+		Path += TEXT(".hreplay");
+	}
+	if (!Reader.Open(Path)) { return false; }
+
+	PlaybackTimeMs = 0.0;
+	bPlaybackPaused = false;
+	UpdatePuppets();
+	UE_LOG(LogTemp, Log, TEXT("HeistReplay: playing %s, %s, %.1f seconds."), *Path, *Reader.GetHeader().MapName, Reader.GetDurationMs() / 1000.0f);
+	return true;
+}
+
+void UHeistReplaySubsystem::StopPlayback()
+{
+	if (!IsPlaying()) { return; }
+
+	Reader.Close();
+	for (const TPair<uint16, TWeakObjectPtr<AHeistFPSCharacter>>& Pair : Puppets)
+	{
+		if (AHeistFPSCharacter* Puppet = Pair.Value.Get())
+		{
+			for (AWeaponBase* Weapon : Puppet->Inventory)
+			{
+				if (Weapon != nullptr)
+				{
+					Weapon->Destroy();
+				}
+			}
+			Puppet->Destroy();
+		}
+	}
+	Puppets.Reset();
+}
+
+void UHeistReplaySubsystem::SeekPlayback(float Seconds)
+{
+	if (!IsPlaying()) { return; }
+
+	PlaybackTimeMs = FMath::Clamp(Seconds * 1000.0, 0.0, static_cast<double>(Reader.GetDurationMs()));
+	Reader.SeekTo(static_cast<uint32>(PlaybackTimeMs));
+	UpdatePuppets();
+}
+
+void UHeistReplaySubsystem::UpdatePuppets()
+{
+	const TMap<uint16, FHeistReplayCharacterState>& States = Reader.GetStates();
+
+	for (auto It = Puppets.CreateIterator(); It; ++It)
+	{
+		//Puppets are kept hidden rather than destroyed so scrubbing back does not respawn them
+		AHeistFPSCharacter* Puppet = It.Value().Get();
+		if (Puppet == nullptr)
+		{
+			It.RemoveCurrent();
+		}
+		else if (!States.Contains(It.Key()))
+		{
+			Puppet->SetActorHiddenInGame(true);
+		}
+	}
+
+	for (const TPair<uint16, FHeistReplayCharacterState>& Pair : States)
+	{
+		TWeakObjectPtr<AHeistFPSCharacter>& WeakPuppet = Puppets.FindOrAdd(Pair.Key);
+		AHeistFPSCharacter* Puppet = WeakPuppet.Get();
+		if (Puppet == nullptr)
+		{
+			Puppet = SpawnPuppet();
+			WeakPuppet = Puppet;
+			if (Puppet == nullptr) { continue; }
+		}
+		Puppet->SetActorHiddenInGame(false);
+		Pair.Value.ApplyToCharacter(*Puppet);
+	}
+}
+
+AHeistFPSCharacter* UHeistReplaySubsystem::SpawnPuppet()
+{
+	HEISTFPS_LLM_SCOPE(Characters);
+
+	UWorld* World = GetWorld();
+	UClass* Class = PuppetClass.LoadSynchronous();
+	if (Class == nullptr && World->GetAuthGameMode() != nullptr)
+	{
+		Class = World->GetAuthGameMode()->GetDefaultPawnClassForController(nullptr);
+	}
+	if (Class == nullptr || !Class->IsChildOf(AHeistFPSCharacter::StaticClass())) { return nullptr; }
+
+	FActorSpawnParameters SpawnInfo;
+	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	AHeistFPSCharacter* Puppet = World->SpawnActor<AHeistFPSCharacter>(Class, FTransform::Identity, SpawnInfo);
+	if (Puppet != nullptr)
+	{
+		Puppet->MakePuppet();
+	}
+	return Puppet;
+}
+
+void UHeistReplaySubsystem::PlayShot(const FHeistReplayShot& Shot)
+{
+	const TWeakObjectPtr<AHeistFPSCharacter>* WeakPuppet = Puppets.Find(Shot.CharacterId);
+	AHeistFPSCharacter* Puppet = WeakPuppet != nullptr ? WeakPuppet->Get() : nullptr;
+	if (Puppet != nullptr && Puppet->Inventory.Num() > 0)
+	{
+		Puppet->Inventory[0]->SimulateWeaponFire();
+	}
+}
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Player/HeistInputSampler.h"
+#include "HeistFPS.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHeistAxisSamplerTest, "HeistFPS.Input.AxisSampler", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FHeistAxisSamplerTest::RunTest(const FString& Parameters)
+{
+	IConsoleVariable* SampleRate = IConsoleManager::Get().FindConsoleVariable(TEXT("heist.Input.SampleRate"));
+	if (!TestNotNull(TEXT("heist.Input.SampleRate is registered"), SampleRate)) { return false; }
+	const float SavedRate = SampleRate->GetFloat();
+	SampleRate->Set(60.0f, ECVF_SetByConsole);
+
+	FHeistAxisSampler Sampler;
+	const float Tolerance = FHeistAxisSampler::Quantum;
+
+	//Pressing the axis applies at once, then the value is held for the sample period
+	TestEqual(TEXT("Press applies at once"), Sampler.Sample(0.5f, 10.0), 0.5f, Tolerance);
+	TestEqual(TEXT("Change inside the period is held"), Sampler.Sample(0.8f, 10.005), 0.5f, Tolerance);
+	TestEqual(TEXT("Change after the period is taken"), Sampler.Sample(0.8f, 10.02), 0.8f, Tolerance);
+
+	//Keys only read -1, 0 or 1, so a digital value is a press and never waits for the period
+	TestEqual(TEXT("Digital value applies at once"), Sampler.Sample(1.0f, 10.021), 1.0f, KINDA_SMALL_NUMBER);
+	TestEqual(TEXT("Analog change after a digital one is held"), Sampler.Sample(0.8f, 10.022), 1.0f, KINDA_SMALL_NUMBER);
+	TestEqual(TEXT("Analog change is taken again after the period"), Sampler.Sample(0.8f, 10.039), 0.8f, Tolerance);
+
+	//Noise below the quantum is not a change
+	const float Held = Sampler.GetHeldValue();
+	TestEqual(TEXT("Noise is snapped away"), Sampler.Sample(Held + Tolerance * 0.25f, 10.04), Held, KINDA_SMALL_NUMBER);
+
+	//Reversing and releasing never wait for the period
+	TestEqual(TEXT("Reverse applies at once"), Sampler.Sample(-1.0f, 10.041), -1.0f, KINDA_SMALL_NUMBER);
+	TestEqual(TEXT("Release applies at once"), Sampler.Sample(0.0f, 10.042), 0.0f, KINDA_SMALL_NUMBER);
+
+	Sampler.Reset();
+	TestEqual(TEXT("Reset clears the held value"), Sampler.GetHeldValue(), 0.0f, KINDA_SMALL_NUMBER);
+
+	//A budget below the sample rate stretches the period - 20 Hz holds analog changes for 50 ms
+	Sampler.Sample(0.5f, 30.0, 20.0f);
+	TestEqual(TEXT("Change inside the budget period is held"), Sampler.Sample(0.7f, 30.03, 20.0f), 0.5f, Tolerance);
+	TestEqual(TEXT("Change after the budget period is taken"), Sampler.Sample(0.7f, 30.051, 20.0f), 0.7f, Tolerance);
+	Sampler.Reset();
+
+	//A rate of 0 passes every value through unchanged
+	SampleRate->Set(0.0f, ECVF_SetByConsole);
+	TestEqual(TEXT("Pass-through when sampling is off"), Sampler.Sample(0.3337f, 20.0), 0.3337f, KINDA_SMALL_NUMBER);
+
+	SampleRate->Set(SavedRate, ECVF_SetByConsole);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
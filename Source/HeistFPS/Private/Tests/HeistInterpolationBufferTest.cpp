@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/HeistInterpolationBuffer.h"
+#include "HeistFPS.h"
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace HeistInterpolationBufferTest
+{
+	static FHeistAnimSample MakeSample(float ServerTime, float Speed, float Direction, float Yaw)
+	{
+		FHeistAnimSample Sample;
+		Sample.ServerTime = ServerTime;
+		Sample.Speed = Speed;
+		Sample.Direction = Direction;
+		Sample.Yaw = Yaw;
+		return Sample;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHeistInterpolationBufferTest, "HeistFPS.Net.InterpolationBuffer", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FHeistInterpolationBufferTest::RunTest(const FString& Parameters)
+{
+	using namespace HeistInterpolationBufferTest;
+
+	FHeistAnimInterpolationBuffer Buffer;
+	FHeistAnimSample Out;
+	TestFalse(TEXT("Empty buffer has nothing to sample"), Buffer.Sample(0.0f, Out));
+
+	//Between two samples the parameters are blended by time
+	Buffer.AddSample(MakeSample(1.0f, 0.0f, 0.0f, 0.0f));
+	Buffer.AddSample(MakeSample(1.1f, 100.0f, 20.0f, 10.0f));
+	TestTrue(TEXT("Sample succeeds"), Buffer.Sample(1.05f, Out));
+	TestEqual(TEXT("Speed is interpolated"), Out.Speed, 50.0f, 0.01f);
+	TestEqual(TEXT("Direction is interpolated"), Out.Direction, 10.0f, 0.01f);
+	TestEqual(TEXT("Yaw is interpolated"), Out.Yaw, 5.0f, 0.01f);
+
+	//Before the oldest sample the oldest one is held
+	Buffer.Sample(0.5f, Out);
+	TestEqual(TEXT("Render time before the buffer holds the oldest"), Out.Speed, 0.0f, 0.01f);
+
+	//Samples older than the newest are dropped
+	Buffer.AddSample(MakeSample(1.05f, 999.0f, 0.0f, 0.0f));
+	TestEqual(TEXT("Late sample is dropped"), Buffer.GetNum(), 2);
+
+	//Past the newest sample the motion continues for MaxExtrapolation and no further
+	Buffer.Sample(1.1f + Buffer.MaxExtrapolation * 0.5f, Out);
+	TestTrue(TEXT("Extrapolation continues the last motion"), Out.Yaw > 10.0f);
+	FHeistAnimSample AtLimit;
+	Buffer.Sample(1.1f + Buffer.MaxExtrapolation, AtLimit);
+	Buffer.Sample(1.1f + Buffer.MaxExtrapolation + Buffer.ExtrapolationRecovery * 0.5f, Out);
+	TestTrue(TEXT("Extrapolation never runs past MaxExtrapolation"), Out.Yaw <= AtLimit.Yaw + KINDA_SMALL_NUMBER);
+	TestTrue(TEXT("Overshoot eases back towards the newest sample"), Out.Yaw < AtLimit.Yaw && Out.Yaw > 10.0f);
+
+	//Nothing newer arrived, so the newest sample was the final value and is held once the ease is done
+	Buffer.Sample(1.1f + Buffer.MaxExtrapolation + Buffer.ExtrapolationRecovery + 0.01f, Out);
+	TestEqual(TEXT("Settles on the newest sample"), Out.Yaw, 10.0f, 0.01f);
+	Buffer.Sample(1.1f + 5.0f, Out);
+	TestEqual(TEXT("Holds the newest sample"), Out.Speed, 100.0f, 0.01f);
+
+	//Angles take the shortest way round instead of sweeping through 0
+	FHeistAnimInterpolationBuffer Wrapping;
+	Wrapping.AddSample(MakeSample(0.0f, 0.0f, 170.0f, 0.0f));
+	Wrapping.AddSample(MakeSample(0.1f, 0.0f, -170.0f, 0.0f));
+	Wrapping.Sample(0.05f, Out);
+	TestEqual(TEXT("Direction wraps through 180"), FMath::Abs(Out.Direction), 180.0f, 0.01f);
+
+	//A long gap means the value held, not that it ramped slowly across the gap
+	FHeistAnimInterpolationBuffer Gapped;
+	Gapped.AddSample(MakeSample(0.0f, 100.0f, 0.0f, 0.0f));
+	Gapped.AddSample(MakeSample(2.0f, 300.0f, 0.0f, 0.0f));
+	Gapped.Sample(1.0f, Out);
+	TestEqual(TEXT("Value holds across a long gap"), Out.Speed, 100.0f, 0.01f);
+
+	//The buffer keeps only the newest Capacity samples
+	FHeistAnimInterpolationBuffer Full;
+	for (int32 i = 0; i < FHeistAnimInterpolationBuffer::Capacity * 2; i++)
+	{
+		Full.AddSample(MakeSample(i * 0.05f, i, 0.0f, 0.0f));
+	}
+	TestEqual(TEXT("Buffer is capped at Capacity"), Full.GetNum(), FHeistAnimInterpolationBuffer::Capacity);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,191 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/HeistMockSessionInterface.h"
+#include "HeistFPS.h"
+
+#include "CoreGlobals.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+#include "TimerManager.h"
+
+#include "Game/HeistFPSGameInstance.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace HeistMockSessionTest
+{
+	/** Session name the game instance hosts and joins under */
+	static const FName SessionName = TEXT("My Session");
+
+	/** Sets a console variable for the length of the test and puts the old value back afterwards */
+	struct FScopedCVar
+	{
+		IConsoleVariable* Variable;
+		FString SavedValue;
+
+		explicit FScopedCVar(const TCHAR* Name)
+			: Variable(IConsoleManager::Get().FindConsoleVariable(Name))
+			, SavedValue(Variable != nullptr ? Variable->GetString() : FString())
+		{
+		}
+
+		~FScopedCVar()
+		{
+			if (Variable != nullptr)
+			{
+				Variable->Set(*SavedValue, ECVF_SetByConsole);
+			}
+		}
+
+		void Set(const TCHAR* Value)
+		{
+			if (Variable != nullptr)
+			{
+				Variable->Set(Value, ECVF_SetByConsole);
+			}
+		}
+	};
+
+	/** Runs the mock's completions and the game instance's retry timers for Seconds of game time */
+	static void Pump(UHeistFPSGameInstance* GameInstance, FHeistMockSessionInterface& Mock, float Seconds)
+	{
+		const float Step = 0.1f;
+		for (float Elapsed = 0.0f; Elapsed < Seconds; Elapsed += Step)
+		{
+			Mock.Tick(Step);
+			//The timer manager ticks once per frame, so every step is a frame of its own
+			GFrameCounter++;
+			GameInstance->GetTimerManager().Tick(Step);
+		}
+		Mock.Tick(Step);
+	}
+
+	/** Failed creates before the first success for a mock seeded with Seed - the mock draws once per completed request */
+	static int32 CountLeadingFailures(int32 Seed, float FailurePct, int32 MaxDraws)
+	{
+		FRandomStream Stream(Seed);
+		int32 Failures = 0;
+		while (Failures < MaxDraws && Stream.FRand() * 100.0f < FailurePct)
+		{
+			Failures++;
+		}
+		return Failures;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHeistMockSessionTest, "HeistFPS.Net.MockSessions", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FHeistMockSessionTest::RunTest(const FString& Parameters)
+{
+	using namespace HeistMockSessionTest;
+
+	FScopedCVar Latency(TEXT("heist.MockSessions.LatencyMs"));
+	FScopedCVar FailurePct(TEXT("heist.MockSessions.FailurePct"));
+	FScopedCVar Count(TEXT("heist.MockSessions.Count"));
+	FScopedCVar Seed(TEXT("heist.MockSessions.Seed"));
+	if (!TestNotNull(TEXT("heist.MockSessions.Seed is registered"), Seed.Variable)) { return false; }
+	Latency.Set(TEXT("0"));
+	Count.Set(TEXT("20"));
+	Seed.Set(TEXT("7"));
+
+	//The game instance runs its own Init against a throwaway world, so the mock is picked the same way -MockSessions picks it
+	UHeistFPSGameInstance* GameInstance = NewObject<UHeistFPSGameInstance>(GEngine);
+	GameInstance->bUseMockSessions = true;
+	GameInstance->InitializeStandalone();
+	UWorld* World = GameInstance->GetWorld();
+	IMenuInterface* Menu = GameInstance;
+
+	TSharedPtr<FHeistMockSessionInterface, ESPMode::ThreadSafe> Mock = StaticCastSharedPtr<FHeistMockSessionInterface>(GameInstance->GetSessionInterface());
+	if (TestTrue(TEXT("Game instance uses the mock backend"), Mock.IsValid() && World != nullptr))
+	{
+		FHostSettings Settings = GameInstance->GetDefaultHostSettings();
+
+		//Every create fails - the host flow retries until MaxHostAttempts and hands control back to the menu
+		FailurePct.Set(TEXT("100"));
+		Menu->HostMap(Settings);
+		Pump(GameInstance, *Mock, 5.0f);
+		TestTrue(TEXT("Failing host uses every attempt"), GameInstance->GetHostAttempts() == GameInstance->GetMaxHostAttempts());
+		TestTrue(TEXT("Failing host ends idle"), GameInstance->GetHostState() == EHostState::Idle);
+		TestNull(TEXT("Failed create leaves no session"), Mock->GetNamedSession(SessionName));
+		TestTrue(TEXT("Failing host does not travel"), World->NextURL.IsEmpty());
+
+		//Nothing fails - the first create travels to the hosted map as a listen server
+		FailurePct.Set(TEXT("0"));
+		Menu->HostMap(Settings);
+		Pump(GameInstance, *Mock, 1.0f);
+		TestTrue(TEXT("Host succeeds on the first attempt"), GameInstance->GetHostAttempts() == 0);
+		TestTrue(TEXT("Host travels as a listen server"), World->NextURL.Contains(TEXT("?listen")));
+		const FNamedOnlineSession* Hosted = Mock->GetNamedSession(SessionName);
+		TestTrue(TEXT("Hosted session is ours"), Hosted != nullptr && Hosted->bHosting);
+		World->NextURL.Empty();
+
+		//Searches are capped at MaxSearchResults
+		GameInstance->MaxSearchResults = 5;
+		Menu->RefreshServerList();
+		Pump(GameInstance, *Mock, 1.0f);
+		TestEqual(TEXT("Search is capped at MaxSearchResults"), GameInstance->GetNumSearchResults(), 5);
+
+		//A failed destroy keeps the session so it can be retried, a successful one removes it
+		FailurePct.Set(TEXT("100"));
+		Mock->DestroySession(SessionName);
+		Pump(GameInstance, *Mock, 1.0f);
+		TestNotNull(TEXT("Failed destroy keeps the session"), Mock->GetNamedSession(SessionName));
+		FailurePct.Set(TEXT("0"));
+		Mock->DestroySession(SessionName);
+		Pump(GameInstance, *Mock, 1.0f);
+		TestNull(TEXT("Destroy removes the session"), Mock->GetNamedSession(SessionName));
+
+		//A join past the end of the results is ignored
+		Menu->JoinMap(GameInstance->GetNumSearchResults());
+		Pump(GameInstance, *Mock, 1.0f);
+		TestNull(TEXT("Join past the results is ignored"), Mock->GetNamedSession(SessionName));
+
+		//A failed join leaves no session behind, a successful one resolves to the configured address
+		FailurePct.Set(TEXT("100"));
+		Menu->JoinMap(0);
+		Pump(GameInstance, *Mock, 1.0f);
+		TestNull(TEXT("Failed join leaves no session"), Mock->GetNamedSession(SessionName));
+		FailurePct.Set(TEXT("0"));
+		Menu->JoinMap(0);
+		Pump(GameInstance, *Mock, 1.0f);
+		const FNamedOnlineSession* Joined = Mock->GetNamedSession(SessionName);
+		TestTrue(TEXT("Joined session is someone else's"), Joined != nullptr && !Joined->bHosting);
+		FString ConnectAddress;
+		TestTrue(TEXT("Joined session resolves"), Mock->GetResolvedConnectString(SessionName, ConnectAddress));
+		TestEqual(TEXT("Joined session resolves to the configured address"), ConnectAddress, IConsoleManager::Get().FindConsoleVariable(TEXT("heist.MockSessions.ConnectAddress"))->GetString());
+
+		//Hosting from a joined session destroys it and creates our own
+		Menu->HostMap(Settings);
+		Pump(GameInstance, *Mock, 1.0f);
+		Hosted = Mock->GetNamedSession(SessionName);
+		TestTrue(TEXT("Joined session is replaced by our own"), Hosted != nullptr && Hosted->bHosting);
+		TestTrue(TEXT("Host after a join travels"), World->NextURL.Contains(TEXT("?listen")));
+		World->NextURL.Empty();
+
+		//With a fixed seed the retry count is known up front - a new seed restarts the failure sequence at the first create
+		Mock->RemoveNamedSession(SessionName);
+		Seed.Set(TEXT("11"));
+		FailurePct.Set(TEXT("60"));
+		const int32 ExpectedAttempts = CountLeadingFailures(11, 60.0f, GameInstance->GetMaxHostAttempts());
+		Menu->HostMap(Settings);
+		Pump(GameInstance, *Mock, 5.0f);
+		TestEqual(TEXT("Retry count follows the seed"), GameInstance->GetHostAttempts(), ExpectedAttempts);
+		TestTrue(TEXT("Host travels unless every attempt failed"), World->NextURL.IsEmpty() == (ExpectedAttempts == GameInstance->GetMaxHostAttempts()));
+		TestTrue(TEXT("Seeded host ends idle"), GameInstance->GetHostState() == EHostState::Idle);
+		World->NextURL.Empty();
+	}
+
+	GameInstance->Shutdown();
+	if (World != nullptr)
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+	}
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
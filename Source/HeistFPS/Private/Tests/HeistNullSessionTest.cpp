@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Game/HeistFPSGameInstance.h"
+#include "HeistFPS.h"
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "HAL/MemoryBase.h"
+#include "Misc/AutomationTest.h"
+#include "OnlineSubsystem.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace HeistNullSessionTest
+{
+	/** Session name the game instance hosts under */
+	static const FName SessionName = TEXT("My Session");
+
+	/** Times one session step and counts its allocations - the NULL subsystem completes create, update and destroy inline */
+	struct FStepCost
+	{
+		const TCHAR* Name;
+		double StartTime;
+		uint64 StartAllocations;
+
+		explicit FStepCost(const TCHAR* InName)
+			: Name(InName)
+			, StartTime(FPlatformTime::Seconds())
+			, StartAllocations(static_cast<uint64>(FMalloc::TotalMallocCalls))
+		{
+		}
+
+		~FStepCost()
+		{
+			UE_LOG(LogTemp, Log, TEXT("NullSessions: %s took %.3f ms and %llu allocations."), Name,
+				(FPlatformTime::Seconds() - StartTime) * 1000.0, static_cast<uint64>(FMalloc::TotalMallocCalls) - StartAllocations);
+		}
+	};
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHeistNullSessionTest, "HeistFPS.Net.NullSessions", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FHeistNullSessionTest::RunTest(const FString& Parameters)
+{
+	using namespace HeistNullSessionTest;
+
+	//Find and join are left to the mock test - the NULL subsystem's LAN beacon can't see a session hosted by its own process
+	UHeistFPSGameInstance* GameInstance = NewObject<UHeistFPSGameInstance>(GEngine);
+	GameInstance->bUseMockSessions = false;
+	GameInstance->InitializeStandalone();
+	UWorld* World = GameInstance->GetWorld();
+	IMenuInterface* Menu = GameInstance;
+
+	IOnlineSessionPtr Sessions = GameInstance->GetSessionInterface();
+	if (!Sessions.IsValid() || World == nullptr)
+	{
+		AddWarning(TEXT("No online subsystem session interface - skipping the NULL session flows."));
+	}
+	else if (Sessions->GetNamedSession(SessionName) != nullptr)
+	{
+		AddWarning(TEXT("A session is already running in this process - skipping the NULL session flows."));
+	}
+	else
+	{
+		FHostSettings Settings = GameInstance->GetDefaultHostSettings();
+
+		//The first host creates the session and travels to the map as a listen server
+		{
+			FStepCost Cost(TEXT("Create"));
+			Menu->HostMap(Settings);
+		}
+		TestTrue(TEXT("Host succeeds on the first attempt"), GameInstance->GetHostAttempts() == 0);
+		TestTrue(TEXT("Host ends idle"), GameInstance->GetHostState() == EHostState::Idle);
+		TestTrue(TEXT("Host travels as a listen server"), World->NextURL.Contains(TEXT("?listen")));
+		const FNamedOnlineSession* Hosted = Sessions->GetNamedSession(SessionName);
+		TestTrue(TEXT("Hosted session is ours"), Hosted != nullptr && Hosted->bHosting);
+		World->NextURL.Empty();
+
+		//Hosting again reuses our session through an update instead of a destroy and create
+		Settings.MaxPlayers = FMath::Max(Settings.MaxPlayers - 1, 1);
+		{
+			FStepCost Cost(TEXT("Update"));
+			Menu->HostMap(Settings);
+		}
+		TestTrue(TEXT("Rehost ends idle"), GameInstance->GetHostState() == EHostState::Idle);
+		TestTrue(TEXT("Rehost travels"), World->NextURL.Contains(TEXT("?listen")));
+		Hosted = Sessions->GetNamedSession(SessionName);
+		TestTrue(TEXT("Rehost keeps the session"), Hosted != nullptr && Hosted->bHosting);
+		TestEqual(TEXT("Rehost pushes the new settings"), Hosted != nullptr ? Hosted->SessionSettings.NumPublicConnections : -1, Settings.MaxPlayers);
+		World->NextURL.Empty();
+
+		{
+			FStepCost Cost(TEXT("Destroy"));
+			Sessions->DestroySession(SessionName);
+		}
+		TestNull(TEXT("Destroy removes the session"), Sessions->GetNamedSession(SessionName));
+	}
+
+	GameInstance->Shutdown();
+	if (World != nullptr)
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+	}
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Net/HeistRPCLimiterSubsystem.h"
+#include "HeistFPS.h"
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHeistTokenBucketTest, "HeistFPS.Net.RPCLimiter.TokenBucket", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FHeistTokenBucketTest::RunTest(const FString& Parameters)
+{
+	FHeistRPCRateLimit Limit;
+	Limit.TokensPerSecond = 10.0f;
+	Limit.Burst = 5.0f;
+
+	//A new bucket starts full, so a burst goes through and the call after it is dropped
+	FHeistTokenBucket Bucket;
+	int32 Accepted = 0;
+	for (int32 i = 0; i < 6; i++)
+	{
+		Accepted += Bucket.TryConsume(Limit, 100.0) ? 1 : 0;
+	}
+	TestEqual(TEXT("Burst accepted"), Accepted, 5);
+
+	//One token comes back every 1 / TokensPerSecond seconds
+	TestFalse(TEXT("Dropped before a token refills"), Bucket.TryConsume(Limit, 100.05));
+	TestTrue(TEXT("Accepted once a token refills"), Bucket.TryConsume(Limit, 100.16));
+	TestFalse(TEXT("Refilled token is used up"), Bucket.TryConsume(Limit, 100.16));
+
+	//A long pause refills to Burst and no further
+	Accepted = 0;
+	for (int32 i = 0; i < 10; i++)
+	{
+		Accepted += Bucket.TryConsume(Limit, 200.0) ? 1 : 0;
+	}
+	TestEqual(TEXT("Refill is capped at the burst"), Accepted, 5);
+
+	//Sustained calls at the limit rate are never dropped
+	FHeistTokenBucket Steady;
+	bool bAllAccepted = true;
+	for (int32 i = 0; i < 100; i++)
+	{
+		bAllAccepted &= Steady.TryConsume(Limit, 300.0 + i / Limit.TokensPerSecond);
+	}
+	TestTrue(TEXT("Calls at the sustained rate are all accepted"), bAllAccepted);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,191 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Replay/HeistReplayFormat.h"
+#include "HeistFPS.h"
+
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace HeistReplayFormatTest
+{
+	static constexpr uint32 FrameIntervalMs = 50;
+	static constexpr uint32 DurationMs = 1000;
+
+	/** Character 1 walks 10 cm along X every frame */
+	static FHeistReplayCharacterState WalkerAt(uint32 TimeMs)
+	{
+		FHeistReplayCharacterState State;
+		State.LocationX = static_cast<int32>(TimeMs / FrameIntervalMs) * 10;
+		State.LocationY = -250;
+		State.LocationZ = 90;
+		State.Yaw = static_cast<uint16>(TimeMs * 37);
+		State.Speed = 200;
+		State.Flags = FHeistReplayCharacterState::PrimaryEquipped;
+		return State;
+	}
+
+	/** Character 2 stands still from 200 ms until it leaves at 800 ms */
+	static FHeistReplayCharacterState Stander()
+	{
+		FHeistReplayCharacterState State;
+		State.LocationX = 500;
+		State.AimPitch = 0xF000;
+		State.Flags = FHeistReplayCharacterState::Crouched;
+		return State;
+	}
+
+	static bool SameState(const FHeistReplayCharacterState& A, const FHeistReplayCharacterState& B)
+	{
+		return A.DiffMask(B) == 0;
+	}
+
+	/** Records the scripted replay with a keyframe every 500 ms and writes it to Path */
+	static bool WriteReplay(const FString& Path)
+	{
+		FHeistReplayEncoder Encoder;
+		FHeistReplayHeader Header;
+		Header.MapName = TEXT("Test1");
+		Header.URL = TEXT("/Game/Maps/Test/Test1");
+		Header.SampleRate = 1000.0f / FrameIntervalMs;
+		Header.KeyframeInterval = 0.5f;
+		Encoder.WriteHeader(Header);
+
+		Encoder.WriteCharacterAdded(0, 1, TEXT("Alpha"));
+		for (uint32 TimeMs = 0; TimeMs <= DurationMs; TimeMs += FrameIntervalMs)
+		{
+			if (TimeMs == 200)
+			{
+				Encoder.WriteCharacterAdded(TimeMs, 2, TEXT("Bravo"));
+			}
+			if (TimeMs == 800)
+			{
+				Encoder.WriteCharacterRemoved(TimeMs, 2);
+			}
+
+			TArray<TPair<uint16, FHeistReplayCharacterState>> States;
+			States.Emplace(1, WalkerAt(TimeMs));
+			if (TimeMs >= 200 && TimeMs < 800)
+			{
+				States.Emplace(2, Stander());
+			}
+			Encoder.WriteFrame(TimeMs, States, TimeMs % 500 == 0);
+
+			if (TimeMs == 150)
+			{
+				FHeistReplayShot Shot;
+				Shot.CharacterId = 1;
+				Shot.PackedShot = 0x8003;
+				Shot.AimPitch = 0x0100;
+				Shot.AimYaw = 0x4000;
+				Encoder.WriteShot(TimeMs, Shot);
+			}
+		}
+		Encoder.WriteFooter(DurationMs);
+		return FFileHelper::SaveArrayToFile(Encoder.TakeChunk(), *Path);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHeistReplayFormatTest, "HeistFPS.Replay.Format", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FHeistReplayFormatTest::RunTest(const FString& Parameters)
+{
+	using namespace HeistReplayFormatTest;
+
+	const FString Path = FPaths::AutomationTransientDir() / TEXT("HeistReplayFormatTest.hreplay");
+	if (!TestTrue(TEXT("Replay written"), WriteReplay(Path))) { return false; }
+
+	FHeistReplayReader Reader;
+	if (!TestTrue(TEXT("Replay opens"), Reader.Open(Path))) { return false; }
+	TestEqual(TEXT("Map name"), Reader.GetHeader().MapName, FString(TEXT("Test1")));
+	TestEqual(TEXT("Duration"), static_cast<int32>(Reader.GetDurationMs()), static_cast<int32>(DurationMs));
+
+	//Playing through reports every shot once and ends on the last recorded state
+	TArray<FHeistReplayShot> Shots;
+	Reader.AdvanceTo(DurationMs, [&Shots](const FHeistReplayShot& Shot) { Shots.Add(Shot); });
+	if (TestEqual(TEXT("Shots reported"), Shots.Num(), 1))
+	{
+		TestEqual(TEXT("Shot character"), static_cast<int32>(Shots[0].CharacterId), 1);
+		TestEqual(TEXT("Shot packed index"), static_cast<int32>(Shots[0].PackedShot), 0x8003);
+		TestEqual(TEXT("Shot aim"), static_cast<int32>(Shots[0].AimYaw), 0x4000);
+	}
+	const FHeistReplayCharacterState* Walker = Reader.GetStates().Find(1);
+	TestTrue(TEXT("Walker decoded at the end"), Walker != nullptr && SameState(*Walker, WalkerAt(DurationMs)));
+	TestFalse(TEXT("Removed character is gone"), Reader.GetStates().Contains(2));
+
+	//Seeking decodes from the keyframe before the target and matches a straight play-through
+	TestTrue(TEXT("Seek succeeds"), Reader.SeekTo(700));
+	Walker = Reader.GetStates().Find(1);
+	const FHeistReplayCharacterState* Standing = Reader.GetStates().Find(2);
+	TestTrue(TEXT("Walker after seek"), Walker != nullptr && SameState(*Walker, WalkerAt(700)));
+	TestTrue(TEXT("Stander after seek"), Standing != nullptr && SameState(*Standing, Stander()));
+	TestEqual(TEXT("Walker's name after seek"), Reader.GetNames().FindRef(1), FString(TEXT("Alpha")));
+	TestEqual(TEXT("Stander's name after seek"), Reader.GetNames().FindRef(2), FString(TEXT("Bravo")));
+
+	//Advancing in steps that fall between records keeps decoding from the last record, not the playback clock
+	TestTrue(TEXT("Seek to the start for stepping"), Reader.SeekTo(0));
+	bool bStepsMatch = true;
+	for (uint32 TimeMs = 7; TimeMs <= DurationMs; TimeMs += 7)
+	{
+		Reader.AdvanceTo(TimeMs, [](const FHeistReplayShot&) {});
+		Walker = Reader.GetStates().Find(1);
+		bStepsMatch &= Walker != nullptr && SameState(*Walker, WalkerAt(TimeMs / FrameIntervalMs * FrameIntervalMs));
+		bStepsMatch &= Reader.GetCurrentTimeMs() == TimeMs;
+	}
+	TestTrue(TEXT("Small steps decode the same states as a play-through"), bStepsMatch);
+
+	TestTrue(TEXT("Seek back to the start"), Reader.SeekTo(0));
+	Walker = Reader.GetStates().Find(1);
+	TestTrue(TEXT("Walker at the start"), Walker != nullptr && SameState(*Walker, WalkerAt(0)));
+	TestFalse(TEXT("Stander not yet added at the start"), Reader.GetStates().Contains(2));
+
+	Reader.Close();
+
+	//A recording killed before its footer is read by scanning for keyframes. Cut inside the last keyframe, it ends at the frame before.
+	TArray<uint8> Complete;
+	TestTrue(TEXT("Replay read back"), FFileHelper::LoadFileToArray(Complete, *Path));
+	uint64 IndexOffset = 0;
+	FMemory::Memcpy(&IndexOffset, Complete.GetData() + Complete.Num() - 16, sizeof(IndexOffset));
+	TArray<uint8> Cut(Complete.GetData(), static_cast<int32>(IndexOffset) - 3);
+	FFileHelper::SaveArrayToFile(Cut, *Path);
+	AddExpectedError(TEXT("has no index"), EAutomationExpectedErrorFlags::Contains, 2);
+	if (TestTrue(TEXT("Cut replay opens"), Reader.Open(Path)))
+	{
+		TestEqual(TEXT("Cut replay ends at its last whole record"), static_cast<int32>(Reader.GetDurationMs()), static_cast<int32>(DurationMs - FrameIntervalMs));
+		TestTrue(TEXT("Seek in a cut replay"), Reader.SeekTo(700));
+		Walker = Reader.GetStates().Find(1);
+		TestTrue(TEXT("Walker after seek in a cut replay"), Walker != nullptr && SameState(*Walker, WalkerAt(700)));
+		TestEqual(TEXT("Stander's name after seek in a cut replay"), Reader.GetNames().FindRef(2), FString(TEXT("Bravo")));
+		Reader.AdvanceTo(DurationMs, [](const FHeistReplayShot&) {});
+		Walker = Reader.GetStates().Find(1);
+		TestTrue(TEXT("Cut replay plays to its last whole frame"), Walker != nullptr && SameState(*Walker, WalkerAt(DurationMs - FrameIntervalMs)));
+		Reader.Close();
+	}
+
+	//Cut on a record boundary, every record is kept
+	Cut = TArray<uint8>(Complete.GetData(), static_cast<int32>(IndexOffset));
+	FFileHelper::SaveArrayToFile(Cut, *Path);
+	if (TestTrue(TEXT("Replay without an index opens"), Reader.Open(Path)))
+	{
+		TestEqual(TEXT("Replay without an index keeps every record"), static_cast<int32>(Reader.GetDurationMs()), static_cast<int32>(DurationMs));
+		Reader.Close();
+	}
+
+	//Without even one whole keyframe there is nothing to play from
+	FHeistReplayEncoder Truncated;
+	Truncated.WriteHeader(FHeistReplayHeader());
+	Truncated.WriteFrame(0, { TPair<uint16, FHeistReplayCharacterState>(1, WalkerAt(0)) }, true);
+	TArray<uint8> Chunk = Truncated.TakeChunk();
+	Chunk.SetNum(Chunk.Num() - 2);
+	FFileHelper::SaveArrayToFile(Chunk, *Path);
+	AddExpectedError(TEXT("is not a complete replay"), EAutomationExpectedErrorFlags::Contains, 1);
+	TestFalse(TEXT("Replay without a whole keyframe is rejected"), Reader.Open(Path));
+	IFileManager::Get().Delete(*Path);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,267 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapon/WeaponBase.h"
+#include "HeistFPS.h"
+#include "Player/HeistFPSCharacter.h"
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHeistShotSequenceTest, "HeistFPS.Weapon.ShotSequence", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FHeistShotSequenceTest::RunTest(const FString& Parameters)
+{
+	//Packing keeps 11 bits of index, 4 bits of epoch and the ADS flag
+	const uint16 Packed = AWeaponBase::PackShot(0x5BC, 0xA, true);
+	TestEqual(TEXT("Packed index"), static_cast<int32>(AWeaponBase::UnpackShotIndex(Packed)), 0x5BC);
+	TestEqual(TEXT("Packed epoch"), static_cast<int32>(AWeaponBase::UnpackShotEpoch(Packed)), 0xA);
+	TestTrue(TEXT("Packed ADS flag"), AWeaponBase::UnpackAimDownSight(Packed));
+	TestFalse(TEXT("Hip fire flag"), AWeaponBase::UnpackAimDownSight(AWeaponBase::PackShot(5, 0xF, false)));
+
+	//Draws depend only on seed and index, so every machine rebuilds the same shots
+	TestTrue(TEXT("Checksum is repeatable"), AWeaponBase::ChecksumShotSequence(1234, 500) == AWeaponBase::ChecksumShotSequence(1234, 500));
+	TestTrue(TEXT("Checksum depends on the seed"), AWeaponBase::ChecksumShotSequence(1234, 500) != AWeaponBase::ChecksumShotSequence(1235, 500));
+
+	//Golden value for the default accuracy settings - if this changes, clients and servers built before the change disagree on every shot
+	FHeistShotPatternGenerator Generator;
+	Generator.Seed = 1234;
+	TestTrue(TEXT("Checksum matches the golden value"), Generator.Checksum(500) == 0x074C728Bu);
+	TestTrue(TEXT("Default weapon uses the default generator"), AWeaponBase::ChecksumShotSequence(1234, 500) == Generator.Checksum(500));
+
+	//Index bookkeeping lives on the weapon, so the rest runs against one spawned in a throwaway world
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	AWeaponBase* Weapon = World->SpawnActor<AWeaponBase>();
+	if (TestNotNull(TEXT("Weapon spawned"), Weapon))
+	{
+		Weapon->ResetShotSequence();
+		TestEqual(TEXT("First shot index"), static_cast<int32>(Weapon->ConsumeShotIndex()), 0);
+		TestEqual(TEXT("Second shot index"), static_cast<int32>(Weapon->ConsumeShotIndex()), 1);
+
+		//The server takes each index once, in order, and skips over lost shots
+		TestTrue(TEXT("First shot accepted"), Weapon->AcceptShot(AWeaponBase::PackShot(0, 0, false)));
+		TestFalse(TEXT("Duplicate rejected"), Weapon->AcceptShot(AWeaponBase::PackShot(0, 0, false)));
+		TestTrue(TEXT("Next shot accepted"), Weapon->AcceptShot(AWeaponBase::PackShot(1, 0, true)));
+		TestFalse(TEXT("Replayed older shot rejected"), Weapon->AcceptShot(AWeaponBase::PackShot(0, 0, false)));
+		TestTrue(TEXT("Shot after a loss accepted"), Weapon->AcceptShot(AWeaponBase::PackShot(5, 0, false)));
+
+		//Indices wrap at 11 bits without being mistaken for replays
+		Weapon->ResetShotSequence();
+		for (int32 i = 0; i < AWeaponBase::ShotIndexMask; i++)
+		{
+			Weapon->ConsumeShotIndex();
+		}
+		TestEqual(TEXT("Last index before the wrap"), static_cast<int32>(Weapon->ConsumeShotIndex()), static_cast<int32>(AWeaponBase::ShotIndexMask));
+		TestEqual(TEXT("Index wraps to 0"), static_cast<int32>(Weapon->ConsumeShotIndex()), 0);
+		TestTrue(TEXT("Accepts the index before the wrap"), Weapon->AcceptShot(AWeaponBase::PackShot(AWeaponBase::ShotIndexMask - 1, 0, false)));
+		TestTrue(TEXT("Accepts across the wrap"), Weapon->AcceptShot(AWeaponBase::PackShot(1, 0, false)));
+
+		//Epochs wrap at 4 bits - the forward half is newer
+		Weapon->ResetShotSequence(0xE);
+		TestTrue(TEXT("Epoch after the wrap is newer"), Weapon->IsNewerShotEpoch(0x1));
+		TestFalse(TEXT("Same epoch is not newer"), Weapon->IsNewerShotEpoch(0xE));
+		TestFalse(TEXT("Epoch behind is not newer"), Weapon->IsNewerShotEpoch(0xA));
+		Weapon->StartShotEpoch();
+		TestEqual(TEXT("Starting an epoch bumps it"), static_cast<int32>(Weapon->GetShotEpoch()), 0xF);
+		Weapon->StartShotEpoch();
+		TestEqual(TEXT("Epoch wraps to 0"), static_cast<int32>(Weapon->GetShotEpoch()), 0);
+
+		//Spread narrows when aiming down sights
+		float HipSpread = 0.0f;
+		float ADSSpread = 0.0f;
+		for (uint16 ShotIndex = 0; ShotIndex < 200; ShotIndex++)
+		{
+			HipSpread = FMath::Max(HipSpread, FMath::Abs(Weapon->GetShotPattern(ShotIndex, false).SpreadYaw));
+			ADSSpread = FMath::Max(ADSSpread, FMath::Abs(Weapon->GetShotPattern(ShotIndex, true).SpreadYaw));
+		}
+		TestTrue(TEXT("ADS spread is tighter than hip spread"), ADSSpread < HipSpread);
+	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	return true;
+}
+
+namespace HeistShotSequenceTest
+{
+	/** Combat state request on the unreliable RPC - lost, delayed and reordered */
+	struct FCombatMessage
+	{
+		int32 DeliverStep = 0;
+		uint8 Sequence = 0;
+		bool bEquipped = false;
+		uint8 ShotEpoch = 0;
+	};
+
+	/** Shot on the reliable fire RPC - delayed but never lost or reordered */
+	struct FShotMessage
+	{
+		int32 DeliverStep = 0;
+		uint16 PackedShot = 0;
+	};
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHeistShotEpochPacketLossTest, "HeistFPS.Weapon.ShotSequence.PacketLoss", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FHeistShotEpochPacketLossTest::RunTest(const FString& Parameters)
+{
+	using namespace HeistShotSequenceTest;
+
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	//One weapon stands in for the firing client's copy, the other for the server's
+	AWeaponBase* Client = World->SpawnActor<AWeaponBase>();
+	AWeaponBase* Server = World->SpawnActor<AWeaponBase>();
+	if (TestNotNull(TEXT("Client weapon spawned"), Client) && TestNotNull(TEXT("Server weapon spawned"), Server))
+	{
+		//Unequip and re-equip collapse when both requests are lost - the server sees no edge at all
+		Client->StartShotEpoch();
+		Server->ResetShotSequence(Client->GetShotEpoch());
+		for (int32 i = 0; i < 3; i++)
+		{
+			Server->AcceptShot(AWeaponBase::PackShot(Client->ConsumeShotIndex(), Client->GetShotEpoch(), false));
+		}
+		const uint16 Delayed = AWeaponBase::PackShot(Client->ConsumeShotIndex(), Client->GetShotEpoch(), false);
+		Client->StartShotEpoch();
+		TestTrue(TEXT("First shot after a collapsed re-equip accepted"), Server->AcceptShot(AWeaponBase::PackShot(Client->ConsumeShotIndex(), Client->GetShotEpoch(), false)));
+		TestTrue(TEXT("Server moved to the new epoch"), Server->GetShotEpoch() == Client->GetShotEpoch());
+		TestFalse(TEXT("Shot from before the re-equip arriving late is rejected"), Server->AcceptShot(Delayed));
+
+		//5% loss on combat requests, resent until acknowledged, with random delays that reorder them against each other and the shots.
+		//The server side runs the character's own request and shot rules.
+		const float LossPct = 5.0f;
+		const int32 Steps = 20000;
+		const int32 DrainSteps = 100;
+		const int32 ResendSteps = 6;
+		FRandomStream Random(2024);
+
+		Client->ResetShotSequence();
+		Server->ResetShotSequence();
+		bool bClientEquipped = false;
+		uint8 ClientSequence = 0;
+		int32 LastSendStep = 0;
+		bool bServerEquipped = false;
+		FHeistCombatStateAck ServerAck;
+
+		TArray<FCombatMessage> CombatInFlight;
+		TArray<FShotMessage> ShotsInFlight;
+		int32 LastShotDeliverStep = 0;
+		int32 ShotsDelivered = 0;
+		int32 ShotsDropped = 0;
+		int32 EquipCount = 0;
+
+		auto SendCombatState = [&](int32 Step, bool bLossy)
+		{
+			LastSendStep = Step;
+			if (bLossy && Random.FRand() * 100.0f < LossPct) { return; }
+			FCombatMessage& Message = CombatInFlight.AddDefaulted_GetRef();
+			Message.DeliverStep = Step + Random.RandRange(1, 8);
+			Message.Sequence = ClientSequence;
+			Message.bEquipped = bClientEquipped;
+			Message.ShotEpoch = Client->GetShotEpoch();
+		};
+
+		auto ToggleWeapon = [&](int32 Step, bool bLossy)
+		{
+			bClientEquipped = !bClientEquipped;
+			if (bClientEquipped)
+			{
+				Client->StartShotEpoch();
+				EquipCount++;
+			}
+			ClientSequence++;
+			SendCombatState(Step, bLossy);
+		};
+
+		auto FireShot = [&](int32 Step)
+		{
+			FShotMessage& Shot = ShotsInFlight.AddDefaulted_GetRef();
+			Shot.PackedShot = AWeaponBase::PackShot(Client->ConsumeShotIndex(), Client->GetShotEpoch(), false);
+			Shot.DeliverStep = LastShotDeliverStep = FMath::Max(LastShotDeliverStep, Step + Random.RandRange(1, 8));
+		};
+
+		auto Deliver = [&](int32 Step, bool bLossy)
+		{
+			if (ServerAck.Sequence != ClientSequence && Step - LastSendStep >= ResendSteps)
+			{
+				SendCombatState(Step, bLossy);
+			}
+
+			for (int32 Index = CombatInFlight.Num() - 1; Index >= 0; Index--)
+			{
+				const FCombatMessage Message = CombatInFlight[Index];
+				if (Message.DeliverStep > Step) { continue; }
+				CombatInFlight.RemoveAtSwap(Index);
+
+				const uint8 PackedState = (Message.bEquipped ? 1 : 0) | (Message.ShotEpoch << 2);
+				bool bADS = false;
+				AHeistFPSCharacter::ResolveCombatStateRequest(PackedState, Message.Sequence, Server, ServerAck, bServerEquipped, bADS);
+			}
+
+			//Every shot was fired with the weapon out, so none may be dropped whatever the server has seen of the equips
+			while (ShotsInFlight.Num() > 0 && ShotsInFlight[0].DeliverStep <= Step)
+			{
+				const FShotMessage Shot = ShotsInFlight[0];
+				ShotsInFlight.RemoveAt(0, 1, false);
+				ShotsDelivered++;
+				ShotsDropped += AHeistFPSCharacter::ResolveShot(Shot.PackedShot, Server, ServerAck, bServerEquipped) ? 0 : 1;
+			}
+		};
+
+		auto Drain = [&](int32& Step)
+		{
+			for (const int32 Last = Step + DrainSteps; Step < Last; Step++)
+			{
+				Deliver(Step, false);
+			}
+		};
+
+		int32 Step = 0;
+		for (; Step < Steps; Step++)
+		{
+			//The client toggles its weapon now and then and fires whenever it is out
+			if (Random.FRand() < 0.03f)
+			{
+				ToggleWeapon(Step, true);
+			}
+			else if (bClientEquipped)
+			{
+				FireShot(Step);
+			}
+			Deliver(Step, true);
+		}
+
+		TestTrue(TEXT("Simulation equipped often enough to wrap the epoch"), EquipCount > 2 * (AWeaponBase::ShotEpochMask + 1));
+		TestTrue(TEXT("Shots were delivered"), ShotsDelivered > 0);
+		TestEqual(TEXT("No shot fired with the weapon out dropped"), ShotsDropped, 0);
+
+		//Once the link is clean everything in flight lands and the server ends in the client's state
+		Drain(Step);
+		TestTrue(TEXT("Latest request acknowledged"), ServerAck.Sequence == ClientSequence);
+		TestTrue(TEXT("Client and server agree on the weapon being out"), bServerEquipped == bClientEquipped);
+
+		if (!bClientEquipped)
+		{
+			ToggleWeapon(Step, false);
+		}
+		FireShot(Step);
+		Drain(Step);
+		TestEqual(TEXT("Shot on a clean link accepted"), ShotsDropped, 0);
+		TestTrue(TEXT("Server equipped on a clean link"), bServerEquipped);
+		TestTrue(TEXT("Client and server epochs agree"), Server->GetShotEpoch() == Client->GetShotEpoch());
+	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,258 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Weapon/HeistProjectileSubsystem.h"
+#include "HeistFPS.h"
+
+#include "Engine/World.h"
+#include "Engine/CollisionProfile.h"
+#include "Components/SphereComponent.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "CollisionQueryParams.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("ProjectileSimulate"), STAT_HeistProjectileSimulate, STATGROUP_HeistFPS);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectiles In Flight"), STAT_HeistProjectilesInFlight, STATGROUP_HeistFPS);
+
+void UHeistProjectileSubsystem::SpawnProjectile(const FVector& Origin, const FVector& Direction, const FHeistBallistics& Ballistics, AActor* Instigator, bool bAuthoritative, float ExtrapolateSeconds)
+{
+	HEISTFPS_LLM_SCOPE(Weapons);
+	UWorld* World = GetWorld();
+	const float WorldGravityZ = World != nullptr ? World->GetGravityZ() : -980.0f;
+
+	Positions.Add(Origin);
+	Velocities.Add(Direction.GetSafeNormal() * Ballistics.MuzzleSpeed);
+	GravityZ.Add(WorldGravityZ * Ballistics.GravityScale);
+	Drags.Add(Ballistics.Drag);
+	RemainingLifetimes.Add(Ballistics.MaxLifetime);
+	Instigators.Add(Instigator);
+	Authoritative.Add(bAuthoritative);
+
+	//Cosmetic rounds on clients catch up with the server's copy by the time the fire event took to arrive
+	if (ExtrapolateSeconds > 0.0f)
+	{
+		const int32 Index = Positions.Num() - 1;
+		float Remaining = ExtrapolateSeconds;
+		while (Remaining > 0.0f)
+		{
+			const float Step = FMath::Min(Remaining, MaxSubstepTime);
+			FVector& Velocity = Velocities[Index];
+			Velocity += (FVector(0.0f, 0.0f, GravityZ[Index]) - Velocity * Velocity.Size() * Drags[Index]) * Step;
+			Positions[Index] += Velocity * Step;
+			Remaining -= Step;
+		}
+		RemainingLifetimes[Index] -= ExtrapolateSeconds;
+	}
+}
+
+void UHeistProjectileSubsystem::Tick(float DeltaTime)
+{
+	HEISTFPS_LLM_SCOPE(Weapons);
+	Simulate(DeltaTime);
+}
+
+TStatId UHeistProjectileSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UHeistProjectileSubsystem, STATGROUP_Tickables);
+}
+
+void UHeistProjectileSubsystem::Simulate(float DeltaTime)
+{
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistProjectileSimulate);
+	SET_DWORD_STAT(STAT_HeistProjectilesInFlight, Positions.Num());
+
+	UWorld* World = GetWorld();
+	if (World == nullptr) { return; }
+
+	//Expired rounds are removed before anything is traced
+	for (int32 Index = Positions.Num() - 1; Index >= 0; Index--)
+	{
+		RemainingLifetimes[Index] -= DeltaTime;
+		if (RemainingLifetimes[Index] <= 0.0f)
+		{
+			RemoveProjectile(Index);
+		}
+	}
+
+	const int32 NumProjectiles = Positions.Num();
+	if (NumProjectiles == 0) { return; }
+
+	const int32 NumSubsteps = FMath::Max(1, FMath::CeilToInt(DeltaTime / MaxSubstepTime));
+	const float SubstepTime = DeltaTime / NumSubsteps;
+
+	//Weak pointers are resolved here on the game thread, the trace tasks only read the results
+	TraceInstigators.SetNumUninitialized(NumProjectiles, false);
+	TraceHits.SetNum(NumProjectiles, false);
+	TraceBlocked.SetNumUninitialized(NumProjectiles, false);
+	for (int32 Index = 0; Index < NumProjectiles; Index++)
+	{
+		TraceInstigators[Index] = Instigators[Index].Get();
+	}
+
+	//Rounds are integrated and traced in batches across worker threads - scene queries only take a read lock
+	const int32 NumBatches = FMath::DivideAndRoundUp(NumProjectiles, TraceBatchSize);
+	ParallelFor(NumBatches, [this, World, NumProjectiles, NumSubsteps, SubstepTime](int32 Batch)
+	{
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(HeistProjectileTrace), true);
+		QueryParams.bReturnPhysicalMaterial = true;
+
+		const int32 End = FMath::Min((Batch + 1) * TraceBatchSize, NumProjectiles);
+		for (int32 Index = Batch * TraceBatchSize; Index < End; Index++)
+		{
+			//Integrate gravity and quadratic drag in fixed sub-steps
+			const FVector Start = Positions[Index];
+			FVector Position = Start;
+			FVector Velocity = Velocities[Index];
+			const FVector Gravity(0.0f, 0.0f, GravityZ[Index]);
+			const float Drag = Drags[Index];
+			for (int32 Step = 0; Step < NumSubsteps; Step++)
+			{
+				Velocity += (Gravity - Velocity * Velocity.Size() * Drag) * SubstepTime;
+				Position += Velocity * SubstepTime;
+			}
+
+			//One trace per round per tick along the chord of the sub-stepped path
+			QueryParams.ClearIgnoredActors();
+			QueryParams.AddIgnoredActor(TraceInstigators[Index]);
+			TraceBlocked[Index] = World->LineTraceSingleByChannel(TraceHits[Index], Start, Position, ECC_Visibility, QueryParams);
+
+			Positions[Index] = Position;
+			Velocities[Index] = Velocity;
+		}
+	}, NumBatches == 1);
+
+	//Impacts are reported on the game thread. Iterating backwards, a round swapped into a removed slot has already been handled.
+	for (int32 Index = NumProjectiles - 1; Index >= 0; Index--)
+	{
+		if (!TraceBlocked[Index]) { continue; }
+
+		if (Authoritative[Index])
+		{
+			OnProjectileImpact.Broadcast(TraceInstigators[Index], TraceHits[Index]);
+		}
+		RemoveProjectile(Index);
+	}
+}
+
+void UHeistProjectileSubsystem::ClearProjectiles()
+{
+	Positions.Reset();
+	Velocities.Reset();
+	GravityZ.Reset();
+	Drags.Reset();
+	RemainingLifetimes.Reset();
+	Instigators.Reset();
+	Authoritative.Reset();
+}
+
+void UHeistProjectileSubsystem::RemoveProjectile(int32 Index)
+{
+	Positions.RemoveAtSwap(Index, 1, false);
+	Velocities.RemoveAtSwap(Index, 1, false);
+	GravityZ.RemoveAtSwap(Index, 1, false);
+	Drags.RemoveAtSwap(Index, 1, false);
+	RemainingLifetimes.RemoveAtSwap(Index, 1, false);
+	Instigators.RemoveAtSwap(Index, 1, false);
+	Authoritative.RemoveAtSwap(Index, 1, false);
+}
+
+/********************************************************************
+				BENCHMARK
+*********************************************************************/
+static FAutoConsoleCommandWithWorldAndArgs HeistBenchProjectilesCommand(
+	TEXT("heist.Bench.Projectiles"),
+	TEXT("heist.Bench.Projectiles [Count=10000] - times 60 simulated frames of Count pooled rounds against Count projectile actors with a sphere and UProjectileMovementComponent. Run with no rounds in flight."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		UHeistProjectileSubsystem* Projectiles = World != nullptr ? World->GetSubsystem<UHeistProjectileSubsystem>() : nullptr;
+		if (Projectiles == nullptr) { return; }
+
+		//The benchmark clears the subsystem afterwards, so it must not start with real rounds in it
+		if (Projectiles->GetNumProjectiles() > 0)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("heist.Bench.Projectiles: %d rounds in flight - run it when no one is firing."), Projectiles->GetNumProjectiles());
+			return;
+		}
+
+		const int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000;
+		const int32 Frames = 60;
+		const float FrameTime = 1.0f / 60.0f;
+		FHeistBallistics Ballistics;
+		Ballistics.MaxLifetime = 10.0f;
+
+		//Fire straight up from high above the level so rounds stay in flight for the whole run
+		const FVector Origin(0.0f, 0.0f, 100000.0f);
+		TArray<FVector> Starts;
+		TArray<FVector> Directions;
+		FRandomStream Random(1234);
+		for (int32 i = 0; i < Count; i++)
+		{
+			Starts.Add(Origin + Random.VRand() * 1000.0f);
+			Directions.Add((FVector::UpVector + Random.VRand() * 0.1f).GetSafeNormal());
+		}
+
+		const double PooledStart = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Count; i++)
+		{
+			Projectiles->SpawnProjectile(Starts[i], Directions[i], Ballistics, nullptr, false);
+		}
+		const double PooledSpawnMs = (FPlatformTime::Seconds() - PooledStart) * 1000.0;
+		const double PooledSimulateStart = FPlatformTime::Seconds();
+		for (int32 Frame = 0; Frame < Frames; Frame++)
+		{
+			Projectiles->Simulate(FrameTime);
+		}
+		const double PooledFrameMs = (FPlatformTime::Seconds() - PooledSimulateStart) * 1000.0 / Frames;
+		const int32 PooledInFlight = Projectiles->GetNumProjectiles();
+		Projectiles->ClearProjectiles();
+
+		//The per-actor path a projectile actor takes - spawn, a swept move per tick from its movement component, destroy
+		const double ActorStart = FPlatformTime::Seconds();
+		TArray<AActor*> Actors;
+		TArray<UProjectileMovementComponent*> Movements;
+		Actors.Reserve(Count);
+		Movements.Reserve(Count);
+		for (int32 i = 0; i < Count; i++)
+		{
+			FActorSpawnParameters SpawnInfo;
+			SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+			AActor* Actor = World->SpawnActor<AActor>(AActor::StaticClass(), Starts[i], FRotator::ZeroRotator, SpawnInfo);
+			if (Actor == nullptr) { continue; }
+
+			USphereComponent* Sphere = NewObject<USphereComponent>(Actor);
+			Sphere->InitSphereRadius(1.0f);
+			Sphere->SetCollisionProfileName(UCollisionProfile::BlockAllDynamic_ProfileName);
+			Actor->SetRootComponent(Sphere);
+			Sphere->SetWorldLocation(Starts[i]);
+			Sphere->RegisterComponent();
+
+			UProjectileMovementComponent* Movement = NewObject<UProjectileMovementComponent>(Actor);
+			Movement->SetUpdatedComponent(Sphere);
+			Movement->Velocity = Directions[i] * Ballistics.MuzzleSpeed;
+			Movement->ProjectileGravityScale = Ballistics.GravityScale;
+			Movement->RegisterComponent();
+
+			Actors.Add(Actor);
+			Movements.Add(Movement);
+		}
+		const double ActorSpawnMs = (FPlatformTime::Seconds() - ActorStart) * 1000.0;
+
+		const double ActorSimulateStart = FPlatformTime::Seconds();
+		for (int32 Frame = 0; Frame < Frames; Frame++)
+		{
+			for (UProjectileMovementComponent* Movement : Movements)
+			{
+				Movement->TickComponent(FrameTime, LEVELTICK_All, nullptr);
+			}
+		}
+		const double ActorFrameMs = (FPlatformTime::Seconds() - ActorSimulateStart) * 1000.0 / Frames;
+
+		for (AActor* Actor : Actors)
+		{
+			Actor->Destroy();
+		}
+
+		UE_LOG(LogTemp, Log, TEXT("heist.Bench.Projectiles: %d rounds - pooled: spawn %.3f ms, %.3f ms per frame (%d in flight) | actors: spawn %.3f ms, %.3f ms per frame."),
+			Count, PooledSpawnMs, PooledFrameMs, PooledInFlight, ActorSpawnMs, ActorFrameMs);
+	}));
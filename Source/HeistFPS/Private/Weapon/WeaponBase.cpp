@@ -2,19 +2,34 @@
 
 
 #include "Weapon/WeaponBase.h"
+#include "HeistFPS.h"
+#include "Net/HeistNetTelemetrySubsystem.h"
+#include "NPC/HeistCrowdSubsystem.h"
+#include "Replay/HeistReplaySubsystem.h"
 #include "Particles/ParticleSystemComponent.h"
 #include "NiagaraFunctionLibrary.h"
 #include "Camera/CameraComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "Net/UnrealNetwork.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("SimulateWeaponFire"), STAT_HeistSimulateWeaponFire, STATGROUP_HeistFPS);
 
 // Sets default values
 AWeaponBase::AWeaponBase()
 {
+	HEISTFPS_LLM_SCOPE(Weapons);
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
 
 	WeaponMesh = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("WeaponMesh"));
 	SetRootComponent(WeaponMesh);
 	bReplicates = true;
+	// Relevant exactly when the character carrying it is
+	bNetUseOwnerRelevancy = true;
 
 	// Create a camera
 	ADSCamera = CreateDefaultSubobject<UCameraComponent>(TEXT("ADSCamera"));
@@ -24,7 +39,13 @@ AWeaponBase::AWeaponBase()
 // Called when the game starts or when spawned
 void AWeaponBase::BeginPlay()
 {
+	HEISTFPS_LLM_SCOPE(Weapons);
 	Super::BeginPlay();
+	if (HasAuthority())
+	{
+		SpreadSeed = FMath::Rand();
+		NextSpreadSeed = FMath::Rand();
+	}
 	if (WeaponMesh)
 	{
 		ADSCamera->AttachToComponent(WeaponMesh, FAttachmentTransformRules::SnapToTargetNotIncludingScale, ADSCameraAttachPoint);
@@ -39,9 +60,211 @@ void AWeaponBase::Tick(float DeltaTime)
 
 }
 
+FVector AWeaponBase::GetMuzzleLocation() const
+{
+	if (WeaponMesh && MuzzleAttachPoint != NAME_None)
+	{
+		return WeaponMesh->GetSocketLocation(MuzzleAttachPoint);
+	}
+	return GetActorLocation();
+}
+
+void AWeaponBase::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	DOREPLIFETIME(AWeaponBase, SpreadSeed);
+	DOREPLIFETIME_CONDITION(AWeaponBase, NextSpreadSeed, COND_OwnerOnly);
+}
+
+void AWeaponBase::StartShotEpoch()
+{
+	ResetShotSequence(ShotEpoch + 1);
+}
+
+void AWeaponBase::ResetShotSequence(uint8 Epoch)
+{
+	Epoch &= ShotEpochMask;
+
+	// A new epoch is a new equip, which moves both sides onto the seed the owner was sent ahead of time. The client
+	// only ever copies NextSpreadSeed, so several equips the server saw as one still land on the same seed.
+	const bool bNewer = IsNewerShotEpoch(Epoch);
+	if (bNewer)
+	{
+		SpreadSeed = NextSpreadSeed;
+		if (HasAuthority())
+		{
+			NextSpreadSeed = FMath::Rand();
+		}
+	}
+	if (!bNewer || IsBeyondShotEpochHorizon(Epoch))
+	{
+		ShotEpochHorizon = Epoch;
+	}
+	ShotEpoch = Epoch;
+	NextShotIndex = 0;
+	LastAcceptedShotIndex = ShotIndexMask;
+}
+
+bool AWeaponBase::IsNewerShotEpoch(uint8 Epoch) const
+{
+	// Forward half of the 4 bit space is newer, the back half is from an earlier equip. Equips the server has
+	// heard of stretch the forward range, so a run of equips without a shot can't wrap around into looking old.
+	const uint8 Delta = (Epoch - ShotEpoch) & ShotEpochMask;
+	const uint8 Horizon = (ShotEpochHorizon - ShotEpoch) & ShotEpochMask;
+	return Delta != 0 && Delta <= FMath::Max<uint8>(Horizon, ShotEpochMask >> 1);
+}
+
+void AWeaponBase::ExtendShotEpochHorizon(uint8 Epoch)
+{
+	Epoch &= ShotEpochMask;
+	if (IsNewerShotEpoch(Epoch) && IsBeyondShotEpochHorizon(Epoch))
+	{
+		ShotEpochHorizon = Epoch;
+	}
+}
+
+bool AWeaponBase::IsBeyondShotEpochHorizon(uint8 Epoch) const
+{
+	return ((Epoch - ShotEpoch) & ShotEpochMask) > ((ShotEpochHorizon - ShotEpoch) & ShotEpochMask);
+}
+
+uint16 AWeaponBase::ConsumeShotIndex()
+{
+	const uint16 ShotIndex = NextShotIndex;
+	NextShotIndex = (NextShotIndex + 1) & ShotIndexMask;
+	return ShotIndex;
+}
+
+bool AWeaponBase::AcceptShot(uint16 PackedShot)
+{
+	const uint8 Epoch = UnpackShotEpoch(PackedShot);
+	if (Epoch != ShotEpoch)
+	{
+		// Shots from before a re-equip are stale. A newer epoch is a re-equip whose combat state never reached us.
+		if (!IsNewerShotEpoch(Epoch))
+		{
+			return false;
+		}
+		ResetShotSequence(Epoch);
+	}
+
+	// Distance forward in 11 bit space - anything in the back half is a replay or a duplicate
+	const uint16 ShotIndex = UnpackShotIndex(PackedShot);
+	const uint16 Delta = (ShotIndex - LastAcceptedShotIndex) & ShotIndexMask;
+	if (Delta == 0 || Delta > (ShotIndexMask >> 1))
+	{
+		return false;
+	}
+	LastAcceptedShotIndex = ShotIndex;
+	return true;
+}
+
+FHeistShotPattern FHeistShotPatternGenerator::Generate(uint16 ShotIndex, bool bAimDownSight) const
+{
+	// FRandomStream only uses integer math and bit casts, so the draws match bit for bit across builds
+	FRandomStream Stream(static_cast<int32>(HashCombine(static_cast<uint32>(Seed), ShotIndex)));
+	const float Spread = bAimDownSight ? ADSSpreadDegrees : HipSpreadDegrees;
+
+	FHeistShotPattern Pattern;
+	Pattern.SpreadPitch = Stream.FRandRange(-Spread, Spread);
+	Pattern.SpreadYaw = Stream.FRandRange(-Spread, Spread);
+	Pattern.RecoilPitch = RecoilPitchDegrees * Stream.FRandRange(0.8f, 1.2f);
+	Pattern.RecoilYaw = Stream.FRandRange(-RecoilYawDegrees, RecoilYawDegrees);
+	return Pattern;
+}
+
+uint32 FHeistShotPatternGenerator::Checksum(int32 Count) const
+{
+	uint32 Crc = 0;
+	for (int32 ShotIndex = 0; ShotIndex < Count; ShotIndex++)
+	{
+		const FHeistShotPattern Pattern = Generate(ShotIndex & AWeaponBase::ShotIndexMask, (ShotIndex & 1) != 0);
+		Crc = FCrc::MemCrc32(&Pattern, sizeof(Pattern), Crc);
+	}
+	return Crc;
+}
+
+FHeistShotPattern AWeaponBase::GetShotPattern(uint16 ShotIndex, bool bAimDownSight) const
+{
+	return GetShotPatternGenerator().Generate(ShotIndex, bAimDownSight);
+}
+
+FHeistShotPatternGenerator AWeaponBase::GetShotPatternGenerator() const
+{
+	FHeistShotPatternGenerator Generator;
+	Generator.Seed = SpreadSeed;
+	Generator.HipSpreadDegrees = HipSpreadDegrees;
+	Generator.ADSSpreadDegrees = ADSSpreadDegrees;
+	Generator.RecoilPitchDegrees = RecoilPitchDegrees;
+	Generator.RecoilYawDegrees = RecoilYawDegrees;
+	return Generator;
+}
+
+FVector AWeaponBase::GetShotDirection(const FRotator& Aim, const FHeistShotPattern& Pattern)
+{
+	return FRotator(Aim.Pitch + Pattern.SpreadPitch, Aim.Yaw + Pattern.SpreadYaw, 0.0f).Vector();
+}
+
+void AWeaponBase::MulticastFire_Implementation(uint16 PackedShot, uint16 AimPitch, uint16 AimYaw)
+{
+	UHeistReplaySubsystem::RecordShot(this, PackedShot, AimPitch, AimYaw);
+
+	if (HasAuthority())
+	{
+		UHeistCrowdSubsystem::ReportNoise(this, GetMuzzleLocation(), NoiseRadius);
+	}
+
+	// The server and the shooting client have already simulated this round
+	APawn* Shooter = GetInstigator();
+	if (HasAuthority() || Shooter == nullptr || Shooter->IsLocallyControlled())
+	{
+		return;
+	}
+	SimulateWeaponFire();
+
+	// Rebuild the shot from the index alone - remote clients know the seed and the shooter's position
+	const FRotator Aim(FRotator::DecompressAxisFromShort(AimPitch), FRotator::DecompressAxisFromShort(AimYaw), 0.0f);
+	const FHeistShotPattern Pattern = GetShotPattern(UnpackShotIndex(PackedShot), UnpackAimDownSight(PackedShot));
+
+	// Extrapolate by half the local round trip so the cosmetic round lines up with the server's
+	float ExtrapolateSeconds = 0.0f;
+	APlayerController* LocalPC = GetWorld()->GetFirstPlayerController();
+	if (LocalPC != nullptr && LocalPC->PlayerState != nullptr)
+	{
+		ExtrapolateSeconds = LocalPC->PlayerState->ExactPing * 0.0005f;
+	}
+
+	UHeistProjectileSubsystem* Projectiles = GetWorld()->GetSubsystem<UHeistProjectileSubsystem>();
+	if (Projectiles != nullptr)
+	{
+		Projectiles->SpawnProjectile(Shooter->GetPawnViewLocation(), GetShotDirection(Aim, Pattern), Ballistics, Shooter, false, ExtrapolateSeconds);
+	}
+}
+
+// Weapons only replicate engine state - visibility and attachment change on equip
+void AWeaponBase::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	UHeistNetTelemetrySubsystem* Telemetry = UHeistNetTelemetrySubsystem::Get(this);
+	if (Telemetry == nullptr) { return; }
+
+	static const FName HiddenName(TEXT("bHidden"));
+	static const FName AttachmentReplicationName(TEXT("AttachmentReplication"));
+
+	const bool bIsHidden = IsHidden();
+	Telemetry->RecordPropertyIfChanged(this, HiddenName, bIsHidden);
+
+	const FRepAttachment& Attachment = GetAttachmentReplication();
+	Telemetry->RecordPropertyIfChanged(this, AttachmentReplicationName, HashCombine(GetTypeHash(Attachment.AttachParent), GetTypeHash(Attachment.AttachSocket)), sizeof(FRepAttachment));
+}
+
 //Play cosmetic aspects of weapon firing - FX etc.
 void AWeaponBase::SimulateWeaponFire()
 {
+	HEISTFPS_SCOPE_CYCLE_COUNTER(STAT_HeistSimulateWeaponFire);
+	HEISTFPS_LLM_SCOPE(FX);
+
 	if (WeaponMesh && MuzzleFX) {
 		FVector LocationOffset = FVector(0.0f, 0.0f, 0.0f);
 		FRotator RotationOffset = FRotator(90.0f, 0.0f, 0.0f);
@@ -49,3 +272,20 @@ void AWeaponBase::SimulateWeaponFire()
 	}
 }
 
+uint32 AWeaponBase::ChecksumShotSequence(int32 Seed, int32 Count)
+{
+	FHeistShotPatternGenerator Generator = GetDefault<AWeaponBase>()->GetShotPatternGenerator();
+	Generator.Seed = Seed;
+	return Generator.Checksum(Count);
+}
+
+static FAutoConsoleCommand HeistDumpShotSequenceCommand(
+	TEXT("heist.Weapon.DumpShotSequence"),
+	TEXT("heist.Weapon.DumpShotSequence <Seed> [Count=1000] - prints a CRC of the spread and recoil draws for Count shots."),
+	FConsoleCommandWithArgsDelegate::CreateStatic([](const TArray<FString>& Args)
+	{
+		if (Args.Num() == 0) { return; }
+		const int32 Count = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 1000;
+		const uint32 Crc = AWeaponBase::ChecksumShotSequence(FCString::Atoi(*Args[0]), Count);
+		UE_LOG(LogTemp, Log, TEXT("heist.Weapon.DumpShotSequence: seed %s, %d shots, crc %08x"), *Args[0], Count, Crc);
+	}));
\ No newline at end of file
@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "HeistDamageSubsystem.generated.h"
+
+class AHeistFPSCharacter;
+
+/** Damage dealt by rounds from a weapon */
+USTRUCT(BlueprintType)
+struct FHeistDamageProfile
+{
+	GENERATED_BODY()
+public:
+	/** Damage of a body hit closer than FalloffStart */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	float BaseDamage = 25.0f;
+
+	/** Applied to hits on the head, which also bypass armor */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	float HeadshotMultiplier = 2.5f;
+
+	/** Distance in cm at which damage starts to fall off */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	float FalloffStart = 2000.0f;
+
+	/** Distance in cm at which damage reaches MinDamageScale */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	float FalloffEnd = 6000.0f;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	float MinDamageScale = 0.4f;
+};
+
+/** A death resolved by the server, sent to clients with the rest of its frame's deaths */
+USTRUCT(BlueprintType)
+struct FHeistDeathEvent
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(BlueprintReadOnly)
+	AHeistFPSCharacter* Victim = nullptr;
+
+	UPROPERTY(BlueprintReadOnly)
+	class APlayerState* Killer = nullptr;
+
+	UPROPERTY(BlueprintReadOnly)
+	bool bHeadshot = false;
+};
+
+/**
+ * Server damage pipeline. Projectile impacts on characters are queued as they happen and resolved in
+ * one batch at the end of the frame: hits are grouped by victim, armor and health are written once
+ * per victim, and every death of the frame goes to clients in a single AHeistFPSGameState multicast.
+ *
+ * heist.Damage.Batched 0 resolves and broadcasts each hit immediately instead, for comparing the two
+ * in the perf harness.
+ */
+UCLASS(Config = Game)
+class HEISTFPS_API UHeistDamageSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return !IsTemplate() && PendingHits.Num() > 0; }
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+
+	/** Server - queues a hit to be resolved with the rest of this frame's hits */
+	void QueueHit(AHeistFPSCharacter* Victim, AController* Instigator, const FHeistDamageProfile& Profile, float Distance, bool bHeadshot);
+
+	/** Damage of a single round before armor */
+	static float ComputeDamage(const FHeistDamageProfile& Profile, float Distance, bool bHeadshot);
+
+	/** Totals since the world started, read by the perf harness */
+	int32 GetNumHitsResolved() const { return NumHitsResolved; }
+	int32 GetNumDeathBroadcasts() const { return NumDeathBroadcasts; }
+
+	/** Hits on this bone count as headshots */
+	UPROPERTY(Config)
+	FName HeadBoneName = TEXT("head");
+
+	/** Capsule hits above this share of the half height over the capsule centre count as headshots */
+	UPROPERTY(Config)
+	float HeadshotHeightFraction = 0.7f;
+
+private:
+	struct FPendingHit
+	{
+		TWeakObjectPtr<AHeistFPSCharacter> Victim;
+		TWeakObjectPtr<AController> Instigator;
+		float Damage;
+		bool bHeadshot;
+	};
+	TArray<FPendingHit> PendingHits;
+	TArray<FHeistDeathEvent> PendingDeaths;
+
+	int32 NumHitsResolved = 0;
+	int32 NumDeathBroadcasts = 0;
+
+	FDelegateHandle ImpactHandle;
+
+	void OnProjectileImpact(AActor* Instigator, const FHitResult& Hit);
+
+	/** Applies every queued hit and collects the resulting deaths */
+	void ResolveHits();
+
+	/** Sends the collected deaths to clients in one multicast */
+	void BroadcastDeaths();
+};
@@ -4,8 +4,11 @@
 
 #include "CoreMinimal.h"
 #include "Engine/GameInstance.h"
+#include "Async/Future.h"
+#include "Game/HeistProfileFormat.h"
 #include "Game/MenuInterface.h"
 #include "Interfaces/OnlineSessionInterface.h"
+#include "OnlineSessionSettings.h"
 #include "HeistFPSGameInstance.generated.h"
 
 USTRUCT(BlueprintType)
@@ -20,7 +23,18 @@ public:
 		FText MapDescription;
 };
 
-UCLASS()
+/** Steps of the asynchronous host flow driven by HostMap */
+UENUM()
+enum class EHostState : uint8
+{
+	Idle,
+	Creating,
+	Updating,
+	Destroying,
+	Travelling
+};
+
+UCLASS(Config = Game)
 class HEISTFPS_API UHeistFPSGameInstance : public UGameInstance, public IMenuInterface
 {
 	GENERATED_BODY()
@@ -31,36 +45,164 @@ public:
 
 	virtual void Init() override;
 
+	/** Waits for a profile save still being written */
+	virtual void Shutdown() override;
+
 	UFUNCTION(BlueprintCallable)
 	void LoadMainMenu();
 
 	void TogglePauseMenu();
 
+	/** Maps offered in the host menu - the first entry is used when nothing else is chosen */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = Hosting)
+	TArray<FMapInfo> HostableMaps;
+
+	/** Defaults for the host menu, overridable with -MaxPlayers=, -LAN/-NoLAN and -HostMap= */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = Hosting)
+	FHostSettings DefaultHostSettings;
+
+	/** Upper bound for MaxPlayers regardless of what the menu or command line asks for */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = Hosting)
+	int32 MaxPlayersLimit = 32;
+
+	/** Upper bound for MaxSpectators regardless of what the command line asks for */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = Hosting)
+	int32 MaxSpectatorsLimit = 64;
+
+	/** Maximum number of results returned by a session search */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = Hosting)
+	int32 MaxSearchResults = 100;
+
+	/** Uses the in-process mock session backend instead of the online subsystem - also set by -MockSessions */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = Hosting)
+	bool bUseMockSessions = false;
+
+	/** Profile file under Saved/SaveGames */
+	UPROPERTY(Config, EditAnywhere, Category = Profile)
+	FString ProfileFileName = TEXT("Profile.hprofile");
+
+	const FHeistProfile& GetProfile() const { return Profile; }
+
+	/** Sets the loadout sent on the next join and saves the profile */
+	void SetLoadout(const TArray<uint16>& Loadout);
+
+	/** Writes the profile off the game thread, replacing the file only once the new one is complete */
+	void SaveProfile();
+
+	/** Refreshes the main menu's server list against NumSessions mock sessions Runs times in a row and logs the time per refresh */
+	void StartSessionBenchmark(int32 NumSessions, int32 Runs);
+
+	/** Session backend picked in Init - the mock one when bUseMockSessions is set */
+	IOnlineSessionPtr GetSessionInterface() const { return SessionInterface; }
+
+	EHostState GetHostState() const { return HostState; }
+
+	/** Failed host attempts since HostMap was last called */
+	int32 GetHostAttempts() const { return HostAttempts; }
+
+	int32 GetMaxHostAttempts() const { return MaxHostAttempts; }
+
+	/** Sessions found by the last server list refresh */
+	int32 GetNumSearchResults() const;
+
 protected:
-	UFUNCTION()
-	void HostMap() override;
+	void HostMap(const FHostSettings& Settings) override;
+	FHostSettings GetDefaultHostSettings() const override;
+	TArray<FText> GetHostableMapNames() const override;
 	UFUNCTION()
 	void JoinMap(uint32 SessionIndex) override;
 	UFUNCTION()
+	void SpectateMap(uint32 SessionIndex) override;
+	UFUNCTION()
 	void QuitGame() override;
 	UFUNCTION()
 	void RefreshServerList() override;
 
 private:
-	TSubclassOf<class UUserWidget> PauseMenuClass;
-	class UUserWidget* PauseMenu;
-
-	TSubclassOf<class UUserWidget> MainMenuClass;
-	class UMainMenu* MainMenu;
+	/** Cached by UHeistUISubsystem - set once the main menu has been shown */
+	class UMainMenu* MainMenu = nullptr;
 
 	IOnlineSessionPtr SessionInterface;
 
 	TSharedPtr<class FOnlineSessionSearch> SessionSearch;
 
+	/** Settings of the host request currently in flight */
+	FHostSettings PendingHostSettings;
+
+	/** Current step of the host flow - HostMap is ignored unless Idle */
+	EHostState HostState = EHostState::Idle;
+
+	/** Number of failed host attempts since HostMap was called */
+	int32 HostAttempts = 0;
+
+	/** Host attempts allowed before giving up and returning control to the menu */
+	int32 MaxHostAttempts = 3;
+
+	/** Seconds between a failed host step and the next attempt, scaled by attempt count */
+	float HostRetryDelay = 0.5f;
+
+	/** Timestamps used to log host latency per step and in total */
+	double HostStartTime = 0.0;
+	double HostStepStartTime = 0.0;
+
+	FTimerHandle HostRetryTimerHandle;
+
 	void OnCreateSessionComplete(FName SessionName, bool Success);
+	void OnUpdateSessionComplete(FName SessionName, bool Success);
 	void OnDestroySessionComplete(FName SessionName, bool Success);
 	void OnFindSessionsComplete(bool Success);
 	void OnJoinSessionComplete(FName SessionName, EOnJoinSessionCompleteResult::Type Result);
 
 	void CreateSession();
+
+	FOnlineSessionSettings MakeSessionSettings() const;
+
+	/** Applies command line overrides on top of the configured host defaults */
+	void ParseHostCommandLine();
+
+	FString GetHostedMapURL() const;
+
+	/** Picks the cheapest way to get a hosted session: update an existing one in place or create a new one */
+	void StartHostStep();
+
+	void SetHostState(EHostState NewState);
+
+	/** Destroys and recreates the session after a delay, or gives up once MaxHostAttempts is reached */
+	void HandleHostFailure(const TCHAR* Reason);
+
+	void TravelToHostedMap();
+
+	/** Joins the session at SessionIndex as a player or as a spectator-only observer */
+	void JoinSessionAt(uint32 SessionIndex, bool bAsSpectator);
+
+	/** Set by SpectateMap and consumed when the join completes */
+	bool bJoinAsSpectator = false;
+
+	/** Time the current server list refresh was requested */
+	double SearchStartTime = 0.0;
+
+	int32 SessionBenchmarkRuns = 0;
+	int32 SessionBenchmarkRunsLeft = 0;
+	double SessionBenchmarkTotalMs = 0.0;
+	double SessionBenchmarkWorstMs = 0.0;
+	double SessionBenchmarkListMs = 0.0;
+
+	/** Values the benchmark overrides, put back once it finishes */
+	int32 SessionBenchmarkSavedMaxSearchResults = 0;
+	int32 SessionBenchmarkSavedSessionCount = 0;
+
+	/** Records a finished refresh and starts the next one while runs are left */
+	void UpdateSessionBenchmark(double ListMs);
+
+	FHeistProfile Profile;
+
+	TFuture<void> PendingProfileWrite;
+
+	FString GetProfilePath() const;
+
+	/** Reads the profile written by SaveProfile, keeping the defaults if there is none or it cannot be read */
+	void LoadProfile();
+
+	/** ?Loadout= login option for the current profile, empty for the character's default weapons */
+	FString GetLoadoutOption() const;
 };
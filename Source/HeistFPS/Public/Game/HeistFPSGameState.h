@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/GameStateBase.h"
+#include "Game/HeistDamageSubsystem.h"
+#include "HeistFPSGameState.generated.h"
+
+/** Two bytes per objective - steps done out of steps required */
+USTRUCT(BlueprintType)
+struct FHeistObjectiveProgress
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(BlueprintReadOnly)
+	uint8 Completed = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	uint8 Required = 0;
+
+	bool IsComplete() const { return Required > 0 && Completed >= Required; }
+};
+
+UENUM(BlueprintType)
+enum class EHeistRoundPhase : uint8
+{
+	WaitingForPlayers,
+	InProgress,
+	/** Between rounds - nobody respawns until the next one starts */
+	RoundOver
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnHeistDeaths, const TArray<FHeistDeathEvent>& /*Deaths*/);
+DECLARE_MULTICAST_DELEGATE(FOnHeistObjectivesChanged);
+
+UCLASS()
+class HEISTFPS_API AHeistFPSGameState : public AGameStateBase
+{
+	GENERATED_BODY()
+
+public:
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** Every death the server resolved in one frame */
+	UFUNCTION(NetMulticast, Reliable)
+	void MulticastDeaths(const TArray<FHeistDeathEvent>& Deaths);
+
+	/** Broadcast on the server and every client for each batch of deaths, e.g. for a kill feed */
+	FOnHeistDeaths OnDeaths;
+
+	/** Server - adds a required step to objective Index, registered by each interactable counting towards it */
+	void AddObjectiveStep(int32 Index);
+
+	/** Server - completes one step of objective Index */
+	void AdvanceObjective(int32 Index);
+
+	/** Server - adds to the secured loot total */
+	void AddLoot(int32 Value);
+
+	const TArray<FHeistObjectiveProgress>& GetObjectives() const { return Objectives; }
+
+	UFUNCTION(BlueprintPure, Category = Heist)
+	int32 GetLootValue() const { return LootValue; }
+
+	/** True once every objective with steps is complete */
+	UFUNCTION(BlueprintPure, Category = Heist)
+	bool AreObjectivesComplete() const;
+
+	/** Broadcast on the server and every client when objective progress or loot changes, e.g. for the HUD */
+	FOnHeistObjectivesChanged OnObjectivesChanged;
+
+	/** Server - clears objective progress and loot for a new round, keeping the required steps */
+	void ResetObjectives();
+
+	/** Server - enters Phase for Seconds, 0 for no time limit */
+	void SetRoundPhase(EHeistRoundPhase Phase, float Seconds);
+
+	UFUNCTION(BlueprintPure, Category = Heist)
+	EHeistRoundPhase GetRoundPhase() const { return RoundPhase; }
+
+	UFUNCTION(BlueprintPure, Category = Heist)
+	int32 GetRoundNumber() const { return RoundNumber; }
+
+	/** Seconds left in the current phase, 0 without a time limit */
+	UFUNCTION(BlueprintPure, Category = Heist)
+	float GetPhaseSecondsRemaining() const;
+
+protected:
+	UFUNCTION()
+	void OnRep_Objectives();
+
+	UPROPERTY(ReplicatedUsing = OnRep_Objectives)
+	TArray<FHeistObjectiveProgress> Objectives;
+
+	UPROPERTY(ReplicatedUsing = OnRep_Objectives)
+	int32 LootValue = 0;
+
+	UPROPERTY(Replicated)
+	EHeistRoundPhase RoundPhase = EHeistRoundPhase::WaitingForPlayers;
+
+	/** Server world time the phase ends at, 0 without a time limit */
+	UPROPERTY(Replicated)
+	float PhaseEndTime = 0.0f;
+
+	UPROPERTY(Replicated)
+	int32 RoundNumber = 0;
+};
@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/GameSession.h"
+#include "HeistGameSession.generated.h"
+
+/**
+ * Keeps spectator-only players out of the online session so observers never take one of the
+ * NumPublicConnections slots. Their capacity is limited by MaxSpectators instead.
+ */
+UCLASS()
+class HEISTFPS_API AHeistGameSession : public AGameSession
+{
+	GENERATED_BODY()
+
+public:
+	virtual void RegisterPlayer(APlayerController* NewPlayer, const TSharedPtr<const FUniqueNetId>& UniqueId, bool bWasFromInvite) override;
+
+	using Super::UnregisterPlayer;
+	virtual void UnregisterPlayer(const APlayerController* ExitingPlayer) override;
+
+	/** True if the login options ask to join as a spectator */
+	static bool IsSpectatorLogin(const FString& Options);
+};
@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Player profile file layout (.hprofile, little endian):
+ *   Header   - magic u32, version u16, header size u16, payload size u32, payload CRC32 u32
+ *   Payload  - experience i64, level i32, cash i32, item count u32, loadout count u32,
+ *              items as packed FHeistProfileItem, loadout as u16 weapon ids
+ * Arrays are stored exactly as they sit in memory, so reading is a bounds check and one copy per array.
+ * Later versions only append to the payload - older readers ignore the bytes past what they know.
+ */
+namespace HeistProfile
+{
+	static constexpr uint32 Magic = 0x46525048; // HPRF
+	static constexpr uint16 Version = 1;
+}
+
+/** One owned item - the id indexes the catalog the item type belongs to */
+struct FHeistProfileItem
+{
+	uint16 ItemId = 0;
+	uint16 Count = 0;
+	uint32 Flags = 0;
+};
+static_assert(sizeof(FHeistProfileItem) == 8, "FHeistProfileItem is written to disk as is");
+
+struct HEISTFPS_API FHeistProfile
+{
+	int64 Experience = 0;
+	int32 Level = 1;
+	int32 Cash = 0;
+	TArray<FHeistProfileItem> Items;
+
+	/** Indices into AHeistFPSGameMode::LoadoutWeaponClasses, primary first - empty for the character's defaults */
+	TArray<uint16> Loadout;
+};
+
+class HEISTFPS_API FHeistProfileFormat
+{
+public:
+	static void Write(const FHeistProfile& Profile, TArray<uint8>& OutBytes);
+
+	/** Returns false and leaves OutProfile untouched if the data is truncated, corrupt or from an unknown format */
+	static bool Read(const uint8* Data, int64 Size, FHeistProfile& OutProfile);
+
+	/** Loadout as sent in the ?Loadout= login option, e.g. "0.3" */
+	static FString EncodeLoadout(const TArray<uint16>& Loadout);
+	static bool DecodeLoadout(const FString& Value, int32 MaxWeapons, TArray<uint16>& OutLoadout);
+};
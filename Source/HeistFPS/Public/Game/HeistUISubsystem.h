@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Engine/World.h"
+#include "HeistUISubsystem.generated.h"
+
+class APlayerController;
+class IMenuInterface;
+class UMainMenu;
+class UUserWidget;
+struct FStreamableHandle;
+
+UENUM()
+enum class EHeistMenuScreen : uint8
+{
+	MainMenu,
+	PauseMenu
+};
+
+/**
+ * Owns the menu widgets for the lifetime of the game instance, so they are created once and survive
+ * travel. Each screen is added to the viewport once per world and then only has its visibility
+ * switched. Input mode and focus change only when the shown screen changes. A screen's class is
+ * loaded in the background and its widget built ahead of time: the main menu at startup, the pause
+ * menu once the main menu is up and after every map load.
+ *
+ * heist.Test.MenuTiming [Cycles] cycles through every transition and fails if any frame after one
+ * takes longer than MaxTransitionFrameMs. -HeistUITest runs it on the first map and exits with the
+ * result. It only times transitions between screens that are already built. A screen's first
+ * creation is covered by the MenuCreate stat, and travelling back to the menu by the map load.
+ */
+UCLASS(Config = Game)
+class HEISTFPS_API UHeistUISubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Shows the main menu, building it first if the preload has not finished */
+	UMainMenu* ShowMainMenu(IMenuInterface* MenuInterface);
+
+	void TogglePauseMenu();
+
+	/** Makes Widget visible with UI input focused on it */
+	void ShowWidget(UUserWidget* Widget);
+
+	/** Collapses Widget and gives input back to the game once no menu is shown */
+	void HideWidget(UUserWidget* Widget);
+
+	/** Loads the screen's class in the background and builds its widget hidden in the viewport */
+	void PreloadScreen(EHeistMenuScreen Screen);
+
+	void StartTimingTest(int32 Cycles, bool bExitWhenDone);
+
+	UPROPERTY(Config)
+	TSoftClassPtr<UMainMenu> MainMenuClass;
+
+	UPROPERTY(Config)
+	TSoftClassPtr<UUserWidget> PauseMenuClass;
+
+	/** Frames after a menu transition longer than this fail heist.Test.MenuTiming */
+	UPROPERTY(Config)
+	float MaxTransitionFrameMs = 16.0f;
+
+private:
+	/** Cached widget of each screen, indexed by EHeistMenuScreen */
+	UPROPERTY(Transient)
+	UUserWidget* Screens[2];
+
+	TSharedPtr<FStreamableHandle> ScreenLoadHandles[2];
+
+	/** Screens shown now, most recent last - it gets focus, and input returns to the game when this empties */
+	TArray<TWeakObjectPtr<UUserWidget>> ShownWidgets;
+
+	/** Player controller and focus the input mode was last set for */
+	TWeakObjectPtr<APlayerController> InputController;
+	TWeakObjectPtr<UUserWidget> InputFocus;
+	bool bInputModeSet = false;
+
+	FDelegateHandle PostLoadMapHandle;
+	FDelegateHandle WorldCleanupHandle;
+
+	UUserWidget*& GetScreenWidget(EHeistMenuScreen Screen) { return Screens[static_cast<int32>(Screen)]; }
+	UMainMenu* GetMainMenu() const;
+	static int32 GetScreenZOrder(EHeistMenuScreen Screen);
+
+	/** Returns the screen's widget, loading its class and creating it now if it is not cached */
+	UUserWidget* GetOrCreateScreen(EHeistMenuScreen Screen);
+
+	/** Adds the widget to the current viewport, hidden, if travel removed it */
+	void AttachToViewport(EHeistMenuScreen Screen);
+
+	void ApplyInputMode();
+
+	void OnPostLoadMap(UWorld* World);
+	void OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources);
+
+	/********************************************************************
+					TIMING TEST
+	*********************************************************************/
+	bool bTestRequested = false;
+	bool bTestExitWhenDone = false;
+	int32 TestStepsLeft = 0;
+	int32 TestFramesToMeasure = 0;
+	int32 TestTransitions = 0;
+	double TestLastFrameTime = 0.0;
+	double TestWorstMs = 0.0;
+	FDelegateHandle TestEndFrameHandle;
+
+	void OnTestEndFrame();
+	void RunTestStep();
+	void FinishTimingTest();
+};
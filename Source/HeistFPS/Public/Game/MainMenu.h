@@ -23,6 +23,9 @@ public:
 
 	void ClearServerList();
 
+	/** Back to the first screen with an empty server list and nothing selected - the widget is reused across travel */
+	void ResetMenu();
+
 	void SetMenuInterface(IMenuInterface* Interface);
 
 	void SetSelectedSession(uint32 InIndex);
@@ -31,9 +34,15 @@ public:
 
 	void Teardown();
 
+	/** Milliseconds per frame spent filling in server list rows - the rest wait for the next frame */
+	UPROPERTY(EditDefaultsOnly, Category = "Server List")
+	float RowBuildBudgetMs = 2.0f;
+
 protected:
 	virtual bool Initialize();
 
+	virtual void NativeTick(const FGeometry& MyGeometry, float InDeltaTime) override;
+
 
 private:
 
@@ -69,15 +78,37 @@ private:
 	UPROPERTY(meta = (BindWidget))
 	class UCircularThrobber* LoadingThrobber;
 
+	/** Optional host options - defaults from the game instance are used when absent */
+	UPROPERTY(meta = (BindWidgetOptional))
+	class USpinBox* HostMaxPlayersSpin;
+
+	UPROPERTY(meta = (BindWidgetOptional))
+	class UCheckBox* HostLANCheck;
+
+	UPROPERTY(meta = (BindWidgetOptional))
+	class UComboBoxString* HostMapCombo;
+
+	/** Optional - joins the selected session as a spectator */
+	UPROPERTY(meta = (BindWidgetOptional))
+	class UButton* JoinSpectateBtn;
+
 	UFUNCTION()
 	void OpenHostMenu();
 
+	/** Fills the host option widgets from the menu interface defaults */
+	void PopulateHostOptions();
+
+	FHostSettings GetSelectedHostSettings() const;
+
 	UFUNCTION()
 	void OpenJoinMenu();
 
 	UFUNCTION()
 	void JoinAGame();
 
+	UFUNCTION()
+	void SpectateAGame();
+
 	UFUNCTION()
 	void HostAGame();
 
@@ -90,4 +121,16 @@ private:
 	IMenuInterface* MenuInterface;
 
 	TOptional<uint32> SelectedSessionIndex;
+
+	/** Rows kept across refreshes - unused ones are collapsed rather than removed */
+	UPROPERTY(Transient)
+	TArray<class USessionBtn*> SessionRows;
+
+	/** Names waiting to be shown, from PendingRowIndex on */
+	TArray<FString> PendingSessionNames;
+	int32 PendingRowIndex = 0;
+	int32 NumShownRows = 0;
+
+	/** Fills in pending rows until the budget is spent */
+	void BuildPendingRows();
 };
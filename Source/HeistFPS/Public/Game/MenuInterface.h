@@ -6,6 +6,28 @@
 #include "UObject/Interface.h"
 #include "MenuInterface.generated.h"
 
+/** Options chosen in the host menu or on the command line */
+USTRUCT(BlueprintType)
+struct FHostSettings
+{
+	GENERATED_BODY()
+public:
+	/** Number of public player slots advertised by the session */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 MaxPlayers = 4;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bIsLANMatch = true;
+
+	/** Index into the game instance's HostableMaps */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 MapIndex = 0;
+
+	/** Observer slots, separate from MaxPlayers and not advertised as public connections */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 MaxSpectators = 16;
+};
+
 // This class does not need to be modified.
 UINTERFACE(MinimalAPI)
 class UMenuInterface : public UInterface
@@ -22,10 +44,16 @@ class HEISTFPS_API IMenuInterface
 
 	// Add interface functions to this class. This is the class that will be inherited to implement this interface.
 public:
-	virtual void HostMap() = 0;
+	virtual void HostMap(const FHostSettings& Settings) = 0;
+
+	virtual FHostSettings GetDefaultHostSettings() const = 0;
+
+	virtual TArray<FText> GetHostableMapNames() const = 0;
 
 	virtual void JoinMap(uint32 SessionIndex) = 0;
 
+	virtual void SpectateMap(uint32 SessionIndex) = 0;
+
 	virtual void QuitGame() = 0;
 
 	virtual void RefreshServerList() = 0;
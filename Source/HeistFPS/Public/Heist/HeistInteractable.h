@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "HeistInteractable.generated.h"
+
+class AHeistFPSCharacter;
+
+UENUM(BlueprintType)
+enum class EHeistInteractableType : uint8
+{
+	/** Money bags and other loot - picked up and removed */
+	Loot,
+	/** Opened once, after a long hold */
+	Vault,
+	/** Hacked once, after a short hold */
+	Keypad
+};
+
+/**
+ * Something a player can interact with. Placed in the map and registered with
+ * UHeistInteractionSubsystem on every machine, so players find it through the spatial grid instead
+ * of overlaps. Starts dormant and only costs replication when it is used up. Taken loot is hidden
+ * rather than destroyed so a new round can put it back.
+ */
+UCLASS(Blueprintable)
+class HEISTFPS_API AHeistInteractable : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AHeistInteractable();
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** Server - starts or performs the interaction for Character, who has already been range checked */
+	void Interact(AHeistFPSCharacter* Character);
+
+	bool CanInteract() const { return !bCompleted; }
+
+	/** Server - puts the interactable back for a new round */
+	void ResetForRound();
+
+	int32 GetGridHandle() const { return GridHandle; }
+
+	UPROPERTY(VisibleAnywhere, Category = Interaction)
+	class UStaticMeshComponent* Mesh;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Interaction)
+	EHeistInteractableType Type = EHeistInteractableType::Loot;
+
+	/** Seconds the interactor has to stay in range before the interaction completes - 0 completes at once */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Interaction)
+	float InteractSeconds = 0.0f;
+
+	/** Added to the game state's loot total when picked up */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Interaction)
+	int32 LootValue = 10000;
+
+	/** Objective in AHeistFPSGameState this counts towards, INDEX_NONE for none */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Interaction)
+	int32 ObjectiveIndex = INDEX_NONE;
+
+protected:
+	/** Cosmetic reaction to the interaction completing, e.g. opening the vault door */
+	UFUNCTION(BlueprintImplementableEvent, Category = Interaction)
+	void OnCompleted();
+
+	UFUNCTION()
+	void OnRep_Completed();
+
+	UPROPERTY(ReplicatedUsing = OnRep_Completed)
+	bool bCompleted = false;
+
+private:
+	int32 GridHandle = INDEX_NONE;
+
+	TWeakObjectPtr<AHeistFPSCharacter> Interactor;
+	FTimerHandle InteractTimerHandle;
+
+	void CompleteInteract();
+};
@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Heist/HeistSpatialHash.h"
+#include "HeistInteractionSubsystem.generated.h"
+
+class AHeistFPSCharacter;
+class AHeistInteractable;
+
+/**
+ * Spatial index of every interactable in the world. Players ask it what they can interact with
+ * through a grid query around their view, so the cost follows the number of nearby interactables
+ * rather than the map's total. Runs on every machine - clients for focus prompts, the server to
+ * validate interaction requests.
+ *
+ * Benchmark the query with heist.Bench.Interaction [Lootables=5000] [Players=32].
+ */
+UCLASS(Config = Game)
+class HEISTFPS_API UHeistInteractionSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Returns the grid handle the interactable keeps until it unregisters */
+	int32 Register(AHeistInteractable* Interactable);
+	void Unregister(AHeistInteractable* Interactable);
+
+	/** Best interactable in front of the view within InteractDistance, or null */
+	AHeistInteractable* FindInteractable(const FVector& ViewLocation, const FVector& ViewDirection) const;
+
+	/** Appends every registered interactable within Radius of Center */
+	void QueryInteractables(const FVector& Center, float Radius, TArray<AHeistInteractable*>& OutInteractables) const;
+
+	/** Server check for interaction requests and held interactions */
+	bool IsInRange(const AHeistFPSCharacter* Character, const AHeistInteractable* Interactable) const;
+
+	int32 GetNumInteractables() const { return Grid.Num(); }
+
+	/** Grid cell size - around twice InteractDistance keeps queries to a few cells */
+	UPROPERTY(Config)
+	float CellSize = 500.0f;
+
+	/** Furthest an interactable can be from the player's view */
+	UPROPERTY(Config)
+	float InteractDistance = 250.0f;
+
+	/** Minimum dot product between the view direction and the direction to the interactable */
+	UPROPERTY(Config)
+	float MinFacingDot = 0.5f;
+
+	/** Slack on InteractDistance for server checks, covering movement since the client's query */
+	UPROPERTY(Config)
+	float ServerRangeSlack = 100.0f;
+
+private:
+	FHeistSpatialHash Grid;
+
+	/** Indexed by grid handle */
+	UPROPERTY(Transient)
+	TArray<AHeistInteractable*> Interactables;
+
+	/** Reused by queries to avoid allocating per call */
+	mutable TArray<int32> QueryHandles;
+};
@@ -0,0 +1,39 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Uniform grid over X and Y for static points. Each point gets a handle that stays valid until it is
+ * removed; a radius query only visits the cells the radius overlaps, so its cost depends on how many
+ * points are nearby rather than on the total.
+ */
+struct HEISTFPS_API FHeistSpatialHash
+{
+	explicit FHeistSpatialHash(float InCellSize = 500.0f);
+
+	/** Adds a point and returns its handle */
+	int32 Add(const FVector& Location);
+
+	void Remove(int32 Handle);
+
+	/** Appends the handles of every point within Radius of Center */
+	void Query(const FVector& Center, float Radius, TArray<int32>& OutHandles) const;
+
+	const FVector& GetLocation(int32 Handle) const { return Locations[Handle]; }
+
+	int32 Num() const { return Locations.Num() - FreeHandles.Num(); }
+
+	void Reset();
+
+private:
+	FIntPoint GetCell(const FVector& Location) const;
+
+	float CellSize;
+	TMap<FIntPoint, TArray<int32>> Cells;
+
+	/** Indexed by handle - removed handles are reused */
+	TArray<FVector> Locations;
+	TArray<int32> FreeHandles;
+};
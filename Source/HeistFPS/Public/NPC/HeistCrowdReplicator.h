@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Engine/NetSerialization.h"
+#include "NPC/HeistCrowdTypes.h"
+#include "HeistCrowdReplicator.generated.h"
+
+struct FHeistCrowdNetArray;
+
+/** Quantized state of one NPC as sent to clients */
+USTRUCT()
+struct FHeistCrowdNetEntry : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY()
+	uint16 Id = 0;
+
+	UPROPERTY()
+	EHeistNPCType Type = EHeistNPCType::Civilian;
+
+	UPROPERTY()
+	EHeistNPCState State = EHeistNPCState::Idle;
+
+	/** Yaw in 256ths of a turn */
+	UPROPERTY()
+	uint8 Yaw = 0;
+
+	UPROPERTY()
+	FVector_NetQuantize Location;
+
+	void PostReplicatedAdd(const FHeistCrowdNetArray& InArray);
+	void PostReplicatedChange(const FHeistCrowdNetArray& InArray);
+	void PreReplicatedRemove(const FHeistCrowdNetArray& InArray);
+};
+
+USTRUCT()
+struct FHeistCrowdNetArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY()
+	TArray<FHeistCrowdNetEntry> Items;
+
+	/** Receives the item callbacks on clients */
+	UPROPERTY(NotReplicated)
+	class AHeistCrowdReplicator* Owner = nullptr;
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FHeistCrowdNetEntry, FHeistCrowdNetArray>(Items, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FHeistCrowdNetArray> : public TStructOpsTypeTraitsBase2<FHeistCrowdNetArray>
+{
+	enum { WithNetDeltaSerializer = true };
+};
+
+/**
+ * Replicates the whole crowd as one delta-serialized array instead of one channel per NPC. Only
+ * entries the server marks dirty are sent, and the server only marks NPCs that moved past
+ * NetLocationTolerance or changed state, so far NPCs on slow LOD updates cost almost nothing.
+ * Spawned by UHeistCrowdSubsystem on servers.
+ */
+UCLASS(NotPlaceable)
+class HEISTFPS_API AHeistCrowdReplicator : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AHeistCrowdReplicator();
+
+	virtual void PostInitializeComponents() override;
+	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	UPROPERTY(Replicated)
+	FHeistCrowdNetArray Crowd;
+
+	/** Client - forwards received entries to the crowd subsystem */
+	void OnEntryChanged(const FHeistCrowdNetEntry& Entry);
+	void OnEntryRemoved(const FHeistCrowdNetEntry& Entry);
+};
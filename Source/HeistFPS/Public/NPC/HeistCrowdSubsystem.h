@@ -0,0 +1,227 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "WorldCollision.h"
+#include "NPC/HeistCrowdTypes.h"
+#include "HeistCrowdSubsystem.generated.h"
+
+class AHeistCrowdReplicator;
+class AHeistNPCActor;
+struct FHeistCrowdNetEntry;
+
+/**
+ * Guards and civilians simulated as packed arrays instead of actors. The server runs perception in
+ * one batch of async traces per PerceptionInterval, shares navigation paths between NPCs heading
+ * from the same cell to the same goal, and moves each NPC at an interval set by its distance to the
+ * nearest player. Only NPCs within FullActorDistance of a player get a pooled AHeistNPCActor.
+ * Clients receive the crowd through a single AHeistCrowdReplicator and run the same LOD and actor
+ * pooling against their own view.
+ *
+ * Populate with InitialGuards / InitialCivilians or heist.Crowd.Spawn <Guards> <Civilians>.
+ * Benchmark with heist.Bench.Crowd [SecondsPerCount] on a server or standalone world.
+ */
+UCLASS(Config = Game)
+class HEISTFPS_API UHeistCrowdSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+
+	/** Server - adds NPCs scattered within Radius of Center. Returns the number added. */
+	int32 SpawnNPCs(EHeistNPCType Type, int32 Count, const FVector& Center, float Radius);
+
+	/** Server - removes every NPC */
+	void ClearNPCs();
+
+	int32 GetNumNPCs() const { return Crowd.Num(); }
+
+	/** Server - alerts guards and scatters civilians within Radius of Location */
+	static void ReportNoise(const UObject* WorldContext, const FVector& Location, float Radius);
+
+	/** Client - applies an entry received through the replicator */
+	void ApplyNetEntry(const FHeistCrowdNetEntry& Entry);
+	void RemoveNetEntry(int32 Id);
+
+	/** Starts the heist.Bench.Crowd sequence */
+	void StartBenchmark(const TArray<int32>& Counts, float SecondsPerCount, bool bExitWhenDone);
+
+	UPROPERTY(Config)
+	int32 InitialGuards = 0;
+
+	UPROPERTY(Config)
+	int32 InitialCivilians = 0;
+
+	/** Radius around the first player start that initial NPCs are scattered in */
+	UPROPERTY(Config)
+	float InitialSpawnRadius = 5000.0f;
+
+	/** Pooled actor class for NPCs at full LOD */
+	UPROPERTY(Config)
+	TSoftClassPtr<AHeistNPCActor> NPCActorClass;
+
+	/** NPCs closer than this to a player are simulated every frame and get an actor */
+	UPROPERTY(Config)
+	float FullActorDistance = 3000.0f;
+
+	/** NPCs closer than this move at MidUpdateInterval, the rest at FarUpdateInterval */
+	UPROPERTY(Config)
+	float MidDistance = 10000.0f;
+
+	UPROPERTY(Config)
+	float MidUpdateInterval = 0.1f;
+
+	UPROPERTY(Config)
+	float FarUpdateInterval = 0.5f;
+
+	/** Seconds between LOD reassignments */
+	UPROPERTY(Config)
+	float LODInterval = 0.25f;
+
+	/** Upper bound on actors in use, nearest NPCs first */
+	UPROPERTY(Config)
+	int32 MaxFullActors = 48;
+
+	UPROPERTY(Config)
+	float WalkSpeed = 150.0f;
+
+	UPROPERTY(Config)
+	float RunSpeed = 450.0f;
+
+	/** Seconds between perception batches */
+	UPROPERTY(Config)
+	float PerceptionInterval = 0.25f;
+
+	UPROPERTY(Config)
+	float SightRange = 2500.0f;
+
+	/** Half angle of the guards' view cone in degrees */
+	UPROPERTY(Config)
+	float SightHalfAngle = 60.0f;
+
+	/** Awareness gained per second with a player in sight - guards alert at 1 */
+	UPROPERTY(Config)
+	float AwarenessGainRate = 2.0f;
+
+	UPROPERTY(Config)
+	float AwarenessDecayRate = 0.25f;
+
+	/** Seconds guards stay alerted and civilians keep fleeing */
+	UPROPERTY(Config)
+	float StimulusSeconds = 10.0f;
+
+	/** Path queries run per frame - the rest wait in the queue */
+	UPROPERTY(Config)
+	int32 MaxPathQueriesPerFrame = 8;
+
+	/** Cell size used to share paths between NPCs starting close together */
+	UPROPERTY(Config)
+	float PathShareCellSize = 500.0f;
+
+	/** Cached paths kept before the cache is flushed */
+	UPROPERTY(Config)
+	int32 MaxCachedPaths = 1024;
+
+	/** Crowd updates sent to clients per second */
+	UPROPERTY(Config)
+	float NetUpdateRate = 10.0f;
+
+	/** Movement below this since the last sent value is not replicated */
+	UPROPERTY(Config)
+	float NetLocationTolerance = 25.0f;
+
+private:
+	FHeistCrowdData Crowd;
+	int32 NextId = 0;
+
+	/** Patrol and wander destinations - the world's target points, or a generated ring without any */
+	TArray<FVector> Goals;
+
+	void BuildGoals(const FVector& Center);
+	FVector GetSpawnCenter() const;
+
+	/********************************************************************
+					LOD AND ACTORS
+	*********************************************************************/
+	UPROPERTY(Transient)
+	TArray<AHeistNPCActor*> ActorPool;
+	TArray<int32> FreeActorSlots;
+	float TimeSinceLOD = 0.0f;
+
+	void GatherViewLocations(TArray<FVector>& OutLocations) const;
+	void UpdateLODs();
+	int32 AcquireActor(int32 Index);
+	void ReleaseActor(int32 Index);
+	void UpdateActors();
+
+	/********************************************************************
+					MOVEMENT AND NAVIGATION
+	*********************************************************************/
+	TMap<TPair<FIntPoint, int32>, TSharedPtr<const FHeistCrowdPath>> PathCache;
+	TMap<TPair<FIntPoint, int32>, TArray<int32>> PendingPathRequests;
+
+	void SimulateMovement(float DeltaTime);
+	void MoveNPC(int32 Index, float DeltaTime);
+	void RequestPath(int32 Index);
+	void ProcessPathQueries();
+	int32 PickNextGoal(int32 Index) const;
+
+	/********************************************************************
+					PERCEPTION
+	*********************************************************************/
+	struct FNoiseEvent
+	{
+		FVector Location;
+		float Radius;
+	};
+	TArray<FNoiseEvent> PendingNoises;
+	TArray<FVector> PerceptionTargets;
+	float TimeSincePerception = 0.0f;
+	float LastPerceptionInterval = 0.0f;
+	FTraceDelegate PerceptionTraceDelegate;
+
+	void RunPerception(float Interval);
+	void OnPerceptionTrace(const FTraceHandle& Handle, FTraceDatum& Datum);
+	void ApplyStimulus(int32 Index, const FVector& Location);
+
+	/********************************************************************
+					REPLICATION
+	*********************************************************************/
+	UPROPERTY(Transient)
+	AHeistCrowdReplicator* Replicator = nullptr;
+	float TimeSinceNetUpdate = 0.0f;
+
+	void UpdateReplicator();
+	void SmoothNetLocations(float DeltaTime);
+	bool IsServer() const;
+
+	/********************************************************************
+					BENCHMARK
+	*********************************************************************/
+	TArray<int32> BenchmarkCounts;
+	int32 BenchmarkIndex = INDEX_NONE;
+	float BenchmarkSecondsPerCount = 10.0f;
+	float BenchmarkElapsed = 0.0f;
+	FVector BenchmarkCenter = FVector::ZeroVector;
+	bool bBenchmarkExitWhenDone = false;
+	int32 BenchmarkFrames = 0;
+	double BenchmarkBusyMs = 0.0;
+	double BenchmarkWorstMs = 0.0;
+	double BenchmarkCrowdMs = 0.0;
+
+	void TickBenchmark(float DeltaTime, double CrowdMs);
+	void BeginBenchmarkCount();
+};
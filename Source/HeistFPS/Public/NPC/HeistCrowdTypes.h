@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HeistCrowdTypes.generated.h"
+
+UENUM(BlueprintType)
+enum class EHeistNPCType : uint8
+{
+	Guard,
+	Civilian
+};
+
+UENUM(BlueprintType)
+enum class EHeistNPCState : uint8
+{
+	Idle,
+	/** Guards walking their patrol route, civilians wandering */
+	Patrol,
+	/** Guards moving to where they saw or heard something */
+	Alert,
+	/** Civilians running from a noise */
+	Flee
+};
+
+/** Simulation detail of one NPC - decides its update interval and whether it has an actor */
+enum class EHeistNPCLOD : uint8
+{
+	/** Near a player - moves every frame and has an AHeistNPCActor */
+	Full,
+	/** Visible distance - moves at MidUpdateInterval */
+	Mid,
+	/** Far from every player - moves at FarUpdateInterval */
+	Far
+};
+
+/** Navigation path shared by every NPC that requested the same start cell and goal */
+struct FHeistCrowdPath
+{
+	TArray<FVector> Points;
+};
+
+/**
+ * Packed NPC state. Index i across every array is one NPC, so each simulation pass walks only the
+ * arrays it needs. Removal swaps the last NPC into the freed slot and IdToIndex is kept in step.
+ */
+struct FHeistCrowdData
+{
+	TArray<int32> Ids;
+	TArray<EHeistNPCType> Types;
+	TArray<EHeistNPCState> States;
+	TArray<EHeistNPCLOD> LODs;
+	TArray<FVector> Locations;
+	TArray<float> Yaws;
+	TArray<float> Speeds;
+
+	/** Time accumulated since the NPC last moved, consumed at its LOD's interval */
+	TArray<float> PendingDeltaTimes;
+
+	/** Path being followed, null while one is requested */
+	TArray<TSharedPtr<const FHeistCrowdPath>> Paths;
+	TArray<int32> PathPoints;
+	TArray<int32> Goals;
+
+	/** Guards - builds up while a player is in sight and alerts at 1 */
+	TArray<float> Awareness;
+
+	/** Alert target for guards, the noise to run from for civilians */
+	TArray<FVector> StimulusLocations;
+	TArray<float> StateTimeRemaining;
+
+	/** Server - location last sent to clients. Client - replicated location the NPC is smoothed towards. */
+	TArray<FVector> NetLocations;
+
+	/** Index into the actor pool, INDEX_NONE when the NPC has no actor */
+	TArray<int32> ActorSlots;
+
+	TMap<int32, int32> IdToIndex;
+
+	int32 Num() const { return Ids.Num(); }
+
+	int32 Add(int32 Id, EHeistNPCType Type, const FVector& Location, int32 Goal);
+	void RemoveAtSwap(int32 Index);
+	void Reset();
+};
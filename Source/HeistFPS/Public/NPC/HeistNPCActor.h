@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "NPC/HeistCrowdTypes.h"
+#include "HeistNPCActor.generated.h"
+
+/**
+ * Visual and collision stand-in for one crowd NPC near a player. Spawned locally from a pool by
+ * UHeistCrowdSubsystem and never replicated - its transform and anim inputs are written by the
+ * subsystem every frame the NPC is at full LOD.
+ */
+UCLASS(Blueprintable)
+class HEISTFPS_API AHeistNPCActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AHeistNPCActor();
+
+	/** Binds the actor to an NPC, or unbinds and hides it when Id is INDEX_NONE */
+	void Bind(int32 InNPCId, EHeistNPCType InType);
+
+	int32 GetNPCId() const { return NPCId; }
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = NPC)
+	class UCapsuleComponent* Capsule;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = NPC)
+	class USkeletalMeshComponent* Mesh;
+
+	/** Anim inputs, written by the crowd subsystem */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = NPC)
+	float Speed = 0.0f;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = NPC)
+	EHeistNPCType Type = EHeistNPCType::Civilian;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = NPC)
+	EHeistNPCState State = EHeistNPCState::Idle;
+
+private:
+	int32 NPCId = INDEX_NONE;
+};
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Result of tracing a shot against rewound hitboxes */
+struct FHeistRewindHit
+{
+	int32 Slot = INDEX_NONE;
+	int32 Hitbox = INDEX_NONE;
+
+	/** Distance from the trace start */
+	float Distance = 0.0f;
+	FVector Location = FVector::ZeroVector;
+};
+
+/**
+ * Fixed-size ring of past poses for up to MaxSlots characters, stored as separate arrays per field
+ * indexed by [frame][slot] so a rewind touches only the fields it tests. Each pose is a vertical
+ * capsule and NumHitboxes spheres.
+ *
+ * A uniform grid over X and Y holds each slot's bounds across the whole history, rebuilt in EndFrame
+ * with a counting sort into flat buckets. Traces walk the cells under the shot and only run the
+ * capsule and sphere tests on the slots found there. Nothing here touches the physics scene.
+ *
+ * Not thread safe - traces reuse scratch arrays.
+ */
+class HEISTFPS_API FHeistHitboxHistory
+{
+public:
+	void Init(int32 InNumFrames, int32 InMaxSlots, const TArray<float>& InHitboxRadii, float InCellSize);
+
+	/** Starts a frame at Time, replacing the oldest. Slots not written before EndFrame are absent from it. */
+	void BeginFrame(double Time);
+
+	/** HitboxCenters holds GetNumHitboxes() locations */
+	void WriteSlot(int32 Slot, const FVector& CapsuleCenter, float CapsuleHalfHeight, float CapsuleRadius, const FVector* HitboxCenters);
+
+	/** Rebuilds the broadphase grid */
+	void EndFrame();
+
+	/** Clears one slot from every frame, for reuse by another character */
+	void ClearSlot(int32 Slot);
+
+	/**
+	 * Nearest hitbox crossed by the segment with poses interpolated at Time, which is clamped to the
+	 * recorded range. Without bBroadphase every slot is tested, for comparison.
+	 */
+	bool Trace(const FVector& Start, const FVector& End, double Time, int32 IgnoreSlot, FHeistRewindHit& OutHit, bool bBroadphase = true) const;
+
+	int32 GetNumHitboxes() const { return HitboxRadii.Num(); }
+	int32 GetMaxSlots() const { return MaxSlots; }
+	int32 GetNumRecorded() const { return NumRecorded; }
+	double GetOldestTime() const;
+	double GetNewestTime() const;
+
+	/** Slots that reached the narrow phase in the last trace */
+	int32 GetLastNumCandidates() const { return Candidates.Num(); }
+
+private:
+	static constexpr int32 NumBuckets = 256;
+
+	/** Cells a slot's bounds may cover before it is kept in LargeSlots and tested by every trace */
+	static constexpr int32 MaxCellsPerSlot = 16;
+
+	int32 NumFrames = 0;
+	int32 MaxSlots = 0;
+	float CellSize = 1000.0f;
+
+	/** Ring position of the newest frame */
+	int32 NewestFrame = INDEX_NONE;
+	int32 NumRecorded = 0;
+
+	TArray<double> FrameTimes;
+
+	/** Indexed by frame * MaxSlots + slot */
+	TArray<uint8> Present;
+	TArray<FVector> CapsuleCenters;
+	TArray<float> CapsuleHalfHeights;
+	TArray<float> CapsuleRadii;
+
+	/** Indexed by (frame * MaxSlots + slot) * NumHitboxes + hitbox */
+	TArray<FVector> HitboxCenters;
+	TArray<float> HitboxRadii;
+
+	/** Broadphase - slot indices grouped by bucket, BucketStarts has NumBuckets + 1 entries */
+	TArray<int32> BucketStarts;
+	TArray<int32> BucketEntries;
+	TArray<int32> LargeSlots;
+
+	/** Trace scratch */
+	mutable TArray<uint32> SlotStamps;
+	mutable uint32 CurrentStamp = 0;
+	mutable TArray<int32> Candidates;
+
+	int32 GetFrame(int32 Age) const { return (NewestFrame - Age + NumFrames) % NumFrames; }
+	int32 GetIndex(int32 Frame, int32 Slot) const { return Frame * MaxSlots + Slot; }
+
+	static int32 GetBucket(int32 CellX, int32 CellY);
+
+	void GatherCandidates(const FVector& Start, const FVector& End) const;
+	void AddCandidate(int32 Slot) const;
+
+	/** Bracketing frames and blend for Time */
+	void FindFrames(double Time, int32& OutFrameA, int32& OutFrameB, float& OutAlpha) const;
+
+	bool TraceSlot(int32 Slot, int32 FrameA, int32 FrameB, float Alpha, const FVector& Start, const FVector& Direction, float Length, FHeistRewindHit& InOutHit) const;
+};
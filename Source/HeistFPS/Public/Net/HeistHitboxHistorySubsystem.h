@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "Net/HeistHitboxHistory.h"
+#include "HeistHitboxHistorySubsystem.generated.h"
+
+class AHeistFPSCharacter;
+
+/** A sphere hitbox centred on a bone of the character mesh */
+USTRUCT()
+struct FHeistHitboxDef
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Config)
+	FName BoneName;
+
+	UPROPERTY(Config)
+	float Radius = 15.0f;
+};
+
+/**
+ * Server record of where every character's capsule and hitboxes were over the last HistoryFrames
+ * server ticks, for validating shots against what the shooter saw. Ticks after actors have moved and
+ * animated, so each frame holds the poses that were replicated that tick.
+ *
+ * Shots are tested with TraceRewound against the recorded poses only - the physics scene is never
+ * moved or queried with rewound state.
+ *
+ * Benchmark with heist.Bench.Rewind [Players=32] [Shots=20000].
+ */
+UCLASS(Config = Game)
+class HEISTFPS_API UHeistHitboxHistorySubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+
+	/** Server - called by characters as they begin and end play */
+	void Register(AHeistFPSCharacter* Character);
+	void Unregister(AHeistFPSCharacter* Character);
+
+	/**
+	 * Nearest character hitbox crossed by the segment with everyone posed as they were at ServerTime
+	 * (the world time on the server). OutHitbox indexes Hitboxes.
+	 */
+	AHeistFPSCharacter* TraceRewound(const FVector& Start, const FVector& End, double ServerTime, const AHeistFPSCharacter* IgnoreCharacter, int32& OutHitbox, FVector& OutLocation) const;
+
+	/** Frames kept - 64 covers just over a second at the 60 Hz server tick */
+	UPROPERTY(Config)
+	int32 HistoryFrames = 64;
+
+	UPROPERTY(Config)
+	int32 MaxCharacters = 64;
+
+	/** Broadphase cell size */
+	UPROPERTY(Config)
+	float CellSize = 1000.0f;
+
+	UPROPERTY(Config)
+	TArray<FHeistHitboxDef> Hitboxes;
+
+	const FHeistHitboxHistory& GetHistory() const { return History; }
+
+private:
+	FHeistHitboxHistory History;
+
+	/** Indexed by history slot */
+	TArray<TWeakObjectPtr<AHeistFPSCharacter>> SlotCharacters;
+	TArray<int32> FreeSlots;
+
+	/** Mesh bone index of each hitbox, by slot * Hitboxes.Num() + hitbox - INDEX_NONE falls back to the capsule centre */
+	TArray<int32> SlotBoneIndices;
+
+	TArray<FVector> HitboxScratch;
+
+	int32 FindSlot(const AHeistFPSCharacter* Character) const;
+};
@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Animation parameters of a simulated character at one server time */
+struct FHeistAnimSample
+{
+	float ServerTime = 0.0f;
+	float Speed = 0.0f;
+	float Direction = 0.0f;
+	float Pitch = 0.0f;
+	float Yaw = 0.0f;
+};
+
+/**
+ * Fixed-size buffer of time-stamped anim samples for simulated proxies. Sampling a render time in the
+ * past interpolates between the two samples around it. Past the newest sample it extrapolates for at
+ * most MaxExtrapolation seconds, so a late packet shows as a short continuation of the last motion
+ * instead of a freeze followed by a snap. Servers only send changes, so if nothing arrives the newest
+ * sample was the final value and the overshoot eases back to it over ExtrapolationRecovery seconds.
+ */
+class HEISTFPS_API FHeistAnimInterpolationBuffer
+{
+public:
+	static constexpr int32 Capacity = 16;
+
+	/** Seconds the buffer will continue past the newest sample */
+	float MaxExtrapolation = 0.1f;
+
+	/** Seconds taken to ease back to the newest sample once MaxExtrapolation has run out */
+	float ExtrapolationRecovery = 0.1f;
+
+	/** Gaps longer than this are treated as the value having been constant, not as a slow ramp */
+	float MaxInterpolationGap = 0.5f;
+
+	/** Adds a sample - samples older than the newest one are dropped */
+	void AddSample(const FHeistAnimSample& Sample);
+
+	/** Returns false if the buffer is empty */
+	bool Sample(float RenderTime, FHeistAnimSample& OutSample) const;
+
+	void Reset() { Num = 0; Head = 0; }
+
+	int32 GetNum() const { return Num; }
+
+private:
+	FHeistAnimSample Samples[Capacity];
+
+	/** Index of the oldest sample */
+	int32 Head = 0;
+	int32 Num = 0;
+
+	const FHeistAnimSample& Get(int32 Index) const { return Samples[(Head + Index) % Capacity]; }
+	void Push(const FHeistAnimSample& Sample);
+
+	static FHeistAnimSample Lerp(const FHeistAnimSample& From, const FHeistAnimSample& To, float Alpha);
+};
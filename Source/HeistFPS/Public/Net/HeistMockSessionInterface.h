@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "Interfaces/OnlineSessionInterface.h"
+#include "OnlineSessionSettings.h"
+#include "OnlineSubsystemTypes.h"
+
+/** Session info of a mock session - resolves to the configured connect address */
+class FHeistMockSessionInfo : public FOnlineSessionInfo
+{
+public:
+	FHeistMockSessionInfo(const FString& InSessionId, const FString& InConnectAddress)
+		: SessionId(InSessionId)
+		, ConnectAddress(InConnectAddress)
+	{
+	}
+
+	virtual const uint8* GetBytes() const override { return nullptr; }
+	virtual int32 GetSize() const override { return sizeof(FHeistMockSessionInfo); }
+	virtual bool IsValid() const override { return true; }
+	virtual const FUniqueNetId& GetSessionId() const override { return SessionId; }
+	virtual FString ToString() const override { return SessionId.ToString(); }
+	virtual FString ToDebugString() const override { return FString::Printf(TEXT("%s at %s"), *SessionId.ToString(), *ConnectAddress); }
+
+	const FString& GetConnectAddress() const { return ConnectAddress; }
+
+private:
+	FUniqueNetIdString SessionId;
+	FString ConnectAddress;
+};
+
+/**
+ * In-process session backend used in place of the online subsystem's when the game instance has
+ * bUseMockSessions set or -MockSessions is on the command line. It needs no network. Every request
+ * completes through the usual delegates after heist.MockSessions.LatencyMs, and fails with a chance
+ * of heist.MockSessions.FailurePct. Searches return heist.MockSessions.Count synthetic sessions.
+ * Sessions and failures come from random streams seeded with heist.MockSessions.Seed, so the same
+ * settings give the same results on every run.
+ *
+ * Joined sessions resolve to heist.MockSessions.ConnectAddress. Point it at a local dedicated server
+ * to carry a join on into the travel.
+ */
+class HEISTFPS_API FHeistMockSessionInterface : public IOnlineSession, public FTickerObjectBase
+{
+public:
+	FHeistMockSessionInterface();
+	virtual ~FHeistMockSessionInterface();
+
+	// FTickerObjectBase
+	virtual bool Tick(float DeltaTime) override;
+
+	// IOnlineSession
+	virtual TSharedPtr<const FUniqueNetId> CreateSessionIdFromString(const FString& SessionIdStr) override;
+	virtual FNamedOnlineSession* GetNamedSession(FName SessionName) override;
+	virtual void RemoveNamedSession(FName SessionName) override;
+	virtual EOnlineSessionState::Type GetSessionState(FName SessionName) const override;
+	virtual bool HasPresenceSession() override;
+	virtual bool CreateSession(int32 HostingPlayerNum, FName SessionName, const FOnlineSessionSettings& NewSessionSettings) override;
+	virtual bool CreateSession(const FUniqueNetId& HostingPlayerId, FName SessionName, const FOnlineSessionSettings& NewSessionSettings) override;
+	virtual bool StartSession(FName SessionName) override;
+	virtual bool UpdateSession(FName SessionName, FOnlineSessionSettings& UpdatedSessionSettings, bool bShouldRefreshOnlineData = true) override;
+	virtual bool EndSession(FName SessionName) override;
+	virtual bool DestroySession(FName SessionName, const FOnDestroySessionCompleteDelegate& CompletionDelegate = FOnDestroySessionCompleteDelegate()) override;
+	virtual bool IsPlayerInSession(FName SessionName, const FUniqueNetId& UniqueId) override;
+	virtual bool StartMatchmaking(const TArray<TSharedRef<const FUniqueNetId>>& LocalPlayers, FName SessionName, const FOnlineSessionSettings& NewSessionSettings, TSharedRef<FOnlineSessionSearch>& SearchSettings) override;
+	virtual bool CancelMatchmaking(int32 SearchingPlayerNum, FName SessionName) override;
+	virtual bool CancelMatchmaking(const FUniqueNetId& SearchingPlayerId, FName SessionName) override;
+	virtual bool FindSessions(int32 SearchingPlayerNum, const TSharedRef<FOnlineSessionSearch>& SearchSettings) override;
+	virtual bool FindSessions(const FUniqueNetId& SearchingPlayerId, const TSharedRef<FOnlineSessionSearch>& SearchSettings) override;
+	virtual bool FindSessionById(const FUniqueNetId& SearchingUserId, const FUniqueNetId& SessionId, const FUniqueNetId& FriendId, const FOnSingleSessionResultCompleteDelegate& CompletionDelegate) override;
+	virtual bool CancelFindSessions() override;
+	virtual bool PingSearchResults(const FOnlineSessionSearchResult& SearchResult) override;
+	virtual bool JoinSession(int32 PlayerNum, FName SessionName, const FOnlineSessionSearchResult& DesiredSession) override;
+	virtual bool JoinSession(const FUniqueNetId& PlayerId, FName SessionName, const FOnlineSessionSearchResult& DesiredSession) override;
+	virtual bool FindFriendSession(int32 LocalUserNum, const FUniqueNetId& Friend) override;
+	virtual bool FindFriendSession(const FUniqueNetId& LocalUserId, const FUniqueNetId& Friend) override;
+	virtual bool FindFriendSession(const FUniqueNetId& LocalUserId, const TArray<TSharedRef<const FUniqueNetId>>& FriendList) override;
+	virtual bool SendSessionInviteToFriend(int32 LocalUserNum, FName SessionName, const FUniqueNetId& Friend) override;
+	virtual bool SendSessionInviteToFriend(const FUniqueNetId& LocalUserId, FName SessionName, const FUniqueNetId& Friend) override;
+	virtual bool SendSessionInviteToFriends(int32 LocalUserNum, FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& Friends) override;
+	virtual bool SendSessionInviteToFriends(const FUniqueNetId& LocalUserId, FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& Friends) override;
+	virtual bool GetResolvedConnectString(FName SessionName, FString& ConnectInfo, FName PortType = NAME_GamePort) override;
+	virtual bool GetResolvedConnectString(const FOnlineSessionSearchResult& SearchResult, FName PortType, FString& ConnectInfo) override;
+	virtual FOnlineSessionSettings* GetSessionSettings(FName SessionName) override;
+	virtual bool RegisterPlayer(FName SessionName, const FUniqueNetId& PlayerId, bool bWasInvited) override;
+	virtual bool RegisterPlayers(FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& Players, bool bWasInvited = false) override;
+	virtual bool UnregisterPlayer(FName SessionName, const FUniqueNetId& PlayerId) override;
+	virtual bool UnregisterPlayers(FName SessionName, const TArray<TSharedRef<const FUniqueNetId>>& Players) override;
+	virtual void RegisterLocalPlayer(const FUniqueNetId& PlayerId, FName SessionName, const FOnRegisterLocalPlayerCompleteDelegate& Delegate) override;
+	virtual void UnregisterLocalPlayer(const FUniqueNetId& PlayerId, FName SessionName, const FOnUnregisterLocalPlayerCompleteDelegate& Delegate) override;
+	virtual int32 GetNumSessions() override;
+	virtual void DumpSessionState() override;
+
+protected:
+	virtual FNamedOnlineSession* AddNamedSession(FName SessionName, const FOnlineSessionSettings& SessionSettings) override;
+	virtual FNamedOnlineSession* AddNamedSession(FName SessionName, const FOnlineSession& Session) override;
+
+private:
+	/** Sessions this process has created or joined */
+	TArray<FNamedOnlineSession> Sessions;
+
+	/** Synthetic sessions returned by searches, rebuilt when the count or seed changes */
+	TArray<FOnlineSessionSearchResult> HostedSessions;
+	int32 HostedSessionsSeed = INDEX_NONE;
+
+	/** Search waiting for completion - only one runs at a time, as with the real backends */
+	TSharedPtr<FOnlineSessionSearch> CurrentSearch;
+
+	/** Counts searches so a cancelled one cannot complete the search started after it */
+	int32 SearchSerial = 0;
+
+	struct FPendingCompletion
+	{
+		double DueTime;
+		TFunction<void()> Complete;
+	};
+	TArray<FPendingCompletion> PendingCompletions;
+
+	FRandomStream FailureStream;
+	int32 FailureStreamSeed = INDEX_NONE;
+
+	/** Runs Complete after the configured latency */
+	void Defer(TFunction<void()>&& Complete);
+
+	/** Draws from the failure stream - true if this request should fail */
+	bool ShouldFail();
+
+	void BuildHostedSessions();
+};
@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "UObject/ObjectKey.h"
+#include "HeistNetPrioritySubsystem.generated.h"
+
+class AHeistFPSCharacter;
+struct FNetViewer;
+
+/**
+ * Per-connection replication policy for characters. Each character is scored per viewing connection
+ * from distance, view direction, combat state and recent movement. The score scales the character's
+ * net priority and the rate it is sent to that connection, between MinNetUpdateFrequency and the
+ * character's NetUpdateFrequency. Once a second every client connection is clamped to
+ * BandwidthBudget, and connections running close to it have their character rates scaled down
+ * until they settle under TargetUtilization.
+ */
+UCLASS(Config = Game)
+class HEISTFPS_API UHeistNetPrioritySubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	static UHeistNetPrioritySubsystem* Get(const UObject* WorldContext);
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+
+	/** Relevance of Character to a viewer in [0, 1] - 1 is full rate and priority */
+	float GetRelevance(const AHeistFPSCharacter& Character, const FVector& ViewPos, const FVector& ViewDir) const;
+
+	/** Replacement for AActor::GetNetPriority, scaled by relevance instead of the engine's fixed distance bands */
+	float GetNetPriority(const AHeistFPSCharacter& Character, const FVector& ViewPos, const FVector& ViewDir, const AActor* ViewTarget, float Time) const;
+
+	/** True if Character was sent to Viewer's connection more recently than its rate for that connection allows */
+	bool ShouldThrottle(const AHeistFPSCharacter& Character, const FNetViewer& Viewer) const;
+
+	/** Called once Character has actually been replicated to Connection, which starts its next throttle interval */
+	void RecordSend(const AHeistFPSCharacter& Character, const class UNetConnection* Connection);
+
+	UPROPERTY(Config)
+	bool bEnabled = true;
+
+	/** Outgoing bytes per second allowed per client connection */
+	UPROPERTY(Config)
+	int32 BandwidthBudget = 15000;
+
+	/** Share of BandwidthBudget above which a connection's character rates are scaled down */
+	UPROPERTY(Config)
+	float TargetUtilization = 0.85f;
+
+	/** Lowest rate a character is sent to any connection */
+	UPROPERTY(Config)
+	float MinNetUpdateFrequency = 4.0f;
+
+	/** Characters closer than this are fully relevant by distance */
+	UPROPERTY(Config)
+	float NearDistance = 1500.0f;
+
+	/** Characters beyond this have FarRelevance by distance */
+	UPROPERTY(Config)
+	float FarDistance = 8000.0f;
+
+	UPROPERTY(Config)
+	float FarRelevance = 0.1f;
+
+	/** Relevance multiplier for characters behind the viewer */
+	UPROPERTY(Config)
+	float BehindRelevanceScale = 0.5f;
+
+	/** Relevance multiplier for characters that are neither in combat nor moving */
+	UPROPERTY(Config)
+	float IdleRelevanceScale = 0.25f;
+
+	/** Seconds after a character last moved or aimed that it still counts as moving */
+	UPROPERTY(Config)
+	float RecentMovementSeconds = 1.0f;
+
+	/** Lowest relevance of characters with combat initiated, and of characters aiming down sights */
+	UPROPERTY(Config)
+	float CombatRelevance = 0.6f;
+
+	UPROPERTY(Config)
+	float AimDownSightRelevance = 0.9f;
+
+private:
+	struct FConnectionState
+	{
+		/** Scales character rates for this connection, lowered while it is over TargetUtilization */
+		float FrequencyScale = 1.0f;
+		int64 LastOutTotalBytes = -1;
+		TMap<FObjectKey, float> LastSendTimes;
+	};
+	TMap<FObjectKey, FConnectionState> Connections;
+
+	float TimeSinceBudgetUpdate = 0.0f;
+
+	void UpdateConnectionBudgets(float Interval);
+};
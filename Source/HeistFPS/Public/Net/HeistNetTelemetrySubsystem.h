@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "UObject/ObjectKey.h"
+#include "Async/Future.h"
+#include "HeistNetTelemetrySubsystem.generated.h"
+
+/** Per-second counters for one replicated property or RPC */
+struct FNetTelemetryCounter
+{
+	int32 Count = 0;
+
+	/** Estimated for properties, see RecordPropertyIfChanged */
+	int32 Bytes = 0;
+};
+
+/**
+ * Server-side network telemetry. Aggregates replicated property updates, server RPC counts and
+ * per-connection ping, bandwidth and packet loss once per FlushInterval and appends them to a
+ * rolling CSV file under Saved/Telemetry. Enabled with heist.NetTelemetry 1 or -HeistNetTelemetry.
+ */
+UCLASS(Config = Game)
+class HEISTFPS_API UHeistNetTelemetrySubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Returns the subsystem for WorldContext's world if telemetry is currently being collected there */
+	static UHeistNetTelemetrySubsystem* Get(const UObject* WorldContext);
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+
+	/**
+	 * Counts a property update if ValueHash differs from the last value seen for this actor and property.
+	 * EstimatedBytes is the caller's estimate of the value's size - the net driver does not expose per-property
+	 * bytes, so these are written to the CSV's est_bytes_per_sec column, apart from the measured connection bytes.
+	 */
+	void RecordPropertyIfChanged(const AActor* Actor, FName PropertyName, uint32 ValueHash, int32 EstimatedBytes);
+
+	/** Convenience overload for plain values, hashed by their memory representation and estimated at their in-memory size */
+	template<typename T>
+	void RecordPropertyIfChanged(const AActor* Actor, FName PropertyName, const T& Value)
+	{
+		RecordPropertyIfChanged(Actor, PropertyName, FCrc::MemCrc32(&Value, sizeof(T)), sizeof(T));
+	}
+
+	/** Counts one received server RPC */
+	void RecordRPC(const UObject* Owner, FName FunctionName);
+
+	/** Counts one received server RPC on Owner's world if telemetry is being collected there */
+	static void CountRPC(const UObject* Owner, FName FunctionName);
+
+	/** Counts one server RPC dropped by the rate limiter */
+	void RecordDroppedRPC(const UObject* Owner, FName FunctionName);
+
+	/** Counts one connection kicked by the rate limiter */
+	void RecordKick(const UObject* Owner);
+
+	/** True while the subsystem is collecting - checked by callers before computing value hashes */
+	bool IsCollecting() const;
+
+	/** Seconds between rows written to the CSV */
+	UPROPERTY(Config)
+	float FlushInterval = 1.0f;
+
+	/** Rows written to one file before rolling over to a new one */
+	UPROPERTY(Config)
+	int32 MaxRowsPerFile = 100000;
+
+	/** Telemetry files kept on disk - the oldest are deleted when rolling over */
+	UPROPERTY(Config)
+	int32 MaxFiles = 5;
+
+private:
+	/** Counters keyed by "Class.Property" or "Class.Function" for the current interval */
+	TMap<FName, FNetTelemetryCounter> PropertyCounters;
+	TMap<FName, FNetTelemetryCounter> RPCCounters;
+	TMap<FName, FNetTelemetryCounter> DroppedRPCCounters;
+	int32 Kicks = 0;
+
+	/** "Class.Member" counter names, built once per class and member */
+	TMap<TPair<const UClass*, FName>, FName> CounterNames;
+
+	/** Last value hash per actor and property, used for change detection */
+	TMap<TPair<FObjectKey, FName>, uint32> LastPropertyHashes;
+
+	/** Packet totals per connection at the last flush, used to derive loss over the interval */
+	struct FConnectionTotals
+	{
+		int32 InPackets = 0;
+		int32 OutPackets = 0;
+		int32 InPacketsLost = 0;
+		int32 OutPacketsLost = 0;
+	};
+	TMap<FObjectKey, FConnectionTotals> LastConnectionTotals;
+
+	float TimeSinceFlush = 0.0f;
+	double CollectStartTime = 0.0;
+
+	FString CurrentFilePath;
+	int32 CurrentFileRows = 0;
+
+	/** Last asynchronous append, completed before the next one starts */
+	TFuture<void> PendingWrite;
+
+	FName GetCounterName(const UObject* Owner, FName MemberName);
+
+	void Flush();
+	void AppendConnectionRows(TArray<FString>& OutRows, double Timestamp);
+	void WriteRows(TArray<FString>&& Rows);
+	void RollFile();
+	void PruneStaleEntries();
+};
@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "HeistRPCLimiterSubsystem.generated.h"
+
+/** Token bucket settings for one server RPC */
+USTRUCT()
+struct FHeistRPCRateLimit
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(Config)
+	FName FunctionName;
+
+	/** Sustained calls per second allowed */
+	UPROPERTY(Config)
+	float TokensPerSecond = 10.0f;
+
+	/** Calls allowed in a single burst */
+	UPROPERTY(Config)
+	float Burst = 5.0f;
+};
+
+/** Tokens left for one function on one connection */
+struct HEISTFPS_API FHeistTokenBucket
+{
+	float Tokens = 0.0f;
+	double LastRefillTime = 0.0;
+	bool bStarted = false;
+
+	/** Refills for the time since the last call, starting full, and takes a token. Returns false if none was left. */
+	bool TryConsume(const FHeistRPCRateLimit& Limit, double Now);
+};
+
+/**
+ * Per-connection token bucket limiter for server RPCs. RPC implementations call ConsumeRPC first and
+ * return early when it fails. A connection that keeps exceeding its budget is kicked.
+ * Clients keep a copy of the same budgets, so state RPCs can be held back and coalesced before they are sent, and
+ * shots the server would drop are never predicted.
+ */
+UCLASS(Config = Game)
+class HEISTFPS_API UHeistRPCLimiterSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Returns false if Actor's owning connection is over budget for FunctionName. Local players are never limited. */
+	static bool ConsumeRPC(const AActor* Actor, FName FunctionName);
+
+	/** Server retry of a call ConsumeRPC dropped and the caller kept - not counted as another violation when it fails */
+	static bool RetryRPC(const AActor* Actor, FName FunctionName);
+
+	/** Client check before sending FunctionName - returns false when the server would drop the call, so the caller holds the latest value and tries again */
+	static bool CanSendRPC(const AActor* Actor, FName FunctionName);
+
+	/** Sustained calls per second the server allows for FunctionName, or 0 when the limiter is off */
+	static float GetSustainedRate(const AActor* Actor, FName FunctionName);
+
+	/** Calls FloodFrame every frame for Frames frames and logs the server's frame times and dropped calls against MaxFloodFrameMs */
+	void StartFloodTest(TFunction<void()> FloodFrame, int32 Frames);
+
+	/** Per-function limits - functions without an entry use DefaultLimit */
+	UPROPERTY(Config)
+	TArray<FHeistRPCRateLimit> Limits;
+
+	UPROPERTY(Config)
+	FHeistRPCRateLimit DefaultLimit;
+
+	/** Dropped calls within ViolationWindow that get a connection kicked */
+	UPROPERTY(Config)
+	int32 KickThreshold = 200;
+
+	/** Seconds over which dropped calls are counted towards KickThreshold */
+	UPROPERTY(Config)
+	float ViolationWindow = 5.0f;
+
+	UPROPERTY(Config)
+	bool bEnabled = true;
+
+	/** Server frame time, excluding idle, a flood test must stay under */
+	UPROPERTY(Config)
+	float MaxFloodFrameMs = 16.0f;
+
+private:
+	struct FConnectionBudget
+	{
+		TMap<FName, FHeistTokenBucket> Buckets;
+		int32 Violations = 0;
+		double ViolationWindowStart = 0.0;
+		bool bKicked = false;
+	};
+
+	TMap<FName, FHeistRPCRateLimit> LimitsByFunction;
+	TMap<FObjectKey, FConnectionBudget> Connections;
+
+	/** The client's copy of its connection's budgets */
+	TMap<FName, FHeistTokenBucket> SendBuckets;
+
+	/** Calls dropped since the limiter started, reported by flood tests */
+	int32 DroppedCalls = 0;
+
+	TFunction<void()> FloodTestFrame;
+	FDelegateHandle FloodTestEndFrameHandle;
+	int32 FloodTestFrameCount = 0;
+	int32 FloodTestFrames = 0;
+	int32 FloodTestStartDropped = 0;
+	int32 FloodTestSavedKickThreshold = 0;
+	double FloodTestLastFrameTime = 0.0;
+	double FloodTestTotalMs = 0.0;
+	double FloodTestWorstMs = 0.0;
+
+	const FHeistRPCRateLimit& GetLimit(FName FunctionName) const;
+	bool Consume(class UNetConnection* Connection, FName FunctionName, const AActor* Actor, bool bCountViolation);
+	void Kick(class UNetConnection* Connection);
+	void OnFloodTestEndFrame();
+	void FinishFloodTest();
+};
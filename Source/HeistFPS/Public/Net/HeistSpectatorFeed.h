@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "UObject/ObjectKey.h"
+#include "Replay/HeistReplayFormat.h"
+#include "HeistSpectatorFeed.generated.h"
+
+class AHeistFPSCharacter;
+
+/** Quantized character state sent to spectators - the replicated form of FHeistReplayCharacterState */
+USTRUCT()
+struct FHeistSpectatorCharacterState
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY()
+	uint16 Id = 0;
+
+	UPROPERTY()
+	int32 LocationX = 0;
+
+	UPROPERTY()
+	int32 LocationY = 0;
+
+	UPROPERTY()
+	int32 LocationZ = 0;
+
+	UPROPERTY()
+	uint16 Yaw = 0;
+
+	UPROPERTY()
+	uint16 AimPitch = 0;
+
+	UPROPERTY()
+	uint16 AimYaw = 0;
+
+	UPROPERTY()
+	uint16 Direction = 0;
+
+	UPROPERTY()
+	uint16 Speed = 0;
+
+	UPROPERTY()
+	uint8 Flags = 0;
+
+	static FHeistSpectatorCharacterState FromReplayState(uint16 InId, const FHeistReplayCharacterState& State);
+	FHeistReplayCharacterState ToReplayState() const;
+};
+
+/** Every character at one server time */
+USTRUCT()
+struct FHeistSpectatorSnapshot
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY()
+	float ServerTime = 0.0f;
+
+	UPROPERTY()
+	TArray<FHeistSpectatorCharacterState> Characters;
+};
+
+/**
+ * Replicates all characters to spectator-only connections as one snapshot at SpectatorUpdateRate.
+ * Characters themselves are not relevant to spectators, so each observer costs one actor channel
+ * regardless of player count. Clients render the snapshots InterpolationDelay in the past on
+ * locally spawned puppet characters. Spawned by AHeistFPSGameMode.
+ */
+UCLASS(Config = Game)
+class HEISTFPS_API AHeistSpectatorFeed : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AHeistSpectatorFeed();
+
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void Tick(float DeltaTime) override;
+
+	/** Relevant to spectator-only connections and nobody else */
+	virtual bool IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const override;
+
+	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** True if Viewer is the controller of a spectator-only player */
+	static bool IsSpectatorViewer(const AActor* Viewer);
+
+	/** Snapshots sent to spectators per second */
+	UPROPERTY(Config)
+	float SpectatorUpdateRate = 10.0f;
+
+	/** Seconds behind the server at which spectators render, covering one missed snapshot */
+	UPROPERTY(Config)
+	float InterpolationDelay = 0.25f;
+
+protected:
+	UPROPERTY(ReplicatedUsing = OnRep_Snapshot)
+	FHeistSpectatorSnapshot Snapshot;
+
+	UFUNCTION()
+	void OnRep_Snapshot();
+
+private:
+	/** Received snapshots in server time order, oldest first */
+	TArray<FHeistSpectatorSnapshot> SnapshotBuffer;
+
+	TMap<uint16, TWeakObjectPtr<AHeistFPSCharacter>> Puppets;
+
+	/** Replay-style ids for server characters */
+	TMap<FObjectKey, uint16> CharacterIds;
+	uint16 NextCharacterId = 0;
+
+	void CaptureSnapshot();
+	void UpdatePuppets();
+	AHeistFPSCharacter* SpawnPuppet();
+};
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "Async/Future.h"
+#include "HeistMemorySubsystem.generated.h"
+
+/**
+ * Periodic memory CSV for sizing dedicated server containers. Every CsvInterval seconds appends the
+ * character count, process memory and the HeistFPS LLM tag totals to a rolling file under Saved/Telemetry.
+ * On by default on dedicated servers, elsewhere with heist.MemoryCsv 1 or -HeistMemoryCsv.
+ * heist.Memory.Dump logs the same snapshot once. Tag totals need -llm.
+ */
+UCLASS(Config = Game)
+class HEISTFPS_API UHeistMemorySubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+
+	/** Logs process memory, HeistFPS tag totals and live gameplay object counts for World */
+	static void DumpSnapshot(UWorld* World);
+
+	/** Characters in World - one per player or bot */
+	static int32 CountCharacters(UWorld* World);
+
+	/** Seconds between rows */
+	UPROPERTY(Config)
+	float CsvInterval = 10.0f;
+
+	UPROPERTY(Config)
+	bool bCsvOnDedicatedServer = true;
+
+	/** Rows written to one file before rolling over to a new one */
+	UPROPERTY(Config)
+	int32 MaxRowsPerFile = 50000;
+
+	/** Memory files kept on disk - the oldest are deleted when rolling over */
+	UPROPERTY(Config)
+	int32 MaxFiles = 5;
+
+private:
+	float TimeSinceRow = 0.0f;
+	double StartTime = 0.0;
+
+	FString CurrentFilePath;
+	int32 CurrentFileRows = 0;
+
+	/** Last asynchronous append, completed before the next one starts */
+	TFuture<void> PendingWrite;
+
+	bool IsWritingCsv() const;
+	void WriteRow();
+	void RollFile();
+};
@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+
+/** Low Level Memory tracker tags for HeistFPS gameplay allocations, in the engine's project tag range */
+enum class EHeistLLMTag : int32
+{
+	Characters = 150,
+	Weapons,
+	UI,
+	FX,
+	End
+};
+
+/**
+ * Attributes allocations in the enclosing scope to a HeistFPS LLM tag. Only active with -llm in builds
+ * with ENABLE_LOW_LEVEL_MEM_TRACKER, and compiles out otherwise.
+ */
+#define HEISTFPS_LLM_SCOPE(Tag) LLM_SCOPE(static_cast<ELLMTag>(EHeistLLMTag::Tag))
+
+class HEISTFPS_API FHeistMemoryTags
+{
+public:
+	/** Registers the tag names and stats with LLM - called once at module startup */
+	static void Register();
+
+	/** True if LLM is compiled in and was enabled on the command line */
+	static bool IsTracking();
+
+	/** Bytes currently attributed to Tag, or 0 when not tracking */
+	static int64 GetBytes(EHeistLLMTag Tag);
+
+	static const TCHAR* GetName(EHeistLLMTag Tag);
+
+	/** Calls Visitor for every HeistFPS tag */
+	static void ForEachTag(TFunctionRef<void(EHeistLLMTag)> Visitor);
+};
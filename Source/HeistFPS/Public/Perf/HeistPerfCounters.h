@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/PlatformTime.h"
+#include "Templates/Atomic.h"
+
+/** Accumulated cost of one HEISTFPS_SCOPE_CYCLE_COUNTER scope during a perf capture */
+struct HEISTFPS_API FHeistPerfCounter
+{
+	explicit FHeistPerfCounter(const TCHAR* InName) : Name(InName) {}
+
+	FString Name;
+	TAtomic<uint64> Cycles{ 0 };
+	TAtomic<int32> Calls{ 0 };
+
+	double GetAverageMs() const
+	{
+		const int32 NumCalls = Calls.Load();
+		return NumCalls > 0 ? FPlatformTime::ToMilliseconds64(Cycles.Load()) / NumCalls : 0.0;
+	}
+};
+
+/**
+ * Registry of perf counters fed by HEISTFPS_SCOPE_CYCLE_COUNTER. Unlike stats these are readable from
+ * code in every build configuration, which is what the perf harness compares against its baseline.
+ * Scopes cost a single flag check unless a capture is running.
+ */
+class HEISTFPS_API FHeistPerfCounters
+{
+public:
+	/** Returns the counter for Name, creating it on first use. The reference stays valid for the process lifetime. */
+	static FHeistPerfCounter& FindOrAdd(const TCHAR* Name);
+
+	/** Resets all counters and starts accumulating */
+	static void BeginCapture();
+
+	/** Stops accumulating - counters keep their values until the next BeginCapture */
+	static void EndCapture();
+
+	static bool IsCapturing() { return bCapturing; }
+
+	/** Calls Visitor for every counter that was hit during the last capture */
+	static void ForEachCounter(TFunctionRef<void(const FHeistPerfCounter&)> Visitor);
+
+private:
+	static TAtomic<bool> bCapturing;
+};
+
+/** Adds the duration of its lifetime to a counter while a capture is running */
+struct FHeistPerfScope
+{
+	explicit FHeistPerfScope(FHeistPerfCounter& InCounter)
+		: Counter(FHeistPerfCounters::IsCapturing() ? &InCounter : nullptr)
+		, StartCycles(Counter != nullptr ? FPlatformTime::Cycles64() : 0)
+	{
+	}
+
+	~FHeistPerfScope()
+	{
+		if (Counter != nullptr)
+		{
+			Counter->Cycles += FPlatformTime::Cycles64() - StartCycles;
+			Counter->Calls++;
+		}
+	}
+
+private:
+	FHeistPerfCounter* Counter;
+	uint64 StartCycles;
+};
@@ -0,0 +1,214 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Engine/World.h"
+#include "HAL/PlatformProcess.h"
+#include "UObject/ObjectKey.h"
+#include "HeistPerfHarnessSubsystem.generated.h"
+
+/**
+ * Headless performance guardrail. Captures the HeistFPS perf counters, frame times and memory growth,
+ * then compares them against the committed baseline with a configurable tolerance.
+ * The scripted scenario steps through ScenarioPlayerCounts and reports server frame time and bytes per client
+ * at each count, so it doubles as the player count load test.
+ * ScenarioClients -nullrhi client processes are launched against the server so bandwidth is measured on real
+ * connections; server-side bots make up the rest of each player count. A phase that measures no clients fails.
+ * Bots fire into each other, so the capture includes damage resolution; bots that die are replaced.
+ * ScenarioMovingBotPct of them walk a square while the rest stand, so both the full and the skipped movement paths are measured.
+ * Before the player count phases, spawn, equip, fire, sprint and crouch are each run once on OperationProbeCount bots
+ * and recorded as Op.<Name>.Ms, Op.<Name>.Allocs and Op.<Name>.BytesPerClient per operation.
+ *
+ * Run a scripted scenario and exit with a non-zero code on regression:
+ *   HeistFPS /Game/Maps/Test/Test1 -server -nullrhi -unattended -HeistPerfCheck [-HeistPerfSaveBaseline]
+ * Or capture manually with heist.Perf.Begin / heist.Perf.End [save].
+ */
+UCLASS(Config = Game)
+class HEISTFPS_API UHeistPerfHarnessSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	void BeginCapture();
+
+	/** Ends the capture, logs the results and compares them against the baseline. Returns false on regression. */
+	bool EndCapture(bool bSaveBaseline);
+
+	bool IsCapturing() const { return bCapturing; }
+
+	/** Seconds between the world starting and the capture starting */
+	UPROPERTY(Config)
+	float WarmupSeconds = 5.0f;
+
+	/** Length of the scripted scenario */
+	UPROPERTY(Config)
+	float ScenarioSeconds = 30.0f;
+
+	/** Bot counts the scripted scenario steps through, each held for an equal share of ScenarioSeconds */
+	UPROPERTY(Config)
+	TArray<int32> ScenarioPlayerCounts;
+
+	/** Client processes launched against the scenario server, counted towards each player count */
+	UPROPERTY(Config)
+	int32 ScenarioClients = 4;
+
+	/** Seconds after the warmup the scenario waits for ScenarioClients to connect before starting with fewer */
+	UPROPERTY(Config)
+	float ClientJoinTimeoutSeconds = 60.0f;
+
+	/** Share of bots that walk during the scenario, in percent */
+	UPROPERTY(Config)
+	float ScenarioMovingBotPct = 50.0f;
+
+	/** Bots each operation probe runs on before the player count phases, 0 to skip the probes */
+	UPROPERTY(Config)
+	int32 OperationProbeCount = 8;
+
+	/** Frames the bytes sent after a probed operation are collected over, and the idle frames they are compared against */
+	UPROPERTY(Config)
+	int32 OperationProbeFrames = 30;
+
+	/**
+	 * Allowed relative change from the baseline before a metric counts as a regression - an increase for costs,
+	 * a decrease for Movement.SkippedPct. Counts of work the bots did are only logged.
+	 * A Tolerance entry in the baseline file overrides this. SaveBaseline writes this value there, so a measured
+	 * baseline carries its noise margin and a file of hand-set ceilings can carry 0.
+	 */
+	UPROPERTY(Config)
+	float Tolerance = 0.2f;
+
+	/** Absolute differences below this are treated as noise */
+	UPROPERTY(Config)
+	float NoiseFloor = 0.005f;
+
+	/** Records a replay during the scripted scenario so its cost is part of the capture */
+	UPROPERTY(Config)
+	bool bRecordReplayDuringScenario = true;
+
+	/** Replay recording cost above this share of frame time fails the capture, in percent */
+	UPROPERTY(Config)
+	float MaxReplayRecordFramePct = 1.0f;
+
+	/** Average server frame time, idle excluded, above this at any scenario player count fails the capture */
+	UPROPERTY(Config)
+	float MaxServerFrameMs = 16.0f;
+
+	/** Memory growth per character added during the capture above this fails it, in MB */
+	UPROPERTY(Config)
+	float MaxMemoryGrowthPerPlayerMB = 16.0f;
+
+	/** Baseline file, relative to the project directory */
+	UPROPERTY(Config)
+	FString BaselineFile = TEXT("Config/HeistPerfBaseline.ini");
+
+private:
+	bool bCapturing = false;
+	bool bScenarioRequested = false;
+	bool bSaveBaselineAfterScenario = false;
+
+	double CaptureStartTime = 0.0;
+	uint64 CaptureStartMemory = 0;
+	int32 CaptureStartCharacters = 0;
+	TMap<int32, int64> CaptureStartTagBytes;
+	int32 CaptureStartHits = 0;
+	int32 CaptureStartDeathBroadcasts = 0;
+	int64 CaptureStartMovementSteps = 0;
+	int64 CaptureStartSkippedMovementSteps = 0;
+	int64 CaptureStartClientMoves = 0;
+	uint64 CaptureStartAllocations = 0;
+
+	int32 CapturedFrames = 0;
+	double CapturedFrameMs = 0.0;
+	double WorstFrameMs = 0.0;
+	double LastFrameTime = 0.0;
+
+	/** Frame times of the current phase, reported per player count */
+	int32 PhaseFrames = 0;
+	double PhaseFrameMs = 0.0;
+	double PhaseWorstFrameMs = 0.0;
+
+	FDelegateHandle WorldInitializedHandle;
+	FDelegateHandle EndFrameHandle;
+	FDelegateHandle PreActorTickHandle;
+
+	TWeakObjectPtr<UWorld> ScenarioWorld;
+	TArray<TWeakObjectPtr<class AHeistFPSCharacter>> Bots;
+	FTimerHandle ScenarioTimerHandle;
+	FTimerHandle ScenarioStepTimerHandle;
+	int32 ScenarioStep = 0;
+	int32 ScenarioPhase = 0;
+
+	/** Outgoing bytes per client connection at the start of the current phase */
+	double PhaseStartTime = 0.0;
+	TMap<FObjectKey, int64> PhaseStartConnectionBytes;
+
+	/** Per-client bandwidth of every finished phase, merged into the capture results */
+	TMap<FString, double> PhaseResults;
+	double MaxClientBytesPerSec = 0.0;
+
+	/** Index into the probed operations, INDEX_NONE until the probes have run */
+	int32 ProbeOp = INDEX_NONE;
+	bool bProbeIdleWindow = false;
+	int32 ProbeFramesLeft = 0;
+	int64 ProbeStartBytes = 0;
+	int64 ProbeIdleBytes = 0;
+	int32 ProbeOps = 0;
+	FDelegateHandle ProbeEndFrameHandle;
+
+	/** Per-operation results of the probes, merged into the capture results */
+	TMap<FString, double> OperationResults;
+
+	/** Fewest client connections measured by any phase, INDEX_NONE until a phase ends */
+	int32 MinPhaseClients = INDEX_NONE;
+
+	TArray<FProcHandle> ClientProcesses;
+	double ClientJoinDeadline = 0.0;
+
+	void OnWorldInitializedActors(const UWorld::FActorsInitializedParams& Params);
+	void OnEndFrame();
+
+	void StartScenario();
+	void StepScenario();
+	void FinishScenario();
+
+	/** Gives walking bots their movement input - input is consumed every tick, so it is added every tick */
+	void DriveBots(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+
+	/** Launches ScenarioClients -nullrhi game processes that connect to the scenario server */
+	void LaunchClients();
+	void StopClients();
+	int32 GetNumClientConnections() const;
+
+	/** Runs every probed operation in turn, each after an idle window of the same length, then starts the scenario */
+	void StartOperationProbes();
+	void OnProbeEndFrame();
+
+	/** Runs ProbeOp on the probe bots, recording time and allocations per operation. Returns the operations run. */
+	int32 RunProbeOp();
+
+	/** Bytes sent to all client connections so far */
+	int64 GetClientBytesSent() const;
+
+	/** Allocations made so far, as counted by the engine allocator - 0 if it does not count them */
+	static uint64 GetAllocationCount();
+
+	/** Spawns bots until Count are alive and starts measuring per-client bandwidth */
+	void BeginPhase(int32 Count);
+
+	/** Spawns a bot at its grid slot near the first player start */
+	class AHeistFPSCharacter* SpawnBot(int32 Slot);
+	void EndPhase(int32 Count);
+	void AdvancePhase();
+
+	/** Collects metric name to value for the capture that just ended */
+	TMap<FString, double> CollectResults() const;
+
+	bool CompareAgainstBaseline(const TMap<FString, double>& Results) const;
+	bool CheckBudgets(const TMap<FString, double>& Results) const;
+	void SaveBaseline(const TMap<FString, double>& Results) const;
+};
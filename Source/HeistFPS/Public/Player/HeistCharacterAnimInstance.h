@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Animation/AnimInstance.h"
+#include "Animation/AnimInstanceProxy.h"
+#include "HeistCharacterAnimInstance.generated.h"
+
+class AHeistFPSCharacter;
+
+/**
+ * Anim graph inputs for AHeistFPSCharacter. PreUpdate copies the character's state on the game thread
+ * - a handful of plain values, no casts or Blueprint calls - and Update derives everything the graph
+ * reads on an animation worker thread. The graph reads these through the instance's Proxy property.
+ */
+USTRUCT(BlueprintType)
+struct HEISTFPS_API FHeistCharacterAnimInstanceProxy : public FAnimInstanceProxy
+{
+	GENERATED_BODY()
+
+	FHeistCharacterAnimInstanceProxy() {}
+	FHeistCharacterAnimInstanceProxy(UAnimInstance* InAnimInstance) : FAnimInstanceProxy(InAnimInstance) {}
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Movement)
+	float Speed = 0.0f;
+
+	/** Movement direction relative to facing in degrees, eased so direction flips blend instead of pop */
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Movement)
+	float Direction = 0.0f;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Movement)
+	bool bIsMoving = false;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Movement)
+	bool bIsInAir = false;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Movement)
+	bool bIsCrouched = false;
+
+	/** Yaw turn rate in degrees per second, clamped to +-1 at MaxLeanYawRate */
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Movement)
+	float Lean = 0.0f;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Combat)
+	float AimPitch = 0.0f;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Combat)
+	float AimYaw = 0.0f;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Combat)
+	bool bCombatInitiated = false;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Combat)
+	bool bPrimaryEquipped = false;
+
+	/** Eases between 0 and 1 as aim down sight toggles */
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Combat)
+	float AimDownSightAlpha = 0.0f;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Health)
+	bool bIsDead = false;
+
+protected:
+	virtual void InitializeObjects(UAnimInstance* InAnimInstance) override;
+	virtual void PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds) override;
+	virtual void Update(float DeltaSeconds) override;
+
+private:
+	/** Game thread snapshot, read only by Update */
+	struct FSnapshot
+	{
+		float Speed = 0.0f;
+		float Direction = 0.0f;
+		float AimPitch = 0.0f;
+		float AimYaw = 0.0f;
+		float ActorYaw = 0.0f;
+		bool bIsInAir = false;
+		bool bIsCrouched = false;
+		bool bCombatInitiated = false;
+		bool bPrimaryEquipped = false;
+		bool bAimDownSight = false;
+		bool bIsDead = false;
+	};
+	FSnapshot Snapshot;
+
+	float LastActorYaw = 0.0f;
+	bool bHasLastYaw = false;
+
+	TWeakObjectPtr<AHeistFPSCharacter> Character;
+
+	float DirectionInterpSpeed = 10.0f;
+	float AimDownSightInterpSpeed = 12.0f;
+	float MaxLeanYawRate = 180.0f;
+};
+
+/**
+ * Native parent for the character anim blueprint. Updates run on worker threads through the proxy
+ * (bUseMultiThreadedAnimationUpdate) so the Blueprint event graph should stay empty.
+ *
+ * Compare game thread cost with stat HeistFPS and stat Anim while toggling a.ParallelAnimUpdate and
+ * a.Budget.Enabled, or read Anim.GameThreadFramePct from a heist.Perf capture.
+ */
+UCLASS(Transient, Blueprintable)
+class HEISTFPS_API UHeistCharacterAnimInstance : public UAnimInstance
+{
+	GENERATED_BODY()
+
+public:
+	/** Easing speeds for the derived values */
+	UPROPERTY(EditDefaultsOnly, Category = Smoothing)
+	float DirectionInterpSpeed = 10.0f;
+
+	UPROPERTY(EditDefaultsOnly, Category = Smoothing)
+	float AimDownSightInterpSpeed = 12.0f;
+
+	UPROPERTY(EditDefaultsOnly, Category = Smoothing)
+	float MaxLeanYawRate = 180.0f;
+
+protected:
+	virtual FAnimInstanceProxy* CreateAnimInstanceProxy() override { return &Proxy; }
+	virtual void DestroyAnimInstanceProxy(FAnimInstanceProxy* InProxy) override {}
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Animation, meta = (AllowPrivateAccess = "true"))
+	FHeistCharacterAnimInstanceProxy Proxy;
+
+	friend struct FHeistCharacterAnimInstanceProxy;
+};
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "HeistCharacterMovementComponent.generated.h"
+
+/**
+ * Character movement with two cheaper server paths, toggled with heist.Movement.Simplified:
+ *
+ * Idle - a walking character with no input, no acceleration and no velocity on a static floor would
+ * not move this step, so the step is skipped along with its floor check. The floor is re-checked
+ * with a full step every FloorRecheckInterval. For remote players this applies to each ServerMove:
+ * the position the client reports is the one the server already holds, so reconciliation still
+ * compares the same two values and corrections behave as before.
+ *
+ * Far - server-controlled characters more than FarDistance from every player tick at FarTickInterval
+ * and skip floor checks when they have not moved enough to need one. They return to full rate when
+ * a player comes close or WakeUp is called, e.g. when they take damage.
+ */
+UCLASS()
+class HEISTFPS_API UHeistCharacterMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/** Server - runs one client move, or skips it if it cannot move the character */
+	virtual void MoveAutonomous(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags, const FVector& NewAccel) override;
+
+	/** Leaves the idle and far paths for WakeSeconds */
+	void WakeUp();
+
+	bool IsFar() const { return bFar; }
+
+	/** Steps run and skipped since startup, across all characters - read by the perf harness */
+	static int64 GetNumSteps() { return NumSteps; }
+	static int64 GetNumSkippedSteps() { return NumSkippedSteps; }
+
+	/** Client moves received by the server since startup, across all characters */
+	static int64 GetNumClientMoves() { return NumClientMoves; }
+
+	UPROPERTY(EditDefaultsOnly, Category = "Character Movement: Simplified")
+	float FloorRecheckInterval = 0.5f;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Character Movement: Simplified")
+	float FarDistance = 8000.0f;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Character Movement: Simplified")
+	float FarTickInterval = 0.1f;
+
+	/** Seconds between checks of the distance to the nearest player */
+	UPROPERTY(EditDefaultsOnly, Category = "Character Movement: Simplified")
+	float DistanceCheckInterval = 0.5f;
+
+	UPROPERTY(EditDefaultsOnly, Category = "Character Movement: Simplified")
+	float WakeSeconds = 2.0f;
+
+private:
+	float TimeSinceFloorCheck = 0.0f;
+	float TimeSinceDistanceCheck = 0.0f;
+	float WakeTimeLeft = 0.0f;
+	bool bFar = false;
+
+	static int64 NumSteps;
+	static int64 NumSkippedSteps;
+	static int64 NumClientMoves;
+
+	/** True if a step with InputAcceleration would leave the character where it is */
+	bool CanSkipStep(const FVector& InputAcceleration) const;
+
+	void UpdateFarState(float DeltaTime);
+	void SetFar(bool bNewFar);
+};
@@ -4,19 +4,89 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "Net/HeistInterpolationBuffer.h"
+#include "Player/HeistInputSampler.h"
 #include "HeistFPSCharacter.generated.h"
 
+/** Last combat state request the server applied, replicated back to the owner for reconciliation */
+USTRUCT()
+struct FHeistCombatStateAck
+{
+	GENERATED_BODY()
+public:
+	/** Bit 0 primary equipped, bit 1 aiming down sights */
+	UPROPERTY()
+	uint8 PackedState = 0;
+
+	UPROPERTY()
+	uint8 Sequence = 0;
+
+	/** Shot epoch of the newest shot the server accepted */
+	UPROPERTY()
+	uint8 ShotEpoch = 0;
+};
+
+/** Quantized anim parameters with the server time they were computed at, sent to simulated proxies */
+USTRUCT()
+struct FHeistReplicatedAnimState
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY()
+	float ServerTime = 0.0f;
+
+	/** Speed in cm/s */
+	UPROPERTY()
+	uint16 Speed = 0;
+
+	/** Angles compressed with FRotator::CompressAxisToShort */
+	UPROPERTY()
+	uint16 Direction = 0;
+
+	UPROPERTY()
+	uint16 Pitch = 0;
+
+	UPROPERTY()
+	uint16 Yaw = 0;
+
+	bool HasSameValues(const FHeistReplicatedAnimState& Other) const
+	{
+		return Speed == Other.Speed && Direction == Other.Direction && Pitch == Other.Pitch && Yaw == Other.Yaw;
+	}
+};
+
+/** Health and armor quantized to a byte each of their maximums */
+USTRUCT()
+struct FHeistHealthState
+{
+	GENERATED_BODY()
+public:
+	/** 0 only when dead - any health left rounds up to at least 1 */
+	UPROPERTY()
+	uint8 Health = 255;
+
+	UPROPERTY()
+	uint8 Armor = 0;
+};
+
 UCLASS(config=Game)
 class AHeistFPSCharacter : public ACharacter
 {
 	GENERATED_BODY()
 
 public:
-	AHeistFPSCharacter();
+	/** Swaps in a budgeted mesh component so the animation budget allocator can throttle it */
+	AHeistFPSCharacter(const FObjectInitializer& ObjectInitializer);
 
 	/** spawn inventory, setup initial variables */
 	virtual void PostInitializeComponents() override;
 
+	/** Server - clears state left by the previous owner before a new controller drives the character */
+	virtual void PossessedBy(AController* NewController) override;
+
+	/** Owning client - the client side of the reset done in PossessedBy */
+	virtual void PawnClientRestart() override;
+
 	/** Follow camera */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 	class UCameraComponent* FPSCamera;
@@ -33,6 +103,15 @@ public:
 
 	void SpawnDefaultInventory();
 
+	/** Server - replaces the inventory with WeaponClasses if it differs, or with DefaultWeaponClasses when empty */
+	void SetLoadout(const TArray<TSubclassOf<class AWeaponBase>>& WeaponClasses);
+
+	/** Weapons chosen by the controlling player - overrides DefaultWeaponClasses when not empty */
+	UPROPERTY(Transient)
+	TArray<TSubclassOf<class AWeaponBase>> LoadoutWeaponClasses;
+
+	bool bInventorySpawned = false;
+
 	/** Base turn rate, in deg/sec. Other scaling may affect final turn rate. */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category=Camera)
 	float BaseTurnRate;
@@ -56,16 +135,21 @@ public:
 	UPROPERTY(Replicated, VisibleAnywhere, BlueprintReadOnly, Category = Movement)
 	float LastMoveRightValue = 1.0f;
 
-	UPROPERTY(Replicated, VisibleAnywhere, BlueprintReadOnly, Category = Movement)
+	/** Movement axes held at heist.Input.SampleRate before they reach the movement component */
+	FHeistAxisSampler MoveForwardSampler;
+	FHeistAxisSampler MoveRightSampler;
+
+	/** Anim parameters below are computed on the server and owning client, and interpolated from AnimState on simulated proxies */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Movement)
 	float CurrentSpeed;
 
-	UPROPERTY(Replicated, VisibleAnywhere, BlueprintReadOnly, Category = Movement)
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Movement)
 	float CurrentDirection;
 
-	UPROPERTY(Replicated, VisibleAnywhere, BlueprintReadOnly, Category = Movement)
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Movement)
 	float CurrentPitch;
 
-	UPROPERTY(Replicated, VisibleAnywhere, BlueprintReadOnly, Category = Movement)
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Movement)
 	float CurrentYaw;
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Movement)
@@ -86,15 +170,111 @@ public:
 	/** Returns FollowCamera subobject **/
 	FORCEINLINE class UCameraComponent* GetFPSCamera() const { return FPSCamera; }
 
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Health)
+	float MaxHealth = 100.0f;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Health)
+	float MaxArmor = 100.0f;
+
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Health)
+	float StartingArmor = 50.0f;
+
+	/** Share of body hit damage taken by armor while any is left */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Health)
+	float ArmorAbsorption = 0.6f;
+
+	/** Seconds a dead character stays in the world */
+	UPROPERTY(EditDefaultsOnly, Category = Health)
+	float DeathLifeSpan = 5.0f;
+
+	/** Exact on the server, dequantized from HealthState elsewhere */
+	UFUNCTION(BlueprintPure, Category = Health)
+	float GetHealth() const;
+
+	UFUNCTION(BlueprintPure, Category = Health)
+	float GetArmor() const;
+
+	UFUNCTION(BlueprintPure, Category = Health)
+	bool IsDead() const { return HealthState.Health == 0; }
+
+	/** Server - written by UHeistDamageSubsystem once per frame for each character that was hit */
+	void SetHealthAndArmor(float NewHealth, float NewArmor);
+
+	/** Server - stops the character and leaves the body for DeathLifeSpan */
+	void Die();
+
+	/** Server - hides and parks the character, inventory included, for the game mode's pawn pool. Clients keep the parked actor. */
+	void DeactivateForPool();
+
+	/** Server - brings a pooled character back at Transform with full health and weapons holstered */
+	void ActivateFromPool(const FTransform& Transform);
+
+	bool IsPooled() const { return bPooled; }
+
+	/** Locally controlled - interactable the player would use by pressing Interact, for HUD prompts */
+	UPROPERTY(Transient, BlueprintReadOnly, Category = Interaction)
+	class AHeistInteractable* FocusedInteractable = nullptr;
+
 	/** Property replication */
 	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
+	/** Reports replicated property changes to net telemetry */
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
+	/** Spectator-only connections receive characters through AHeistSpectatorFeed instead. Pooled characters stay relevant while dormant. */
+	virtual bool IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const override;
+
+	/** Scaled per viewing connection by UHeistNetPrioritySubsystem */
+	virtual float GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, class AActor* Viewer, AActor* ViewTarget, class UActorChannel* InChannel, float Time, bool bLowBandwidth) override;
+
+	/** Lowers the rate this character is sent to connections it matters little to */
+	virtual bool IsReplicationPausedForConnection(const FNetViewer& ConnectionOwnerNetViewer) override;
+
+	/** Runs each time the character is actually replicated to a connection, so the throttle times real sends */
+	virtual bool ReplicateSubobjects(class UActorChannel* Channel, class FOutBunch* Bunch, FReplicationFlags* RepFlags) override;
+
+	/** Server - true if the character moved or its anim parameters changed within the last Seconds */
+	bool HasMovedWithin(float Seconds) const;
+
+	/** Turns a locally spawned character into a puppet driven by replays or the spectator feed */
+	void MakePuppet();
+
+	/** Input actions - public so bots, such as the perf harness's, drive characters the way players do */
+	void ToggleCrouch();
+
+	void StartSprint();
+
+	void StopSprint();
+
+	void FireWeapon();
+
+	void TogglePrimaryWeapon();
+
+	/** Server rules for a combat state request, static so the shot sequence tests run the same code. Returns false for a
+	 *  duplicate or a request older than one already applied, otherwise the state to apply, with Ack updated to match. */
+	static bool ResolveCombatStateRequest(uint8 PackedState, uint8 Sequence, class AWeaponBase* Weapon, FHeistCombatStateAck& Ack, bool& bOutEquipped, bool& bOutADS);
+
+	/** Server rules for a shot. Shots are reliable and combat requests are not, so a shot can overtake the equip it was
+	 *  fired after - it then equips (bInOutEquipped) - or trail the unequip that followed it. Returns false to drop it. */
+	static bool ResolveShot(uint16 PackedShot, class AWeaponBase* Weapon, FHeistCombatStateAck& Ack, bool& bInOutEquipped);
+
+#if !UE_BUILD_SHIPPING
+	/** Sends Count server RPCs at once to exercise the server rate limiter */
+	void DebugFloodServerRPCs(int32 Count);
+#endif
+
+	/** Has the owning client call DebugFloodServerRPCs every frame for Frames frames - does nothing in shipping builds */
+	UFUNCTION(Client, Reliable)
+	void ClientDebugFloodServerRPCs(int32 CallsPerFrame, int32 Frames);
+
 protected:
 
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 	
 	void BeginPlay();
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	void Tick(float DeltaTime);
 
 	void MoveForward(float Value);
@@ -107,31 +287,146 @@ protected:
 
 	void TogglePauseMenu();
 
-	void ToggleCrouch();
+	void StartAimDownSight();
 
-	void StartSprint();
+	void StopAimDownSight();
 
-	void StopSprint();
+	void Interact();
 
-	void FireWeapon();
+	/** Locally controlled - refreshes FocusedInteractable from the interaction grid */
+	void UpdateInteractionFocus();
 
-	void TogglePrimaryWeapon();
+	/** Predicts a new equip and ADS state locally and requests it from the server */
+	void SetCombatState(bool bEquipped, bool bADS);
+
+	/** Applies equip and ADS state on whichever side calls it */
+	void ApplyCombatState(bool bEquipped, bool bADS);
+
+	void UpdateAimDownSightCamera();
+
+	void SendCombatState();
+
+	void ResendPendingCombatState();
+
+	static uint8 PackCombatState(bool bEquipped, bool bADS) { return (bEquipped ? 1 : 0) | (bADS ? 2 : 0); }
+
+	UFUNCTION()
+	void OnRep_CombatStateAck();
+
+	UPROPERTY(ReplicatedUsing = OnRep_CombatStateAck)
+	FHeistCombatStateAck CombatStateAck;
+
+	/** Sequence of the latest combat state requested by the owning client */
+	uint8 LocalCombatSequence = 0;
+
+	float LastCombatStateSendTime = 0.0f;
 
-	void AimDownSight();
+	/** Frames skipped between anim updates at each mesh LOD, for meshes the budget allocator is not managing */
+	UPROPERTY(EditDefaultsOnly, Category = Animation)
+	TArray<int32> AnimFramesSkippedPerLOD;
+
+	/** Distance from the local view at which anim budget significance has fallen to half */
+	UPROPERTY(EditDefaultsOnly, Category = Animation)
+	float AnimSignificanceDistance = 2500.0f;
+
+	/** Seconds between anim budget significance updates - distance to the view changes slowly */
+	UPROPERTY(EditDefaultsOnly, Category = Animation)
+	float AnimSignificanceInterval = 0.25f;
+
+	/** Counts up to AnimSignificanceInterval, started at a random offset so characters update on different frames */
+	float TimeSinceAnimSignificanceUpdate = 0.0f;
+
+	/** Local player controller whose view significance is measured from */
+	TWeakObjectPtr<APlayerController> AnimSignificanceViewer;
+
+	/** Seconds between resends of an unacknowledged combat state request */
+	UPROPERTY(EditDefaultsOnly, Category = Combat)
+	float CombatStateResendInterval = 0.1f;
 
 	void UpdateCharacterAnimMovement(float DeltaTime);
 
+	/** Clients - URO frame skipping by LOD, set up when the mesh creates its update rate parameters */
+	void OnAnimUpdateRateParamsCreated(FAnimUpdateRateParameters* Params);
+
+	/** Clients - ranks this mesh for the animation budget allocator by distance to the local view, every AnimSignificanceInterval */
+	void UpdateAnimBudgetSignificance();
+
+	/** Server - publishes the anim parameters to simulated proxies when their quantized values change */
+	void UpdateReplicatedAnimState();
+
+	/** Simulated proxies - renders anim parameters ProxyInterpolationDelay behind the server */
+	void UpdateProxyAnimation();
+
+	UFUNCTION()
+	void OnRep_AnimState();
+
+	UFUNCTION()
+	void OnRep_HealthState();
+
+	UPROPERTY(ReplicatedUsing = OnRep_HealthState)
+	FHeistHealthState HealthState;
+
+	/** Server only - HealthState carries the replicated copy */
+	float Health = 0.0f;
+	float Armor = 0.0f;
+
+	/** Ragdolls the mesh and disables movement and collision - runs on every machine */
+	void PlayDeath();
+
+	/** Undoes PlayDeath when a pooled character is reused */
+	void RestoreFromDeath();
+
+	bool bPlayedDeath = false;
+	bool bPooled = false;
+
+	/** Mesh placement and collision before any ragdoll, restored by RestoreFromDeath */
+	FTransform MeshRelativeTransform;
+	FName MeshCollisionProfile;
+
+	UPROPERTY(ReplicatedUsing = OnRep_AnimState)
+	FHeistReplicatedAnimState AnimState;
+
+	FHeistAnimInterpolationBuffer AnimBuffer;
+
+	/** Seconds in the past simulated proxies render at - at least one update interval keeps them interpolating */
+	UPROPERTY(EditDefaultsOnly, Category = Replication)
+	float ProxyInterpolationDelay = 0.1f;
+
 	UFUNCTION(Server, Unreliable, WithValidation)
 	void ServerUpdateLastMoveRight(float Value);
 
+	/** Sprint and move right values held back by the RPC budget - clients send the latest once it refills, the server applies what its limiter dropped */
+	TOptional<bool> PendingSprint;
+	TOptional<float> PendingMoveRight;
+
+#if !UE_BUILD_SHIPPING
+	/** Flood started by ClientDebugFloodServerRPCs */
+	int32 DebugFloodCallsPerFrame = 0;
+	int32 DebugFloodFramesLeft = 0;
+#endif
+
+	void FlushPendingServerState();
+
+	/** Resets combat sequences, shot sequences, anim state and input sampling to a fresh character's */
+	void ResetForPossession();
+
+	/** Sends the full desired state and the weapon's shot epoch with a sequence number, so it can be unreliable and resent */
+	UFUNCTION(Server, Unreliable, WithValidation)
+	void ServerSetCombatState(uint8 PackedState, uint8 Sequence);
+
 	UFUNCTION(Server, Reliable, WithValidation)
-	void ServerAimDownSight();
+	void ServerToggleSprint(bool bIsSprinting);
 
+	/** Sends the packed shot index and compressed aim - the server derives spread and recoil from the weapon seed */
 	UFUNCTION(Server, Reliable, WithValidation)
-	void ServerTogglePrimaryWeapon(bool IsEquipping);
+	void ServerFireWeapon(uint16 PackedShot, uint16 AimPitch, uint16 AimYaw);
 
+	/** The server repeats the range check before interacting */
 	UFUNCTION(Server, Reliable, WithValidation)
-	void ServerToggleSprint(bool bIsSprinting);
+	void ServerInteract(class AHeistInteractable* Target);
+
+	/** Spawns the authoritative round on the server and notifies remote clients */
+	void HandleFireWeapon(uint16 PackedShot, const FRotator& Aim);
 
 };
 
@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Holds an input axis at a fixed rate so the rate it changes at does not depend on frame rate.
+ * Values are snapped to steps of Quantum so stick noise does not count as a change. A new value is
+ * taken once per sample period. Pressing, releasing or reversing the axis is applied at once, and so
+ * is any digital value - keys only read -1, 0 or 1, so every change they make is a press or release.
+ * Between samples the axis reads the held value. Consecutive frames then give the movement component
+ * equal accelerations, so their saved moves combine and a high frame rate client sends no more moves
+ * than a low frame rate one.
+ *
+ * The sample rate is set with heist.Input.SampleRate - 0 passes every frame's value through.
+ */
+class HEISTFPS_API FHeistAxisSampler
+{
+public:
+	/** Axis values are snapped to multiples of this */
+	static constexpr float Quantum = 1.0f / 64.0f;
+
+	/**
+	 * Records the raw value read at Time, in platform seconds, and returns the value to apply.
+	 * MaxRate, when above 0, caps how often an analog value is taken, e.g. to the RPC budget of an axis the server is told about.
+	 */
+	float Sample(float RawValue, double Time, float MaxRate = 0.0f);
+
+	float GetHeldValue() const { return HeldValue; }
+
+	void Reset() { HeldValue = 0.0f; SampleTime = 0.0; }
+
+	/** Seconds between samples, 0 when sampling every frame */
+	static float GetSamplePeriod(float MaxRate = 0.0f);
+
+private:
+	float HeldValue = 0.0f;
+
+	/** Platform time the held value was taken at */
+	double SampleTime = 0.0;
+};
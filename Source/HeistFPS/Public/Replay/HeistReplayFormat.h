@@ -0,0 +1,235 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AHeistFPSCharacter;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * Heist replay file layout (.hreplay, little endian):
+ *   Header   - magic, version, sample rate, keyframe interval, start time, map name and travel URL
+ *   Records  - [type u8][time varint][payload], time is absolute ms for keyframes and a delta otherwise
+ *   Index    - keyframe count, then (time ms u32, file offset u64) per keyframe
+ *   Footer   - index offset u64, duration ms u32, magic u32
+ * Frame records only carry the characters and field groups that changed since the previous sample,
+ * as zigzag varint deltas. Keyframes carry every character in full, followed by the names of every
+ * character added so far, so playback can start from them.
+ */
+namespace HeistReplay
+{
+	static constexpr uint32 HeaderMagic = 0x4C505248; // HRPL
+	static constexpr uint32 FooterMagic = 0x49505248; // HRPI
+	static constexpr uint32 Version = 2;
+}
+
+enum class EHeistReplayRecord : uint8
+{
+	Frame = 1,
+	Keyframe = 2,
+	Shot = 3,
+	CharacterAdded = 4,
+	CharacterRemoved = 5,
+};
+
+/** Quantized animation-relevant state of one character in a replay sample */
+struct HEISTFPS_API FHeistReplayCharacterState
+{
+	enum EFlags : uint8
+	{
+		Crouched = 1 << 0,
+		CombatInitiated = 1 << 1,
+		PrimaryEquipped = 1 << 2,
+		AimDownSight = 1 << 3,
+		MoveRightNegative = 1 << 4,
+	};
+
+	/** Field groups written by delta frames */
+	enum EFieldMask : uint8
+	{
+		FieldLocation = 1 << 0,
+		FieldYaw = 1 << 1,
+		FieldAim = 1 << 2,
+		FieldSpeed = 1 << 3,
+		FieldDirection = 1 << 4,
+		FieldFlags = 1 << 5,
+		FieldAll = 0x3F,
+	};
+
+	/** Location in whole centimetres */
+	int32 LocationX = 0;
+	int32 LocationY = 0;
+	int32 LocationZ = 0;
+
+	/** Angles compressed with FRotator::CompressAxisToShort */
+	uint16 Yaw = 0;
+	uint16 AimPitch = 0;
+	uint16 AimYaw = 0;
+	uint16 Direction = 0;
+
+	/** Speed in cm/s */
+	uint16 Speed = 0;
+
+	uint8 Flags = 0;
+
+	static FHeistReplayCharacterState FromCharacter(const AHeistFPSCharacter& Character);
+
+	void ApplyToCharacter(AHeistFPSCharacter& Character) const;
+
+	/** Field groups that differ from Other */
+	uint8 DiffMask(const FHeistReplayCharacterState& Other) const;
+};
+
+struct FHeistReplayHeader
+{
+	FString MapName;
+	FString URL;
+	int64 StartTimeTicks = 0;
+	float SampleRate = 0.0f;
+	float KeyframeInterval = 0.0f;
+};
+
+struct FHeistReplayKeyframe
+{
+	uint32 TimeMs = 0;
+	uint64 Offset = 0;
+};
+
+/** Shot recorded from AWeaponBase::MulticastFire */
+struct FHeistReplayShot
+{
+	uint16 CharacterId = 0;
+	uint16 PackedShot = 0;
+	uint16 AimPitch = 0;
+	uint16 AimYaw = 0;
+};
+
+/**
+ * Encodes replay records into a byte buffer. The owner moves Buffer out in chunks and writes it to disk,
+ * adding the flushed size to BaseOffset so keyframe offsets stay absolute.
+ */
+class HEISTFPS_API FHeistReplayEncoder
+{
+public:
+	TArray<uint8> Buffer;
+
+	void WriteHeader(const FHeistReplayHeader& Header);
+
+	/** Writes changed characters as a delta frame, or every character if bKeyframe */
+	void WriteFrame(uint32 TimeMs, const TArray<TPair<uint16, FHeistReplayCharacterState>>& States, bool bKeyframe);
+
+	void WriteShot(uint32 TimeMs, const FHeistReplayShot& Shot);
+	void WriteCharacterAdded(uint32 TimeMs, uint16 CharacterId, const FString& Name);
+	void WriteCharacterRemoved(uint32 TimeMs, uint16 CharacterId);
+
+	/** Writes the keyframe index and footer - the encoder must not be used afterwards */
+	void WriteFooter(uint32 DurationMs);
+
+	/** Moves the pending bytes out for writing */
+	TArray<uint8> TakeChunk();
+
+	uint64 GetOffset() const { return BaseOffset + Buffer.Num(); }
+
+private:
+	TMap<uint16, FHeistReplayCharacterState> Baselines;
+	TMap<uint16, FString> Names;
+	TArray<FHeistReplayKeyframe> Keyframes;
+	uint64 BaseOffset = 0;
+	uint32 LastTimeMs = 0;
+
+	void WriteRecordStart(EHeistReplayRecord Type, uint32 TimeMs);
+	void WriteCharacter(uint16 CharacterId, const FHeistReplayCharacterState& State, const FHeistReplayCharacterState& Baseline, uint8 Mask);
+	void WriteVarUInt(uint32 Value);
+	void WriteVarInt(int32 Value);
+	void WriteString(const FString& Value);
+
+	template<typename T>
+	void WriteRaw(T Value)
+	{
+		Buffer.Append(reinterpret_cast<const uint8*>(&Value), sizeof(T));
+	}
+};
+
+/**
+ * Reads a replay through a memory mapped view of the file. SeekTo jumps to the nearest keyframe at or
+ * before the requested time and decodes forward, so scrubbing never decodes more than one keyframe interval.
+ * A recording cut off before its footer, by a crash or a kill, is opened by scanning its records for keyframes.
+ */
+class HEISTFPS_API FHeistReplayReader
+{
+public:
+	FHeistReplayReader();
+	~FHeistReplayReader();
+
+	bool Open(const FString& Path);
+	void Close();
+
+	bool IsOpen() const { return Data != nullptr; }
+
+	const FHeistReplayHeader& GetHeader() const { return Header; }
+	uint32 GetDurationMs() const { return DurationMs; }
+	uint32 GetCurrentTimeMs() const { return CurrentTimeMs; }
+
+	/** Restarts decoding from the keyframe at or before TimeMs and advances to TimeMs without reporting shots */
+	bool SeekTo(uint32 TimeMs);
+
+	/** Decodes records up to TimeMs, reporting shots passed on the way */
+	void AdvanceTo(uint32 TimeMs, TFunctionRef<void(const FHeistReplayShot&)> OnShot);
+
+	const TMap<uint16, FHeistReplayCharacterState>& GetStates() const { return States; }
+	const TMap<uint16, FString>& GetNames() const { return Names; }
+
+private:
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	const uint8* Data = nullptr;
+	int64 RecordsBegin = 0;
+	int64 RecordsEnd = 0;
+	int64 Cursor = 0;
+
+	FHeistReplayHeader Header;
+	TArray<FHeistReplayKeyframe> Keyframes;
+	uint32 DurationMs = 0;
+
+	/** Playback clock - the last time advanced or seeked to */
+	uint32 CurrentTimeMs = 0;
+
+	/** Time of the last record decoded, which delta record times are relative to */
+	uint32 LastRecordTimeMs = 0;
+
+	/** Set when a read runs past RecordsEnd */
+	bool bReadPastEnd = false;
+
+	TMap<uint16, FHeistReplayCharacterState> States;
+	TMap<uint16, FString> Names;
+
+	bool ReadHeader();
+	bool ReadIndex(int64 FileSize);
+	bool ScanForKeyframes(int64 FileSize);
+
+	/** Decodes the payload of a record whose type and time have been read - false for an unknown type */
+	bool ReadRecord(EHeistReplayRecord Type, TFunctionRef<void(const FHeistReplayShot&)> OnShot);
+	void ReadCharacter(bool bKeyframe);
+	bool ReadVarUInt(uint32& OutValue);
+	int32 ReadVarInt();
+	FString ReadString();
+
+	template<typename T>
+	T ReadRaw()
+	{
+		T Value = T();
+		if (Cursor + static_cast<int64>(sizeof(T)) <= RecordsEnd)
+		{
+			FMemory::Memcpy(&Value, Data + Cursor, sizeof(T));
+		}
+		else
+		{
+			bReadPastEnd = true;
+		}
+		Cursor += sizeof(T);
+		return Value;
+	}
+};
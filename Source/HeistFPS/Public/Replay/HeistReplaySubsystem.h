@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "UObject/ObjectKey.h"
+#include "Async/Future.h"
+#include "Replay/HeistReplayFormat.h"
+#include "HeistReplaySubsystem.generated.h"
+
+class AHeistFPSCharacter;
+class AWeaponBase;
+class IFileHandle;
+
+/**
+ * Records character transforms, anim state and shots into a compact .hreplay file under Saved/Replays,
+ * and plays them back in a standalone world with scrubbing through keyframe checkpoints.
+ *
+ * Record with heist.Replay.Record / heist.Replay.Stop, or from world start with -HeistRecordReplay.
+ * Play with heist.Replay.Play <File>, then heist.Replay.Seek <Seconds> and heist.Replay.Pause.
+ */
+UCLASS(Config = Game)
+class HEISTFPS_API UHeistReplaySubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+
+	void StartRecording();
+	void StopRecording();
+	bool IsRecording() const { return FileHandle.IsValid(); }
+
+	/** Records a shot fired by Weapon's instigator if a replay is being recorded in its world */
+	static void RecordShot(const AWeaponBase* Weapon, uint16 PackedShot, uint16 AimPitch, uint16 AimYaw);
+
+	/** Opens File (a path, or a name under Saved/Replays) and spawns puppets for its characters */
+	bool StartPlayback(const FString& File);
+	void StopPlayback();
+	void SeekPlayback(float Seconds);
+	void TogglePlaybackPaused() { bPlaybackPaused = !bPlaybackPaused; }
+	bool IsPlaying() const { return Reader.IsOpen(); }
+
+	/** Character samples written per second */
+	UPROPERTY(Config)
+	float SampleRate = 20.0f;
+
+	/** Seconds between keyframes - the longest span a seek has to decode */
+	UPROPERTY(Config)
+	float KeyframeInterval = 2.0f;
+
+	/** Encoded bytes buffered before a chunk is handed to the writer thread */
+	UPROPERTY(Config)
+	int32 ChunkBytes = 64 * 1024;
+
+	/** Replay files kept on disk - the oldest are deleted when a new recording starts */
+	UPROPERTY(Config)
+	int32 MaxReplays = 10;
+
+	/** Character class spawned as playback puppets - defaults to the game mode's pawn class */
+	UPROPERTY(Config)
+	TSoftClassPtr<AHeistFPSCharacter> PuppetClass;
+
+private:
+	/********************************************************************
+					RECORDING
+	*********************************************************************/
+	FHeistReplayEncoder Encoder;
+	TUniquePtr<IFileHandle> FileHandle;
+	FString RecordingPath;
+
+	/** Last chunk handed to the writer thread, completed before the next one starts */
+	TFuture<void> PendingWrite;
+
+	/** Replay ids of characters seen in the last sample */
+	TMap<FObjectKey, uint16> CharacterIds;
+	uint16 NextCharacterId = 0;
+
+	double RecordStartTime = 0.0;
+	float TimeSinceSample = 0.0f;
+	float TimeSinceKeyframe = 0.0f;
+
+	/** Reused between samples to avoid allocating every tick */
+	TArray<TPair<uint16, FHeistReplayCharacterState>> SampleStates;
+
+	uint32 GetRecordTimeMs() const;
+	void RecordSample();
+	void FlushChunk();
+
+	/********************************************************************
+					PLAYBACK
+	*********************************************************************/
+	FHeistReplayReader Reader;
+	TMap<uint16, TWeakObjectPtr<AHeistFPSCharacter>> Puppets;
+	double PlaybackTimeMs = 0.0;
+	bool bPlaybackPaused = false;
+
+	void UpdatePuppets();
+	AHeistFPSCharacter* SpawnPuppet();
+	void PlayShot(const FHeistReplayShot& Shot);
+};
@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "Engine/EngineTypes.h"
+#include "HeistProjectileSubsystem.generated.h"
+
+/** Flight parameters for rounds fired by a weapon */
+USTRUCT(BlueprintType)
+struct FHeistBallistics
+{
+	GENERATED_BODY()
+public:
+	/** Initial speed in cm/s */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	float MuzzleSpeed = 40000.0f;
+
+	/** Multiplier for world gravity */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	float GravityScale = 1.0f;
+
+	/** Quadratic drag - deceleration is Drag * speed^2 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	float Drag = 0.000002f;
+
+	/** Seconds before a round that has not hit anything is removed */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+	float MaxLifetime = 3.0f;
+};
+
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnHeistProjectileImpact, AActor* /*Instigator*/, const FHitResult& /*Hit*/);
+
+/**
+ * Simulates every in-flight round of a world in contiguous arrays instead of one actor per bullet.
+ * Rounds are integrated with fixed sub-steps for gravity and drag, then traced once per tick along
+ * the distance they covered, in batches spread over worker threads. The server owns authoritative rounds; clients spawn cosmetic copies from
+ * the fire multicast and extrapolate them locally.
+ */
+UCLASS()
+class HEISTFPS_API UHeistProjectileSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Spawns a round. Only authoritative rounds report impacts through OnProjectileImpact. */
+	void SpawnProjectile(const FVector& Origin, const FVector& Direction, const FHeistBallistics& Ballistics, AActor* Instigator, bool bAuthoritative, float ExtrapolateSeconds = 0.0f);
+
+	/** Advances all rounds by DeltaTime - called from Tick, exposed for benchmarks */
+	void Simulate(float DeltaTime);
+
+	int32 GetNumProjectiles() const { return Positions.Num(); }
+
+	/** Removes every round without reporting impacts */
+	void ClearProjectiles();
+
+	/** Current positions of all rounds, for tracer rendering */
+	const TArray<FVector>& GetPositions() const { return Positions; }
+
+	/** Broadcast on the server when an authoritative round hits something */
+	FOnHeistProjectileImpact OnProjectileImpact;
+
+	/** Longest step used when integrating gravity and drag */
+	float MaxSubstepTime = 1.0f / 60.0f;
+
+	/** Rounds integrated and traced by one worker task */
+	int32 TraceBatchSize = 256;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return !IsTemplate() && Positions.Num() > 0; }
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override;
+
+private:
+	TArray<FVector> Positions;
+	TArray<FVector> Velocities;
+	TArray<float> GravityZ;
+	TArray<float> Drags;
+	TArray<float> RemainingLifetimes;
+	TArray<TWeakObjectPtr<AActor>> Instigators;
+	TArray<bool> Authoritative;
+
+	/** Per-tick scratch for the batched traces, kept to avoid reallocating */
+	TArray<AActor*> TraceInstigators;
+	TArray<FHitResult> TraceHits;
+	TArray<bool> TraceBlocked;
+
+	/** Removes round Index by swapping the last round into its slot */
+	void RemoveProjectile(int32 Index);
+};
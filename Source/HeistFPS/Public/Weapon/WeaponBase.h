@@ -4,8 +4,35 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Engine/NetSerialization.h"
+#include "Weapon/HeistProjectileSubsystem.h"
+#include "Game/HeistDamageSubsystem.h"
 #include "WeaponBase.generated.h"
 
+// Spread and recoil of one shot, derived from the weapon's seed and the shot index
+struct FHeistShotPattern
+{
+	float SpreadPitch = 0.0f;
+	float SpreadYaw = 0.0f;
+	float RecoilPitch = 0.0f;
+	float RecoilYaw = 0.0f;
+};
+
+// Draws shot patterns from a seed and the spread and recoil settings, with no weapon needed
+struct FHeistShotPatternGenerator
+{
+	int32 Seed = 0;
+	float HipSpreadDegrees = 2.0f;
+	float ADSSpreadDegrees = 0.5f;
+	float RecoilPitchDegrees = 0.6f;
+	float RecoilYawDegrees = 0.25f;
+
+	FHeistShotPattern Generate(uint16 ShotIndex, bool bAimDownSight) const;
+
+	// CRC of the draws for the first Count shots, alternating hip and ADS
+	uint32 Checksum(int32 Count) const;
+};
+
 UCLASS()
 class HEISTFPS_API AWeaponBase : public AActor
 {
@@ -21,9 +48,74 @@ public:
 	// Handle cosmetic aspects of weapon firing
 	virtual void SimulateWeaponFire();
 
+	// Reports replicated state changes to net telemetry
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
 	/** Returns FollowCamera subobject **/
 	FORCEINLINE class UCameraComponent* GetADSCamera() const { return ADSCamera; }
 
+	/** Returns flight parameters for rounds fired by this weapon **/
+	FORCEINLINE const FHeistBallistics& GetBallistics() const { return Ballistics; }
+
+	/** Returns damage dealt by rounds fired from this weapon **/
+	FORCEINLINE const FHeistDamageProfile& GetDamageProfile() const { return DamageProfile; }
+
+	// World location rounds are fired from
+	FVector GetMuzzleLocation() const;
+
+	// Spawn event for remote clients - they play FX and simulate their own copy of the round
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastFire(uint16 PackedShot, uint16 AimPitch, uint16 AimYaw);
+
+	// Starts the next shot epoch at index 0 - called on each equip by the owning client and the server
+	void StartShotEpoch();
+
+	// Restarts the shot sequence at Epoch
+	void ResetShotSequence(uint8 Epoch = 0);
+
+	FORCEINLINE uint8 GetShotEpoch() const { return ShotEpoch; }
+
+	// True if Epoch is ahead of this weapon's epoch, allowing for the wrap
+	bool IsNewerShotEpoch(uint8 Epoch) const;
+
+	// Server - the client reported equipping into Epoch. Only shots move the sequence there, so shots still in
+	// flight from an earlier epoch are kept, but shots up to Epoch stay newer however many equips they skip.
+	void ExtendShotEpochHorizon(uint8 Epoch);
+
+	// True if Epoch is newer than every epoch the server has heard of from requests or shots
+	bool IsBeyondShotEpochHorizon(uint8 Epoch) const;
+
+	// Returns the next shot index on the firing client
+	uint16 ConsumeShotIndex();
+
+	// Server check of a client's packed shot. A newer epoch restarts the sequence, which covers an
+	// unequip and re-equip the server never saw. Older epochs, replays and duplicates are rejected.
+	bool AcceptShot(uint16 PackedShot);
+
+	// Deterministic spread and recoil for ShotIndex - identical on every machine sharing SpreadSeed
+	FHeistShotPattern GetShotPattern(uint16 ShotIndex, bool bAimDownSight) const;
+
+	// Generator for this weapon's seed and accuracy settings
+	FHeistShotPatternGenerator GetShotPatternGenerator() const;
+
+	// Aim rotation with the shot's spread applied
+	static FVector GetShotDirection(const FRotator& Aim, const FHeistShotPattern& Pattern);
+
+	// Packs an 11 bit shot index, a 4 bit epoch and the ADS flag into the two bytes sent with fire RPCs.
+	// The server only takes the ADS flag as a hint and fires with its own aim state.
+	static constexpr uint16 ShotIndexMask = 0x07FF;
+	static constexpr uint8 ShotEpochMask = 0x0F;
+	static uint16 PackShot(uint16 ShotIndex, uint8 Epoch, bool bAimDownSight) { return (ShotIndex & ShotIndexMask) | ((Epoch & ShotEpochMask) << 11) | (bAimDownSight ? 0x8000 : 0); }
+	static uint16 UnpackShotIndex(uint16 PackedShot) { return PackedShot & ShotIndexMask; }
+	static uint8 UnpackShotEpoch(uint16 PackedShot) { return (PackedShot >> 11) & ShotEpochMask; }
+	static bool UnpackAimDownSight(uint16 PackedShot) { return (PackedShot & 0x8000) != 0; }
+
+	// CRC of the default weapon's spread and recoil draws for Seed - compared across client and server builds
+	static uint32 ChecksumShotSequence(int32 Seed, int32 Count);
+
+	/** Property replication */
+	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
@@ -46,6 +138,54 @@ protected:
 
 	UPROPERTY(VisibleAnywhere, Category = Camera)
 	class UCameraComponent* ADSCamera;
+
+	// Flight parameters for rounds simulated by UHeistProjectileSubsystem
+	UPROPERTY(EditDefaultsOnly, Category = Ballistics)
+	FHeistBallistics Ballistics;
+
+	// Maximum spread from the aim direction when firing from the hip, in degrees
+	UPROPERTY(EditDefaultsOnly, Category = Accuracy)
+	float HipSpreadDegrees = 2.0f;
+
+	// Maximum spread from the aim direction when aiming down sights, in degrees
+	UPROPERTY(EditDefaultsOnly, Category = Accuracy)
+	float ADSSpreadDegrees = 0.5f;
+
+	// Upward kick per shot, in degrees
+	UPROPERTY(EditDefaultsOnly, Category = Accuracy)
+	float RecoilPitchDegrees = 0.6f;
+
+	// Maximum sideways kick per shot, in degrees
+	UPROPERTY(EditDefaultsOnly, Category = Accuracy)
+	float RecoilYawDegrees = 0.25f;
+
+	// Damage, headshot multiplier and falloff of rounds from this weapon
+	UPROPERTY(EditDefaultsOnly, Category = Ballistics)
+	FHeistDamageProfile DamageProfile;
+
+	// Crowd NPCs within this distance of a shot hear it
+	UPROPERTY(EditDefaultsOnly, Category = Accuracy)
+	float NoiseRadius = 3000.0f;
+
+	// Seed for spread and recoil, re-rolled by the server on every equip
+	UPROPERTY(Replicated)
+	int32 SpreadSeed = 0;
+
+	// Seed the next equip switches to - sent to the owner early so its predicted shots match the server's
+	UPROPERTY(Replicated)
+	int32 NextSpreadSeed = 0;
+
+	// Bumped on every equip - the firing client's current epoch, or on the server the newest one it has accepted
+	uint8 ShotEpoch = 0;
+
+	// Newest epoch the server has heard of - never behind ShotEpoch, and equal to it on the firing client
+	uint8 ShotEpochHorizon = 0;
+
+	// Next shot index on the firing client
+	uint16 NextShotIndex = 0;
+
+	// Last shot index the server accepted in ShotEpoch
+	uint16 LastAcceptedShotIndex = ShotIndexMask;
 	
 
 private:	